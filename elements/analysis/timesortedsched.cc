@@ -24,12 +24,12 @@
 #include <click/args.hh>
 #include <click/router.hh>
 #include <click/heap.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
 TimeSortedSched::TimeSortedSched()
-    : _pkt(0), _npkt(0), _input(0), _nready(0),
-      _notifier(Notifier::SEARCH_CONTINUE_WAKE), _buffer(1),
-      _well_ordered(true)
+    : _pkt(0), _npkt(0), _input(0), _ready(0), _nready(0), _map_words(0),
+      _pending(0), _buffer(1), _bounded(false), _well_ordered(true)
 {
 }
 
@@ -41,7 +41,7 @@ void *
 TimeSortedSched::cast(const char *n)
 {
     if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
-	return &_notifier;
+	return static_cast<Notifier *>(&_notifier);
     else
 	return Element::cast(n);
 }
@@ -54,6 +54,7 @@ TimeSortedSched::configure(Vector<String> &conf, ErrorHandler *errh)
     if (Args(conf, this, errh)
 	.read("STOP", _stop)
 	.read("BUFFER", _buffer)
+	.read("LATENESS", _lateness).read_status(_bounded)
 	.complete() < 0)
 	return -1;
     if (_buffer <= 0)
@@ -64,16 +65,26 @@ TimeSortedSched::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 TimeSortedSched::initialize(ErrorHandler *errh)
 {
+    _map_words = (ninputs() + map_bits - 1) / map_bits;
     _pkt = new packet_s[ninputs() * _buffer];
     _input = new input_s[ninputs()];
-    if (!_pkt || !_input)
+    _ready = new int[ninputs()];
+    _pending = new atomic_uint32_t[_map_words];
+    if (!_pkt || !_input || !_ready || !_pending)
 	return errh->error("out of memory!");
+    _nready = 0;
     for (int i = 0; i < ninputs(); i++) {
-	_input[i].signal = Notifier::upstream_empty_signal(this, i, &_notifier);
-	_input[i].space = _buffer;
-	_input[i].ready = i;
+	input_s &is = _input[i];
+	is.owner = this;
+	is.port = i;
+	is.space = _buffer;
+	is.ready_pos = -1;
+	is.signal = Notifier::upstream_empty_signal(this, i, input_wake, &is);
+	add_ready(i);
     }
-    _nready = ninputs();
+    for (int w = 0; w < _map_words; w++)
+	_pending[w] = 0;
+    _pending_any = 0;
     return 0;
 }
 
@@ -84,55 +95,124 @@ TimeSortedSched::cleanup(CleanupStage)
 	_pkt[i].p->kill();
     delete[] _pkt;
     delete[] _input;
+    delete[] _ready;
+    delete[] _pending;
 }
 
-Packet*
-TimeSortedSched::pull(int)
+inline void
+TimeSortedSched::add_ready(int i)
 {
-    bool signals_on = false;
-    // first maybe fill in buffer
-    for (int rpos = _nready - 1; rpos >= 0; --rpos) {
-	int i = _input[rpos].ready;
-	input_s &is = _input[i];
-	if (is.signal) {
-	    signals_on = true;
-	    while ((_pkt[_npkt].p = input(i).pull())) {
-		_pkt[_npkt].input = i;
-		++_npkt;
-		push_heap(_pkt, _pkt + _npkt, heap_less());
-		--is.space;
-		if (!is.space) {
-		    _input[rpos].ready = _input[_nready - 1].ready;
-		    --_nready;
-		    break;
-		}
-	    }
+    _input[i].ready_pos = _nready;
+    _ready[_nready] = i;
+    ++_nready;
+}
+
+inline void
+TimeSortedSched::remove_ready(int i)
+{
+    int pos = _input[i].ready_pos;
+    int last = _ready[_nready - 1];
+    _ready[pos] = last;
+    _input[last].ready_pos = pos;
+    _input[i].ready_pos = -1;
+    --_nready;
+}
+
+void
+TimeSortedSched::input_wake(void *user_data, Notifier *)
+{
+    // Possibly called from another thread: note the input, and let the next
+    // pull refill it.
+    input_s *is = static_cast<input_s *>(user_data);
+    TimeSortedSched *tss = is->owner;
+    tss->_pending[is->port / map_bits] |= 1U << (is->port % map_bits);
+    tss->_pending_any = 1;
+    tss->_notifier.wake();
+}
+
+void
+TimeSortedSched::wake_inputs()
+{
+    for (int w = 0; w < _map_words; w++) {
+	if (!_pending[w].value())
+	    continue;
+	for (uint32_t bits = _pending[w].swap(0); bits; bits &= bits - 1) {
+	    int i = w * map_bits + ffs_lsb(bits) - 1;
+	    if (_input[i].space && _input[i].ready_pos < 0)
+		add_ready(i);
 	}
     }
+}
+
+void
+TimeSortedSched::refill(int i)
+{
+    input_s &is = _input[i];
+    while (Packet *p = input(i).pull()) {
+	_pkt[_npkt].p = p;
+	_pkt[_npkt].input = i;
+	++_npkt;
+	push_heap(_pkt, _pkt + _npkt, heap_less());
+	is.last = p->timestamp_anno();
+	if (!--is.space) {
+	    remove_ready(i);
+	    return;
+	}
+    }
+    // An input whose notifier has gone to sleep waits for input_wake().
+    if (!is.signal)
+	remove_ready(i);
+}
+
+bool
+TimeSortedSched::lagging(const Timestamp &ts) const
+{
+    // Only active inputs with nothing buffered can still produce a packet
+    // older than ts; they are all on the ready list.
+    for (int r = 0; r < _nready; ++r) {
+	const input_s &is = _input[_ready[r]];
+	if (is.space == _buffer
+	    && (!is.last || is.last + _lateness < ts))
+	    return true;
+    }
+    return false;
+}
+
+Packet*
+TimeSortedSched::pull(int)
+{
+    if (_pending_any.value() && _pending_any.swap(0))
+	wake_inputs();
+
+    // refill inputs with buffer space; refill() may remove its input from
+    // the ready list, so walk it backwards
+    for (int rpos = _nready - 1; rpos >= 0; --rpos)
+	refill(_ready[rpos]);
 
-    // then maybe emit a packet
-    _notifier.set_active(_npkt > 0 || signals_on);
     if (_npkt > 0) {
 	Packet *p = _pkt[0].p;
+	if (_bounded && lagging(p->timestamp_anno()))
+	    return 0;
 	if (p->timestamp_anno()) {
 	    if (_last_emission && p->timestamp_anno() < _last_emission)
 		_well_ordered = false;
 	    _last_emission = p->timestamp_anno();
 	}
-	input_s &is = _input[_pkt[0].input];
-	++is.space;
-	if (is.space == 1) {
-	    _input[_nready].ready = _pkt[0].input;
-	    ++_nready;
-	}
+	int i = _pkt[0].input;
+	if (++_input[i].space == 1)
+	    add_ready(i);
 	pop_heap(_pkt, _pkt + _npkt, heap_less());
 	--_npkt;
 	return p;
-    } else {
-	if (_stop && !signals_on)
+    } else if (_nready == 0) {
+	// every input is asleep
+	_notifier.sleep();
+	if (_pending_any.value())
+	    _notifier.wake();
+	else if (_stop)
 	    router()->please_stop_driver();
-	return 0;
     }
+    return 0;
 }
 
 void
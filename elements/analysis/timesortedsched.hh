@@ -3,12 +3,13 @@
 #define CLICK_TIMESORTEDSCHED_HH
 #include <click/element.hh>
 #include <click/notifier.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 
 /*
 =c
 
-TimeSortedSched(I<keywords> STOP, BUFFER)
+TimeSortedSched(I<keywords> STOP, BUFFER, LATENESS)
 
 =s timestamps
 
@@ -28,8 +29,16 @@ timestamp.  If the C<well_ordered> handler returns "false", then one or more
 packet streams did not arrive correctly sorted by timestamp, so
 TimeSortedSched emitted some packets out of order.  (But see BUFFER, below.)
 
-TimeSortedSched listens for notification from its inputs to avoid useless
-pulls, and provides notification for its output.
+TimeSortedSched keeps the buffered packets in a heap ordered by timestamp, so
+emitting a packet costs O(log I<n>) for I<n> inputs. After emitting a packet
+it refills only the input that packet came from. Inputs whose notifiers say
+they are empty are not pulled again until the notifiers wake up, so idle or
+exhausted inputs cost nothing per packet. TimeSortedSched provides
+notification for its output.
+
+By default TimeSortedSched emits the oldest buffered packet even if some
+other input, which has no packet buffered, might soon produce an older one.
+The LATENESS keyword bounds how far ahead of such an input the output may run.
 
 Keyword arguments are:
 
@@ -47,12 +56,22 @@ Integer. Up to BUFFER packets per input are buffered within
 TimeSortedSched. Default BUFFER is 1. Higher BUFFER values let TimeSortedSched
 cope with minor reordering in its input streams.
 
+=item LATENESS
+
+Time. If set, TimeSortedSched holds a packet with timestamp I<t> while some
+input with nothing buffered is still active and last produced a packet older
+than I<t> - LATENESS (or has produced none at all). Held packets are emitted
+once the lagging input catches up or its notifier goes to sleep. LATENESS 0
+gives a strict merge, as long as every input has an empty notifier. Inputs
+without notifiers count as always active, so a LATENESS merge can stall on
+them. Default is unset, which never holds packets.
+
 =back
 
 =n
 
-TimeSortedSched is a notifier signal, active iff any of the upstream notifiers
-are active.
+TimeSortedSched's notifier is active while it has packets buffered or some
+input it still pulls from is active.
 
 =e
 
@@ -97,6 +116,8 @@ class TimeSortedSched : public Element { public:
 
   private:
 
+    enum { map_bits = 32 };
+
     struct packet_s {
 	Packet *p;
 	int input;		// for space, consider using annotation?
@@ -107,23 +128,41 @@ class TimeSortedSched : public Element { public:
 	}
     };
     struct input_s {
+	TimeSortedSched *owner;
 	NotifierSignal signal;
+	Timestamp last;		// timestamp of the last packet pulled
+	int port;
 	int space;
-	int ready;
+	int ready_pos;		// position in _ready, or -1
     };
 
     packet_s *_pkt;
     int _npkt;
 
     input_s *_input;
+    int *_ready;		// inputs with buffer space to refill
     int _nready;
 
-    Notifier _notifier;
+    int _map_words;
+    atomic_uint32_t *_pending;	// inputs whose notifiers woke up
+    atomic_uint32_t _pending_any;
+
+    ActiveNotifier _notifier;
     int _buffer;
+    Timestamp _lateness;
     Timestamp _last_emission;
+    bool _bounded;
     bool _stop;
     bool _well_ordered;
 
+    inline void add_ready(int i);
+    inline void remove_ready(int i);
+    void wake_inputs();
+    void refill(int i);
+    bool lagging(const Timestamp &ts) const;
+
+    static void input_wake(void *user_data, Notifier *);
+
 };
 
 CLICK_ENDDECLS
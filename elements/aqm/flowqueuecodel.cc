@@ -0,0 +1,386 @@
+/*
+ * flowqueuecodel.{cc,hh} -- flow-queueing CoDel (FQ-CoDel) element
+ */
+
+#include <click/config.h>
+#include "flowqueuecodel.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <click/packet_anno.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+FlowQueueCoDel::FlowQueueCoDel()
+    : _len(0), _highwater_len(0), _codel_drops(0), _overlimit_drops(0),
+      _ecn_marks(0), _new_flow_count(0), _sleepiness(0)
+{
+    _new.head = _new.tail = _old.head = _old.tail = -1;
+}
+
+FlowQueueCoDel::~FlowQueueCoDel()
+{
+}
+
+void *
+FlowQueueCoDel::cast(const char *n)
+{
+    if (strcmp(n, "FlowQueueCoDel") == 0)
+	return this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+FlowQueueCoDel::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    unsigned capacity = 10240, nflows = 1024, quantum = 1514;
+    Timestamp target = Timestamp::make_msec(0, 5);
+    Timestamp interval = Timestamp::make_msec(0, 100);
+    bool ecn = true;
+    uint32_t perturb = click_random();
+
+    if (Args(conf, this, errh)
+	.read_p("CAPACITY", capacity)
+	.read("FLOWS", nflows)
+	.read("QUANTUM", quantum)
+	.read("TARGET", target)
+	.read("INTERVAL", interval)
+	.read("ECN", ecn)
+	.read("PERTURB", perturb)
+	.complete() < 0)
+	return -1;
+    if (capacity == 0 || nflows == 0 || nflows > 65536 || quantum == 0)
+	return errh->error("bad CAPACITY, FLOWS, or QUANTUM");
+    if (interval <= Timestamp())
+	return errh->error("INTERVAL must be positive");
+
+    _capacity = capacity;
+    _nflows = nflows;
+    _quantum = quantum;
+    _target = target.nsecval();
+    _interval = interval.nsecval();
+    _ecn = ecn;
+    _perturb = perturb;
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+int
+FlowQueueCoDel::initialize(ErrorHandler *)
+{
+    Flow f;
+    memset(&f, 0, sizeof(f));
+    f.next = -1;
+    _flows.assign(_nflows, f);
+    _new.head = _new.tail = _old.head = _old.tail = -1;
+    _maxpacket = 0;
+    _len = _highwater_len = 0;
+    return 0;
+}
+
+void
+FlowQueueCoDel::cleanup(CleanupStage)
+{
+    for (Flow *f = _flows.begin(); f != _flows.end(); ++f)
+	while (Packet *p = flow_pop(*f))
+	    p->kill();
+}
+
+int
+FlowQueueCoDel::classify(const Packet *p) const
+{
+    uint32_t h = _perturb;
+    if (p->has_network_header()
+	&& p->network_length() >= (int) sizeof(click_ip)) {
+	const click_ip *iph = p->ip_header();
+	if (iph->ip_v == 4) {
+	    h = (h ^ iph->ip_src.s_addr) * 0x9E3779B1U;
+	    h = (h ^ iph->ip_dst.s_addr) * 0x9E3779B1U;
+	    h = (h ^ iph->ip_p) * 0x9E3779B1U;
+	    if (IP_FIRSTFRAG(iph) && p->has_transport_header()
+		&& p->transport_length() >= 4
+		&& (iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP
+		    || iph->ip_p == IP_PROTO_UDPLITE || iph->ip_p == IP_PROTO_DCCP))
+		h = (h ^ *reinterpret_cast<const uint32_t *>(p->transport_header())) * 0x9E3779B1U;
+	}
+    }
+    h ^= h >> 16;
+    // Scale to [0, _nflows) without a division.
+    return ((uint64_t) h * _nflows) >> 32;
+}
+
+inline void
+FlowQueueCoDel::list_push(FlowList &l, int fi, uint8_t which)
+{
+    Flow &f = _flows[fi];
+    f.next = -1;
+    f.list = which;
+    if (l.tail >= 0)
+	_flows[l.tail].next = fi;
+    else
+	l.head = fi;
+    l.tail = fi;
+}
+
+inline void
+FlowQueueCoDel::list_pop(FlowList &l)
+{
+    Flow &f = _flows[l.head];
+    l.head = f.next;
+    if (l.head < 0)
+	l.tail = -1;
+    f.next = -1;
+    f.list = list_none;
+}
+
+inline Packet *
+FlowQueueCoDel::flow_pop(Flow &f)
+{
+    Packet *p = f.head;
+    if (p) {
+	f.head = p->next();
+	if (!f.head)
+	    f.tail = 0;
+	p->set_next(0);
+	f.backlog -= p->length();
+	--_len;
+    }
+    return p;
+}
+
+void
+FlowQueueCoDel::drop_from_fattest()
+{
+    // As in Linux, a linear scan: overflow should be rare once CoDel is
+    // controlling each flow's queue.
+    Flow *fattest = _flows.begin();
+    for (Flow *f = _flows.begin() + 1; f != _flows.end(); ++f)
+	if (f->backlog > fattest->backlog)
+	    fattest = f;
+    if (Packet *p = flow_pop(*fattest)) {
+	p->kill();
+	++_overlimit_drops;
+    }
+}
+
+void
+FlowQueueCoDel::push(int, Packet *p)
+{
+    int fi = classify(p);
+    Flow &f = _flows[fi];
+    SET_FIRST_TIMESTAMP_ANNO(p, Timestamp::now_steady());
+    p->set_next(0);
+    if (f.tail)
+	f.tail->set_next(p);
+    else
+	f.head = p;
+    f.tail = p;
+    f.backlog += p->length();
+    if (p->length() > _maxpacket)
+	_maxpacket = p->length();
+    ++_len;
+
+    if (f.list == list_none) {
+	list_push(_new, fi, list_new);
+	f.deficit = _quantum;
+	++_new_flow_count;
+    }
+    if (_len > _capacity)
+	drop_from_fattest();
+    if (_len > _highwater_len)
+	_highwater_len = _len;
+    _empty_note.wake();
+}
+
+inline int64_t
+FlowQueueCoDel::control_law(int64_t t, uint32_t count) const
+{
+    // t + INTERVAL / sqrt(count), with 8 fraction bits in the square root
+    uint32_t c = count < 65535 ? count : 65535;
+    return t + (_interval << 8) / int_sqrt(c << 16);
+}
+
+inline Packet *
+FlowQueueCoDel::dodequeue(Flow &f, int64_t now, bool &ok_to_drop)
+{
+    ok_to_drop = false;
+    Packet *p = flow_pop(f);
+    if (!p) {
+	f.first_above = 0;
+	return 0;
+    }
+    int64_t sojourn = now - FIRST_TIMESTAMP_ANNO(p).nsecval();
+    if (sojourn < _target || f.backlog <= _maxpacket)
+	f.first_above = 0;
+    else if (!f.first_above)
+	f.first_above = now + _interval;
+    else if (now >= f.first_above)
+	ok_to_drop = true;
+    return p;
+}
+
+inline bool
+FlowQueueCoDel::ecn_capable(Packet *p) const
+{
+    if (!_ecn || !p->has_network_header()
+	|| p->network_length() < (int) sizeof(click_ip))
+	return false;
+    const click_ip *iph = p->ip_header();
+    return iph->ip_v == 4 && (iph->ip_tos & IP_ECNMASK) != IP_ECN_NOT_ECT;
+}
+
+Packet *
+FlowQueueCoDel::mark_ce(Packet *p)
+{
+    ++_ecn_marks;
+    if ((p->ip_header()->ip_tos & IP_ECNMASK) == IP_ECN_CE)
+	return p;
+    WritablePacket *q = p->uniqueify();
+    if (!q)
+	return 0;
+    click_ip *iph = q->ip_header();
+    uint16_t old_hw = *reinterpret_cast<uint16_t *>(iph);
+    iph->ip_tos |= IP_ECN_CE;
+    click_update_in_cksum(&iph->ip_sum, old_hw, *reinterpret_cast<uint16_t *>(iph));
+    return q;
+}
+
+Packet *
+FlowQueueCoDel::codel_dequeue(Flow &f, int64_t now)
+{
+    // RFC 8289's dequeue, with ECN marking as in RFC 8290.
+    bool ok_to_drop;
+    Packet *p = dodequeue(f, now, ok_to_drop);
+    if (!p) {
+	f.dropping = false;
+	return 0;
+    }
+
+    if (f.dropping) {
+	if (!ok_to_drop)
+	    f.dropping = false;
+	while (f.dropping && now >= f.drop_next) {
+	    ++f.count;
+	    if (ecn_capable(p)) {
+		f.drop_next = control_law(f.drop_next, f.count);
+		return mark_ce(p);
+	    }
+	    p->kill();
+	    ++_codel_drops;
+	    p = dodequeue(f, now, ok_to_drop);
+	    if (!ok_to_drop)
+		f.dropping = false;
+	    else
+		f.drop_next = control_law(f.drop_next, f.count);
+	}
+    } else if (ok_to_drop) {
+	if (ecn_capable(p))
+	    p = mark_ce(p);
+	else {
+	    p->kill();
+	    ++_codel_drops;
+	    p = dodequeue(f, now, ok_to_drop);
+	}
+	f.dropping = true;
+	// Resume near the previous drop rate if we were dropping recently.
+	uint32_t delta = f.count - f.lastcount;
+	if (delta > 1 && now - f.drop_next < 16 * _interval)
+	    f.count = delta;
+	else
+	    f.count = 1;
+	f.lastcount = f.count;
+	f.drop_next = control_law(now, f.count);
+    }
+    return p;
+}
+
+Packet *
+FlowQueueCoDel::pull_empty()
+{
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+	if (_len)
+	    _empty_note.wake();
+    } else
+	++_sleepiness;
+    return 0;
+}
+
+Packet *
+FlowQueueCoDel::pull(int)
+{
+    int64_t now = Timestamp::now_steady().nsecval();
+    while (1) {
+	FlowList &l = _new.head >= 0 ? _new : _old;
+	int fi = l.head;
+	if (fi < 0)
+	    return pull_empty();
+	Flow &f = _flows[fi];
+
+	if (f.deficit <= 0) {
+	    f.deficit += _quantum;
+	    list_pop(l);
+	    list_push(_old, fi, list_old);
+	    continue;
+	}
+
+	Packet *p = codel_dequeue(f, now);
+	if (!p) {
+	    if (f.head)		// mark_ce() ran out of memory
+		continue;
+	    // An emptied new flow goes to the back of the old list, so a flow
+	    // cannot stay "new" by sending one packet at a time.
+	    list_pop(l);
+	    if (&l == &_new && _old.head >= 0)
+		list_push(_old, fi, list_old);
+	    continue;
+	}
+
+	f.deficit -= p->length();
+	_sleepiness = 0;
+	return p;
+    }
+}
+
+String
+FlowQueueCoDel::read_handler(Element *e, void *thunk)
+{
+    FlowQueueCoDel *fq = static_cast<FlowQueueCoDel *>(e);
+    switch ((intptr_t) thunk) {
+    case 0:
+	return String(fq->_codel_drops + fq->_overlimit_drops);
+    default: {
+	StringAccum sa;
+	unsigned active = 0;
+	for (Flow *f = fq->_flows.begin(); f != fq->_flows.end(); ++f)
+	    if (f->head)
+		++active;
+	sa << fq->_len << " packets queued\n"
+	   << active << " flows with packets\n"
+	   << fq->_new_flow_count << " new flows\n"
+	   << fq->_codel_drops << " CoDel drops\n"
+	   << fq->_overlimit_drops << " overlimit drops\n"
+	   << fq->_ecn_marks << " ECN marks\n";
+	return sa.take_string();
+    }
+    }
+}
+
+void
+FlowQueueCoDel::add_handlers()
+{
+    add_data_handlers("length", Handler::OP_READ, &_len);
+    add_data_handlers("highwater_length", Handler::OP_READ, &_highwater_len);
+    add_data_handlers("capacity", Handler::OP_READ, &_capacity);
+    add_data_handlers("ecn_marks", Handler::OP_READ, &_ecn_marks);
+    add_read_handler("drops", read_handler, 0);
+    add_read_handler("stats", read_handler, 1);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(int64)
+EXPORT_ELEMENT(FlowQueueCoDel)
@@ -0,0 +1,191 @@
+#ifndef CLICK_FLOWQUEUECODEL_HH
+#define CLICK_FLOWQUEUECODEL_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/timestamp.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+FlowQueueCoDel([CAPACITY, I<KEYWORDS>])
+
+=s aqm
+
+stores packets in per-flow queues scheduled with DRR and managed with P<CoDel>
+
+=d
+
+Implements FQ-CoDel, the flow-queueing AQM of RFC 8290. FlowQueueCoDel is a
+push-to-pull queue. It hashes each packet's IPv4 addresses, protocol, and
+ports (for first fragments) into one of FLOWS sub-queues. Non-IP packets all
+share one sub-queue. The sub-queues share a single pool of CAPACITY packets.
+
+Output is scheduled by deficit round robin with a QUANTUM of bytes per
+round. Sub-queues that have just become active are served from a "new flows"
+list before the "old flows" list, so short, sparse flows see almost no
+queueing delay even when they share the element with bulk transfers.
+
+Each sub-queue runs its own CoDel state machine on the time its packets
+spend in FlowQueueCoDel. When CoDel would drop an ECN-capable IP packet,
+FlowQueueCoDel instead marks it Congestion Experienced, unless ECN is false.
+When a push overflows CAPACITY, FlowQueueCoDel drops the head packet of the
+sub-queue holding the most bytes, rather than the arriving packet.
+
+FlowQueueCoDel records each packet's arrival time in its "first timestamp"
+annotation, overwriting any previous value. It provides an empty notifier,
+so downstream tasks sleep while it is empty.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Integer. Maximum number of packets held across all sub-queues. Default is
+10240.
+
+=item FLOWS
+
+Integer. Number of sub-queues. Default is 1024.
+
+=item QUANTUM
+
+Integer. Bytes a sub-queue may send per round. Default is 1514.
+
+=item TARGET
+
+Time. CoDel target queueing delay. Default is 5ms.
+
+=item INTERVAL
+
+Time. CoDel sliding-minimum window width. Default is 100ms.
+
+=item ECN
+
+Boolean. If true, mark ECN-capable packets instead of dropping them. Default
+is true.
+
+=item PERTURB
+
+Integer. Seed mixed into the flow hash. Default is random.
+
+=back
+
+=e
+
+  ... -> FlowQueueCoDel(FLOWS 4096, TARGET 1ms, INTERVAL 20ms)
+      -> BandwidthRatedUnqueue(1Gbps) -> ...
+
+=h length read-only
+
+Returns the number of packets queued.
+
+=h highwater_length read-only
+
+Returns the largest number of packets queued at once.
+
+=h capacity read-only
+
+Returns the CAPACITY.
+
+=h drops read-only
+
+Returns the number of packets dropped, by CoDel or on overflow.
+
+=h ecn_marks read-only
+
+Returns the number of packets marked Congestion Experienced.
+
+=h stats read-only
+
+Returns human-readable statistics.
+
+=a CoDel, Queue, DRRSched
+
+RFC 8290, I<The Flow Queue CoDel Packet Scheduler and Active Queue
+Management Algorithm>. RFC 8289, I<Controlled Delay Active Queue
+Management>. */
+
+class FlowQueueCoDel : public Element { public:
+
+    FlowQueueCoDel() CLICK_COLD;
+    ~FlowQueueCoDel() CLICK_COLD;
+
+    const char *class_name() const		{ return "FlowQueueCoDel"; }
+    const char *port_count() const		{ return PORTS_1_1; }
+    const char *processing() const		{ return PUSH_TO_PULL; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+
+  private:
+
+    enum { list_none = 0, list_new = 1, list_old = 2 };
+    enum { SLEEPINESS_TRIGGER = 9 };
+
+    struct Flow {
+	Packet *head;
+	Packet *tail;
+	uint32_t backlog;	// bytes
+	int deficit;
+	int next;		// next flow on the same list
+	uint8_t list;
+	bool dropping;
+	uint32_t count;
+	uint32_t lastcount;
+	int64_t first_above;	// steady nanoseconds; 0 if below target
+	int64_t drop_next;
+    };
+
+    struct FlowList {
+	int head;
+	int tail;
+    };
+
+    Vector<Flow> _flows;
+    FlowList _new;
+    FlowList _old;
+    unsigned _capacity;
+    unsigned _nflows;
+    int _quantum;
+    int64_t _target;
+    int64_t _interval;
+    bool _ecn;
+    uint32_t _perturb;
+    uint32_t _maxpacket;
+
+    unsigned _len;
+    unsigned _highwater_len;
+    uint32_t _codel_drops;
+    uint32_t _overlimit_drops;
+    uint32_t _ecn_marks;
+    uint32_t _new_flow_count;
+    int _sleepiness;
+    ActiveNotifier _empty_note;
+
+    int classify(const Packet *p) const;
+    inline void list_push(FlowList &l, int fi, uint8_t which);
+    inline void list_pop(FlowList &l);
+    inline Packet *flow_pop(Flow &f);
+    void drop_from_fattest();
+    inline Packet *dodequeue(Flow &f, int64_t now, bool &ok_to_drop);
+    Packet *codel_dequeue(Flow &f, int64_t now);
+    inline int64_t control_law(int64_t t, uint32_t count) const;
+    inline bool ecn_capable(Packet *p) const;
+    Packet *mark_ce(Packet *p);
+    Packet *pull_empty();
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
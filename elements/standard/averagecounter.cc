@@ -28,13 +28,44 @@ AverageCounter::AverageCounter()
 {
 }
 
+uint32_t
+AverageCounter::count() const
+{
+  uint32_t count = 0;
+  for (unsigned i = 0; i != _stats.size(); ++i)
+    count += _stats[i].count;
+  return count;
+}
+
+uint32_t
+AverageCounter::byte_count() const
+{
+  uint32_t byte_count = 0;
+  for (unsigned i = 0; i != _stats.size(); ++i)
+    byte_count += _stats[i].byte_count;
+  return byte_count;
+}
+
+uint32_t
+AverageCounter::last() const
+{
+  // the latest of the threads' last packets, compared relative to _first
+  // so jiffy wraparound does no harm
+  uint32_t first = _first.value();
+  int32_t d = 0;
+  for (unsigned i = 0; i != _stats.size(); ++i)
+    if (_stats[i].count || _stats[i].last)
+      if ((int32_t) (_stats[i].last - first) > d)
+	d = _stats[i].last - first;
+  return first + d;
+}
+
 void
 AverageCounter::reset()
 {
-  _count = 0;
-  _byte_count = 0;
+  stats zero = {0, 0, 0};
+  _stats.assign(zero);
   _first = 0;
-  _last = 0;
 }
 
 int
@@ -48,8 +79,10 @@ AverageCounter::configure(Vector<String> &conf, ErrorHandler *errh)
 }
 
 int
-AverageCounter::initialize(ErrorHandler *)
+AverageCounter::initialize(ErrorHandler *errh)
 {
+  if (!_stats.initialize())
+    return errh->error("out of memory!");
   reset();
   return 0;
 }
@@ -58,12 +91,17 @@ Packet *
 AverageCounter::simple_action(Packet *p)
 {
     uint32_t jpart = click_jiffies();
-    _first.compare_swap(0, jpart);
-    if (jpart - _first >= _ignore) {
-	_count++;
-	_byte_count += p->length();
+    uint32_t first = _first.value();
+    if (unlikely(!first)) {
+	_first.compare_swap(0, jpart);
+	first = _first.value();
+    }
+    stats &s = _stats.get();
+    if (jpart - first >= _ignore) {
+	s.count++;
+	s.byte_count += p->length();
     }
-    _last = jpart;
+    s.last = jpart;
     return p;
 }
 
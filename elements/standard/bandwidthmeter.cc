@@ -23,7 +23,7 @@
 CLICK_DECLS
 
 BandwidthMeter::BandwidthMeter()
-  : _meters(0), _nmeters(0)
+  : _epoch(0), _epoch_total(0), _meters(0), _nmeters(0)
 {
 }
 
@@ -73,10 +73,36 @@ BandwidthMeter::configure(Vector<String> &conf, ErrorHandler *errh)
   return 0;
 }
 
+int
+BandwidthMeter::initialize(ErrorHandler *errh)
+{
+  if (!_totals.initialize())
+    return errh->error("out of memory!");
+  return 0;
+}
+
+void
+BandwidthMeter::update_rate(click_jiffies_t now)
+{
+  // The first thread to see a new jiffy feeds the average everything
+  // counted since the last update.
+  if (!_rate_lock.attempt())
+    return;
+  if (_epoch != now) {
+    unsigned total = 0;
+    for (unsigned i = 0; i != _totals.size(); ++i)
+      total += _totals[i];
+    _rate.update(total - _epoch_total);
+    _epoch_total = total;
+    _epoch = now;
+  }
+  _rate_lock.release();
+}
+
 void
 BandwidthMeter::push(int, Packet *p)
 {
-  _rate.update(p->length());
+  count(p->length());
 
   unsigned r = _rate.scaled_average();
   if (_nmeters < 2) {
@@ -112,7 +138,7 @@ String
 BandwidthMeter::read_rate_handler(Element *f, void *)
 {
   BandwidthMeter *c = (BandwidthMeter *)f;
-  c->_rate.update(0);
+  c->update_rate(click_jiffies());
   return cp_unparse_real2(c->scaled_rate()*c->rate_freq(), c->rate_scale());
 }
 
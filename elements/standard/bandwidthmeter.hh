@@ -2,6 +2,8 @@
 #define CLICK_BANDWIDTHMETER_HH
 #include <click/element.hh>
 #include <click/ewma.hh>
+#include <click/perthread.hh>
+#include <click/sync.hh>
 CLICK_DECLS
 
 /*
@@ -25,6 +27,11 @@ CLICK_DECLS
  * sent to output 1; and so on. If it is >= RATEI<n>, packets are sent to
  * output I<n>.
  *
+ * Each thread adds its packets to its own running total, and the moving
+ * average is brought up to date from the summed totals once per jiffy, so
+ * packets from several threads can pass through one BandwidthMeter without
+ * contending for its state.
+ *
  * =e
  *
  * This configuration fragment drops the input stream when it is generating
@@ -38,6 +45,10 @@ CLICK_DECLS
 class BandwidthMeter : public Element { protected:
 
   RateEWMA _rate;
+  PerThread<unsigned> _totals;
+  volatile click_jiffies_t _epoch;
+  unsigned _epoch_total;
+  SimpleSpinlock _rate_lock;
 
   unsigned _meter1;
   unsigned *_meters;
@@ -46,6 +57,9 @@ class BandwidthMeter : public Element { protected:
   static String meters_read_handler(Element *, void *) CLICK_COLD;
   static String read_rate_handler(Element *, void *);
 
+  void update_rate(click_jiffies_t now);
+  inline void count(unsigned amount);
+
  public:
 
   BandwidthMeter() CLICK_COLD;
@@ -60,11 +74,21 @@ class BandwidthMeter : public Element { protected:
   unsigned rate_freq() const		{ return _rate.epoch_frequency(); }
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+  int initialize(ErrorHandler *) CLICK_COLD;
   void add_handlers() CLICK_COLD;
 
   void push(int port, Packet *);
 
 };
 
+inline void
+BandwidthMeter::count(unsigned amount)
+{
+  click_jiffies_t now = click_jiffies();
+  if (now != _epoch)
+    update_rate(now);
+  _totals.get() += amount;
+}
+
 CLICK_ENDDECLS
 #endif
@@ -34,12 +34,16 @@ BandwidthRatedUnqueue::run_task(Task *)
 
     if (!_active)
 	return false;
+    if (_precise)
+	return run_paced();
 
-    _tb.refill();
+    click_jiffies_t now = click_jiffies();
+    _tb.refill(now);
 
     if (_tb.contains(tb_bandwidth_thresh)) {
 	if (Packet *p = input(0).pull()) {
 	    _tb.remove(p->length());
+	    note_release(1, p->length(), jiffy_nsec(now));
 	    _pushes++;
 	    worked = true;
 	    output(0).push(p);
@@ -49,7 +53,9 @@ BandwidthRatedUnqueue::run_task(Task *)
 		return false;	// without rescheduling
 	}
     } else {
-	_timer.schedule_after(Timestamp::make_jiffies(_tb.time_until_contains(tb_bandwidth_thresh)));
+	click_jiffies_t delay = _tb.time_until_contains(tb_bandwidth_thresh);
+	note_wait(jiffy_nsec(now + delay));
+	_timer.schedule_after(Timestamp::make_jiffies(delay));
 	_empty_runs++;
 	return false;
     }
@@ -34,8 +34,28 @@ CLICK_DECLS
  * Integer.  If specified, the capacity of the token bucket is set to this
  * value in bytes.
  *
+ * =item PRECISE
+ *
+ * Boolean.  If true, pace packets with nanosecond precision.  See
+ * RatedUnqueue.  Default is false.
+ *
+ * =item SPIN
+ *
+ * Time.  In PRECISE mode, poll for deadlines closer than this rather than
+ * sleeping.  Default is 50us.
+ *
+ * =back
+ *
  * =h rate read/write
  *
+ * =h pacing read-only
+ *
+ * Returns pacing statistics, as for RatedUnqueue.
+ *
+ * =h reset_pacing write-only
+ *
+ * Resets the pacing statistics.
+ *
  * =a RatedUnqueue, Unqueue, BandwidthShaper, BandwidthRatedSplitter */
 
 class BandwidthRatedUnqueue : public RatedUnqueue { public:
@@ -255,6 +255,31 @@ Classifier::push(int, Packet *p)
     checked_output_push(_prog.match(p), p);
 }
 
+void
+Classifier::push_batch(int, PacketBatch &batch)
+{
+    // Forward each run of packets bound for the same output as one batch.
+    PacketBatch run;
+    int run_port = -1;
+    while (Packet *p = batch.pop_front()) {
+	int port = _prog.match(p);
+	if (port != run_port && !run.empty()) {
+	    if ((unsigned) run_port < (unsigned) noutputs())
+		output(run_port).push_batch(run);
+	    else
+		run.kill();
+	}
+	run_port = port;
+	run.append(p);
+    }
+    if (!run.empty()) {
+	if ((unsigned) run_port < (unsigned) noutputs())
+	    output(run_port).push_batch(run);
+	else
+	    run.kill();
+    }
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(AlignmentInfo Classification)
 EXPORT_ELEMENT(Classifier)
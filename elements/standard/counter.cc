@@ -22,10 +22,12 @@
 #include <click/confparse.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/integers.hh>
 CLICK_DECLS
 
 Counter::Counter()
-  : _count_trigger_h(0), _byte_trigger_h(0)
+  : _epoch(0), _epoch_count(0), _epoch_byte_count(0), _use_window(false),
+    _window_timer(this), _count_trigger_h(0), _byte_trigger_h(0)
 {
 }
 
@@ -35,11 +37,37 @@ Counter::~Counter()
   delete _byte_trigger_h;
 }
 
+Counter::counter_t
+Counter::count() const
+{
+    counter_t count = 0;
+    for (unsigned i = 0; i != _stats.size(); ++i)
+	count += _stats[i].count;
+    return count;
+}
+
+Counter::counter_t
+Counter::byte_count() const
+{
+    counter_t byte_count = 0;
+    for (unsigned i = 0; i != _stats.size(); ++i)
+	byte_count += _stats[i].byte_count;
+    return byte_count;
+}
+
 void
 Counter::reset()
 {
-  _count = _byte_count = 0;
-  _count_triggered = _byte_triggered = false;
+  stats zero = {0, 0};
+  _stats.assign(zero);
+  _epoch_count = _epoch_byte_count = 0;
+  // a trigger that is not set counts as already fired
+  _count_triggered = (_count_trigger == (counter_t)(-1));
+  _byte_triggered = (_byte_trigger == (counter_t)(-1));
+  sample start = {Timestamp::now_steady(), 0, 0};
+  _rate_lock.acquire();
+  _window_start[0] = _window_start[1] = start;
+  _rate_lock.release();
 }
 
 int
@@ -48,8 +76,11 @@ Counter::configure(Vector<String> &conf, ErrorHandler *errh)
   String count_call, byte_count_call;
   if (Args(conf, this, errh)
       .read("COUNT_CALL", AnyArg(), count_call)
-      .read("BYTE_COUNT_CALL", AnyArg(), byte_count_call).complete() < 0)
+      .read("BYTE_COUNT_CALL", AnyArg(), byte_count_call)
+      .read("RATE_WINDOW", _window).read_status(_use_window).complete() < 0)
     return -1;
+  if (_use_window && !_window)
+    return errh->error("RATE_WINDOW must be positive");
 
   if (count_call) {
     IntArg ia;
@@ -81,50 +112,182 @@ Counter::initialize(ErrorHandler *errh)
     return -1;
   if (_byte_trigger_h && _byte_trigger_h->initialize_write(this, errh) < 0)
     return -1;
+  if (!_stats.initialize())
+    return errh->error("out of memory!");
   reset();
+  if (_use_window) {
+    _window_timer.initialize(this);
+    _window_timer.schedule_after(_window);
+  }
   return 0;
 }
 
-Packet *
-Counter::simple_action(Packet *p)
+void
+Counter::run_timer(Timer *)
 {
-    _count++;
-    _byte_count += p->length();
-    _rate.update(1);
-    _byte_rate.update(p->length());
+    sample s = {Timestamp::now_steady(), count(), byte_count()};
+    _rate_lock.acquire();
+    _window_start[0] = _window_start[1];
+    _window_start[1] = s;
+    _rate_lock.release();
+    _window_timer.reschedule_after(_window);
+}
 
-  if (_count == _count_trigger && !_count_triggered) {
-    _count_triggered = true;
-    if (_count_trigger_h)
-      (void) _count_trigger_h->call_write();
+void
+Counter::update_rates(click_jiffies_t now)
+{
+    // Whoever sees the new jiffy first feeds the moving averages everything
+    // counted since the last update; everyone else carries on.
+    if (!_rate_lock.attempt())
+	return;
+    if (_epoch != now) {
+	counter_t count = this->count(), byte_count = this->byte_count();
+	_rate.update(count - _epoch_count);
+	_byte_rate.update(byte_count - _epoch_byte_count);
+	_epoch_count = count;
+	_epoch_byte_count = byte_count;
+	_epoch = now;
+    }
+    _rate_lock.release();
+}
+
+void
+Counter::check_triggers(counter_t n)
+{
+  if (!_count_triggered) {
+    counter_t count = this->count();
+    if (count >= _count_trigger && count - n < _count_trigger) {
+      _count_triggered = true;
+      if (_count_trigger_h)
+	(void) _count_trigger_h->call_write();
+    }
   }
-  if (_byte_count >= _byte_trigger && !_byte_triggered) {
+  if (!_byte_triggered && byte_count() >= _byte_trigger) {
     _byte_triggered = true;
     if (_byte_trigger_h)
       (void) _byte_trigger_h->call_write();
   }
+}
 
-  return p;
+inline void
+Counter::count_packets(counter_t n, counter_t bytes)
+{
+    if (!_use_window) {
+	click_jiffies_t now = click_jiffies();
+	if (now != _epoch)
+	    update_rates(now);
+    }
+
+    stats &s = _stats.get();
+    s.count += n;
+    s.byte_count += bytes;
+
+    if (unlikely(!(_count_triggered && _byte_triggered)))
+	check_triggers(n);
+}
+
+Packet *
+Counter::simple_action(Packet *p)
+{
+    count_packets(1, p->length());
+    return p;
+}
+
+void
+Counter::push_batch(int, PacketBatch &batch)
+{
+    counter_t bytes = 0;
+    for (Packet *p = batch.first(); p; p = p->next())
+	bytes += p->length();
+    count_packets(batch.count(), bytes);
+    output(0).push_batch(batch);
+}
+
+int
+Counter::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    Packet *last = batch.last();
+    int n = input(0).pull_batch(max, batch);
+    if (n) {
+	counter_t bytes = 0;
+	for (Packet *p = last ? last->next() : batch.first(); p; p = p->next())
+	    bytes += p->length();
+	count_packets(n, bytes);
+    }
+    return n;
 }
 
 
 enum { H_COUNT, H_BYTE_COUNT, H_RATE, H_BIT_RATE, H_BYTE_RATE, H_RESET,
        H_COUNT_CALL, H_BYTE_COUNT_CALL };
 
+static String
+unparse_window_rate(Counter::counter_t delta, Timestamp interval)
+{
+#if HAVE_INT64_TYPES
+    // events per second, with 10 bits of fraction
+    uint64_t usec = interval.usecval();
+    while (usec > 0xFFFFFFFFU) {
+	usec >>= 1;
+	delta >>= 1;
+    }
+    if (!usec)
+	return String(0);
+    else if (delta < ((uint64_t) 1 << 32))
+	return cp_unparse_real2(int_divide((uint64_t) delta * 1000000 << 10, (uint32_t) usec), 10);
+    else
+	return String(int_divide((uint64_t) delta * 1000000, (uint32_t) usec));
+#else
+    uint32_t msec = interval.msecval();
+    return String(msec ? (delta / msec) * 1000 : 0);
+#endif
+}
+
+void
+Counter::window_delta(counter_t &count, counter_t &byte_count,
+		      Timestamp &interval)
+{
+    _rate_lock.acquire();
+    sample s = _window_start[0];
+    _rate_lock.release();
+    Timestamp now = Timestamp::now_steady();
+    count = this->count() - s.count;
+    byte_count = this->byte_count() - s.byte_count;
+    interval = now - s.when;
+}
+
+String
+Counter::window_rate(int which)
+{
+    counter_t count, byte_count;
+    Timestamp interval;
+    window_delta(count, byte_count, interval);
+    if (which == H_RATE)
+	return unparse_window_rate(count, interval);
+    else if (which == H_BYTE_RATE)
+	return unparse_window_rate(byte_count, interval);
+    else
+	return unparse_window_rate(byte_count * 8, interval);
+}
+
 String
 Counter::read_handler(Element *e, void *thunk)
 {
     Counter *c = (Counter *)e;
-    switch ((intptr_t)thunk) {
+    int which = (intptr_t)thunk;
+    if (which == H_RATE || which == H_BIT_RATE || which == H_BYTE_RATE) {
+	if (c->_use_window)
+	    return c->window_rate(which);
+	c->update_rates(click_jiffies()); // drop rate after idle period
+    }
+    switch (which) {
       case H_COUNT:
-	return String(c->_count);
+	return String(c->count());
       case H_BYTE_COUNT:
-	return String(c->_byte_count);
+	return String(c->byte_count());
       case H_RATE:
-	c->_rate.update(0);	// drop rate after idle period
 	return c->_rate.unparse_rate();
       case H_BIT_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
 	// avoid integer overflow by adjusting scale factor instead of
 	// multiplying
 	if (c->_byte_rate.scale() >= 3)
@@ -132,7 +295,6 @@ Counter::read_handler(Element *e, void *thunk)
 	else
 	    return cp_unparse_real2(c->_byte_rate.scaled_average() * c->_byte_rate.epoch_frequency() * 8, c->_byte_rate.scale());
       case H_BYTE_RATE:
-	c->_byte_rate.update(0); // drop rate after idle period
 	return c->_byte_rate.unparse_rate();
       case H_COUNT_CALL:
 	if (c->_count_trigger_h)
@@ -194,7 +356,19 @@ Counter::llrpc(unsigned command, void *data)
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0)
       return -EINVAL;
-    _rate.update(0);		// drop rate after idle period
+    if (_use_window) {
+      counter_t count, byte_count;
+      Timestamp interval;
+      window_delta(count, byte_count, interval);
+      uint32_t msec = interval.msecval();
+#if HAVE_INT64_TYPES
+      *val = (msec ? (uint32_t) int_divide((uint64_t) count * 1000, msec) : 0);
+#else
+      *val = (msec ? (count / msec) * 1000 : 0);
+#endif
+      return 0;
+    }
+    update_rates(click_jiffies()); // drop rate after idle period
     *val = _rate.rate();
     return 0;
 
@@ -202,7 +376,7 @@ Counter::llrpc(unsigned command, void *data)
     uint32_t *val = reinterpret_cast<uint32_t *>(data);
     if (*val != 0 && *val != 1)
       return -EINVAL;
-    *val = (*val == 0 ? _count : _byte_count);
+    *val = (*val == 0 ? count() : byte_count());
     return 0;
 
   } else if (command == CLICK_LLRPC_GET_COUNTS) {
@@ -213,9 +387,9 @@ Counter::llrpc(unsigned command, void *data)
       return -EINVAL;
     for (unsigned i = 0; i < cs.n; i++) {
       if (cs.keys[i] == 0)
-	cs.values[i] = _count;
+	cs.values[i] = count();
       else if (cs.keys[i] == 1)
-	cs.values[i] = _byte_count;
+	cs.values[i] = byte_count();
       else
 	return -EINVAL;
     }
@@ -4,13 +4,17 @@
 #include <click/element.hh>
 #include <click/ewma.hh>
 #include <click/llrpc.h>
+#include <click/perthread.hh>
+#include <click/sync.hh>
+#include <click/timestamp.hh>
+#include <click/timer.hh>
 CLICK_DECLS
 class HandlerCall;
 
 /*
 =c
 
-Counter([I<keywords COUNT_CALL, BYTE_COUNT_CALL>])
+Counter([I<keywords COUNT_CALL, BYTE_COUNT_CALL, RATE_WINDOW>])
 
 =s counters
 
@@ -37,8 +41,23 @@ Argument is `I<N> I<HANDLER> [I<VALUE>]'. When the byte count reaches or
 exceeds I<N>, call the write handler I<HANDLER> with value I<VALUE> before
 emitting the packet.
 
+=item RATE_WINDOW
+
+Time. If set, the rate handlers report the average rate over the last
+RATE_WINDOW to 2*RATE_WINDOW, rather than a moving average. Counter samples
+its counts with a timer every RATE_WINDOW, and a rate read works from the
+sample before last, so a rate is never averaged over longer than
+2*RATE_WINDOW however rarely it is read. Counter then does no rate
+bookkeeping per packet. Default is unset.
+
 =back
 
+Counter keeps separate counts for each thread, and adds them up when they
+are read, so threads passing packets through the same Counter do not
+contend for its counts. The moving averages are brought up to date once per
+jiffy from the summed counts. COUNT_CALL and BYTE_COUNT_CALL make Counter
+sum the counts on every packet until they fire.
+
 =h count read-only
 
 Returns the number of packets that have passed through since the last reset.
@@ -50,17 +69,17 @@ Returns the number of bytes that have passed through since the last reset.
 =h rate read-only
 
 Returns the recent arrival rate, measured by exponential
-weighted moving average, in packets per second.
+weighted moving average (or over RATE_WINDOW), in packets per second.
 
 =h bit_rate read-only
 
 Returns the recent arrival rate, measured by exponential
-weighted moving average, in bits per second.
+weighted moving average (or over RATE_WINDOW), in bits per second.
 
 =h byte_rate read-only
 
 Returns the recent arrival rate, measured by exponential
-weighted moving average, in bytes per second.
+weighted moving average (or over RATE_WINDOW), in bytes per second.
 
 =h reset_counts write-only
 
@@ -81,8 +100,8 @@ Writes a new BYTE_COUNT_CALL argument. The handler can be omitted.
 =h CLICK_LLRPC_GET_RATE llrpc
 
 Argument is a pointer to an integer that must be 0.  Returns the recent
-arrival rate (measured by exponential weighted moving average) in
-packets per second.
+arrival rate (measured by exponential weighted moving average, or over
+RATE_WINDOW) in packets per second.
 
 =h CLICK_LLRPC_GET_COUNT llrpc
 
@@ -111,19 +130,29 @@ class Counter : public Element { public:
     const char *class_name() const		{ return "Counter"; }
     const char *port_count() const		{ return PORTS_1_1; }
 
-    counter_t count() const                     { return _count; }
-    counter_t byte_count() const                { return _byte_count; }
+    counter_t count() const;
+    counter_t byte_count() const;
     void reset();
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     int initialize(ErrorHandler *) CLICK_COLD;
     void add_handlers() CLICK_COLD;
     int llrpc(unsigned, void *);
+    void run_timer(Timer *);
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    int pull_batch(int port, unsigned max, PacketBatch &batch);
 
   private:
 
+    inline void count_packets(counter_t n, counter_t bytes);
+    void update_rates(click_jiffies_t now);
+    void check_triggers(counter_t n);
+    void window_delta(counter_t &count, counter_t &byte_count,
+		      Timestamp &interval);
+    String window_rate(int which);
+
 #ifdef HAVE_INT64_TYPES
     // Reduce bits of fraction for byte rate to avoid overflow
     typedef RateEWMAX<RateEWMAXParameters<4, 10, uint64_t, int64_t> > rate_t;
@@ -133,11 +162,32 @@ class Counter : public Element { public:
     typedef RateEWMAX<RateEWMAXParameters<4, 4> > byte_rate_t;
 #endif
 
-    counter_t _count;
-    counter_t _byte_count;
+    struct stats {
+	counter_t count;
+	counter_t byte_count;
+    };
+    struct sample {
+	Timestamp when;
+	counter_t count;
+	counter_t byte_count;
+    };
+
+    PerThread<stats> _stats;
+
+    // moving averages, updated from the summed counts once per jiffy
+    volatile click_jiffies_t _epoch;
+    counter_t _epoch_count;
+    counter_t _epoch_byte_count;
+    SimpleSpinlock _rate_lock;
     rate_t _rate;
     byte_rate_t _byte_rate;
 
+    // RATE_WINDOW samples, taken by _window_timer, under _rate_lock
+    Timestamp _window;
+    sample _window_start[2];
+    bool _use_window;
+    Timer _window_timer;
+
     counter_t _count_trigger;
     HandlerCall *_count_trigger_h;
 
@@ -2,63 +2,174 @@
 #include "cpuqueue.hh"
 #include <click/error.hh>
 #include <click/args.hh>
+#include <click/integers.hh>
 
 CLICK_DECLS
 
+// Orders a ring's packet loads before the store that frees their slots.
+static inline void
+load_store_fence()
+{
+#if !CLICK_LINUXMODULE && (defined(__i386__) || defined(__x86_64__))
+    click_compiler_fence();
+#else
+    click_fence();
+#endif
+}
+
 CPUQueue::CPUQueue()
-  : _last(0), _drops(0)
+  : _rings(0), _rings_alloc(0), _nrings(0), _last(0), _sleepiness(0)
 {
-  memset(&_q, 0, sizeof(_q));
+  for (int i = 0; i < map_words; i++)
+    _nonempty[i] = 0;
 }
 
 CPUQueue::~CPUQueue()
 {
 }
 
+void *
+CPUQueue::cast(const char *n)
+{
+    if (strcmp(n, "CPUQueue") == 0)
+	return this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
 int
 CPUQueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    if (click_max_cpu_ids() > 256)
+    if (click_max_cpu_ids() > max_rings)
         return errh->error("too many CPUs for CPUQueue");
     unsigned new_capacity = 128;
     if (Args(conf, this, errh)
 	.read_p("CAPACITY", new_capacity)
 	.complete() < 0)
 	return -1;
+    if (new_capacity == 0)
+	return errh->error("CAPACITY must be positive");
     _capacity = new_capacity;
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
     return 0;
 }
 
 int
 CPUQueue::initialize(ErrorHandler *errh)
 {
-  for (unsigned i=0; i<click_max_cpu_ids(); i++)
-    if (!(_q[i]._q = new Packet*[_capacity+1]))
+  // Give each CPU's ring its own cache line.
+  _nrings = click_max_cpu_ids();
+  if (!(_rings_alloc = new char[_nrings * sizeof(Ring) + CLICK_CACHE_LINE_SIZE]))
+    return errh->error("out of memory!");
+  uintptr_t a = reinterpret_cast<uintptr_t>(_rings_alloc);
+  a = (a + CLICK_CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CLICK_CACHE_LINE_SIZE - 1);
+  _rings = reinterpret_cast<Ring *>(a);
+  for (unsigned i=0; i<_nrings; i++) {
+    _rings[i]._head = _rings[i]._tail = _rings[i]._drops = 0;
+    if (!(_rings[i]._q = new Packet*[_capacity+1]))
       return errh->error("out of memory!");
-  _drops = 0;
+  }
+  for (int i = 0; i < map_words; i++)
+    _nonempty[i] = 0;
   _last = 0;
+  _sleepiness = 0;
   return 0;
 }
 
 void
 CPUQueue::cleanup(CleanupStage)
 {
-  for (unsigned i=0; i<click_max_cpu_ids(); i++) {
-    for (unsigned j = _q[i]._head; j != _q[i]._tail; j = next_i(j))
-      _q[i]._q[j]->kill();
-    delete[] _q[i]._q;
-    _q[i]._q = 0;
+  for (unsigned i=0; _rings && i<_nrings; i++) {
+    Ring &r = _rings[i];
+    if (r._q)
+      for (unsigned j = r._head; j != r._tail; j = next_i(j))
+	r._q[j]->kill();
+    delete[] r._q;
+    r._q = 0;
   }
+  delete[] _rings_alloc;
+  _rings_alloc = 0;
+  _rings = 0;
+}
+
+inline void
+CPUQueue::mark_nonempty(unsigned n)
+{
+    atomic_uint32_t &word = _nonempty[n / ring_bits];
+    uint32_t bit = 1U << (n % ring_bits);
+    if (!(word.value() & bit))
+	word |= bit;
+    _empty_note.wake();
+}
+
+inline int
+CPUQueue::next_ready()
+{
+    // Search the bitmap round-robin, starting at _last.
+    unsigned nwords = (_nrings + ring_bits - 1) / ring_bits;
+    unsigned w = _last / ring_bits;
+    uint32_t first_mask = ~0U << (_last % ring_bits);
+    for (unsigned i = 0; i <= nwords; i++) {
+	uint32_t bits = _nonempty[w].value();
+	if (i == 0)
+	    bits &= first_mask;
+	else if (i == nwords)
+	    bits &= ~first_mask;
+	if (bits)
+	    return w * ring_bits + ffs_lsb((unsigned) bits) - 1;
+	w = (w + 1 == nwords ? 0 : w + 1);
+    }
+    return -1;
+}
+
+inline int
+CPUQueue::deq(unsigned n, unsigned max, PacketBatch &batch)
+{
+    Ring &r = _rings[n];
+    unsigned h = r._head, t = r._tail, k = 0;
+    click_read_fence();
+    for (; h != t && k < max; k++, h = next_i(h))
+	batch.append(r._q[h]);
+    load_store_fence();
+    r._head = h;
+    if (h == t) {
+	// Clear the ring's bit, then look again: its CPU may have pushed a
+	// packet after we read _tail but before the bit went clear.
+	uint32_t bit = 1U << (n % ring_bits);
+	_nonempty[n / ring_bits] &= ~bit;
+	if (r._tail != h)
+	    _nonempty[n / ring_bits] |= bit;
+    }
+    return k;
+}
+
+bool
+CPUQueue::find_stranded()
+{
+    // A pusher that read its bit as set just before deq() cleared it leaves
+    // a nonempty ring with a clear bit.  Find such rings before sleeping.
+    bool found = false;
+    for (unsigned n = 0; n < _nrings; n++)
+	if (_rings[n]._head != _rings[n]._tail) {
+	    _nonempty[n / ring_bits] |= 1U << (n % ring_bits);
+	    found = true;
+	}
+    return found;
 }
 
-inline Packet *
-CPUQueue::deq(int n)
+Packet *
+CPUQueue::pull_empty()
 {
-  if (_q[n]._head != _q[n]._tail) {
-    Packet *p = _q[n]._q[_q[n]._head];
-    _q[n]._head = next_i(_q[n]._head);
-    return p;
-  } else
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+	// Work around race condition between push() and pull(), as in
+	// NotifierQueue.
+	if (find_stranded())
+	    _empty_note.wake();
+    } else
+	_sleepiness++;
     return 0;
 }
 
@@ -66,32 +177,88 @@ void
 CPUQueue::push(int, Packet *p)
 {
     unsigned n = click_current_cpu_id();
-    unsigned next = next_i(_q[n]._tail);
-    if (next != _q[n]._head) {
-	_q[n]._q[_q[n]._tail] = p;
-	_q[n]._tail = next;
+    Ring &r = _rings[n];
+    unsigned t = r._tail, next = next_i(t);
+    if (next != r._head) {
+	r._q[t] = p;
+	click_write_fence();
+	r._tail = next;
+	mark_nonempty(n);
     } else {
 	p->kill();
-	_drops++;
+	r._drops++;
+    }
+}
+
+void
+CPUQueue::push_batch(int, PacketBatch &batch)
+{
+    unsigned n = click_current_cpu_id();
+    Ring &r = _rings[n];
+    unsigned t = r._tail, h = r._head, first = t;
+    while (!batch.empty()) {
+	unsigned next = next_i(t);
+	if (next == h) {
+	    r._drops += batch.count();
+	    batch.kill();
+	    break;
+	}
+	r._q[t] = batch.pop_front();
+	t = next;
+    }
+    if (t != first) {
+	click_write_fence();
+	r._tail = t;
+	mark_nonempty(n);
     }
 }
 
 Packet *
 CPUQueue::pull(int)
 {
-    unsigned n = _last;
-    Packet *p = 0;
-    for (unsigned i = 0; i < click_max_cpu_ids(); i++) {
-	p = deq(n);
-	n++;
-	if (n == click_max_cpu_ids())
-	    n = 0;
-	if (p) {
-	    _last = n;
-	    return p;
-	}
+    int n = next_ready();
+    PacketBatch batch;
+    if (n < 0 || !deq(n, 1, batch))
+	return pull_empty();
+    _last = (n + 1 == (int) _nrings ? 0 : n + 1);
+    _sleepiness = 0;
+    return batch.pop_front();
+}
+
+int
+CPUQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    unsigned got = 0;
+    int n;
+    while (got < max && (n = next_ready()) >= 0) {
+	got += deq(n, max - got, batch);
+	_last = (n + 1 == (int) _nrings ? 0 : n + 1);
     }
-    return 0;
+    if (got)
+	_sleepiness = 0;
+    else
+	pull_empty();
+    return got;
+}
+
+unsigned
+CPUQueue::drops() const
+{
+  unsigned d = 0;
+  for (unsigned i = 0; i < _nrings; i++)
+    d += _rings[i]._drops;
+  return d;
+}
+
+unsigned
+CPUQueue::size() const
+{
+  unsigned s = 0;
+  for (unsigned i = 0; i < _nrings; i++) {
+    unsigned h = _rings[i]._head, t = _rings[i]._tail;
+    s += (t >= h ? t - h : t + _capacity + 1 - h);
+  }
+  return s;
 }
 
 String
@@ -103,6 +270,8 @@ CPUQueue::read_handler(Element *e, void *thunk)
     return String(q->capacity());
    case 1:
     return String(q->drops());
+   case 2:
+    return String(q->size());
    default:
     return "";
   }
@@ -113,6 +282,7 @@ CPUQueue::add_handlers()
 {
   add_read_handler("capacity", read_handler, 0);
   add_read_handler("drops", read_handler, 1);
+  add_read_handler("length", read_handler, 2);
 }
 
 CLICK_ENDDECLS
@@ -1,6 +1,8 @@
 #ifndef CPUQUEUE_HH
 #define CPUQUEUE_HH
 #include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
 
 CLICK_DECLS
 
@@ -17,23 +19,54 @@ CLICK_DECLS
  * calling the push method. Drops incoming packets if the queue already holds
  * CAPACITY packets. The default for CAPACITY is 128.
  *
- * =a Queue
+ * Each CPU's queue is a ring on its own cache line, written only by that
+ * CPU, so pushing CPUs never share lines with one another. A bitmap records
+ * which rings hold packets; pull finds the next nonempty ring, round-robin
+ * from the last one served, without scanning empty rings. Batched pulls
+ * take as many packets as they can from each ready ring in turn.
+ *
+ * CPUQueue provides an empty notifier, so a downstream task such as Unqueue
+ * sleeps while every ring is empty and wakes when any CPU pushes a packet.
+ *
+ * Any number of CPUs may push at once, but only one thread at a time may
+ * pull.
+ *
+ * =h capacity read-only
+ * Returns the capacity of each CPU's queue.
+ * =h drops read-only
+ * Returns the number of packets dropped so far, summed over every CPU.
+ * =h length read-only
+ * Returns the number of packets queued, summed over every CPU.
+ *
+ * =a Queue, ThreadSafeQueue
  */
 class CPUQueue : public Element {
-  struct {
+  struct Ring {
     Packet **_q;
-    unsigned _head;
-    unsigned _tail;
-    unsigned _pad[5];
-  } _q[CLICK_CPU_MAX];
+    volatile unsigned _head;	// written only by the puller
+    volatile unsigned _tail;	// written only by this ring's CPU
+    unsigned _drops;
+  } CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+  enum { max_rings = 256, ring_bits = 32,
+	 map_words = max_rings / ring_bits,
+	 SLEEPINESS_TRIGGER = 9 };
 
+  Ring *_rings;
+  char *_rings_alloc;
+  unsigned _nrings;
   unsigned _last;
   unsigned _capacity;
-  unsigned _drops;
+  int _sleepiness;
+  atomic_uint32_t _nonempty[map_words];
+  ActiveNotifier _empty_note;
 
-  int next_i(unsigned i) const { return (i!=_capacity ? i+1 : 0); }
-  int prev_i(unsigned i) const { return (i!=0 ? i-1 : _capacity); }
-  Packet *deq(int);
+  unsigned next_i(unsigned i) const { return (i!=_capacity ? i+1 : 0); }
+  inline void mark_nonempty(unsigned n);
+  inline int next_ready();
+  inline int deq(unsigned n, unsigned max, PacketBatch &batch);
+  bool find_stranded();
+  Packet *pull_empty();
 
   static String read_handler(Element *, void *) CLICK_COLD;
 
@@ -45,16 +78,20 @@ class CPUQueue : public Element {
   const char *class_name() const		{ return "CPUQueue"; }
   const char *port_count() const		{ return "1/1-"; }
   const char *processing() const		{ return PUSH_TO_PULL; }
+  void *cast(const char *);
   int initialize(ErrorHandler *) CLICK_COLD;
   void cleanup(CleanupStage) CLICK_COLD;
 
-  unsigned drops() const			{ return _drops; }
+  unsigned drops() const;
   unsigned capacity() const			{ return _capacity; }
+  unsigned size() const;
 
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
   void push(int port, Packet *);
+  void push_batch(int port, PacketBatch &batch);
   Packet *pull(int port);
+  int pull_batch(int port, unsigned max, PacketBatch &batch);
 
   void add_handlers() CLICK_COLD;
 };
@@ -52,12 +52,12 @@ DRRSched::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 DRRSched::initialize(ErrorHandler *errh)
 {
-    if (!(_pi = new portinfo[ninputs()]))
+    if (!(_pi = new portinfo[ninputs()])
+	|| _ready.initialize(this, &_notifier) < 0)
 	return errh->error("out of memory!");
     for (int i = 0; i < ninputs(); i++) {
 	_pi[i].head = 0;
 	_pi[i].deficit = 0;
-	_pi[i].signal = Notifier::upstream_empty_signal(this, i, &_notifier);
     }
     _next = 0;
     return 0;
@@ -78,38 +78,37 @@ Packet *
 DRRSched::pull(int)
 {
     int n = ninputs();
-    bool signals_on = false;
 
-    // Look at each input once, starting at the *same*
-    // one we left off on last time.
-    for (int j = 0; j < n; j++) {
+    // Look at each ready input once, starting at the *same* one we left off
+    // on last time. Inputs that are not ready have no packet and no
+    // deficit, so skipping them is the same as visiting them.
+    if (!_ready.test(_next) && (_next = _ready.next_cyclic(_next)) >= 0)
+	_pi[_next].deficit += _quantum;
+    for (int j = 0; j < n && _next >= 0; j++) {
 	portinfo &pi = _pi[_next];
 	Packet *p;
-	if ((p = pi.head)) {
+	if ((p = pi.head))
 	    pi.head = 0;
-	    signals_on = true;
-	} else if (pi.signal) {
+	else if (_ready.signal(_next))
 	    p = input(_next).pull();
-	    signals_on = true;
-	} else
-	    p = 0;
 
-	if (p == 0)
+	if (p == 0) {
 	    pi.deficit = 0;
-	else if (p->length() <= pi.deficit) {
+	    _ready.idle(_next);
+	} else if (p->length() <= pi.deficit) {
 	    pi.deficit -= p->length();
 	    _notifier.set_active(true);
 	    return p;
 	} else
 	    pi.head = p;
 
-	_next++;
-	if (_next >= n)
-	    _next = 0;
-	_pi[_next].deficit += _quantum;
+	if ((_next = _ready.next_cyclic(_next + 1 < n ? _next + 1 : 0)) >= 0)
+	    _pi[_next].deficit += _quantum;
     }
 
-    _notifier.set_active(signals_on);
+    if (_next < 0)
+	_next = 0;
+    _notifier.set_active(!_ready.empty());
     return 0;
 }
 
@@ -2,7 +2,7 @@
 #ifndef CLICK_DRR_HH
 #define CLICK_DRR_HH
 #include <click/element.hh>
-#include <click/notifier.hh>
+#include <click/standard/readyinputs.hh>
 CLICK_DECLS
 
 /*
@@ -18,7 +18,9 @@ CLICK_DECLS
  * Queuing using Deficit Round Robin."
  *
  * The inputs usually come from Queues or other pull schedulers.
- * DRRSched uses notification to avoid pulling from empty inputs.
+ * DRRSched uses notification to avoid pulling from empty inputs:
+ * inputs whose notifiers have gone to sleep are skipped in constant time,
+ * however many there are.
  *
  * Keyword arguments are:
  *
@@ -59,11 +61,11 @@ class DRRSched : public Element { public:
     struct portinfo {
 	Packet *head;
 	unsigned deficit;
-	NotifierSignal signal;
     };
 
     int _quantum;   // Number of bytes to send per round.
     portinfo *_pi;
+    ReadyInputs _ready;
     Notifier _notifier;
     int _next;      // Next input to consider.
 
@@ -39,28 +39,64 @@
 
 CLICK_DECLS
 
-EstimateTraffic::EstimateTraffic() : _task(this)
+EstimateTraffic::EstimateTraffic() : _generation(0), _sample_nano(0),
+                                     _estimates(0), _estimator(estimator_raw),
+                                     _ewma_shift(3), _window(16),
+                                     _horizon(1000), _task(this)
 {
     pthread_mutex_init(&_lock, NULL);
     pthread_mutex_init(&_adu_lock, NULL);
 }
 
+bool
+EstimateTraffic::parse_estimator(const String &str, int &estimator)
+{
+    String s = str.trim_space().upper();
+    if (s == "RAW")
+        estimator = estimator_raw;
+    else if (s == "EWMA")
+        estimator = estimator_ewma;
+    else if (s == "MAX")
+        estimator = estimator_max;
+    else if (s == "PREDICT")
+        estimator = estimator_predict;
+    else
+        return false;
+    return true;
+}
+
 int
 EstimateTraffic::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    String estimator = "RAW";
     if (Args(conf, this, errh)
         .read_mp("NUM_HOSTS", _num_hosts)
         .read_mp("SOURCE", source)
+        .read("ESTIMATOR", WordArg(), estimator)
+        .read("EWMA_SHIFT", _ewma_shift)
+        .read("WINDOW", _window)
+        .read("HORIZON", _horizon)
         .complete() < 0)
         return -1;
     
     if (_num_hosts == 0)
         return -1;
+    if (!parse_estimator(estimator, _estimator))
+        return errh->error("bad ESTIMATOR %<%s%>", estimator.c_str());
+    if (_ewma_shift < 1 || _ewma_shift > 16)
+        return errh->error("EWMA_SHIFT must be between 1 and 16");
+    if (_window < 1)
+        return errh->error("WINDOW must be positive");
 
     _traffic_matrix = (long long *)malloc(sizeof(long long) *
                                           _num_hosts * _num_hosts);
     bzero(_traffic_matrix, sizeof(long long) * _num_hosts * _num_hosts);
 
+    _estimates = new demand_estimate[_num_hosts * _num_hosts];
+    for (int i = 0; i < _num_hosts * _num_hosts; i++)
+        _estimates[i].window = new uint64_t[_window];
+    reset_estimates();
+
     _queue_clear_timeout = 1e9;  // 1s
     clock_gettime(CLOCK_MONOTONIC, &_last_queue_clear);
 
@@ -149,6 +185,17 @@ EstimateTraffic::initialize(ErrorHandler *errh)
     return 0;
 }
 
+void
+EstimateTraffic::cleanup(CleanupStage)
+{
+    if (_estimates) {
+        for (int i = 0; i < _num_hosts * _num_hosts; i++)
+            delete[] _estimates[i].window;
+        delete[] _estimates;
+        _estimates = 0;
+    }
+}
+
 bool
 EstimateTraffic::run_task(Task *)
 {
@@ -227,6 +274,10 @@ EstimateTraffic::run_task(Task *)
             }
         }
 
+	struct timespec ts_sample;
+	clock_gettime(CLOCK_MONOTONIC, &ts_sample);
+	long long sample_nano = 1e9 * ts_sample.tv_sec + ts_sample.tv_nsec;
+
 	bzero(_traffic_matrix, sizeof(long long) * _num_hosts * _num_hosts);
 	if (source == "ADU") {
 	    pthread_mutex_lock(&_adu_lock);
@@ -276,6 +327,10 @@ EstimateTraffic::run_task(Task *)
             }
         }
 
+	pthread_mutex_lock(&_lock);
+        update_estimates(sample_nano);
+	pthread_mutex_unlock(&_lock);
+
         // copy TM to store for handler
         String *tm = new String;
         for(int src = 0; src < _num_hosts; src++) {
@@ -288,6 +343,8 @@ EstimateTraffic::run_task(Task *)
 	pthread_mutex_lock(&_lock);
         String *temp = output_traffic_matrix;
         output_traffic_matrix = tm;
+        _generation++;
+        _sample_nano = sample_nano;
         delete temp;
 	pthread_mutex_unlock(&_lock);
 
@@ -318,6 +375,72 @@ EstimateTraffic::run_task(Task *)
     return true;
 }
 
+void
+EstimateTraffic::reset_estimates()
+{
+    for (int i = 0; i < _num_hosts * _num_hosts; i++) {
+        demand_estimate &e = _estimates[i];
+        e.avg.clear();
+        e.avg.set_stability_shift(_ewma_shift);
+        bzero(e.window, sizeof(uint64_t) * _window);
+        e.window_pos = 0;
+        e.max_pos = 0;
+        e.last = 0;
+        e.last_nano = 0;
+        e.slope = 0;
+    }
+}
+
+// Feed the raw samples in _traffic_matrix through every estimator stage, then
+// replace them with the output of the selected stage.
+void
+EstimateTraffic::update_estimates(long long now)
+{
+    int estimator = _estimator;
+
+    for (int i = 0; i < _num_hosts * _num_hosts; i++) {
+        demand_estimate &e = _estimates[i];
+        long long sample = _traffic_matrix[i];
+
+        e.avg.update(sample);
+
+        // Windowed max. Only rescan the window when the current maximum is
+        // the sample being overwritten.
+        e.window_pos = (e.window_pos + 1) % _window;
+        e.window[e.window_pos] = sample;
+        if (e.window_pos == e.max_pos) {
+            for (int j = 0; j < _window; j++)
+                if (e.window[j] > e.window[e.max_pos])
+                    e.max_pos = j;
+        } else if ((uint64_t) sample >= e.window[e.max_pos])
+            e.max_pos = e.window_pos;
+
+        // Smoothed backlog growth (positive) or drain (negative) rate.
+        if (e.last_nano && now > e.last_nano) {
+            double rate = double(sample - e.last) / (now - e.last_nano);
+            e.slope += (rate - e.slope) / (1 << _ewma_shift);
+        }
+        e.last = sample;
+        e.last_nano = now;
+
+        switch (estimator) {
+        case estimator_ewma:
+            _traffic_matrix[i] = e.avg.unscaled_average();
+            break;
+        case estimator_max:
+            _traffic_matrix[i] = e.window[e.max_pos];
+            break;
+        case estimator_predict: {
+            double predicted = sample + e.slope * _horizon * 1000;
+            _traffic_matrix[i] = predicted > 0 ? (long long) predicted : 0;
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
 String
 EstimateTraffic::get_traffic(Element *e, void *)
 {
@@ -328,6 +451,17 @@ EstimateTraffic::get_traffic(Element *e, void *)
     return out;
 }
 
+String
+EstimateTraffic::get_traffic_snapshot(Element *e, void *)
+{
+    EstimateTraffic *et = static_cast<EstimateTraffic *>(e);
+    pthread_mutex_lock(&(et->_lock));
+    String out = String(et->_generation) + " " + String(et->_sample_nano)
+        + " " + *et->output_traffic_matrix;
+    pthread_mutex_unlock(&(et->_lock));
+    return out;
+}
+
 int
 EstimateTraffic::set_source(const String &str, Element *e, void *, ErrorHandler *)
 {
@@ -354,15 +488,41 @@ EstimateTraffic::clear(const String &, Element *e, void *, ErrorHandler *)
     et->expected_adu = std::unordered_map<const struct traffic_info, long long,
 					  info_key_hash, info_key_equal>();
     pthread_mutex_unlock(&(et->_adu_lock));
+    pthread_mutex_lock(&(et->_lock));
+    et->reset_estimates();
+    pthread_mutex_unlock(&(et->_lock));
+    return 0;
+}
+
+int
+EstimateTraffic::set_estimator(const String &str, Element *e, void *,
+                               ErrorHandler *errh)
+{
+    EstimateTraffic *et = static_cast<EstimateTraffic *>(e);
+    int estimator;
+    if (!parse_estimator(str, estimator))
+        return errh->error("bad estimator %<%s%>", str.c_str());
+    et->_estimator = estimator;
     return 0;
 }
 
+String
+EstimateTraffic::get_estimator(Element *e, void *)
+{
+    static const char * const names[] = { "RAW", "EWMA", "MAX", "PREDICT" };
+    EstimateTraffic *et = static_cast<EstimateTraffic *>(e);
+    return names[et->_estimator];
+}
+
 void
 EstimateTraffic::add_handlers()
 {
     add_write_handler("setSource", set_source, 0);
     add_read_handler("getTraffic", get_traffic, 0);
+    add_read_handler("getTrafficSnapshot", get_traffic_snapshot, 0);
     add_write_handler("clear", clear, 0);
+    add_read_handler("estimator", get_estimator, 0);
+    add_write_handler("estimator", set_estimator, 0);
 }
 
 CLICK_ENDDECLS
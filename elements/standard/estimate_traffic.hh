@@ -3,6 +3,7 @@
 #define CLICK_ESTIMATE_TRAFFIC_HH
 #include <click/element.hh>
 #include <click/timer.hh>
+#include <click/ewma.hh>
 #include <pthread.h>
 #include <unordered_map>
 #include "fullnotelockqueue.hh"
@@ -12,7 +13,8 @@ CLICK_DECLS
 /*
 =c
 
-EstimateTraffic()
+EstimateTraffic(NUM_HOSTS, SOURCE, I<keywords> ESTIMATOR, EWMA_SHIFT, WINDOW,
+HORIZON)
 
 =s control
 
@@ -20,21 +22,102 @@ Estimates OCS Traffic
 
 =d
 
-TODO
+Samples the hybrid switch VOQs (or the outstanding ADU bytes, when SOURCE is
+"ADU") and publishes the resulting NUM_HOSTS x NUM_HOSTS traffic matrix.
 
-=h
+Each raw sample is passed through an estimator stage before it is published.
+Every stage is maintained incrementally for each (src, dst) pair on every
+sample, so switching between them takes effect immediately. The stages are:
+
+=over 8
+
+=item RAW
+
+The instantaneous sample. This is the default.
+
+=item EWMA
+
+An exponentially weighted moving average of the samples with alpha
+1/2^EWMA_SHIFT.
+
+=item MAX
+
+The largest sample seen in the last WINDOW samples.
+
+=item PREDICT
+
+The sample extrapolated HORIZON microseconds into the future using a smoothed
+estimate of the rate at which the pair's backlog grows or drains. Never
+negative.
+
+=back
+
+Keyword arguments are:
+
+=over 8
+
+=item ESTIMATOR
+
+One of RAW, EWMA, MAX or PREDICT. Default is RAW.
+
+=item EWMA_SHIFT
+
+Unsigned. Stability shift used by EWMA and PREDICT. Default is 3.
+
+=item WINDOW
+
+Integer. Number of samples covered by MAX. Default is 16.
+
+=item HORIZON
+
+Integer. Prediction horizon in microseconds used by PREDICT. Default is 1000.
+
+=back
+
+=h getTraffic read-only
+
+Returns the latest estimated traffic matrix, row-major, space-separated.
+
+=h getTrafficSnapshot read-only
+
+Returns "GENERATION SAMPLE_NS MATRIX", where GENERATION increases by one with
+every published matrix, SAMPLE_NS is the CLOCK_MONOTONIC time in nanoseconds
+at which its VOQs were sampled, and MATRIX is as for getTraffic. Solstice uses
+this to trace the control loop.
+
+=h estimator read/write
+
+Returns or sets the estimator stage.
+
+=h clear write-only
+
+Clears the traffic matrix, the ADU table and all estimator state.
 
 */
 
 #define ADU_PORT "8123"
 
+enum { estimator_raw, estimator_ewma, estimator_max, estimator_predict };
+
+struct demand_estimate {
+    DirectEWMAX<StabilityEWMAXParameters<10, uint64_t, int64_t> > avg;
+    uint64_t *window;		// last WINDOW samples, circular
+    int window_pos;
+    int max_pos;		// index of the largest sample in window
+    long long last;		// previous sample, bytes
+    long long last_nano;	// time of previous sample
+    double slope;		// smoothed backlog growth, bytes per ns
+};
+
 class EstimateTraffic : public Element {
   public:
     EstimateTraffic() CLICK_COLD;
 
     const char *class_name() const	{ return "EstimateTraffic"; }
+    const char *flags() const		{ return "Y0"; }
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
     void add_handlers() CLICK_COLD;
 
     bool run_task(Task *);
@@ -45,6 +128,13 @@ class EstimateTraffic : public Element {
     static int set_source(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
     static int clear(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
     static String get_traffic(Element *e, void *user_data);
+    static String get_traffic_snapshot(Element *e, void *user_data);
+    static int set_estimator(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
+    static String get_estimator(Element *e, void *user_data);
+    static bool parse_estimator(const String &, int &);
+
+    void update_estimates(long long now);
+    void reset_estimates();
 
     int _serverSocket;
     fd_set _active_fd_set;
@@ -55,6 +145,13 @@ class EstimateTraffic : public Element {
     int _num_hosts;
 
     long long *_traffic_matrix;
+    uint64_t _generation;	// id of the published matrix
+    long long _sample_nano;	// when the published matrix was sampled
+    demand_estimate *_estimates;
+    int _estimator;
+    unsigned _ewma_shift;
+    int _window;
+    long long _horizon;
     Task _task;
     int _print;
 
@@ -174,6 +174,27 @@ FullNoteLockQueue::pull(int)
     }
 }
 
+void
+FullNoteLockQueue::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	FullNoteLockQueue::push(port, p);
+}
+
+int
+FullNoteLockQueue::pull_batch(int port, unsigned max, PacketBatch &batch)
+{
+    unsigned n = 0;
+    while (n < max) {
+	Packet *p = FullNoteLockQueue::pull(port);
+	if (!p)
+	    break;
+	batch.append(p);
+	++n;
+    }
+    return n;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 FullNoteLockQueue::read_handler(Element *e, void *)
@@ -158,6 +158,8 @@ class FullNoteLockQueue : public NotifierQueue { public:
 
     void push(int port, Packet *p);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    int pull_batch(int port, unsigned max, PacketBatch &batch);
 
     long long get_bytes();
     long long get_seen_adu(struct traffic_info);
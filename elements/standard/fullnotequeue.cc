@@ -76,6 +76,42 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+void
+FullNoteQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from SimpleQueue::push_batch() and push_success().
+    Storage::index_type h = head();
+    if (enq_burst(_q, batch)) {
+	int s = size(h, tail());
+	if (s > _highwater_length)
+	    _highwater_length = s;
+
+	_empty_note.wake();
+
+	if (size() == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+    while (Packet *p = batch.pop_front())
+	push_failure(p);
+}
+
+int
+FullNoteQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    unsigned n = deq_burst(_q, max, batch);
+    if (n) {
+	_sleepiness = 0;
+	_full_note.wake();
+    } else
+	pull_failure();
+    return n;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 FullNoteQueue::read_handler(Element *e, void *)
@@ -0,0 +1,615 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * hierarchicalshaper.{cc,hh} -- hierarchical token bucket shaper
+ */
+
+#include <click/config.h>
+#include "hierarchicalshaper.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/integers.hh>
+#include <click/heap.hh>
+CLICK_DECLS
+
+HierarchicalShaper::HierarchicalShaper()
+    : _mtu(1514), _nactive(0), _map_words(0), _pending(0), _poll(0),
+      _polling(false), _updates(0), _timer(this)
+{
+    for (int l = 0; l < max_level; l++) {
+	_row_mask[l] = 0;
+	for (int p = 0; p < max_prio; p++)
+	    _row[l][p] = 0;
+    }
+}
+
+HierarchicalShaper::~HierarchicalShaper()
+{
+}
+
+void *
+HierarchicalShaper::cast(const char *n)
+{
+    if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+HierarchicalShaper::Class *
+HierarchicalShaper::find_class(const String &name)
+{
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c)
+	if (c->name == name)
+	    return c;
+    return 0;
+}
+
+int
+HierarchicalShaper::parse_class(const String &spec, ErrorHandler *errh)
+{
+    Vector<String> words, conf;
+    cp_spacevec(spec, words);
+    if (!words.size())
+	return errh->error("CLASS needs a name");
+    String name = words[0];
+    PrefixErrorHandler cerrh(errh, "CLASS " + name + ": ");
+    if (find_class(name))
+	return cerrh.error("class redeclared");
+    if (words.size() % 2 == 0)
+	return cerrh.error("expected keyword/value pairs");
+    for (int i = 1; i < words.size(); i += 2)
+	conf.push_back(words[i] + " " + words[i + 1]);
+
+    String parent_name;
+    unsigned rate = 0, ceil = 0, burst = 0, cburst = 0, quantum = 0;
+    int prio = 0;
+    if (Args(conf, this, &cerrh)
+	.read("PARENT", AnyArg(), parent_name)
+	.read_m("RATE", BandwidthArg(), rate)
+	.read("CEIL", BandwidthArg(), ceil)
+	.read("BURST", burst)
+	.read("CBURST", cburst)
+	.read("PRIO", prio)
+	.read("QUANTUM", quantum)
+	.complete() < 0)
+	return -1;
+    if (rate == 0)
+	return cerrh.error("RATE must be positive");
+    if (ceil == 0)
+	ceil = rate;
+    else if (ceil < rate)
+	return cerrh.error("CEIL must be at least RATE");
+    if (prio < 0 || prio >= max_prio)
+	return cerrh.error("PRIO must be between 0 and %d", max_prio - 1);
+
+    Class *parent = 0;
+    if (parent_name) {
+	if (!(parent = find_class(parent_name)))
+	    return cerrh.error("no class named %<%s%>", parent_name.c_str());
+	// Inner classes occupy levels max_level - 1 (roots) down to 1.
+	if (parent->level < 1)
+	    return cerrh.error("class tree too deep");
+    }
+
+    Class c;
+    c.name = name;
+    c.parent = 0;
+    c.shaper = this;
+    c.index = _classes.size();
+    c.level = parent ? parent->level - 1 : max_level - 1;
+    c.port = parent ? parent->index : -1;	// parent index, for now
+    c.prio = prio;
+    c.quantum = quantum;
+    c.rate = c.pending_rate = rate;
+    c.ceil = c.pending_ceil = ceil;
+    c.burst = burst;
+    c.cburst = cburst;
+    _classes.push_back(c);
+    return 0;
+}
+
+int
+HierarchicalShaper::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Vector<String> specs;
+    unsigned mtu = 1514;
+    if (Args(conf, this, errh)
+	.read_all("CLASS", AnyArg(), specs)
+	.read("MTU", mtu)
+	.complete() < 0)
+	return -1;
+    if (mtu == 0)
+	return errh->error("MTU must be positive");
+    _mtu = mtu;
+
+    _classes.clear();
+    int before = errh->nerrors();
+    for (String *s = specs.begin(); s != specs.end(); ++s)
+	parse_class(*s, errh);
+    if (errh->nerrors() != before)
+	return -1;
+    if (!_classes.size())
+	return errh->error("no classes");
+
+    // The class vector no longer changes, so link parents and find leaves.
+    Vector<int> nchildren(_classes.size(), 0);
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c)
+	if (c->port >= 0) {
+	    c->parent = &_classes[c->port];
+	    nchildren[c->port]++;
+	}
+    int nleaves = 0;
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c)
+	if (nchildren[c->index])
+	    c->port = -1;
+	else {
+	    c->port = nleaves++;
+	    c->level = 0;
+	}
+    if (nleaves != ninputs())
+	return errh->error("%d leaf classes but %d input ports", nleaves, ninputs());
+
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c)
+	if (!c->quantum) {
+	    unsigned q = c->rate / 10;
+	    c->quantum = (q < _mtu ? _mtu : q > 200000 ? 200000 : q);
+	}
+
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+inline void
+HierarchicalShaper::set_bursts(Class *c)
+{
+    // A jiffy's worth of tokens by default, so no refill overflows the
+    // bucket, plus MTU so a full-sized packet always fits.
+    unsigned burst = c->burst ? c->burst : c->rate / CLICK_HZ;
+    unsigned cburst = c->cburst ? c->cburst : c->ceil / CLICK_HZ;
+    c->tb.assign_adjust(c->rate, burst + _mtu);
+    c->ctb.assign_adjust(c->ceil, cburst + _mtu);
+}
+
+int
+HierarchicalShaper::initialize(ErrorHandler *errh)
+{
+    _map_words = (_classes.size() + map_bits - 1) / map_bits;
+    if (!(_pending = new atomic_uint32_t[_map_words])
+	|| !(_updates = new atomic_uint32_t[_map_words])
+	|| !(_poll = new uint32_t[_map_words]))
+	return errh->error("out of memory!");
+
+    _leaves.assign(ninputs(), 0);
+    for (Class *c = _classes.begin(); c != _classes.end(); ++c) {
+	set_bursts(c);
+	c->tb.set_full();
+	c->ctb.set_full();
+	c->mode = mode_can_send;
+	c->prio_activity = 0;
+	c->heap_index = -1;
+	c->wait_until = 0;
+	for (int i = 0; i < max_level; i++)
+	    c->deficit[i] = c->quantum;
+	for (int i = 0; i < max_prio; i++)
+	    c->next[i] = c->prev[i] = c->feed[i] = 0;
+	c->packets = c->bytes = 0;
+	c->lends = c->borrows = c->overlimits = 0;
+	if (c->port >= 0) {
+	    _leaves[c->port] = c;
+	    c->signal = Notifier::upstream_empty_signal(this, c->port, leaf_wake, c);
+	}
+    }
+
+    // Look at every input on the first pull.
+    for (int w = 0; w < _map_words; w++) {
+	_pending[w] = 0;
+	_updates[w] = 0;
+	_poll[w] = 0;
+    }
+    for (int i = 0; i < _leaves.size(); i++)
+	_poll[i / map_bits] |= 1U << (i % map_bits);
+    _polling = true;
+    _pending_any = 0;
+    _updates_any = 0;
+    _timer.initialize(this);
+    return 0;
+}
+
+void
+HierarchicalShaper::cleanup(CleanupStage)
+{
+    delete[] _pending;
+    delete[] _updates;
+    delete[] _poll;
+    _pending = _updates = 0;
+    _poll = 0;
+}
+
+void
+HierarchicalShaper::leaf_wake(void *user_data, Notifier *)
+{
+    // Runs in the context of whoever woke the input, possibly another
+    // thread: just note the leaf, and let the next pull activate it.
+    Class *c = static_cast<Class *>(user_data);
+    HierarchicalShaper *hs = c->shaper;
+    hs->_pending[c->port / map_bits] |= 1U << (c->port % map_bits);
+    hs->_pending_any = 1;
+    hs->_empty_note.wake();
+}
+
+void
+HierarchicalShaper::run_timer(Timer *)
+{
+    _empty_note.wake();
+}
+
+inline void
+HierarchicalShaper::ring_insert(Class *&head, Class *c, int prio)
+{
+    // Insert just behind the round-robin position, at the end of the round.
+    if (!head) {
+	c->next[prio] = c->prev[prio] = c;
+	head = c;
+    } else {
+	Class *tail = head->prev[prio];
+	c->next[prio] = head;
+	c->prev[prio] = tail;
+	tail->next[prio] = c;
+	head->prev[prio] = c;
+    }
+}
+
+inline void
+HierarchicalShaper::ring_remove(Class *&head, Class *c, int prio)
+{
+    if (c->next[prio] == c)
+	head = 0;
+    else {
+	c->prev[prio]->next[prio] = c->next[prio];
+	c->next[prio]->prev[prio] = c->prev[prio];
+	if (head == c)
+	    head = c->next[prio];
+    }
+}
+
+int
+HierarchicalShaper::class_mode(Class *c, click_jiffies_t &wait)
+{
+    c->ctb.refill();
+    if (!c->ctb.contains(_mtu)) {
+	wait = c->ctb.time_until_contains(_mtu);
+	return mode_cant_send;
+    }
+    c->tb.refill();
+    if (c->tb.contains(_mtu))
+	return mode_can_send;
+    wait = c->tb.time_until_contains(_mtu);
+    return mode_may_borrow;
+}
+
+void
+HierarchicalShaper::activate_prios(Class *c)
+{
+    // Hook c's backlogged prios into its parent's feeds, and continue up
+    // the tree while the parent must itself borrow. A class that can send
+    // on its own rate goes on its level's rows instead.
+    Class *p = c->parent;
+    unsigned mask = c->prio_activity;
+    while (c->mode == mode_may_borrow && p && mask) {
+	for (unsigned m = mask; m; m &= m - 1) {
+	    int prio = ffs_lsb(m) - 1;
+	    // A parent with other borrowers at this prio is already active.
+	    if (p->feed[prio])
+		mask &= ~(1U << prio);
+	    ring_insert(p->feed[prio], c, prio);
+	}
+	p->prio_activity |= mask;
+	c = p;
+	p = c->parent;
+    }
+    if (c->mode == mode_can_send && mask) {
+	for (unsigned m = mask; m; m &= m - 1) {
+	    int prio = ffs_lsb(m) - 1;
+	    ring_insert(_row[c->level][prio], c, prio);
+	}
+	_row_mask[c->level] |= mask;
+    }
+}
+
+void
+HierarchicalShaper::deactivate_prios(Class *c)
+{
+    Class *p = c->parent;
+    unsigned mask = c->prio_activity;
+    while (c->mode == mode_may_borrow && p && mask) {
+	unsigned m = mask;
+	mask = 0;
+	for (; m; m &= m - 1) {
+	    int prio = ffs_lsb(m) - 1;
+	    ring_remove(p->feed[prio], c, prio);
+	    if (!p->feed[prio])
+		mask |= 1U << prio;
+	}
+	p->prio_activity &= ~mask;
+	c = p;
+	p = c->parent;
+    }
+    if (c->mode == mode_can_send && mask)
+	for (; mask; mask &= mask - 1) {
+	    int prio = ffs_lsb(mask) - 1;
+	    ring_remove(_row[c->level][prio], c, prio);
+	    if (!_row[c->level][prio])
+		_row_mask[c->level] &= ~(1U << prio);
+	}
+}
+
+void
+HierarchicalShaper::update_mode(Class *c, click_jiffies_t now, bool rekey)
+{
+    click_jiffies_t wait = 0;
+    int m = class_mode(c, wait);
+    if (m != c->mode) {
+	if (m == mode_cant_send)
+	    c->overlimits++;
+	if (c->prio_activity) {
+	    if (c->mode != mode_cant_send)
+		deactivate_prios(c);
+	    c->mode = m;
+	    if (m != mode_cant_send)
+		activate_prios(c);
+	} else
+	    c->mode = m;
+    } else if (!rekey)
+	return;
+
+    if (m == mode_can_send) {
+	if (c->heap_index >= 0) {
+	    remove_heap(_wait.begin(), _wait.end(), _wait.begin() + c->heap_index,
+			heap_less(), heap_place());
+	    _wait.pop_back();
+	    c->heap_index = -1;
+	}
+    } else {
+	c->wait_until = now + (wait ? wait : 1);
+	if (c->heap_index >= 0)
+	    change_heap(_wait.begin(), _wait.end(), _wait.begin() + c->heap_index,
+			heap_less(), heap_place());
+	else {
+	    _wait.push_back(c);
+	    push_heap(_wait.begin(), _wait.end(), heap_less(), heap_place());
+	}
+    }
+}
+
+void
+HierarchicalShaper::activate_leaf(Class *c)
+{
+    if (!c->prio_activity) {
+	c->prio_activity = 1U << c->prio;
+	activate_prios(c);
+	_nactive++;
+    }
+}
+
+void
+HierarchicalShaper::deactivate_leaf(Class *c)
+{
+    if (c->prio_activity) {
+	deactivate_prios(c);
+	c->prio_activity = 0;
+	_nactive--;
+    }
+}
+
+void
+HierarchicalShaper::wake_leaves()
+{
+    if (_pending_any.value() && _pending_any.swap(0)) {
+	for (int w = 0; w < _map_words; w++)
+	    if (_pending[w].value())
+		_poll[w] |= _pending[w].swap(0);
+	_polling = true;
+    }
+    if (!_polling)
+	return;
+    _polling = false;
+    for (int w = 0; w < _map_words; w++) {
+	uint32_t bits = _poll[w];
+	_poll[w] = 0;
+	for (; bits; bits &= bits - 1) {
+	    Class *c = _leaves[w * map_bits + ffs_lsb(bits) - 1];
+	    if (c->signal.active())
+		activate_leaf(c);
+	}
+    }
+}
+
+void
+HierarchicalShaper::apply_updates(click_jiffies_t now)
+{
+    _updates_any = 0;
+    for (int w = 0; w < _map_words; w++) {
+	if (!_updates[w].value())
+	    continue;
+	uint32_t bits = _updates[w].swap(0);
+	click_read_fence();
+	for (; bits; bits &= bits - 1) {
+	    Class *c = &_classes[w * map_bits + ffs_lsb(bits) - 1];
+	    c->rate = c->pending_rate;
+	    c->ceil = c->pending_ceil;
+	    set_bursts(c);
+	    update_mode(c, now, true);
+	}
+    }
+}
+
+void
+HierarchicalShaper::run_events(click_jiffies_t now)
+{
+    // Classes whose tokens have refilled change mode. update_mode() either
+    // removes the top class or pushes its wait time past now.
+    while (_wait.size() && !click_jiffies_less(now, _wait[0]->wait_until))
+	update_mode(_wait[0], now, true);
+}
+
+inline HierarchicalShaper::Class *
+HierarchicalShaper::lookup_leaf(int prio, int level)
+{
+    Class *c = _row[level][prio];
+    while (c->port < 0)
+	c = c->feed[prio];
+    return c;
+}
+
+Packet *
+HierarchicalShaper::dequeue_tree(int prio, int level, click_jiffies_t now)
+{
+    // Each failed pull deactivates a leaf, so this loop ends.
+    while (_row[level][prio]) {
+	Class *c = lookup_leaf(prio, level);
+	if (Packet *p = input(c->port).pull()) {
+	    unsigned len = p->length();
+	    c->deficit[level] -= len;
+	    if (c->deficit[level] < 0) {
+		c->deficit[level] += c->quantum;
+		Class *&head = (level ? c->parent->feed[prio] : _row[level][prio]);
+		head = c->next[prio];
+	    }
+	    if (!c->signal.active())
+		deactivate_leaf(c);
+	    charge(c, level, len, now);
+	    return p;
+	}
+	deactivate_leaf(c);
+	// An input's empty signal may lag behind its queue; keep polling
+	// the leaf until the signal goes inactive and a wakeup takes over.
+	if (c->signal.active()) {
+	    _poll[c->port / map_bits] |= 1U << (c->port % map_bits);
+	    _polling = true;
+	}
+    }
+    return 0;
+}
+
+void
+HierarchicalShaper::charge(Class *c, int level, unsigned len, click_jiffies_t now)
+{
+    // Classes at or above the sending level spend rate tokens; classes
+    // below it borrowed. Everyone on the path spends ceil tokens.
+    for (; c; c = c->parent) {
+	if (c->level >= level) {
+	    if (c->level == level)
+		c->lends++;
+	    c->tb.refill();
+	    c->tb.remove(len);
+	} else
+	    c->borrows++;
+	c->ctb.refill();
+	c->ctb.remove(len);
+	c->packets++;
+	c->bytes += len;
+	update_mode(c, now, false);
+    }
+}
+
+Packet *
+HierarchicalShaper::pull_empty(click_jiffies_t now)
+{
+    if (_polling)
+	return 0;
+    _empty_note.sleep();
+    // An input may have woken after wake_leaves() looked.
+    if (_pending_any.value() || _updates_any.value())
+	_empty_note.wake();
+    else if (_nactive && _wait.size()) {
+	click_jiffies_t when = _wait[0]->wait_until;
+	click_jiffies_t delay = (click_jiffies_less(now, when) ? when - now : 1);
+	_timer.schedule_after(Timestamp::make_jiffies(delay));
+    }
+    return 0;
+}
+
+Packet *
+HierarchicalShaper::pull(int)
+{
+    click_jiffies_t now = click_jiffies();
+    if (_updates_any.value())
+	apply_updates(now);
+    wake_leaves();
+    run_events(now);
+    for (int level = 0; level < max_level; level++)
+	for (unsigned m = _row_mask[level]; m; m &= m - 1)
+	    if (Packet *p = dequeue_tree(ffs_lsb(m) - 1, level, now))
+		return p;
+    return pull_empty(now);
+}
+
+String
+HierarchicalShaper::read_handler(Element *e, void *thunk)
+{
+    HierarchicalShaper *hs = static_cast<HierarchicalShaper *>(e);
+    static const char * const mode_names[] = {
+	"cant_send", "may_borrow", "can_send"
+    };
+    StringAccum sa;
+    for (Class *c = hs->_classes.begin(); c != hs->_classes.end(); ++c)
+	if (thunk == 0)
+	    sa << c->name << ' ' << BandwidthArg::unparse(c->rate)
+	       << ' ' << BandwidthArg::unparse(c->ceil) << '\n';
+	else {
+	    sa << c->name << ": mode " << mode_names[c->mode]
+	       << " rate " << BandwidthArg::unparse(c->rate)
+	       << " ceil " << BandwidthArg::unparse(c->ceil)
+	       << " tokens " << c->tb.size()
+	       << " ctokens " << c->ctb.size() << '\n';
+	    sa << "  packets " << c->packets << " bytes " << c->bytes
+	       << " lends " << c->lends << " borrows " << c->borrows
+	       << " overlimits " << c->overlimits << '\n';
+	}
+    return sa.take_string();
+}
+
+int
+HierarchicalShaper::write_handler(const String &str, Element *e, void *, ErrorHandler *errh)
+{
+    HierarchicalShaper *hs = static_cast<HierarchicalShaper *>(e);
+    String name;
+    unsigned rate, ceil = 0;
+    Class *c;
+    if (Args(e, errh).push_back_words(str)
+	.read_mp("CLASS", AnyArg(), name)
+	.read_mp("RATE", BandwidthArg(), rate)
+	.read_p("CEIL", BandwidthArg(), ceil)
+	.complete() < 0)
+	return -1;
+    if (!(c = hs->find_class(name)))
+	return errh->error("no class named %<%s%>", name.c_str());
+    if (rate == 0)
+	return errh->error("RATE must be positive");
+    if (ceil == 0)
+	ceil = (c->ceil < rate ? rate : c->ceil);
+    else if (ceil < rate)
+	return errh->error("CEIL must be at least RATE");
+
+    // The pulling thread picks the new rates up at its next pull.
+    c->pending_rate = rate;
+    c->pending_ceil = ceil;
+    click_write_fence();
+    hs->_updates[c->index / map_bits] |= 1U << (c->index % map_bits);
+    hs->_updates_any = 1;
+    hs->_empty_note.wake();
+    return 0;
+}
+
+void
+HierarchicalShaper::add_handlers()
+{
+    add_read_handler("rate", read_handler, 0);
+    add_write_handler("rate", write_handler, 0);
+    add_read_handler("stats", read_handler, 1);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(HierarchicalShaper)
+ELEMENT_MT_SAFE(HierarchicalShaper)
@@ -0,0 +1,238 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_HIERARCHICALSHAPER_HH
+#define CLICK_HIERARCHICALSHAPER_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/tokenbucket.hh>
+#include <click/timer.hh>
+#include <click/atomic.hh>
+#include <click/vector.hh>
+CLICK_DECLS
+
+/*
+=c
+
+HierarchicalShaper(CLASS I<spec>, ..., [MTU])
+
+=s shaping
+
+shapes traffic with a hierarchical token bucket class tree
+
+=io
+
+one output, one input per leaf class
+
+=d
+
+Shapes the packets it pulls from its inputs through a tree of traffic
+classes, in the style of the Linux HTB queueing discipline. One
+HierarchicalShaper replaces trees of BandwidthShaper, BandwidthRatedSplitter
+and PrioSched elements: it keeps every class's token buckets and scheduling
+state itself, and pulls each packet directly from the input that will send
+it.
+
+Each CLASS argument declares one class. Its I<spec> is a class name followed
+by space-separated keyword arguments:
+
+=over 8
+
+=item PARENT
+
+The name of a previously declared class. The new class becomes its child.
+Classes without a PARENT are roots.
+
+=item RATE
+
+Bandwidth. The class's guaranteed rate. Required.
+
+=item CEIL
+
+Bandwidth. The highest rate the class may reach by borrowing unused bandwidth
+from its ancestors. Must be at least RATE. Defaults to RATE.
+
+=item BURST
+
+Integer. Bytes the class may send at full speed above RATE after being idle.
+Defaults to one jiffy's worth of RATE.
+
+=item CBURST
+
+Integer. Like BURST, for CEIL. Defaults to one jiffy's worth of CEIL.
+
+=item PRIO
+
+Integer between 0 and 7. Leaf classes with lower PRIO values are served
+first, both for their own rate and when borrowing. Defaults to 0.
+
+=item QUANTUM
+
+Integer. Bytes a leaf sends per deficit round robin turn among leaves with
+the same priority. Defaults to RATE/10, clamped between MTU and 200000.
+
+=back
+
+Classes with no children are leaves. Each leaf owns one input port, in the
+order the leaves are declared. Inner classes own no port and exist to share
+their rate among their descendants.
+
+A class whose RATE tokens are exhausted may still send by borrowing from the
+nearest ancestor that has tokens, as long as its own CEIL tokens last. A
+class sends only when it holds at least MTU tokens, so every packet up to MTU
+bytes can be charged in full. The default MTU is 1514.
+
+HierarchicalShaper keeps active classes on per-level, per-priority
+round-robin rings, so choosing the next packet costs time proportional to the
+depth of the tree, not the number of classes. Classes waiting for tokens sit
+in a heap ordered by the time they can next send.
+
+HierarchicalShaper learns which inputs have packets from their empty
+notifiers, and pulls only from those. Inputs without empty notifiers are
+polled. It provides its own empty notifier, which sleeps while no class can
+send, and wakes when an input becomes nonempty or when a waiting class's
+tokens refill.
+
+Only one thread at a time may pull from HierarchicalShaper. Rates may be
+changed from any thread through the C<rate> handler; the change takes effect
+at the next pull.
+
+=e
+
+  ... -> q1 :: Queue; ... -> q2 :: Queue; ... -> q3 :: Queue;
+  hs :: HierarchicalShaper(
+          CLASS root RATE 100Mbps,
+          CLASS voice PARENT root RATE 10Mbps PRIO 0,
+          CLASS tenant PARENT root RATE 60Mbps CEIL 100Mbps PRIO 1,
+          CLASS bulk PARENT root RATE 30Mbps CEIL 90Mbps PRIO 2);
+  q1 -> [0] hs; q2 -> [1] hs; q3 -> [2] hs;
+  hs -> Unqueue -> ...
+
+=h rate read/write
+
+When read, returns one line per class with its name, RATE and CEIL. Write
+"I<name> I<rate> [I<ceil>]" to change a class's RATE, and optionally its
+CEIL, without reconfiguring. If CEIL is omitted it is kept, unless it is
+below the new RATE, in which case it is raised to RATE. Default BURST and
+CBURST values follow the new rates.
+
+=h stats read-only
+
+Returns one line per class with its mode, rates, tokens, and counts of the
+packets and bytes it sent, the packets it sent within its own rate ("lends"),
+the packets it sent on borrowed bandwidth ("borrows"), and the times it ran
+out of CEIL tokens ("overlimits").
+
+=a BandwidthShaper, BandwidthRatedUnqueue, PrioSched, DRRSched */
+
+class HierarchicalShaper : public Element { public:
+
+    HierarchicalShaper() CLICK_COLD;
+    ~HierarchicalShaper() CLICK_COLD;
+
+    const char *class_name() const		{ return "HierarchicalShaper"; }
+    const char *port_count() const		{ return "-/1"; }
+    const char *processing() const		{ return PULL; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    Packet *pull(int port);
+    void run_timer(Timer *);
+
+  private:
+
+    enum { max_prio = 8, max_level = 8, map_bits = 32 };
+    enum { mode_cant_send = 0, mode_may_borrow = 1, mode_can_send = 2 };
+
+    struct Class {
+	String name;
+	Class *parent;
+	HierarchicalShaper *shaper;
+	int index;
+	int level;		// 0 for leaves; roots are max_level - 1
+	int port;		// input port for leaves, -1 for inner classes
+	int prio;
+	int quantum;
+	unsigned rate;		// bytes per second
+	unsigned ceil;
+	unsigned burst;		// 0 means derive from rate
+	unsigned cburst;
+	TokenBucket tb;
+	TokenBucket ctb;
+	int mode;
+	uint8_t prio_activity;	// prios this class has backlogged leaves in
+	int heap_index;		// position in _wait, -1 if not waiting
+	click_jiffies_t wait_until;
+	int deficit[max_level];
+	Class *next[max_prio];	// ring links, per prio
+	Class *prev[max_prio];
+	Class *feed[max_prio];	// inner classes: ring of borrowing children
+	NotifierSignal signal;	// leaves: upstream empty signal
+	volatile unsigned pending_rate;
+	volatile unsigned pending_ceil;
+	uint64_t packets;
+	uint64_t bytes;
+	uint32_t lends;
+	uint32_t borrows;
+	uint32_t overlimits;
+    };
+
+    struct heap_less {
+	inline bool operator()(Class *a, Class *b) {
+	    return click_jiffies_less(a->wait_until, b->wait_until);
+	}
+    };
+    struct heap_place {
+	inline void operator()(Class **begin, Class **it) {
+	    (*it)->heap_index = it - begin;
+	}
+    };
+
+    Vector<Class> _classes;
+    Vector<Class *> _leaves;
+    Vector<Class *> _wait;	// heap of classes waiting for tokens
+    Class *_row[max_level][max_prio];
+    uint8_t _row_mask[max_level];
+    unsigned _mtu;
+    int _nactive;		// backlogged leaves
+
+    int _map_words;
+    atomic_uint32_t *_pending;	// leaves whose inputs woke up
+    atomic_uint32_t _pending_any;
+    uint32_t *_poll;		// leaves that may still have packets
+    bool _polling;
+    atomic_uint32_t *_updates;	// classes with pending rate changes
+    atomic_uint32_t _updates_any;
+
+    ActiveNotifier _empty_note;
+    Timer _timer;
+
+    static inline void ring_insert(Class *&head, Class *c, int prio);
+    static inline void ring_remove(Class *&head, Class *c, int prio);
+    inline void set_bursts(Class *c);
+    int class_mode(Class *c, click_jiffies_t &wait);
+    void activate_prios(Class *c);
+    void deactivate_prios(Class *c);
+    void update_mode(Class *c, click_jiffies_t now, bool rekey);
+    void activate_leaf(Class *c);
+    void deactivate_leaf(Class *c);
+    void wake_leaves();
+    void apply_updates(click_jiffies_t now);
+    void run_events(click_jiffies_t now);
+    inline Class *lookup_leaf(int prio, int level);
+    Packet *dequeue_tree(int prio, int level, click_jiffies_t now);
+    void charge(Class *c, int level, unsigned len, click_jiffies_t now);
+    Packet *pull_empty(click_jiffies_t now);
+    Class *find_class(const String &name);
+    int parse_class(const String &spec, ErrorHandler *errh);
+
+    static void leaf_wake(void *user_data, Notifier *);
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
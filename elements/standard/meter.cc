@@ -27,7 +27,7 @@ Meter::Meter()
 void
 Meter::push(int, Packet *p)
 {
-  _rate.update(1);		// packets, not bytes
+  count(1);			// packets, not bytes
 
   unsigned r = _rate.scaled_average();
   if (_nmeters < 2) {
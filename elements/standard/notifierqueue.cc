@@ -90,6 +90,46 @@ NotifierQueue::pull(int)
     return p;
 }
 
+void
+NotifierQueue::push_batch(int, PacketBatch &batch)
+{
+    // Code taken from SimpleQueue::push_batch().
+    Storage::index_type h = head();
+    if (enq_burst(_q, batch)) {
+	int s = size(h, tail());
+	if (s > _highwater_length)
+	    _highwater_length = s;
+	_empty_note.wake();
+    }
+    if (!batch.empty()) {
+	if (_drops == 0 && _capacity > 0)
+	    click_chatter("%p{element}: overflow", this);
+	_drops += batch.count();
+	while (Packet *p = batch.pop_front())
+	    checked_output_push(1, p);
+    }
+}
+
+int
+NotifierQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    unsigned n = deq_burst(_q, max, batch);
+
+    // Code taken from NotifierQueue::pull().
+    if (n)
+	_sleepiness = 0;
+    else if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+#if HAVE_MULTITHREAD
+	if (size())
+	    _empty_note.wake();
+#endif
+    } else
+	++_sleepiness;
+
+    return n;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 NotifierQueue::read_handler(Element *e, void *)
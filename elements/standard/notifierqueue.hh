@@ -79,6 +79,8 @@ class NotifierQueue : public SimpleQueue { public:
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    int pull_batch(int port, unsigned max, PacketBatch &batch);
 
 #if CLICK_DEBUG_SCHEDULING
     void add_handlers() CLICK_COLD;
@@ -47,6 +47,24 @@ Paint::simple_action(Packet *p)
     return p;
 }
 
+void
+Paint::push_batch(int, PacketBatch &batch)
+{
+    for (Packet *p = batch.first(); p; p = p->next())
+	p->set_anno_u8(_anno, _color);
+    output(0).push_batch(batch);
+}
+
+int
+Paint::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    Packet *last = batch.last();
+    int n = input(0).pull_batch(max, batch);
+    for (Packet *p = last ? last->next() : batch.first(); p; p = p->next())
+	p->set_anno_u8(_anno, _color);
+    return n;
+}
+
 void
 Paint::add_handlers()
 {
@@ -37,6 +37,8 @@ class Paint : public Element { public:
     void add_handlers() CLICK_COLD;
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
+    int pull_batch(int port, unsigned max, PacketBatch &batch);
 
   private:
 
@@ -23,33 +23,26 @@
 CLICK_DECLS
 
 PrioSched::PrioSched()
-    : _signals(0)
 {
 }
 
 int
 PrioSched::initialize(ErrorHandler *errh)
 {
-    if (!(_signals = new NotifierSignal[ninputs()]))
+    if (_ready.initialize(this) < 0)
 	return errh->error("out of memory!");
-    for (int i = 0; i < ninputs(); i++)
-	_signals[i] = Notifier::upstream_empty_signal(this, i);
     return 0;
 }
 
-void
-PrioSched::cleanup(CleanupStage)
-{
-    delete[] _signals;
-}
-
 Packet *
 PrioSched::pull(int)
 {
     Packet *p;
-    for (int i = 0; i < ninputs(); i++)
-	if (_signals[i] && (p = input(i).pull()))
+    for (int i = _ready.next(0); i >= 0; i = _ready.next(i + 1))
+	if (_ready.signal(i) && (p = input(i).pull()))
 	    return p;
+	else
+	    _ready.idle(i);
     return 0;
 }
 
@@ -2,7 +2,7 @@
 #ifndef CLICK_PRIOSCHED_HH
 #define CLICK_PRIOSCHED_HH
 #include <click/element.hh>
-#include <click/notifier.hh>
+#include <click/standard/readyinputs.hh>
 CLICK_DECLS
 
 /*
@@ -17,7 +17,9 @@ CLICK_DECLS
  * This amounts to a strict priority scheduler.
  *
  * The inputs usually come from Queues or other pull schedulers.
- * PrioSched uses notification to avoid pulling from empty inputs.
+ * PrioSched uses notification to avoid pulling from empty inputs:
+ * inputs whose notifiers have gone to sleep are skipped in constant time,
+ * however many there are.
  *
  * =a Queue, RoundRobinSched, StrideSched, DRRSched, SimplePrioSched
  */
@@ -32,13 +34,12 @@ class PrioSched : public Element { public:
     const char *flags() const		{ return "S0"; }
 
     int initialize(ErrorHandler *) CLICK_COLD;
-    void cleanup(CleanupStage) CLICK_COLD;
 
     Packet *pull(int port);
 
   private:
 
-    NotifierSignal *_signals;
+    ReadyInputs _ready;
 
 };
 
@@ -74,6 +74,9 @@ class QuickNoteQueue : public FullNoteQueue { public:
 
     // FullNoteQueue's push() suffices
     Packet *pull(int port);
+    int pull_batch(int port, unsigned max, PacketBatch &batch) {
+	return Element::pull_batch(port, max, batch);
+    }
 
 };
 
@@ -27,18 +27,54 @@
 CLICK_DECLS
 
 RatedUnqueue::RatedUnqueue()
-    : _task(this), _timer(&_task), _runs(0), _pushes(0), _failed_pulls(0), _empty_runs(0), _active(true)
+    : _task(this), _timer(&_task), _runs(0), _pushes(0), _failed_pulls(0), _empty_runs(0), _active(true),
+      _precise(false), _waiting(false), _batch(1), _rate(0), _unit_cost(0), _tau(0),
+      _tat(0), _tat_frac(0), _spin(0), _deadline(0)
 {
+    reset_pacing();
 }
 
 int
 RatedUnqueue::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    return configure_helper(&_tb, is_bandwidth(), this, conf, errh);
+    bool precise = false;
+    Timestamp spin = Timestamp::make_usec(0, 50);
+    unsigned batch = 1;
+    Args args(this, errh);
+    args.bind(conf).read("PRECISE", precise).read("SPIN", spin);
+    if (!is_bandwidth())
+	args.read("BATCH", batch);
+    if (args.consume() < 0)
+	return -1;
+    if (batch < 1 || batch > paced_batch_max)
+	return errh->error("BATCH must be between 1 and %d", (int) paced_batch_max);
+
+    unsigned rate, burst;
+    if (configure_helper(&_tb, is_bandwidth(), this, conf, errh, &rate, &burst) < 0)
+	return -1;
+
+    // One token costs 10^9 / RATE nanoseconds.  A bucket of BURST tokens
+    // lets a packet leave up to BURST tokens' time early; without byte
+    // debts, a packet bucket holds the packet being sent, too.
+    if (precise != _precise)
+	reset_pacing();		// the two modes keep time differently
+    _precise = precise;
+    _batch = batch;
+    _spin = spin.nsecval();
+    _rate = rate;
+    _unit_cost = rate ? ((uint64_t) 1000000000 << cost_shift) / rate : 0;
+    if (!is_bandwidth() && burst)
+	--burst;
+    _tau = (int64_t) ((burst * _unit_cost) >> cost_shift);
+    _tat = Timestamp::now_steady().nsecval();
+    _tat_frac = 0;
+    _waiting = false;
+    _deadline = 0;
+    return 0;
 }
 
 int
-RatedUnqueue::configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh)
+RatedUnqueue::configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh, unsigned *rate_out, unsigned *burst_out)
 {
     unsigned r;
     unsigned dur_msec = 20;
@@ -64,6 +100,10 @@ RatedUnqueue::configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt,
 	bigint::divide(res, res, 2, 1000);
 	tokens = res[1] ? UINT_MAX : res[0];
     }
+    if (rate_out)
+	*rate_out = r;
+    if (burst_out)
+	*burst_out = tokens ? tokens : 1;
 
     if (is_bandwidth) {
 	unsigned new_tokens = tokens + tb_bandwidth_thresh;
@@ -83,6 +123,109 @@ RatedUnqueue::initialize(ErrorHandler *errh)
     return 0;
 }
 
+void
+RatedUnqueue::note_release(unsigned packets, unsigned units, int64_t now)
+{
+    if (_deadline) {
+	int64_t late = now - _deadline;
+	if (late < 0)
+	    late = 0;
+	++_late_count;
+	_late_sum += late;
+	if (late > _late_max)
+	    _late_max = late;
+	_deadline = 0;
+    }
+    _last_release = now;
+    _units += units;
+    _burst += packets;
+    _waiting = false;
+}
+
+void
+RatedUnqueue::note_wait(int64_t deadline)
+{
+    // Measure the achieved rate from the end of the first burst, when the
+    // bucket has first run dry.
+    if (!_first_release && _units) {
+	_first_release = deadline;
+	_first_units = _units;
+    }
+    if (!_waiting && _burst) {
+	++_bursts;
+	_burst_packets += _burst;
+	if (_burst > _max_burst)
+	    _max_burst = _burst;
+	_burst = 0;
+    }
+    _waiting = true;
+    _deadline = deadline;
+}
+
+void
+RatedUnqueue::reset_pacing()
+{
+    _units = _first_units = 0;
+    _first_release = _last_release = 0;
+    _bursts = _burst = _max_burst = 0;
+    _burst_packets = 0;
+    _late_count = 0;
+    _late_sum = _late_max = 0;
+}
+
+bool
+RatedUnqueue::run_paced()
+{
+    // Release every packet whose departure time has come, as one batch.
+    int64_t now = Timestamp::now_steady().nsecval();
+    PacketBatch batch;
+    unsigned units = 0;
+    bool empty = false;
+    while (_tat - _tau <= now && batch.count() < paced_batch_max) {
+	Packet *p = input(0).pull();
+	if (!p) {
+	    _failed_pulls++;
+	    empty = true;
+	    break;
+	}
+	if (_tat < now) {
+	    _tat = now;
+	    _tat_frac = 0;
+	}
+	unsigned u = is_bandwidth() ? p->length() : 1;
+	uint64_t cost = u * _unit_cost + _tat_frac;
+	_tat += cost >> cost_shift;
+	_tat_frac = cost & ((1U << cost_shift) - 1);
+	units += u;
+	batch.append(p);
+    }
+
+    unsigned n = batch.count();
+    if (n) {
+	_pushes += n;
+	note_release(n, units, now);
+	output(0).push_batch(batch);
+    }
+
+    if (empty) {
+	if (!_signal)
+	    return n > 0;	// without rescheduling
+	_task.fast_reschedule();
+    } else if (_tat - _tau > now) {
+	// Sleep until just before the deadline, then poll.
+	int64_t deadline = _tat - _tau;
+	note_wait(deadline);
+	if (deadline - now > _spin)
+	    _timer.schedule_at_steady(Timestamp::make_nsec(deadline - _spin));
+	else
+	    _task.fast_reschedule();
+    } else
+	_task.fast_reschedule();
+    if (!n)
+	_empty_runs++;
+    return n > 0;
+}
+
 bool
 RatedUnqueue::run_task(Task *)
 {
@@ -90,12 +233,33 @@ RatedUnqueue::run_task(Task *)
     _runs++;
     if (!_active)
 	return false;
-    _tb.refill();
+    if (_precise)
+	return run_paced();
+    // Jiffy mode keeps its statistics in jiffies, too, so releases cost no
+    // extra clock reads.
+    click_jiffies_t now = click_jiffies();
+    _tb.refill(now);
     if (_tb.contains(1)) {
-	if (Packet *p = input(0).pull()) {
+	unsigned n = 0;
+	if (_batch > 1) {
+	    // Take up to BATCH packets the bucket allows with one pull_batch().
+	    unsigned max = _tb.size();
+	    if (max > _batch)
+		max = _batch;
+	    PacketBatch batch;
+	    if ((n = input(0).pull_batch(max, batch))) {
+		_tb.remove(n);
+		note_release(n, n, jiffy_nsec(now));
+		output(0).push_batch(batch);
+	    }
+	} else if (Packet *p = input(0).pull()) {
+	    n = 1;
 	    _tb.remove(1);
+	    note_release(1, 1, jiffy_nsec(now));
 	    output(0).push(p);
-            _pushes++;
+	}
+	if (n) {
+            _pushes += n;
 	    worked = true;
 	} else { // no Packet available
             _failed_pulls++;
@@ -103,7 +267,9 @@ RatedUnqueue::run_task(Task *)
 		return false; // without rescheduling
         }
     } else {
-	_timer.schedule_after(Timestamp::make_jiffies(_tb.time_until_contains(1)));
+	click_jiffies_t delay = _tb.time_until_contains(1);
+	note_wait(jiffy_nsec(now + delay));
+	_timer.schedule_after(Timestamp::make_jiffies(delay));
 	_empty_runs++;
 	return false;
     }
@@ -113,6 +279,32 @@ RatedUnqueue::run_task(Task *)
     return worked;
 }
 
+String
+RatedUnqueue::unparse_pacing() const
+{
+    StringAccum sa;
+    // Rates in units per second.
+    uint64_t achieved = 0;
+    int64_t span_us = (_last_release - _first_release) / 1000;
+    if (_first_release && span_us > 0)
+	achieved = (_units - _first_units) * 1000000 / span_us;
+    int64_t error_ppm = _rate ? ((int64_t) achieved - (int64_t) _rate) * 1000000 / (int64_t) _rate : 0;
+    if (is_bandwidth())
+	sa << "rate " << BandwidthArg::unparse(_rate) << '\n'
+	   << "achieved_rate " << BandwidthArg::unparse(achieved > 0xFFFFFFFFU ? 0xFFFFFFFFU : achieved) << '\n';
+    else
+	sa << "rate " << _rate << '\n'
+	   << "achieved_rate " << achieved << '\n';
+    sa << "rate_error_ppm " << error_ppm << '\n'
+       << "bursts " << _bursts << '\n';
+    uint64_t mean100 = _bursts ? _burst_packets * 100 / _bursts : 0;
+    sa.snprintf(64, "mean_burst %u.%02u\n", (unsigned) (mean100 / 100), (unsigned) (mean100 % 100));
+    sa << "max_burst " << _max_burst << '\n'
+       << "mean_lateness " << Timestamp::make_nsec(_late_count ? _late_sum / _late_count : 0) << '\n'
+       << "max_lateness " << Timestamp::make_nsec(_late_max) << '\n';
+    return sa.take_string();
+}
+
 String
 RatedUnqueue::read_handler(Element *e, void *thunk)
 {
@@ -131,15 +323,31 @@ RatedUnqueue::read_handler(Element *e, void *thunk)
 	     << ru->_failed_pulls << " failed pulls\n";
 	  return sa.take_string();
       }
+      case h_pacing:
+	return ru->unparse_pacing();
     }
     return String();
 }
 
+int
+RatedUnqueue::write_handler(const String &, Element *e, void *thunk, ErrorHandler *)
+{
+    RatedUnqueue *ru = (RatedUnqueue *)e;
+    switch ((uintptr_t) thunk) {
+      case h_reset_pacing:
+	ru->reset_pacing();
+	return 0;
+    }
+    return -1;
+}
+
 void
 RatedUnqueue::add_handlers()
 {
     add_read_handler("calls", read_handler, h_calls);
     add_read_handler("rate", read_handler, h_rate);
+    add_read_handler("pacing", read_handler, h_pacing);
+    add_write_handler("reset_pacing", write_handler, h_reset_pacing, Handler::BUTTON);
     add_write_handler("rate", reconfigure_keyword_handler, "0 RATE");
     add_data_handlers("active", Handler::OP_READ | Handler::OP_WRITE | Handler::CHECKBOX, &_active);
     add_task_handlers(&_task);
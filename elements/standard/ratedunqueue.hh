@@ -38,8 +38,48 @@ CLICK_DECLS
  * Integer.  If specified, the capacity of the token bucket is set to this
  * value.
  *
+ * =item PRECISE
+ *
+ * Boolean.  If true, pace packets with nanosecond precision rather than in
+ * jiffies.  Default is false.
+ *
+ * =item SPIN
+ *
+ * Time.  In PRECISE mode, wait for deadlines closer than this by keeping the
+ * task scheduled, rather than by sleeping on a timer.  Default is 50us.
+ *
+ * =item BATCH
+ *
+ * Integer between 1 and 256.  Outside PRECISE mode, pull up to this many
+ * packets per task run with one batched pull, which a Queue serves with a
+ * single ring update.  Default is 1, which releases one packet per run.
+ *
+ * =back
+ *
+ * By default, RatedUnqueue refills its bucket once per jiffy and sleeps
+ * until the next jiffy when the bucket is empty, so at high rates it sends
+ * a jiffy's worth of packets at a time.  In PRECISE mode it instead tracks
+ * the time each packet may leave to the nanosecond, using the same rate and
+ * burst.  When a packet must wait, RatedUnqueue sleeps on a timer until SPIN
+ * before the deadline, then polls until the deadline itself.  Each wakeup
+ * releases every packet the elapsed time allows, as one batch.
+ *
  * =h rate read/write
  *
+ * =h pacing read-only
+ *
+ * Returns pacing statistics: the configured and achieved rates, the
+ * achieved rate's error in parts per million, and the number, mean size,
+ * and largest size of bursts, where a burst is the packets released between
+ * two waits for tokens.  Also reports how late wakeups were relative to
+ * their deadlines.  The achieved rate is measured from the first time the
+ * bucket runs dry, and is meaningful only while the input stays backlogged.
+ * Outside PRECISE mode these times are measured in jiffies.
+ *
+ * =h reset_pacing write-only
+ *
+ * Resets the pacing statistics.
+ *
  * =a BandwidthRatedUnqueue, Unqueue, Shaper, RatedSplitter */
 
 class RatedUnqueue : public Element { public:
@@ -52,7 +92,7 @@ class RatedUnqueue : public Element { public:
     bool is_bandwidth() const		{ return class_name()[0] == 'B'; }
 
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
-    static int configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh);
+    static int configure_helper(TokenBucket *tb, bool is_bandwidth, Element *elt, Vector<String> &conf, ErrorHandler *errh, unsigned *rate_out = 0, unsigned *burst_out = 0);
     enum { tb_bandwidth_thresh = 131072 };
 
     bool can_live_reconfigure() const	{ return true; }
@@ -72,11 +112,48 @@ class RatedUnqueue : public Element { public:
     uint32_t _failed_pulls;
     uint32_t _empty_runs;
 
-    enum { h_calls, h_rate };
+    enum { h_calls, h_rate, h_pacing, h_reset_pacing };
 
     static String read_handler(Element *e, void *thunk) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
 
     bool _active;
+
+    // PRECISE pacing: a packet may leave once _tat - _tau <= now.  Times
+    // are steady-clock nanoseconds; costs carry 16 fraction bits.
+    enum { cost_shift = 16, paced_batch_max = 256 };
+    bool _precise;
+    bool _waiting;
+    unsigned _batch;
+    unsigned _rate;
+    uint64_t _unit_cost;	// per packet, or per byte if is_bandwidth()
+    int64_t _tau;
+    int64_t _tat;
+    uint32_t _tat_frac;
+    int64_t _spin;
+    int64_t _deadline;
+
+    // Pacing statistics
+    uint64_t _units;
+    uint64_t _first_units;
+    int64_t _first_release;
+    int64_t _last_release;
+    uint32_t _bursts;
+    uint32_t _burst;
+    uint32_t _max_burst;
+    uint64_t _burst_packets;
+    uint32_t _late_count;
+    int64_t _late_sum;
+    int64_t _late_max;
+
+    bool run_paced();
+    void note_release(unsigned packets, unsigned units, int64_t now);
+    static int64_t jiffy_nsec(click_jiffies_t j) {
+	return Timestamp::make_jiffies(j).nsecval();
+    }
+    void note_wait(int64_t deadline);
+    void reset_pacing();
+    String unparse_pacing() const;
 };
 
 CLICK_ENDDECLS
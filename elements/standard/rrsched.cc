@@ -22,33 +22,29 @@
 CLICK_DECLS
 
 RRSched::RRSched()
-    : _next(0), _signals(0)
+    : _next(0)
 {
 }
 
 int
 RRSched::initialize(ErrorHandler *errh)
 {
-    if (!(_signals = new NotifierSignal[ninputs()]))
+    if (_ready.initialize(this) < 0)
 	return errh->error("out of memory!");
-    for (int i = 0; i < ninputs(); i++)
-	_signals[i] = Notifier::upstream_empty_signal(this, i);
     return 0;
 }
 
-void
-RRSched::cleanup(CleanupStage)
-{
-    delete[] _signals;
-}
-
 Packet *
 RRSched::pull(int)
 {
     int n = ninputs();
     int i = _next;
     for (int j = 0; j < n; j++) {
-	Packet *p = (_signals[i] ? input(i).pull() : 0);
+	if ((i = _ready.next_cyclic(i)) < 0)
+	    break;
+	Packet *p = (_ready.signal(i) ? input(i).pull() : 0);
+	if (!p)
+	    _ready.idle(i);
 	i++;
 	if (i >= n)
 	    i = 0;
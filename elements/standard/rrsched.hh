@@ -2,7 +2,7 @@
 #ifndef CLICK_RRSCHED_HH
 #define CLICK_RRSCHED_HH
 #include <click/element.hh>
-#include <click/notifier.hh>
+#include <click/standard/readyinputs.hh>
 CLICK_DECLS
 
 /*
@@ -20,7 +20,9 @@ CLICK_DECLS
  * scheduler.
  *
  * The inputs usually come from Queues or other pull schedulers.
- * RoundRobinSched uses notification to avoid pulling from empty inputs.
+ * RoundRobinSched uses notification to avoid pulling from empty inputs:
+ * inputs whose notifiers have gone to sleep are skipped in constant time,
+ * however many there are.
  *
  * =a PrioSched, StrideSched, DRRSched, RoundRobinSwitch, SimpleRoundRobinSched
  */
@@ -35,14 +37,13 @@ class RRSched : public Element { public:
     const char *flags() const		{ return "S0"; }
 
     int initialize(ErrorHandler *) CLICK_COLD;
-    void cleanup(CleanupStage) CLICK_COLD;
 
     Packet *pull(int port);
 
   private:
 
     int _next;
-    NotifierSignal *_signals;
+    ReadyInputs _ready;
 
 };
 
@@ -21,8 +21,11 @@
 #include <click/confparse.hh>
 #include <click/error.hh>
 #include <click/standard/scheduleinfo.hh>
+#include <click/straccum.hh>
+#include <click/master.hh>
 #include <sys/select.h>
 #include <math.h>
+#include <errno.h>
 #include <pthread.h>
 
 CLICK_DECLS
@@ -31,8 +34,13 @@ RunSchedule::RunSchedule() : new_sched(false), _task(this), _num_hosts(0),
                              _small_queue_cap(16), _big_queue_cap(128),
                              _small_marking_thresh(1000),
                              _big_marking_thresh(1000), _print(0),
-                             _in_advance(12000), _next_time(0)
+                             _in_advance(12000),
+                             _last_generation(0), _latency_log(0),
+                             _npartitions(1), _partitions(0),
+                             _next_thread_sched(0)
 {
+    _next_stamp.generation = 0;
+    memset(&_timeline_params, 0, sizeof(_timeline_params));
     pthread_mutex_init(&lock, NULL);
     clock_gettime(CLOCK_MONOTONIC, &_start_time);
 }
@@ -40,22 +48,122 @@ RunSchedule::RunSchedule() : new_sched(false), _task(this), _num_hosts(0),
 int
 RunSchedule::configure(Vector<String> &conf, ErrorHandler *errh)
 {
+    String threads;
     if (Args(conf, this, errh)
         .read_mp("NUM_HOSTS", _num_hosts)
         .read_mp("RESIZE", do_resize)
+        .read("PARTITIONS", _npartitions)
+        .read("PARTITION_THREADS", AnyArg(), threads)
         .complete() < 0)
         return -1;
     if (_num_hosts == 0)
         return -1;
+    if (_npartitions < 1 || _npartitions > _num_hosts)
+        return errh->error("PARTITIONS must be between 1 and NUM_HOSTS");
+
+    _partitions = new schedule_partition[_npartitions];
+    Vector<String> thread_ids;
+    cp_spacevec(cp_unquote(threads), thread_ids);
+    for (int p = 0; p < _npartitions; p++) {
+        _partitions[p].dst_begin = p * _num_hosts / _npartitions;
+        _partitions[p].dst_end = (p + 1) * _num_hosts / _npartitions;
+        _partitions[p].thread = 0;
+        _partitions[p].task = 0;
+        _partitions[p].done = 0;
+        _partitions[p].claimed = 0;
+        _partitions[p].dead = false;
+        if (_npartitions > 1
+            && (p >= thread_ids.size()
+                || !IntArg().parse(thread_ids[p], _partitions[p].thread)))
+            return errh->error("PARTITION_THREADS must list one thread per partition");
+        if (_npartitions > 1
+            && (_partitions[p].thread < 0
+                || _partitions[p].thread >= master()->nthreads()))
+            return errh->error("partition %d: no thread %d", p, _partitions[p].thread);
+    }
+
+    // Each partition pulls its own destinations' VOQs.
+    if (_npartitions > 1) {
+        for (int p = 0; p < _npartitions; p++)
+            for (int dst = _partitions[p].dst_begin;
+                 dst < _partitions[p].dst_end; dst++) {
+                String link = "hybrid_switch/circuit_link" + String(dst + 1);
+                for (int i = 0; i < router()->nelements(); i++) {
+                    const String &name = router()->ename(i);
+                    if (name == link || name.starts_with(link + "/")) {
+                        if (i >= _thread_preferences.size())
+                            _thread_preferences.resize(i + 1, THREAD_UNKNOWN);
+                        _thread_preferences[i] = _partitions[p].thread;
+                    }
+                }
+            }
+        _next_thread_sched = router()->thread_sched();
+        router()->set_thread_sched(this);
+    }
+    _work_generation = 0;
     next_schedule = "";
     return 0;
 }
 
+// A StaticThreadSched's explicit placement wins over the partitions'.
+int
+RunSchedule::initial_home_thread_id(const Element *e)
+{
+    int x = THREAD_UNKNOWN;
+    if (_next_thread_sched)
+        x = _next_thread_sched->initial_home_thread_id(e);
+    int eidx = e->eindex();
+    if (x == THREAD_UNKNOWN && eidx >= 0 && eidx < _thread_preferences.size())
+        x = _thread_preferences[eidx];
+    return x;
+}
+
+int
+RunSchedule::initial_steal_policy(const Element *e)
+{
+    int x = STEAL_UNKNOWN;
+    if (_next_thread_sched)
+        x = _next_thread_sched->initial_steal_policy(e);
+    int eidx = e->eindex();
+    if (x == STEAL_UNKNOWN && eidx >= 0 && eidx < _thread_preferences.size()
+        && _thread_preferences[eidx] != THREAD_UNKNOWN)
+        x = STEAL_NEVER;
+    return x;
+}
+
+// Return an element other than this one on thread @a thread whose task,
+// once running, never returns to the scheduler (flag Y0).
+Element *
+RunSchedule::never_yielding_element(int thread) const
+{
+    for (int i = 0; i < router()->nelements(); i++) {
+        Element *e = router()->element(i);
+        if (e != this && router()->home_thread_id(e) == thread
+            && e->flag_value('Y') == 0)
+            return e;
+    }
+    return 0;
+}
+
 int
 RunSchedule::initialize(ErrorHandler *errh)
 {
     ScheduleInfo::initialize_task(this, &_task, true, errh);
 
+    // The runner task never yields its thread, so partition tasks must live
+    // elsewhere.
+    if (_npartitions > 1)
+        for (int p = 0; p < _npartitions; p++) {
+            int thread = _partitions[p].thread;
+            if (thread == _task.home_thread_id())
+                return errh->error("partition %d: thread %d runs the schedule runner", p, thread);
+            if (Element *e = never_yielding_element(thread))
+                return errh->error("partition %d: thread %d runs %p{element}, whose task never yields", p, thread, e);
+            _partitions[p].task = new Task(this);
+            _partitions[p].task->move_thread(thread);
+            _partitions[p].task->initialize(this, false);
+        }
+
 #if defined(__linux__)
     sched_setscheduler(getpid(), SCHED_RR, NULL);
 #endif
@@ -116,17 +224,147 @@ RunSchedule::initialize(ErrorHandler *errh)
     return 0;
 }
 
+void
+RunSchedule::cleanup(CleanupStage)
+{
+    if (_latency_log) {
+        fclose(_latency_log);
+        _latency_log = 0;
+    }
+}
+
+void
+RunSchedule::set_schedule(const String &str, const loop_stamp &stamp)
+{
+    pthread_mutex_lock(&lock);
+    if (next_schedule != str) {
+        new_sched = true;
+        _next_stamp = stamp;
+    }
+    next_schedule = String(str);
+    pthread_mutex_unlock(&lock);
+}
+
 int
 RunSchedule::set_schedule_handler(const String &str, Element *e, void *,
                                   ErrorHandler *)
 {
     RunSchedule *rs = static_cast<RunSchedule *>(e);
+    loop_stamp stamp;
+    stamp.generation = 0;
+    rs->set_schedule(str, stamp);
+    return 0;
+}
+
+int
+RunSchedule::set_stamped_schedule_handler(const String &str, Element *e,
+                                          void *, ErrorHandler *errh)
+{
+    RunSchedule *rs = static_cast<RunSchedule *>(e);
+    Vector<String> v = split(str, ' ');
+    loop_stamp stamp;
+    if (v.size() < 4
+        || !IntArg().parse(v[0], stamp.generation)
+        || !IntArg().parse(v[1], stamp.sample_nano)
+        || !IntArg().parse(v[2], stamp.schedule_nano))
+        return errh->error("bad stamped schedule");
+    int skip = v[0].length() + v[1].length() + v[2].length() + 3;
+    rs->set_schedule(str.substring(skip), stamp);
+    return 0;
+}
+
+String
+LoopLatencyHistogram::unparse() const
+{
+    StringAccum sa;
+    sa << "count " << _count << "\n";
+    if (_count) {
+        sa << "mean_us " << (_total_nano / _count) / 1000 << "\n"
+           << "max_us " << _max_nano / 1000 << "\n";
+        for (int b = 0; b < nbuckets; b++)
+            if (_buckets[b])
+                sa << (b ? (uint64_t) 1 << b : 0) << "us " << _buckets[b] << "\n";
+    }
+    return sa.take_string();
+}
+
+// Called by the runner after applying the first configuration of a new
+// stamped schedule.
+void
+RunSchedule::record_latency(const loop_stamp &stamp)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    long long apply_nano = 1e9 * ts.tv_sec + ts.tv_nsec;
+
+    pthread_mutex_lock(&lock);
+    _estimate_latency.add(stamp.schedule_nano - stamp.sample_nano);
+    _actuate_latency.add(apply_nano - stamp.schedule_nano);
+    _loop_latency.add(apply_nano - stamp.sample_nano);
+    _last_generation = stamp.generation;
+    if (_latency_log) {
+        int64_t record[4] = { (int64_t) stamp.generation, stamp.sample_nano,
+                              stamp.schedule_nano, apply_nano };
+        fwrite(record, sizeof(record), 1, _latency_log);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+enum { h_estimate_latency, h_actuate_latency, h_loop_latency,
+       h_last_generation };
+
+String
+RunSchedule::latency_handler(Element *e, void *thunk)
+{
+    RunSchedule *rs = static_cast<RunSchedule *>(e);
+    String out;
+    pthread_mutex_lock(&(rs->lock));
+    switch ((intptr_t) thunk) {
+    case h_estimate_latency:
+        out = rs->_estimate_latency.unparse();
+        break;
+    case h_actuate_latency:
+        out = rs->_actuate_latency.unparse();
+        break;
+    case h_loop_latency:
+        out = rs->_loop_latency.unparse();
+        break;
+    case h_last_generation:
+        out = String(rs->_last_generation);
+        break;
+    }
+    pthread_mutex_unlock(&(rs->lock));
+    return out;
+}
+
+int
+RunSchedule::reset_latency_handler(const String &, Element *e, void *,
+                                   ErrorHandler *)
+{
+    RunSchedule *rs = static_cast<RunSchedule *>(e);
+    pthread_mutex_lock(&(rs->lock));
+    rs->_estimate_latency.clear();
+    rs->_actuate_latency.clear();
+    rs->_loop_latency.clear();
+    pthread_mutex_unlock(&(rs->lock));
+    return 0;
+}
 
+int
+RunSchedule::latency_log_handler(const String &str, Element *e, void *,
+                                 ErrorHandler *errh)
+{
+    RunSchedule *rs = static_cast<RunSchedule *>(e);
+    String fn = str.trim_space();
+    FILE *fp = 0;
+    if (fn && !(fp = fopen(fn.c_str(), "ab")))
+        return errh->error("%s: %s", fn.c_str(), strerror(errno));
     pthread_mutex_lock(&(rs->lock));
-    if (rs->next_schedule != str)
-        rs->new_sched = true;
-    rs->next_schedule = String(str);
+    FILE *old = rs->_latency_log;
+    rs->_latency_log = fp;
     pthread_mutex_unlock(&(rs->lock));
+    if (old)
+        fclose(old);
     return 0;
 }
 
@@ -278,6 +516,7 @@ RunSchedule::execute_schedule(ErrorHandler *errh)
     int big_thresh = _big_marking_thresh;
     int in_advance = _in_advance;
     bool new_s = new_sched;
+    loop_stamp stamp = _next_stamp;
     new_sched = false;
     pthread_mutex_unlock(&lock);
 
@@ -341,35 +580,27 @@ RunSchedule::execute_schedule(ErrorHandler *errh)
     //     }
     // }
 
-    // cleanup from previous run during a new schedule roll over
-    if (new_s && resize) {
-        bool *qbig = (bool *)malloc(sizeof(bool) * _num_hosts * _num_hosts);
-        bzero(qbig, sizeof(bool) * _num_hosts * _num_hosts);
-
-        int remaining = in_advance;
-        for(int k = 0; remaining >= 0; k++) {
-            for(int dst = 0; dst < _num_hosts; dst++) {
-                int src = configurations[k % num_configurations][dst];
-                if (src == -1)
-                    continue;
-                _queue_cap[src * _num_hosts + dst]->call_write(String(big_cap));
-                _queue_marking_thresh[src * _num_hosts + dst]->call_write(String(big_thresh));
-                qbig[src * _num_hosts + dst] = true;
-            }
-            remaining -= durations[k % num_configurations];
-        }
-        for(int dst = 0; dst < _num_hosts; dst++) {
-            for(int src = 0; src < _num_hosts; src++) {
-                if(!qbig[src * _num_hosts + dst]) {
-                    _queue_cap[src * _num_hosts + dst]->
-                        call_write(String(small_cap));
-                    _queue_marking_thresh[src * _num_hosts + dst]->
-                        call_write(String(small_thresh));
-                }
-            }
-        }
-        free(qbig);
+    // Rebuild the resizing timeline when the schedule or its parameters
+    // change, and put every VOQ into its state for the start of the week.
+    timeline_params params;
+    params.small_cap = small_cap;
+    params.big_cap = big_cap;
+    params.small_thresh = small_thresh;
+    params.big_thresh = big_thresh;
+    params.in_advance = in_advance;
+    params.resize = resize;
+    if (new_s || current_schedule != _timeline_schedule
+        || memcmp(&params, &_timeline_params, sizeof(params)) != 0) {
+        build_timeline(configurations, durations, num_configurations, params);
+        _timeline_schedule = current_schedule;
+        _timeline_params = params;
+        for (int i = 0; i < _num_hosts * _num_hosts; i++)
+            if (resize)
+                apply_resize(i, _timeline_initial[i]);
+        _ece_map->call_write(_timeline_initial_ece);
     }
+    _timeline_pos = _ece_pos = 0;
+    long long day_start_us = 0;
 
     // Turn on/off the packet switch for special case schedules (e.g., circuit
     // only, packet only) and during a schedule roll over. I.e., only do this
@@ -396,29 +627,11 @@ RunSchedule::execute_schedule(ErrorHandler *errh)
         // }
 
         // set configuration
-        for(int dst = 0; dst < _num_hosts; dst++) {
-            int src = configurations[m][dst];
-            _circuit_pull_switch[dst]->call_write(String(src));
-            // printf("  enabled circuit for: %d -> %d\n", src, dst);
-
-            // If the circuit to this dst is disabled and there are more than
-            // one configuration, then this must be a circuit night. Disable
-            // the packet switch during the circuit night for the next
-            // (src, dst) pair, since that next src is being configured. Note
-            // that the way that this if-check is written implies that no
-            // configuration will contain "-1"s unless that configuration is for
-            // a circuit night.
-            if (src == -1 && num_configurations > 1) {
-                // This is the next src to connect to this dst. Since it is part
-                // of the reconfiguration, its packet network should be
-                // disabled.
-                int next_src = configurations[(m + 1) % num_configurations][dst];
-                _packet_pull_switch[next_src * _num_hosts + dst]->
-                    call_write(String(-1));
-                // printf(("  circuit night. disabled packet switch for next " +
-                //         "configuration: %d -> %d"), next_src, dst);
-            }
-        }
+        run_partitions(op_apply, configurations, num_configurations, m);
+
+        // The first configuration of a new schedule is now in effect.
+        if (new_s && m == 0 && stamp.generation)
+            record_latency(stamp);
 
         // Log the new configuration.
         char conf[500];
@@ -438,54 +651,11 @@ RunSchedule::execute_schedule(ErrorHandler *errh)
             clock_gettime(CLOCK_MONOTONIC, &ts_new);
             long long current_nano = 1e9 * ts_new.tv_sec + ts_new.tv_nsec;
 
-            // If the current time has past the time at which the next proactive
-            // buffer resizing is supposed to happen...
-            if (current_nano > _next_time) {
-                // set ECE
-                char ecem[5500];
-                bzero(ecem, 5500);
-                int q = 0;
-                int remaining_us = in_advance + elapsed_nano / 1e3;
-                // While there is time remaining, step through the upcoming
-                // configurations.
-                for(int k = 0; remaining_us >= 0; k++) {
-                    int future_cnf = (m + k) % num_configurations;
-                    // For each dst...
-                    for(int dst = 0; dst < _num_hosts; dst++) {
-                        // Extract the future src for this dst.
-                        int future_src = configurations[future_cnf][dst];
-                        // If the circuit is disabled for this future
-                        // configuration, then skip to the next configuration.
-                        if (future_src == -1)
-                            continue;
-
-                        ecem[q] = future_src + 1 + '0';
-                        ecem[q + 1] = dst + 1 + '0';
-                        ecem[q + 2] = ' ';
-                        q += 3;
-
-                        if (resize) {
-                            // Increase the buffer size in advance of this
-                            // future circuit.
-                            //
-                            // Make the buffer for this (future_src, dst) pair
-                            // larger.
-                            _queue_cap[future_src * _num_hosts + dst]->
-                                call_write(String(big_cap));
-                            _queue_marking_thresh[future_src * _num_hosts + dst]->
-                                call_write(String(big_thresh));
-                        }
-                    }
-                    // Reduce the remaining time by the duration of this future
-                    // configuration.
-                    remaining_us -= durations[future_cnf];
-                }
-                _ece_map->call_write(String(ecem));
-                // The next proactive resizing
-                _next_time = current_nano - remaining_us * 1e3;
-            }
+            // Apply the resizing and ECE changes that are due.
+            advance_timeline(day_start_us + elapsed_nano / 1000, resize);
+
             // Compute the time since the end of the last configuration.
-            elapsed_nano = (1e9 * ts_new.tv_sec + ts_new.tv_nsec)
+            elapsed_nano = current_nano
                 - (1e9 * _start_time.tv_sec + _start_time.tv_nsec);
         }
         _start_time = ts_new;
@@ -500,45 +670,334 @@ RunSchedule::execute_schedule(ErrorHandler *errh)
 	//     pthread_mutex_unlock(&lock);
 	// }
 
-        // make this days buffers smaller
-        // only if this (src, dst) pair isn't in the next k configs
-        if(resize) {
-            for(int dst = 0; dst < _num_hosts; dst++) {
-                int src = configurations[m][dst];
-                if (src == -1)
-                    continue;
-                bool not_found = true;
-                int remaining = in_advance;
-                for (int k = 1; remaining >= 0; k++) {
-                    int src2 = configurations[(m + k) % num_configurations][dst];
-                    if (src == src2)
-                        not_found = false;
-                    remaining -= durations[(m+k) % num_configurations];
-                }
-                if (not_found) {
-                    _queue_cap[src * _num_hosts + dst]->
-                        call_write(String(small_cap));
-                    _queue_marking_thresh[src * _num_hosts + dst]->
-                        call_write(String(small_thresh));
-                }
+        // make this days buffers smaller, unless the (src, dst) pair has
+        // another circuit within in_advance
+        day_start_us += durations[m];
+        advance_timeline(day_start_us, resize);
+
+        // re-enable packet switch
+        run_partitions(op_release, configurations, num_configurations, m);
+    }
+    free(durations);
+    return 0;
+}
+
+static int
+resize_event_compar(const void *a, const void *b, void *)
+{
+    const resize_event *ea = static_cast<const resize_event *>(a);
+    const resize_event *eb = static_cast<const resize_event *>(b);
+    if (ea->offset != eb->offset)
+        return ea->offset < eb->offset ? -1 : 1;
+    return ea->voq - eb->voq;
+}
+
+static int
+interval_compar(const void *a, const void *b, void *)
+{
+    const long long *ia = static_cast<const long long *>(a);
+    const long long *ib = static_cast<const long long *>(b);
+    return ia[0] < ib[0] ? -1 : (ia[0] > ib[0] ? 1 : 0);
+}
+
+// Derive one week's resizing and ECE changes from a schedule. A VOQ is big
+// from in_advance microseconds before each of its circuits starts until the
+// circuit ends; the ECE map holds exactly the big VOQs. Offsets are in
+// microseconds from the start of the week.
+void
+RunSchedule::build_timeline(const Vector<int> *configurations,
+                            const int *durations, int num_configurations,
+                            const timeline_params &params)
+{
+    int nvoq = _num_hosts * _num_hosts;
+    long long week = 0;
+    for (int k = 0; k < num_configurations; k++)
+        week += durations[k];
+    _timeline.clear();
+    _timeline_initial.assign(nvoq, false);
+    _ece_offsets.clear();
+    _ece_maps.clear();
+    if (week <= 0) {
+        _timeline_initial_ece = String();
+        return;
+    }
+
+    // big intervals for each VOQ, as [begin, end) pairs within the week
+    Vector<Vector<long long> > intervals(nvoq, Vector<long long>());
+    long long start = 0;
+    for (int k = 0; k < num_configurations; k++) {
+        long long begin = start - params.in_advance;
+        long long end = start + durations[k];
+        start = end;
+        for (int dst = 0; dst < _num_hosts; dst++) {
+            int src = configurations[k][dst];
+            if (src == -1)
+                continue;
+            Vector<long long> &iv = intervals[src * _num_hosts + dst];
+            if (end - begin >= week) {
+                iv.push_back(0);
+                iv.push_back(week);
+                continue;
+            }
+            long long b = ((begin % week) + week) % week;
+            long long e = b + (end - begin);
+            iv.push_back(b);
+            iv.push_back(e < week ? e : week);
+            if (e > week) {
+                iv.push_back(0);
+                iv.push_back(e - week);
             }
         }
+    }
 
-        // re-enable packet switch
-        for(int dst = 0; dst < _num_hosts; dst++) {
-            int src = configurations[m][dst];
-            if (src != -1) {
-                _packet_pull_switch[src * _num_hosts + dst]->call_write(String(0));
+    for (int i = 0; i < nvoq; i++) {
+        Vector<long long> &iv = intervals[i];
+        if (!iv.size())
+            continue;
+        click_qsort(iv.begin(), iv.size() / 2, 2 * sizeof(long long),
+                    interval_compar, 0);
+        // merge overlapping intervals, then emit their edges
+        int n = 0;
+        for (int j = 2; j < iv.size(); j += 2)
+            if (iv[j] <= iv[n + 1]) {
+                if (iv[j + 1] > iv[n + 1])
+                    iv[n + 1] = iv[j + 1];
+            } else {
+                n += 2;
+                iv[n] = iv[j];
+                iv[n + 1] = iv[j + 1];
+            }
+        iv.resize(n + 2);
+        _timeline_initial[i] = (iv[0] == 0);
+        bool wraps = _timeline_initial[i] && iv[n + 1] == week;
+        for (int j = 0; j < iv.size(); j += 2) {
+            resize_event ev;
+            ev.voq = i;
+            if (iv[j] != 0) {
+                ev.offset = iv[j];
+                ev.big = true;
+                ev.capacity = params.big_cap;
+                ev.thresh = params.big_thresh;
+                _timeline.push_back(ev);
+            }
+            if (iv[j + 1] != week || !wraps) {
+                ev.offset = iv[j + 1];
+                ev.big = false;
+                ev.capacity = params.small_cap;
+                ev.thresh = params.small_thresh;
+                _timeline.push_back(ev);
             }
         }
     }
-    free(durations);
-    return 0;
+    click_qsort(_timeline.begin(), _timeline.size(), sizeof(resize_event),
+                resize_event_compar, 0);
+
+    // ECE map after each group of simultaneous changes
+    Vector<bool> big(_timeline_initial);
+    _timeline_initial_ece = unparse_ece(big);
+    for (int j = 0; j < _timeline.size(); ) {
+        long long offset = _timeline[j].offset;
+        for (; j < _timeline.size() && _timeline[j].offset == offset; j++)
+            big[_timeline[j].voq] = _timeline[j].big;
+        _ece_offsets.push_back(offset);
+        _ece_maps.push_back(unparse_ece(big));
+    }
+}
+
+String
+RunSchedule::unparse_ece(const Vector<bool> &big) const
+{
+    StringAccum sa;
+    for (int src = 0; src < _num_hosts; src++)
+        for (int dst = 0; dst < _num_hosts; dst++)
+            if (big[src * _num_hosts + dst])
+                sa << (char) (src + 1 + '0') << (char) (dst + 1 + '0') << ' ';
+    return sa.take_string();
+}
+
+void
+RunSchedule::apply_resize(int voq, bool big)
+{
+    const timeline_params &p = _timeline_params;
+    _queue_cap[voq]->call_write(String(big ? p.big_cap : p.small_cap));
+    _queue_marking_thresh[voq]->
+        call_write(String(big ? p.big_thresh : p.small_thresh));
+}
+
+// Apply every timeline change due at or before week offset now_us.
+void
+RunSchedule::advance_timeline(long long now_us, bool resize)
+{
+    for (; _timeline_pos < _timeline.size()
+             && _timeline[_timeline_pos].offset <= now_us; _timeline_pos++)
+        if (resize) {
+            const resize_event &ev = _timeline[_timeline_pos];
+            _queue_cap[ev.voq]->call_write(String(ev.capacity));
+            _queue_marking_thresh[ev.voq]->call_write(String(ev.thresh));
+        }
+    int ece_pos = _ece_pos;
+    while (ece_pos < _ece_offsets.size() && _ece_offsets[ece_pos] <= now_us)
+        ece_pos++;
+    if (ece_pos != _ece_pos) {
+        _ece_map->call_write(_ece_maps[ece_pos - 1]);
+        _ece_pos = ece_pos;
+    }
+}
+
+void
+RunSchedule::apply_configuration(const Vector<int> *configurations,
+                                 int num_configurations, int m,
+                                 int dst_begin, int dst_end)
+{
+    for(int dst = dst_begin; dst < dst_end; dst++) {
+        int src = configurations[m][dst];
+        _circuit_pull_switch[dst]->call_write(String(src));
+        // printf("  enabled circuit for: %d -> %d\n", src, dst);
+
+        // If the circuit to this dst is disabled and there are more than
+        // one configuration, then this must be a circuit night. Disable
+        // the packet switch during the circuit night for the next
+        // (src, dst) pair, since that next src is being configured. Note
+        // that the way that this if-check is written implies that no
+        // configuration will contain "-1"s unless that configuration is for
+        // a circuit night.
+        if (src == -1 && num_configurations > 1) {
+            // This is the next src to connect to this dst. Since it is part
+            // of the reconfiguration, its packet network should be
+            // disabled.
+            int next_src = configurations[(m + 1) % num_configurations][dst];
+            _packet_pull_switch[next_src * _num_hosts + dst]->
+                call_write(String(-1));
+            // printf(("  circuit night. disabled packet switch for next " +
+            //         "configuration: %d -> %d"), next_src, dst);
+        }
+    }
+}
+
+void
+RunSchedule::release_configuration(const Vector<int> *configurations, int m,
+                                   int dst_begin, int dst_end)
+{
+    for(int dst = dst_begin; dst < dst_end; dst++) {
+        int src = configurations[m][dst];
+        if (src != -1) {
+            _packet_pull_switch[src * _num_hosts + dst]->call_write(String(0));
+        }
+    }
+}
+
+void
+RunSchedule::run_partition_op(int op, const Vector<int> *configurations,
+                              int num_configurations, int m,
+                              int dst_begin, int dst_end)
+{
+    if (op == op_apply)
+        apply_configuration(configurations, num_configurations, m,
+                            dst_begin, dst_end);
+    else
+        release_configuration(configurations, m, dst_begin, dst_end);
+}
+
+// Perform op for configuration m on every partition's slice of the
+// destinations. With multiple partitions, the operation is published once and
+// each partition's task performs its slice on its own thread; this returns
+// once all of them are done.
+void
+RunSchedule::run_partitions(int op, const Vector<int> *configurations,
+                            int num_configurations, int m)
+{
+    if (_npartitions == 1) {
+        run_partition_op(op, configurations, num_configurations, m,
+                         0, _num_hosts);
+        return;
+    }
+
+    _work_op = op;
+    _work_configurations = configurations;
+    _work_num_configurations = num_configurations;
+    _work_config = m;
+    uint32_t generation = _work_generation + 1;
+    click_fence();
+    _work_generation = generation;
+    // Dead partitions' shares are applied here without waiting.
+    for (int p = 0; p < _npartitions; p++)
+        if (!_partitions[p].dead)
+            _partitions[p].task->reschedule();
+        else if (claim_partition(p, generation))
+            run_claimed_partition(p, generation);
+
+    struct timespec start, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!partitions_done(generation)) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if ((now.tv_sec - start.tv_sec) * 1000000000LL
+            + (now.tv_nsec - start.tv_nsec) >= partition_timeout_nano)
+            break;
+        click_relax_fence();
+    }
+
+    // A partition's thread is stuck. Claim its share and apply it here, and
+    // stop waiting for that partition from now on. A partition that claimed
+    // its share first is applying it, so wait for it to finish.
+    for (int p = 0; p < _npartitions; p++)
+        if (_partitions[p].done != generation
+            && claim_partition(p, generation)) {
+            click_chatter("%p{element}: partition %d on thread %d not responding, applying its changes from the runner",
+                          this, p, _partitions[p].thread);
+            _partitions[p].dead = true;
+            run_claimed_partition(p, generation);
+        }
+    while (!partitions_done(generation))
+        click_relax_fence();
+}
+
+// Claim partition p's share of the operation published as generation, so
+// that exactly one of the partition's task and the runner applies it.
+bool
+RunSchedule::claim_partition(int p, uint32_t generation)
+{
+    uint32_t claimed = _partitions[p].claimed.value();
+    return claimed != generation
+        && _partitions[p].claimed.compare_swap(claimed, generation) == claimed;
+}
+
+// Apply partition p's claimed share of the published operation.
+void
+RunSchedule::run_claimed_partition(int p, uint32_t generation)
+{
+    click_fence();
+    run_partition_op(_work_op, _work_configurations,
+                     _work_num_configurations, _work_config,
+                     _partitions[p].dst_begin, _partitions[p].dst_end);
+    click_fence();
+    _partitions[p].done = generation;
 }
 
 bool
-RunSchedule::run_task(Task *)
+RunSchedule::partitions_done(uint32_t generation) const
 {
+    for (int p = 0; p < _npartitions; p++)
+        if (_partitions[p].done != generation)
+            return false;
+    return true;
+}
+
+bool
+RunSchedule::run_task(Task *t)
+{
+    if (t != &_task) {
+        // a partition's share of the published operation
+        for (int p = 0; p < _npartitions; p++)
+            if (_partitions[p].task == t) {
+                uint32_t generation = _work_generation;
+                click_fence();
+                if (claim_partition(p, generation))
+                    run_claimed_partition(p, generation);
+                break;
+            }
+        return true;
+    }
+
     while(1) {
         execute_schedule(ErrorHandler::default_handler());
     }
@@ -549,6 +1008,13 @@ void
 RunSchedule::add_handlers()
 {
     add_write_handler("setSchedule", set_schedule_handler, 0);
+    add_write_handler("setStampedSchedule", set_stamped_schedule_handler, 0);
+    add_read_handler("estimate_latency", latency_handler, h_estimate_latency);
+    add_read_handler("actuate_latency", latency_handler, h_actuate_latency);
+    add_read_handler("loop_latency", latency_handler, h_loop_latency);
+    add_read_handler("last_generation", latency_handler, h_last_generation);
+    add_write_handler("reset_latency", reset_latency_handler, 0);
+    add_write_handler("latency_log", latency_log_handler, 0);
     add_write_handler("setDoResize", resize_handler, 0);
     add_write_handler("setInAdvance", in_advance_handler, 0);
     add_write_handler("queue_capacity", set_queue_cap, 0);
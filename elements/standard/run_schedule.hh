@@ -3,13 +3,16 @@
 #define CLICK_RUNSCHEDULE_HH
 #include <click/element.hh>
 #include <click/timer.hh>
+#include <click/task.hh>
+#include <click/atomic.hh>
+#include <click/standard/threadsched.hh>
 #include <pthread.h>
 CLICK_DECLS
 
 /*
 =c
 
-RunSchedule()
+RunSchedule(NUM_HOSTS, RESIZE, I<keywords> PARTITIONS, PARTITION_THREADS)
 
 =s control
 
@@ -17,21 +20,158 @@ Runs an optical circuit switching schedule
 
 =d
 
-TODO
+Runs the schedule most recently written to setSchedule or setStampedSchedule
+over the "hybrid_switch" compound, switching each destination's circuit link
+and the per-VOQ packet links at configuration boundaries.
 
-=h block write-only
+PARTITIONS splits the destination racks into that many contiguous ranges.
+Each partition gets its own task, which applies the partition's share of
+every configuration change on its own thread; the runner publishes each
+change once and waits for all partitions to apply it. Each partition also
+pulls its destinations' VOQs: RunSchedule places the elements of every
+"hybrid_switch/circuit_linkN" compound, N a destination in the partition, on
+the partition's thread, unless a StaticThreadSched places them elsewhere.
+To keep forwarding local, pin the partition's packet switch elements to the
+same thread with StaticThreadSched. PARTITION_THREADS is a
+space-separated list giving each partition's thread, and is required when
+PARTITIONS is more than 1. No partition may share a thread with the runner,
+or with another element whose task never yields, such as EstimateTraffic or
+Solstice. The default is a single partition, which applies changes from the
+runner itself.
 
-Write this handler to block execution for a specified number of seconds.
+If a partition has not started applying a change within 10 milliseconds,
+RunSchedule reports the partition as not responding, applies its share of
+that change from the runner, and applies its share of every later change
+from the runner too, without waiting.
+
+=h setSchedule write-only
+
+Sets the schedule to run, as "NUM_CONFIGURATIONS [DURATION CONFIGURATION]...".
+
+=h setStampedSchedule write-only
+
+Like setSchedule, but the schedule is prefixed by "GENERATION SAMPLE_NS
+SCHEDULE_NS": the generation and CLOCK_MONOTONIC sample time of the traffic
+matrix the schedule was computed from, and the time it was computed. When
+the schedule's first configuration is applied, the control-loop latencies
+are recorded in the latency handlers below.
+
+=h estimate_latency read-only
+
+Returns a histogram of the time from sampling a traffic matrix to finishing
+the schedule computed from it.
+
+=h actuate_latency read-only
+
+Returns a histogram of the time from finishing a schedule to applying its
+first configuration.
+
+=h loop_latency read-only
+
+Returns a histogram of the time from sampling a traffic matrix to applying
+the first configuration of the schedule computed from it.
+
+=h last_generation read-only
+
+Returns the generation of the most recently applied stamped schedule.
+
+=h reset_latency write-only
+
+Clears the latency histograms.
+
+=h latency_log write-only
+
+Write a filename to append one binary record per applied stamped schedule to
+that file; write an empty string to stop logging. Each record is four native
+64-bit integers: generation, sample time, schedule time and apply time, all
+times in CLOCK_MONOTONIC nanoseconds.
 
 */
 
-class RunSchedule : public Element {
+/** @brief Log2 histogram of control-loop latencies, in microseconds. */
+class LoopLatencyHistogram { public:
+
+    enum { nbuckets = 32 };
+
+    LoopLatencyHistogram() {
+	clear();
+    }
+
+    void clear() {
+	memset(_buckets, 0, sizeof(_buckets));
+	_count = _total_nano = _max_nano = 0;
+    }
+
+    void add(long long nano) {
+	if (nano < 0)
+	    nano = 0;
+	uint64_t us = nano / 1000;
+	int b = 0;
+	while (us > 1 && b < nbuckets - 1) {
+	    us >>= 1;
+	    b++;
+	}
+	_buckets[b]++;
+	_count++;
+	_total_nano += nano;
+	if ((uint64_t) nano > _max_nano)
+	    _max_nano = nano;
+    }
+
+    String unparse() const;
+
+  private:
+
+    uint64_t _buckets[nbuckets];	// bucket b counts [2^b, 2^(b+1)) us
+    uint64_t _count;
+    uint64_t _total_nano;
+    uint64_t _max_nano;
+
+};
+
+struct timeline_params {
+    int small_cap;
+    int big_cap;
+    int small_thresh;
+    int big_thresh;
+    int in_advance;
+    int resize;
+};
+
+struct resize_event {
+    long long offset;		// us from the start of the week
+    int voq;			// src * NUM_HOSTS + dst
+    bool big;
+    int capacity;
+    int thresh;
+};
+
+struct schedule_partition {
+    Task *task;
+    int dst_begin;		// first destination rack in this partition
+    int dst_end;		// one past the last destination rack
+    int thread;
+    volatile uint32_t done;	// last _work_generation applied
+    atomic_uint32_t claimed;	// last _work_generation claimed by the
+				// partition's task or the runner
+    bool dead;			// not responding; the runner applies its share
+};
+
+struct loop_stamp {
+    uint64_t generation;	// 0 if the schedule was not stamped
+    long long sample_nano;
+    long long schedule_nano;
+};
+
+class RunSchedule : public Element, public ThreadSched {
   public:
     RunSchedule() CLICK_COLD;
 
     const char *class_name() const	{ return "RunSchedule"; }
+    const char *flags() const		{ return "Y0"; }
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
     void add_handlers() CLICK_COLD;
 
     bool run_task(Task *);
@@ -42,6 +182,10 @@ class RunSchedule : public Element {
 
   private:
     static int set_schedule_handler(const String&, Element*, void*, ErrorHandler*);
+    static int set_stamped_schedule_handler(const String&, Element*, void*, ErrorHandler*);
+    static String latency_handler(Element*, void *);
+    static int reset_latency_handler(const String&, Element*, void*, ErrorHandler*);
+    static int latency_log_handler(const String&, Element*, void*, ErrorHandler*);
     static int resize_handler(const String&, Element*, void*, ErrorHandler*);
     static int in_advance_handler(const String&, Element*, void*, ErrorHandler*);
     static int set_queue_cap(const String&, Element*, void*, ErrorHandler*);
@@ -50,6 +194,27 @@ class RunSchedule : public Element {
     static String get_marking_thresh(Element*, void *);
     static Vector<String> split(const String&, char);
     int execute_schedule(ErrorHandler *);
+    void set_schedule(const String &, const loop_stamp &);
+
+    void build_timeline(const Vector<int> *, const int *, int,
+                        const timeline_params &);
+    String unparse_ece(const Vector<bool> &) const;
+    void apply_resize(int voq, bool big);
+    void advance_timeline(long long now_us, bool resize);
+
+    enum { op_apply, op_release };
+    static const long long partition_timeout_nano = 10000000;
+    void apply_configuration(const Vector<int> *, int, int, int, int);
+    void release_configuration(const Vector<int> *, int, int, int);
+    void run_partition_op(int, const Vector<int> *, int, int, int, int);
+    void run_partitions(int, const Vector<int> *, int, int);
+    int initial_home_thread_id(const Element *e);
+    int initial_steal_policy(const Element *e);
+    bool claim_partition(int p, uint32_t generation);
+    void run_claimed_partition(int p, uint32_t generation);
+    bool partitions_done(uint32_t generation) const;
+    Element *never_yielding_element(int thread) const;
+    void record_latency(const loop_stamp &);
 
     bool new_sched;
     Task _task;
@@ -67,7 +232,40 @@ class RunSchedule : public Element {
     int _print;
     int _in_advance;
     struct timespec _start_time;
-    long long _next_time;
+
+    // per-week resizing timeline, rebuilt when the schedule or its
+    // parameters change
+    String _timeline_schedule;
+    timeline_params _timeline_params;
+    Vector<resize_event> _timeline;
+    Vector<bool> _timeline_initial;	// big at the start of the week
+    String _timeline_initial_ece;
+    Vector<long long> _ece_offsets;
+    Vector<String> _ece_maps;
+    int _timeline_pos;
+    int _ece_pos;
+
+    // control-loop tracing; protected by lock
+    loop_stamp _next_stamp;
+    LoopLatencyHistogram _estimate_latency;
+    LoopLatencyHistogram _actuate_latency;
+    LoopLatencyHistogram _loop_latency;
+    uint64_t _last_generation;
+    FILE *_latency_log;
+
+    // partitioned actuation; _work_* is the operation published to the
+    // partitions
+    int _npartitions;
+    schedule_partition *_partitions;
+    int _work_op;
+    const Vector<int> *_work_configurations;
+    int _work_num_configurations;
+    int _work_config;
+    volatile uint32_t _work_generation;
+
+    // home threads for the partitions' circuit_link elements, by eindex
+    Vector<int> _thread_preferences;
+    ThreadSched *_next_thread_sched;
 };
 
 CLICK_ENDDECLS
@@ -0,0 +1,115 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * sharedbufferpool.{cc,hh} -- packet buffer budget shared by SharedQueues
+ */
+
+#include <click/config.h>
+#include "sharedbufferpool.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+CLICK_DECLS
+
+SharedBufferPool::SharedBufferPool()
+    : _capacity(0), _alpha(1 << alpha_shift), _highwater_length(0)
+{
+    _length = 0;
+    _drops = 0;
+}
+
+void *
+SharedBufferPool::cast(const char *n)
+{
+    if (strcmp(n, "SharedBufferPool") == 0)
+	return this;
+    else
+	return Element::cast(n);
+}
+
+int
+SharedBufferPool::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t capacity, alpha = 1 << alpha_shift;
+    if (Args(conf, this, errh)
+	.read_mp("CAPACITY", capacity)
+	.read_p("ALPHA", FixedPointArg(alpha_shift), alpha)
+	.complete() < 0)
+	return -1;
+    if (alpha > (256U << alpha_shift))
+	return errh->error("ALPHA must be at most 256");
+    _capacity = capacity;
+    _alpha = alpha;
+    return 0;
+}
+
+enum { h_capacity, h_alpha, h_length, h_free, h_highwater, h_drops,
+       h_reset_counts };
+
+String
+SharedBufferPool::read_handler(Element *e, void *thunk)
+{
+    SharedBufferPool *sbp = static_cast<SharedBufferPool *>(e);
+    uint32_t len = sbp->_length.value();
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_capacity:
+	return String(sbp->_capacity);
+    case h_alpha:
+	return cp_unparse_real2(sbp->_alpha, alpha_shift);
+    case h_length:
+	return String(len);
+    case h_free:
+	return String(len < sbp->_capacity ? sbp->_capacity - len : 0);
+    case h_highwater:
+	return String(sbp->_highwater_length);
+    case h_drops:
+	return String(sbp->_drops.value());
+    default:
+	return String();
+    }
+}
+
+int
+SharedBufferPool::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    SharedBufferPool *sbp = static_cast<SharedBufferPool *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_capacity: {
+	uint32_t capacity;
+	if (!IntArg().parse(str, capacity))
+	    return errh->error("syntax error");
+	sbp->_capacity = capacity;
+	return 0;
+    }
+    case h_alpha: {
+	uint32_t alpha;
+	if (!FixedPointArg(alpha_shift).parse(str, alpha)
+	    || alpha > (256U << alpha_shift))
+	    return errh->error("syntax error");
+	sbp->_alpha = alpha;
+	return 0;
+    }
+    case h_reset_counts:
+	sbp->_drops = 0;
+	sbp->_highwater_length = sbp->_length.value();
+	return 0;
+    default:
+	return -1;
+    }
+}
+
+void
+SharedBufferPool::add_handlers()
+{
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_write_handler("capacity", write_handler, h_capacity);
+    add_read_handler("alpha", read_handler, h_alpha);
+    add_write_handler("alpha", write_handler, h_alpha);
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("free", read_handler, h_free);
+    add_read_handler("highwater_length", read_handler, h_highwater);
+    add_read_handler("drops", read_handler, h_drops);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(SharedBufferPool)
+ELEMENT_MT_SAFE(SharedBufferPool)
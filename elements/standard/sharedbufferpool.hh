@@ -0,0 +1,149 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SHAREDBUFFERPOOL_HH
+#define CLICK_SHAREDBUFFERPOOL_HH
+#include <click/element.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SharedBufferPool(CAPACITY, [ALPHA])
+
+=s storage
+
+packet buffer budget shared by SharedQueue elements
+
+=d
+
+Holds the shared packet budget of a group of SharedQueue elements, the way
+a switch ASIC's buffer manager divides one packet memory among many output
+queues. SharedBufferPool has no ports and stores no packets; each SharedQueue
+keeps its own packets, and asks the pool for a slot whenever it would grow
+beyond its private RESERVE.
+
+A queue holding I<n> packets from the pool gets another slot only while
+I<n> is less than ALPHA times the pool's free space, and the pool has a free
+slot at all. This dynamic threshold lets a single busy queue take a large
+share of the pool, and shrinks every queue's share as the pool fills, so no
+queue can starve the others. With ALPHA 1, a lone busy queue can take half
+the pool; with ALPHA 2, two thirds.
+
+Keyword arguments are:
+
+=over 8
+
+=item CAPACITY
+
+Integer. Number of packet slots in the pool. Required.
+
+=item ALPHA
+
+Fixed-point number between 0 and 256. Default dynamic threshold factor for
+queues that do not set their own. Default is 1.
+
+=back
+
+Any number of threads may use the pool at once.
+
+=h capacity read/write
+
+Returns or sets CAPACITY. Shrinking the pool below its current occupancy
+drops no packets; the queues just cannot take new slots until enough drain.
+
+=h alpha read/write
+
+Returns or sets the default ALPHA.
+
+=h length read-only
+
+Returns the number of slots in use.
+
+=h free read-only
+
+Returns the number of free slots.
+
+=h highwater_length read-only
+
+Returns the largest number of slots ever in use at once.
+
+=h drops read-only
+
+Returns the number of packets dropped because a queue's dynamic threshold
+had been reached or the pool was full.
+
+=h reset_counts write-only
+
+Resets the C<drops> and C<highwater_length> counters.
+
+=a SharedQueue, Queue */
+
+class SharedBufferPool : public Element { public:
+
+    SharedBufferPool() CLICK_COLD;
+
+    const char *class_name() const		{ return "SharedBufferPool"; }
+    const char *port_count() const		{ return PORTS_0_0; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    enum { alpha_shift = 8 };
+
+    uint32_t capacity() const			{ return _capacity; }
+    uint32_t alpha() const			{ return _alpha; }
+    uint32_t length() const			{ return _length.value(); }
+
+    inline bool take(uint32_t used, uint32_t alpha);
+    inline void give(uint32_t n);
+    void count_drop()				{ _drops++; }
+
+  private:
+
+    volatile uint32_t _capacity;
+    volatile uint32_t _alpha;	// fixed point, alpha_shift fraction bits
+    atomic_uint32_t _length;
+    uint32_t _highwater_length;
+    atomic_uint32_t _drops;
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+/** @brief Take one slot for a queue that already holds @a used slots.
+ * @param used slots the queue holds from the pool
+ * @param alpha the queue's threshold factor, with alpha_shift fraction bits
+ * @return true if the queue may store one more packet
+ *
+ * Fails if the pool is full or if @a used has reached @a alpha times the
+ * pool's free space. Does not count a drop; callers that drop the packet
+ * call count_drop(). */
+inline bool
+SharedBufferPool::take(uint32_t used, uint32_t alpha)
+{
+    while (1) {
+	uint32_t len = _length.value(), cap = _capacity;
+	if (len >= cap)
+	    return false;
+	if (((uint64_t) used << alpha_shift) >= (uint64_t) alpha * (cap - len))
+	    return false;
+	if (_length.compare_swap(len, len + 1) == len) {
+	    // Racy, but only ever an underestimate.
+	    if (len + 1 > _highwater_length)
+		_highwater_length = len + 1;
+	    return true;
+	}
+    }
+}
+
+/** @brief Return @a n slots to the pool. */
+inline void
+SharedBufferPool::give(uint32_t n)
+{
+    _length -= n;
+}
+
+CLICK_ENDDECLS
+#endif
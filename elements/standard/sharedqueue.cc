@@ -0,0 +1,341 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * sharedqueue.{cc,hh} -- queue backed by a SharedBufferPool
+ */
+
+#include <click/config.h>
+#include "sharedqueue.hh"
+#include "sharedbufferpool.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/packet_anno.hh>
+CLICK_DECLS
+
+SharedQueue::SharedQueue()
+    : _head(0), _tail(0), _len(0), _highwater_len(0), _drops(0), _pool(0),
+      _reserve(0), _alpha(0), _capacity(0), _thresh(40),
+      _marking_enabled(false), _sleepiness(0)
+{
+}
+
+void *
+SharedQueue::cast(const char *n)
+{
+    if (strcmp(n, "SharedQueue") == 0)
+	return this;
+    else if (strcmp(n, Notifier::EMPTY_NOTIFIER) == 0)
+	return static_cast<Notifier *>(&_empty_note);
+    else
+	return Element::cast(n);
+}
+
+int
+SharedQueue::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    uint32_t reserve = 0, alpha = 0, capacity = 0, thresh = 40;
+    if (Args(conf, this, errh)
+	.read_mp("POOL", ElementCastArg("SharedBufferPool"), _pool)
+	.read_p("RESERVE", reserve)
+	.read("ALPHA", FixedPointArg(SharedBufferPool::alpha_shift), alpha)
+	.read("CAPACITY", capacity)
+	.read("THRESHOLD", thresh)
+	.complete() < 0)
+	return -1;
+    if (thresh == 0)
+	return errh->error("THRESHOLD must be positive");
+    _reserve = reserve;
+    _alpha = alpha;
+    _capacity = capacity;
+    _thresh = thresh;
+    _empty_note.initialize(Notifier::EMPTY_NOTIFIER, router());
+    return 0;
+}
+
+void
+SharedQueue::cleanup(CleanupStage)
+{
+    if (_len > _reserve)
+	_pool->give(_len - _reserve);
+    while (Packet *p = _head) {
+	_head = p->next();
+	p->kill();
+    }
+    _tail = 0;
+    _len = 0;
+}
+
+inline bool
+SharedQueue::admit()
+{
+    // Called with _lock held.
+    uint32_t len = _len;
+    if (_capacity && len >= _capacity)
+	return false;
+    if (len < _reserve)
+	return true;
+    if (_pool->take(len - _reserve, _alpha ? _alpha : _pool->alpha()))
+	return true;
+    _pool->count_drop();
+    return false;
+}
+
+inline void
+SharedQueue::release(uint32_t n, uint32_t old_len)
+{
+    // Packets beyond RESERVE hold pool slots.
+    uint32_t before = (old_len > _reserve ? old_len - _reserve : 0);
+    uint32_t after = (old_len - n > _reserve ? old_len - n - _reserve : 0);
+    if (before != after)
+	_pool->give(before - after);
+}
+
+inline void
+SharedQueue::mark(Packet *p, uint32_t len)
+{
+    // As FullNoteLockQueue: mark packets that take the queue past THRESHOLD.
+    if (_marking_enabled)
+	SET_THRESH_EXCEEDED_ANNO(p, len + 1 > _thresh);
+}
+
+void
+SharedQueue::push(int, Packet *p)
+{
+    _lock.acquire();
+    mark(p, _len);
+    if (admit()) {
+	p->set_next(0);
+	if (_tail)
+	    _tail->set_next(p);
+	else
+	    _head = p;
+	_tail = p;
+	uint32_t len = _len + 1;
+	_len = len;
+	if (len > _highwater_len)
+	    _highwater_len = len;
+	_lock.release();
+	_empty_note.wake();
+    } else {
+	_drops++;
+	_lock.release();
+	checked_output_push(1, p);
+    }
+}
+
+void
+SharedQueue::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch dropped;
+    _lock.acquire();
+    uint32_t len = _len, old_len = len;
+    while (Packet *p = batch.pop_front()) {
+	mark(p, len);
+	if (admit()) {
+	    if (_tail)
+		_tail->set_next(p);
+	    else
+		_head = p;
+	    _tail = p;
+	    _len = ++len;
+	} else
+	    dropped.append(p);
+    }
+    if (len > _highwater_len)
+	_highwater_len = len;
+    _drops += dropped.count();
+    _lock.release();
+    if (len != old_len)
+	_empty_note.wake();
+    while (Packet *p = dropped.pop_front())
+	checked_output_push(1, p);
+}
+
+Packet *
+SharedQueue::pull_empty()
+{
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+	// Work around race condition between push() and pull(), as in
+	// NotifierQueue.
+	if (_len)
+	    _empty_note.wake();
+    } else
+	++_sleepiness;
+    return 0;
+}
+
+Packet *
+SharedQueue::pull(int)
+{
+    if (!_len)
+	return pull_empty();
+    _lock.acquire();
+    Packet *p = _head;
+    if (p) {
+	uint32_t len = _len;
+	if (!(_head = p->next()))
+	    _tail = 0;
+	_len = len - 1;
+	release(1, len);
+	_lock.release();
+	p->set_next(0);
+	_sleepiness = 0;
+	return p;
+    }
+    _lock.release();
+    return pull_empty();
+}
+
+int
+SharedQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    if (!_len) {
+	pull_empty();
+	return 0;
+    }
+    _lock.acquire();
+    uint32_t len = _len;
+    unsigned n = 0;
+    while (n < max && _head) {
+	Packet *p = _head;
+	_head = p->next();
+	batch.append(p);
+	++n;
+    }
+    if (!_head)
+	_tail = 0;
+    _len = len - n;
+    release(n, len);
+    _lock.release();
+    if (n)
+	_sleepiness = 0;
+    else
+	pull_empty();
+    return n;
+}
+
+enum { h_length, h_highwater, h_drops, h_threshold, h_alpha, h_capacity,
+       h_marking_enabled, h_marking_threshold, h_reset_counts, h_reset };
+
+String
+SharedQueue::read_handler(Element *e, void *thunk)
+{
+    SharedQueue *q = static_cast<SharedQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_length:
+	return String(q->_len);
+    case h_highwater:
+	return String(q->_highwater_len);
+    case h_drops:
+	return String(q->_drops);
+    case h_threshold: {
+	// Growing from "used" pool slots, the queue stops at the first U with
+	// U >= alpha * (free - (U - used)): the ceiling of
+	// alpha * (free + used) / (1 + alpha), and at most used + free.
+	uint32_t len = q->_len;
+	uint32_t used = (len > q->_reserve ? len - q->_reserve : 0);
+	uint32_t plen = q->_pool->length(), pcap = q->_pool->capacity();
+	uint64_t alpha = q->_alpha ? q->_alpha : q->_pool->alpha();
+	uint64_t one = 1U << SharedBufferPool::alpha_shift;
+	uint64_t limit = used;
+	if (plen < pcap) {
+	    uint64_t room = pcap - plen + used;
+	    uint64_t u = (alpha * room + one + alpha - 1) / (one + alpha);
+	    if (u > room)
+		u = room;
+	    if (u > limit)
+		limit = u;
+	}
+	limit += q->_reserve;
+	if (q->_capacity && limit > q->_capacity)
+	    limit = q->_capacity;
+	return String((uint32_t) limit);
+    }
+    case h_alpha:
+	return cp_unparse_real2(q->_alpha ? q->_alpha : q->_pool->alpha(),
+				SharedBufferPool::alpha_shift);
+    case h_capacity:
+	return String(q->_capacity);
+    case h_marking_enabled:
+	return String(q->_marking_enabled);
+    case h_marking_threshold:
+	return String(q->_thresh);
+    default:
+	return String();
+    }
+}
+
+int
+SharedQueue::write_handler(const String &str, Element *e, void *thunk, ErrorHandler *errh)
+{
+    SharedQueue *q = static_cast<SharedQueue *>(e);
+    switch (reinterpret_cast<intptr_t>(thunk)) {
+    case h_alpha: {
+	uint32_t alpha;
+	if (!FixedPointArg(SharedBufferPool::alpha_shift).parse(str, alpha))
+	    return errh->error("syntax error");
+	q->_alpha = alpha;
+	return 0;
+    }
+    case h_capacity: {
+	uint32_t capacity;
+	if (!IntArg().parse(str, capacity))
+	    return errh->error("syntax error");
+	q->_capacity = capacity;
+	return 0;
+    }
+    case h_marking_enabled: {
+	bool enabled;
+	if (!BoolArg().parse(str, enabled))
+	    return errh->error("syntax error");
+	q->_marking_enabled = enabled;
+	return 0;
+    }
+    case h_marking_threshold: {
+	uint32_t thresh;
+	if (!IntArg().parse(str, thresh) || thresh == 0)
+	    return errh->error("syntax error");
+	q->_thresh = thresh;
+	return 0;
+    }
+    case h_reset_counts:
+	q->_drops = 0;
+	q->_highwater_len = q->_len;
+	return 0;
+    case h_reset: {
+	PacketBatch batch;
+	while (q->pull_batch(0, 256, batch))
+	    while (Packet *p = batch.pop_front())
+		q->checked_output_push(1, p);
+	return 0;
+    }
+    default:
+	return -1;
+    }
+}
+
+void
+SharedQueue::add_handlers()
+{
+    add_read_handler("length", read_handler, h_length);
+    add_read_handler("highwater_length", read_handler, h_highwater);
+    add_read_handler("drops", read_handler, h_drops);
+    add_read_handler("threshold", read_handler, h_threshold);
+    add_read_handler("alpha", read_handler, h_alpha);
+    add_write_handler("alpha", write_handler, h_alpha);
+    add_read_handler("capacity", read_handler, h_capacity);
+    add_write_handler("capacity", write_handler, h_capacity);
+    add_read_handler("resize_capacity", read_handler, h_capacity);
+    add_write_handler("resize_capacity", write_handler, h_capacity);
+    add_read_handler("marking_enabled", read_handler, h_marking_enabled);
+    add_write_handler("marking_enabled", write_handler, h_marking_enabled);
+    add_read_handler("marking_threshold", read_handler, h_marking_threshold);
+    add_write_handler("marking_threshold", write_handler, h_marking_threshold);
+    add_write_handler("reset_counts", write_handler, h_reset_counts, Handler::BUTTON);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(SharedBufferPool)
+EXPORT_ELEMENT(SharedQueue)
+ELEMENT_MT_SAFE(SharedQueue)
@@ -0,0 +1,162 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SHAREDQUEUE_HH
+#define CLICK_SHAREDQUEUE_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/sync.hh>
+CLICK_DECLS
+class SharedBufferPool;
+
+/*
+=c
+
+SharedQueue(POOL, [RESERVE, I<keywords> ALPHA, CAPACITY, THRESHOLD])
+
+=s storage
+
+stores packets in a FIFO queue backed by a shared buffer pool
+
+=d
+
+Stores incoming packets in a first-in-first-out queue that draws its space
+from the SharedBufferPool element POOL, rather than from a private ring.
+Many SharedQueues can share one pool, so a large set of queues, such as an
+N-by-N matrix of virtual output queues, needs only as much memory as the
+pool, while any one queue can still absorb a burst much larger than its
+fair share.
+
+A SharedQueue may always hold RESERVE packets of its own, default 0. Beyond
+that, each packet takes a slot from POOL, which it grants only while the
+queue's pool slots number less than ALPHA times the pool's free space (see
+SharedBufferPool). Packets that find no space are dropped, or emitted on
+output 1 if it exists.
+
+Keyword arguments are:
+
+=over 8
+
+=item ALPHA
+
+Fixed-point number. The queue's dynamic threshold factor. Defaults to the
+pool's ALPHA.
+
+=item CAPACITY
+
+Integer. A hard limit on the queue's length, whatever the pool allows. 0
+means no limit. Default is 0.
+
+=item THRESHOLD
+
+Positive integer. While marking is enabled, a packet that would take the
+queue's length past THRESHOLD has its THRESH_EXCEEDED_ANNO annotation set to
+1, as in FullNoteLockQueue; other packets have it set to 0. Default is 40.
+
+=back
+
+SharedQueue provides an empty notifier, as NotifierQueue does. Any number
+of threads may push to and pull from a SharedQueue at once; a short spinlock
+serializes access to its packet list.
+
+=h length read-only
+
+Returns the current number of packets in the queue.
+
+=h highwater_length read-only
+
+Returns the maximum number of packets that have ever been in the queue at
+once.
+
+=h drops read-only
+
+Returns the number of packets dropped by the queue so far.
+
+=h threshold read-only
+
+Returns the queue's current length limit: RESERVE plus the pool slots it
+could now hold, but at most CAPACITY.
+
+=h alpha read/write
+
+Returns or sets ALPHA.
+
+=h capacity read/write
+
+Returns or sets CAPACITY. Lowering CAPACITY below the current length drops
+no packets.
+
+=h resize_capacity read/write
+
+A synonym for C<capacity>. With C<marking_threshold>, it lets RunSchedule
+resize SharedQueue VOQs.
+
+=h marking_enabled read/write
+
+"true" or "false". Returns or sets whether threshold-based marking is
+enabled. Marking starts disabled.
+
+=h marking_threshold read/write
+
+Returns or sets THRESHOLD.
+
+=h reset_counts write-only
+
+Resets the C<drops> and C<highwater_length> counters.
+
+=h reset write-only
+
+Drops all packets in the queue.
+
+=a SharedBufferPool, Queue, NotifierQueue, FullNoteLockQueue */
+
+class SharedQueue : public Element { public:
+
+    SharedQueue() CLICK_COLD;
+
+    const char *class_name() const		{ return "SharedQueue"; }
+    const char *port_count() const		{ return PORTS_1_1X2; }
+    const char *processing() const		{ return "h/lh"; }
+    void *cast(const char *);
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    uint32_t length() const			{ return _len; }
+
+    void push(int port, Packet *p);
+    Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    int pull_batch(int port, unsigned max, PacketBatch &batch);
+
+  private:
+
+    enum { SLEEPINESS_TRIGGER = 9 };
+
+    SimpleSpinlock _lock;
+    Packet *_head;
+    Packet *_tail;
+    volatile uint32_t _len;
+    uint32_t _highwater_len;
+    uint32_t _drops;
+
+    SharedBufferPool *_pool;
+    uint32_t _reserve;
+    uint32_t _alpha;		// 0 means the pool's
+    volatile uint32_t _capacity;	// 0 means unlimited
+    volatile uint32_t _thresh;
+    volatile bool _marking_enabled;
+    int _sleepiness;
+    ActiveNotifier _empty_note;
+
+    inline void mark(Packet *p, uint32_t len);
+    inline bool admit();
+    inline void release(uint32_t n, uint32_t old_len);
+    Packet *pull_empty();
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -169,6 +169,32 @@ SimpleQueue::pull(int)
     return deq();
 }
 
+void
+SimpleQueue::push_batch(int, PacketBatch &batch)
+{
+    // If you change this code, also change NotifierQueue::push_batch()
+    // and FullNoteQueue::push_batch().
+    Storage::index_type h = head();
+    if (enq_burst(_q, batch)) {
+	int s = size(h, tail());
+	if (s > _highwater_length)
+	    _highwater_length = s;
+    }
+    if (!batch.empty()) {
+	if (_drops == 0 && _capacity > 0)
+	    click_chatter("%p{element}: overflow", this);
+	_drops += batch.count();
+	while (Packet *p = batch.pop_front())
+	    checked_output_push(1, p);
+    }
+}
+
+int
+SimpleQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    return deq_burst(_q, max, batch);
+}
+
 
 String
 SimpleQueue::read_handler(Element *e, void *thunk)
@@ -25,7 +25,8 @@
 #include <sched.h>
 CLICK_DECLS
 
-Solstice::Solstice() : _task(this)
+Solstice::Solstice() : _task(this), _reconfig_penalty(0), _computed(0),
+                       _installed(0), _unchanged(0), _suppressed(0)
 {
 }
 
@@ -40,8 +41,11 @@ Solstice::configure(Vector<String> &conf, ErrorHandler *errh)
         .read_mp("PACKET_BW", BandwidthArg(), packet_bw)
         .read_mp("RECONFIG_DELAY", reconfig_delay)
         .read_mp("TDF", tdf)
+        .read("RECONFIG_PENALTY", _reconfig_penalty)
         .complete() < 0)
         return -1;
+    if (_reconfig_penalty < 0)
+        return errh->error("RECONFIG_PENALTY must be >= 0");
     _num_hosts = num_hosts;
     
     if (_num_hosts == 0)
@@ -80,10 +84,10 @@ Solstice::initialize(ErrorHandler *errh)
     sched_setscheduler(getpid(), SCHED_RR, NULL);
 #endif
 
-    _tm = new HandlerCall("traffic_matrix.getTraffic");
+    _tm = new HandlerCall("traffic_matrix.getTrafficSnapshot");
     _tm->initialize(HandlerCall::f_read, this, errh);
 
-    _runner = new HandlerCall("runner.setSchedule");
+    _runner = new HandlerCall("runner.setStampedSchedule");
     _runner->initialize(HandlerCall::f_write, this, errh);
 
     return 0;
@@ -105,14 +109,23 @@ Solstice::run_task(Task *)
             printf("****soltice starting...\n");
         }
 
-        // get traffic matrix from estimator and unparse.
+        // get traffic matrix snapshot from estimator and unparse. The
+        // snapshot is prefixed by its generation and sample time.
         String tm = _tm->call_read();
         // if(_print == 0) {
         //     printf("tm = %s\n", tm.c_str());
         // }
-        int start = 0;
+        int gen_end = tm.find_left(' ');
+        int sample_end = tm.find_left(' ', gen_end + 1);
+        if (gen_end < 0 || sample_end < 0) {
+            printf("SOLSTICE BAD TRAFFIC MATRIX\n");
+            return true;
+        }
+        uint64_t generation = strtoull(tm.c_str(), 0, 10);
+        long long sample_nano = atoll(tm.substring(gen_end + 1).c_str());
+        int start = sample_end + 1;
         int sd = 0;
-        for (int ind = 0; ind < tm.length(); ind++) {
+        for (int ind = start; ind < tm.length(); ind++) {
             if (tm[ind] == ' ') {
                 _traffic_matrix[sd]  = atoll(tm.substring(start, ind-start).c_str());
                 start = ind+1;
@@ -193,13 +206,22 @@ Solstice::run_task(Task *)
         sols_schedule(&_s);
         sols_check(&_s);
 
+        struct timespec ts_sched;
+        clock_gettime(CLOCK_MONOTONIC, &ts_sched);
+        long long schedule_nano = 1e9 * ts_sched.tv_sec + ts_sched.tv_nsec;
+
         // each configuration string should be at most _num_hosts*3 length
         // each duration string should be at most 4 length
         // there are _s.nday days and nights
         // add an additional factor of 2 for number of days and delimiters
+        // the schedule is prefixed by the generation, sample time and
+        // schedule time of the traffic matrix it was computed from
         char *schedule = (char *)malloc(sizeof(char) * _s.nday *
-                                        2 * (4 + _num_hosts*3) * 2);
-        sprintf(schedule, "%d ", _s.nday * 2);
+                                        2 * (4 + _num_hosts*3) * 2 + 64);
+        int stamp_len = sprintf(schedule, "%llu %lld %lld ",
+                                (unsigned long long) generation,
+                                sample_nano, schedule_nano);
+        sprintf(&(schedule[stamp_len]), "%d ", _s.nday * 2);
         
         for (int i = 0; i < _s.nday; i++) {
             if (i > 0)
@@ -251,21 +273,80 @@ Solstice::run_task(Task *)
                 }
                 printf("\n");
             }
-            printf("schedule == %s\n", schedule);
+            printf("schedule == %s\n", schedule + stamp_len);
         }
 
         if(!_print2) {
             printf("****Solstice still running...\n");
         }
 
-        // tell schedule runner
-        _runner->call_write(schedule);
+        // remember the candidate's days so it can be scored
+        _candidate_lens.resize(_s.nday);
+        _candidate_ports.resize(_s.nday * _num_hosts);
+        for (int i = 0; i < _s.nday; i++) {
+            _candidate_lens[i] = _s.sched[i].len - _s.night_len;
+            for (int dst = 0; dst < _num_hosts; dst++)
+                _candidate_ports[i * _num_hosts + dst] =
+                    _s.sched[i].input_ports[dst];
+        }
+
+        // tell schedule runner, unless the current schedule is good enough
+        if (should_install(schedule + stamp_len))
+            _runner->call_write(schedule);
 
         free(schedule);
     }
     return true;
 }
 
+// Bytes of the current demand that a schedule's circuit days can serve in one
+// week.
+uint64_t
+Solstice::circuit_service(const Vector<int> &ports,
+                          const Vector<uint64_t> &lens) const
+{
+    Vector<uint64_t> capacity(_num_hosts * _num_hosts, 0);
+    for (int i = 0; i < lens.size(); i++)
+        for (int dst = 0; dst < _num_hosts; dst++) {
+            int src = ports[i * _num_hosts + dst];
+            if (src >= 0)
+                capacity[src * _num_hosts + dst] += lens[i] * _s.link_bw;
+        }
+
+    uint64_t served = 0;
+    for (int i = 0; i < _num_hosts * _num_hosts; i++) {
+        uint64_t demand = _traffic_matrix[i] > 0 ? _traffic_matrix[i] : 0;
+        served += demand < capacity[i] ? demand : capacity[i];
+    }
+    return served;
+}
+
+bool
+Solstice::should_install(const String &schedule)
+{
+    _computed++;
+    if (schedule == _installed_schedule) {
+        _unchanged++;
+        return false;
+    }
+
+    if (_reconfig_penalty > 0 && _installed_schedule) {
+        double gain = double(circuit_service(_candidate_ports, _candidate_lens))
+            - double(circuit_service(_installed_ports, _installed_lens));
+        double cost = _reconfig_penalty * _s.night_len * _s.link_bw * _num_hosts;
+        if (gain <= cost) {
+            _suppressed++;
+            return false;
+        }
+    }
+
+    _installed++;
+    _installed_schedule = schedule;
+    _installed_lens.swap(_candidate_lens);
+    _installed_ports.swap(_candidate_ports);
+    return true;
+}
+
 int
 Solstice::set_enabled(const String &str, Element *e, void *, ErrorHandler *)
 {
@@ -282,11 +363,60 @@ Solstice::set_thresh(const String &str, Element *e, void *, ErrorHandler *)
     return 0;
 }
 
+int
+Solstice::set_reconfig_penalty(const String &str, Element *e, void *,
+                               ErrorHandler *errh)
+{
+    Solstice *s = static_cast<Solstice *>(e);
+    double penalty;
+    if (!DoubleArg().parse(str, penalty) || penalty < 0)
+        return errh->error("reconfig_penalty must be a nonnegative number");
+    s->_reconfig_penalty = penalty;
+    return 0;
+}
+
+enum { h_computed, h_installed, h_unchanged, h_suppressed, h_penalty };
+
+String
+Solstice::read_handler(Element *e, void *thunk)
+{
+    Solstice *s = static_cast<Solstice *>(e);
+    switch ((intptr_t) thunk) {
+    case h_computed:
+        return String(s->_computed);
+    case h_installed:
+        return String(s->_installed);
+    case h_unchanged:
+        return String(s->_unchanged);
+    case h_suppressed:
+        return String(s->_suppressed);
+    case h_penalty:
+        return String(s->_reconfig_penalty);
+    default:
+        return String();
+    }
+}
+
+int
+Solstice::reset_counts(const String &, Element *e, void *, ErrorHandler *)
+{
+    Solstice *s = static_cast<Solstice *>(e);
+    s->_computed = s->_installed = s->_unchanged = s->_suppressed = 0;
+    return 0;
+}
+
 void
 Solstice::add_handlers()
 {
     add_write_handler("setEnabled", set_enabled, 0);
     add_write_handler("setThresh", set_thresh, 0);
+    add_read_handler("reconfig_penalty", read_handler, h_penalty);
+    add_write_handler("reconfig_penalty", set_reconfig_penalty, 0);
+    add_read_handler("computed", read_handler, h_computed);
+    add_read_handler("installed", read_handler, h_installed);
+    add_read_handler("unchanged", read_handler, h_unchanged);
+    add_read_handler("suppressed", read_handler, h_suppressed);
+    add_write_handler("reset_counts", reset_counts, 0);
 }
 
 
@@ -9,7 +9,8 @@ CLICK_DECLS
 /*
 =c
 
-Solstice()
+Solstice(NUM_HOSTS, CIRCUIT_BW, PACKET_BW, RECONFIG_DELAY, TDF,
+I<keywords> RECONFIG_PENALTY)
 
 =s control
 
@@ -17,9 +18,53 @@ Computes OCS Solstice Schedules
 
 =d
 
-TODO
+Reads the traffic matrix from the "traffic_matrix" EstimateTraffic element,
+computes a Solstice schedule for it, and hands the schedule to the "runner"
+RunSchedule element. The matrix's generation and sample time travel with the
+schedule, together with the time the schedule was computed, so that
+RunSchedule can measure the latency of the whole control loop.
 
-=h
+Installing a different schedule makes the runner roll over, which costs the
+circuit switch at least one extra night. When RECONFIG_PENALTY is positive,
+each candidate schedule is scored against the installed one by the bytes of
+current demand their circuit days can serve in one week. The candidate is
+only installed if it serves more than RECONFIG_PENALTY nights' worth of
+circuit bandwidth (across all racks) beyond the installed schedule; otherwise
+the installed schedule keeps running. A RECONFIG_PENALTY of 0, the default,
+installs every changed schedule.
+
+=h setEnabled write-only
+
+Enables or disables scheduling.
+
+=h setThresh write-only
+
+Sets the demand threshold, in bytes, below which small demands are ignored.
+
+=h reconfig_penalty read/write
+
+Returns or sets RECONFIG_PENALTY.
+
+=h computed read-only
+
+Returns the number of schedules computed.
+
+=h installed read-only
+
+Returns the number of schedules handed to the runner.
+
+=h unchanged read-only
+
+Returns the number of computed schedules identical to the installed one.
+
+=h suppressed read-only
+
+Returns the number of changed schedules that were not installed because
+their gain did not cover the reconfiguration cost.
+
+=h reset_counts write-only
+
+Resets the computed, installed, unchanged and suppressed counters.
 
 */
 
@@ -28,6 +73,7 @@ class Solstice : public Element {
     Solstice() CLICK_COLD;
 
     const char *class_name() const	{ return "Solstice"; }
+    const char *flags() const		{ return "Y0"; }
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
     int initialize(ErrorHandler *) CLICK_COLD;
     void add_handlers() CLICK_COLD;
@@ -40,6 +86,13 @@ class Solstice : public Element {
   private:
     static int set_enabled(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
     static int set_thresh(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
+    static int set_reconfig_penalty(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int reset_counts(const String&, Element*, void*, ErrorHandler*) CLICK_COLD;
+
+    uint64_t circuit_service(const Vector<int> &ports,
+                             const Vector<uint64_t> &lens) const;
+    bool should_install(const String &schedule);
 
     sols_t _s;
     long long *_traffic_matrix;
@@ -48,6 +101,19 @@ class Solstice : public Element {
     int _print;
     int _print2;
     unsigned int _thresh;
+    double _reconfig_penalty;
+
+    // installed schedule: per-day length and input port for each output port
+    String _installed_schedule;
+    Vector<uint64_t> _installed_lens;
+    Vector<int> _installed_ports;
+    Vector<uint64_t> _candidate_lens;
+    Vector<int> _candidate_ports;
+
+    uint64_t _computed;
+    uint64_t _installed;
+    uint64_t _unchanged;
+    uint64_t _suppressed;
 
     HandlerCall *_tm;
     HandlerCall *_runner;
@@ -22,13 +22,31 @@
 #include <click/args.hh>
 #include <click/straccum.hh>
 #include <click/error.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 StrideSched::StrideSched()
-    : _all(0), _list(0)
+    : _all(0), _order(0)
 {
 }
 
+void
+StrideSched::insert(Client *c)
+{
+    c->_order = ++_order;
+    _heap.push_back(c);
+    push_heap(_heap.begin(), _heap.end(), heap_less(), heap_place());
+}
+
+void
+StrideSched::remove(Client *c)
+{
+    remove_heap(_heap.begin(), _heap.end(), _heap.begin() + c->_place,
+		heap_less(), heap_place());
+    _heap.pop_back();
+    c->_place = -1;
+}
+
 int
 StrideSched::configure(Vector<String> &conf, ErrorHandler *errh)
 {
@@ -58,20 +76,21 @@ StrideSched::configure(Vector<String> &conf, ErrorHandler *errh)
     }
 
     // insert into reverse order so they're run in forward order on ties
-    _list = 0;
+    _heap.clear();
+    for (int i = 0; i < nclients(); i++)
+	_all[i]._place = -1;
     for (int i = nclients() - 1; i >= 0; i--)
 	if (_all[i]._tickets)
-	    _all[i].insert(&_list);
+	    insert(&_all[i]);
 
     return errh->nerrors() ? -1 : 0;
 }
 
 int
-StrideSched::initialize(ErrorHandler *)
+StrideSched::initialize(ErrorHandler *errh)
 {
-    if (input_is_pull(0))
-	for (int i = 0; i < nclients(); ++i)
-	    _all[i]._signal = Notifier::upstream_empty_signal(this, i);
+    if (input_is_pull(0) && _ready.initialize(this) < 0)
+	return errh->error("out of memory!");
     return 0;
 }
 
@@ -81,28 +100,46 @@ StrideSched::cleanup(CleanupStage)
     delete[] _all;
 }
 
+void
+StrideSched::wake_clients()
+{
+    _ready.clear_woken();
+    for (int w = 0; w < _ready.nwords(); w++)
+	for (uint32_t bits = _ready.take_woken(w); bits; bits &= bits - 1) {
+	    Client *c = &_all[w * ReadyInputs::word_bits + ffs_lsb(bits) - 1];
+	    if (c->_place < 0 && c->_tickets > 0) {
+		// rejoin at the head's pass: sleeping earns no credit
+		if (_heap.size() && PASS_GT(_heap[0]->_pass, c->_pass))
+		    c->_pass = _heap[0]->_pass;
+		insert(c);
+	    }
+	}
+}
+
 Packet *
 StrideSched::pull(int)
 {
-    // go over list until we find a packet, striding as we go
-    Client *stridden = _list, *c;
+    if (_ready.any_woken())
+	wake_clients();
+
+    // go over heap until we find a packet, striding as we go; clients
+    // whose inputs have gone to sleep leave the heap
+    _stridden.clear();
     Packet *p = 0;
-    for (c = _list; c && !p; c = c->_next) {
-	if (c->_signal)
-	    p = input(c - _all).pull();
+    while (!p && _heap.size()) {
+	Client *c = _heap[0];
+	remove(c);
+	int i = c - _all;
+	if (_ready.test(i) && _ready.signal(i))
+	    p = input(i).pull();
 	c->stride();
+	if (p || !_ready.idle(i))
+	    _stridden.push_back(c);
     }
 
-    // remove stridden portion from list
-    if ((_list = c))
-	c->_pprev = &_list;
-
-    // reinsert stridden portion into list
-    while (stridden != c) {
-	Client *next = stridden->_next;
-	stridden->insert(&_list);
-	stridden = next;
-    }
+    // reinsert stridden clients
+    for (Client **cp = _stridden.begin(); cp != _stridden.end(); ++cp)
+	insert(*cp);
 
     return p;
 }
@@ -131,11 +168,12 @@ StrideSched::set_tickets(int port, int tickets, ErrorHandler *errh)
     int old_tickets = _all[port]._tickets;
     _all[port].set_tickets(tickets);
 
-    if (tickets == 0 && old_tickets != 0)
-	_all[port].remove();
-    else if (tickets != 0 && old_tickets == 0) {
-	_all[port]._pass = (_list ? _list->_pass + _all[port]._stride : 0);
-	_all[port].insert(&_list);
+    if (tickets == 0 && old_tickets != 0) {
+	if (_all[port]._place >= 0)
+	    remove(&_all[port]);
+    } else if (tickets != 0 && old_tickets == 0) {
+	_all[port]._pass = (_heap.size() ? _heap[0]->_pass + _all[port]._stride : 0);
+	insert(&_all[port]);
     }
     return 0;
 }
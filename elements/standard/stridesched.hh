@@ -3,7 +3,7 @@
 #define CLICK_STRIDESCHED_HH
 #include <click/element.hh>
 #include <click/task.hh>
-#include <click/notifier.hh>
+#include <click/standard/readyinputs.hh>
 CLICK_DECLS
 
 /*
@@ -24,7 +24,12 @@ CLICK_DECLS
  * consistently with the stride scheduler ordering.
  *
  * The inputs usually come from Queues or other pull schedulers.
- * StrideSched uses notification to avoid pulling from empty inputs.
+ * StrideSched uses notification to avoid pulling from empty inputs.  The
+ * stride scheduling queue is a heap that holds only inputs that might have
+ * packets: an input whose notifier goes to sleep leaves the heap, and
+ * rejoins it, at the pass of the current head, when the notifier wakes up.
+ * Each decision thus costs O(log I<N>) at worst, and idle inputs cost
+ * nothing.
  *
  * =h tickets0...ticketsI<N-1> read/write
  * Returns or sets the number of tickets for each input port.
@@ -56,15 +61,14 @@ class StrideSched : public Element { public:
   protected:
 
     struct Client {
-	Client **_pprev;
-	Client *_next;
+	int _place;		// position in _heap, or -1
 	unsigned _pass;
 	unsigned _stride;
+	unsigned _order;	// breaks pass ties: latest queued goes first
 	int _tickets;
-	NotifierSignal _signal;
 
 	Client()
-	    : _pprev(0), _next(0), _pass(0), _stride(0), _tickets(-1) {
+	    : _place(-1), _pass(0), _stride(0), _order(0), _tickets(-1) {
 	}
 
 	void set_tickets(int t) {
@@ -74,23 +78,29 @@ class StrideSched : public Element { public:
 	void stride() {
 	    _pass += _stride;
 	}
+    };
 
-	void insert(Client **list) {
-	    _pprev = list;
-	    while ((_next = *_pprev) && PASS_GT(_pass, _next->_pass))
-		_pprev = &_next->_next;
-	    *_pprev = this;
-	    if (_next)
-		_next->_pprev = &_next;
+    struct heap_less {
+	inline bool operator()(Client *a, Client *b) {
+	    return PASS_GT(b->_pass, a->_pass)
+		|| (a->_pass == b->_pass && (int) (a->_order - b->_order) > 0);
 	}
-	void remove() {
-	    if ((*_pprev = _next))
-		_next->_pprev = _pprev;
+    };
+    struct heap_place {
+	inline void operator()(Client **begin, Client **it) {
+	    (*it)->_place = it - begin;
 	}
     };
 
     Client *_all;
-    Client *_list;
+    Vector<Client *> _heap;	// clients with tickets that might have packets
+    Vector<Client *> _stridden;
+    unsigned _order;
+    ReadyInputs _ready;
+
+    void insert(Client *c);
+    void remove(Client *c);
+    void wake_clients();
 
     int nclients() const {
 	return input_is_pull(0) ? ninputs() : noutputs();
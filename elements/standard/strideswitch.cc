@@ -20,6 +20,7 @@
 #include "strideswitch.hh"
 #include <click/confparse.hh>
 #include <click/error.hh>
+#include <click/heap.hh>
 CLICK_DECLS
 
 StrideSwitch::StrideSwitch()
@@ -29,13 +30,13 @@ StrideSwitch::StrideSwitch()
 void
 StrideSwitch::push(int, Packet *p)
 {
-    if (_list) {
-	Client *stridden = _list;
-	if ((_list = stridden->_next))
-	    _list->_pprev = &_list;
-	stridden->stride();
-	stridden->insert(&_list);
-	output(stridden - _all).push(p);
+    if (_heap.size()) {
+	Client *c = _heap[0];
+	c->stride();
+	c->_order = ++_order;
+	change_heap(_heap.begin(), _heap.end(), _heap.begin(),
+		    heap_less(), heap_place());
+	output(c - _all).push(p);
     } else
 	p->kill();
 }
@@ -40,6 +40,24 @@ Strip::simple_action(Packet *p)
     return p;
 }
 
+void
+Strip::push_batch(int, PacketBatch &batch)
+{
+    for (Packet *p = batch.first(); p; p = p->next())
+	p->pull(_nbytes);
+    output(0).push_batch(batch);
+}
+
+int
+Strip::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    Packet *last = batch.last();
+    int n = input(0).pull_batch(max, batch);
+    for (Packet *p = last ? last->next() : batch.first(); p; p = p->next())
+	p->pull(_nbytes);
+    return n;
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Strip)
 ELEMENT_MT_SAFE(Strip)
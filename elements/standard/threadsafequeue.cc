@@ -18,11 +18,11 @@
 
 #include <click/config.h>
 #include "threadsafequeue.hh"
+#include <click/error.hh>
 CLICK_DECLS
 
 ThreadSafeQueue::ThreadSafeQueue()
 {
-    _xhead = _xtail = 0;
 }
 
 void *
@@ -30,75 +30,194 @@ ThreadSafeQueue::cast(const char *n)
 {
     if (strcmp(n, "ThreadSafeQueue") == 0)
 	return (ThreadSafeQueue *)this;
+    else if (strcmp(n, "SimpleQueue") == 0 || strcmp(n, "Queue") == 0
+	     || strcmp(n, "NotifierQueue") == 0
+	     || strcmp(n, "FullNoteQueue") == 0)
+	// our packets are not in SimpleQueue's array
+	return 0;
     else
 	return FullNoteQueue::cast(n);
 }
 
+int
+ThreadSafeQueue::initialize(ErrorHandler *errh)
+{
+    if (!_ring.reserve(_capacity))
+	return errh->error("out of memory");
+    _drops = 0;
+    _highwater_length = 0;
+    _byte_count = 0;
+    return 0;
+}
+
+void
+ThreadSafeQueue::cleanup(CleanupStage)
+{
+    Packet *p;
+    while (_ring.dequeue(p))
+	p->kill();
+    set_tail(0);
+}
+
+// Storage's head stays 0 and its tail tracks our length, so Storage::size()
+// works for elements like RED that look at any Storage.
+
+inline void
+ThreadSafeQueue::enqueued()
+{
+    int s = _ring.size();
+    set_tail(s);
+    if (s > _highwater_length)
+	_highwater_length = s;
+    _empty_note.wake();
+    if (s == capacity()) {
+	_full_note.sleep();
+	// Work around race condition between push() and pull(), as in
+	// FullNoteQueue::push_success().
+	if (_ring.size() < (uint32_t) capacity())
+	    _full_note.wake();
+    }
+}
+
+inline void
+ThreadSafeQueue::dequeued()
+{
+    set_tail(_ring.size());
+    _sleepiness = 0;
+    _full_note.wake();
+}
+
+inline Packet *
+ThreadSafeQueue::pull_empty()
+{
+    if (_sleepiness >= SLEEPINESS_TRIGGER) {
+	_empty_note.sleep();
+	// Work around race condition between push() and pull(), as in
+	// FullNoteQueue::pull_failure().
+	if (!_ring.empty())
+	    _empty_note.wake();
+    } else
+	++_sleepiness;
+    return 0;
+}
+
+int
+ThreadSafeQueue::fill_ring(Vector<Packet *> &packets, ErrorHandler *errh)
+{
+    unsigned n = _ring.enqueue_burst(packets.begin(), packets.size());
+    if (n < (unsigned) packets.size())
+	errh->warning("some packets lost (old length %d, new capacity %d)",
+		      packets.size(), capacity());
+    for (Packet **pp = packets.begin() + n; pp != packets.end(); ++pp)
+	(*pp)->kill();
+    set_tail(_ring.size());
+    _highwater_length = _ring.size();
+    return 0;
+}
+
 int
 ThreadSafeQueue::live_reconfigure(Vector<String> &conf, ErrorHandler *errh)
 {
-    int r = NotifierQueue::live_reconfigure(conf, errh);
-    if (r >= 0 && size() < capacity() && _q)
+    // NB: do not call NotifierQueue or FullNoteQueue; they touch _q
+    Storage::index_type old_capacity = _capacity;
+    if (SimpleQueue::configure(conf, errh) < 0)
+	return -1;
+    if (_capacity == old_capacity)
+	return 0;
+
+    Vector<Packet *> packets;
+    Packet *p;
+    while (_ring.dequeue(p))
+	packets.push_back(p);
+    int r = 0;
+    if (!_ring.reserve(_capacity)) {
+	_capacity = old_capacity;
+	_ring.reserve(_capacity);
+	r = errh->error("out of memory");
+    }
+    fill_ring(packets, ErrorHandler::silent_handler());
+    if (size() < capacity())
 	_full_note.wake();
-    _xhead = head();
-    _xtail = tail();
     return r;
 }
 
 void
 ThreadSafeQueue::take_state(Element *e, ErrorHandler *errh)
 {
-    SimpleQueue *q = (SimpleQueue *)e->cast("SimpleQueue");
-    if (!q)
-        return;
+    if (!_ring.empty()) {
+	errh->error("already have packets enqueued, can%,t take state");
+	return;
+    }
 
-    SimpleQueue::take_state(e, errh);
-    _xhead = head();
-    _xtail = tail();
+    Vector<Packet *> packets;
+    Packet *p;
+    if (ThreadSafeQueue *tq = (ThreadSafeQueue *)e->cast("ThreadSafeQueue")) {
+	while (tq->_ring.dequeue(p))
+	    packets.push_back(p);
+	tq->set_tail(0);
+    } else if (SimpleQueue *q = (SimpleQueue *)e->cast("SimpleQueue")) {
+	while ((p = q->deq()))
+	    packets.push_back(p);
+    } else
+	return;
+    fill_ring(packets, errh);
 }
 
 void
 ThreadSafeQueue::push(int, Packet *p)
 {
-    // Code taken from SimpleQueue::push().
-
-    // Reserve a slot by incrementing _xtail
-    Storage::index_type t, nt;
-    do {
-	t = tail();
-	nt = next_i(t);
-    } while (_xtail.compare_swap(t, nt) != t);
-    // Other pushers spin until _tail := nt (or _xtail := t)
-
-    Storage::index_type h = head();
-    if (nt != h)
-	push_success(h, t, nt, p);
-    else {
-	_xtail = t;
+    if (_ring.enqueue(p))
+	enqueued();
+    else
 	push_failure(p);
+}
+
+void
+ThreadSafeQueue::push_batch(int, PacketBatch &batch)
+{
+    Packet *ps[burst_max];
+    while (!batch.empty()) {
+	unsigned n = 0;
+	while (n < burst_max && !batch.empty())
+	    ps[n++] = batch.pop_front();
+	unsigned k = _ring.enqueue_burst(ps, n);
+	if (k)
+	    enqueued();
+	for (; k < n; ++k)
+	    push_failure(ps[k]);
     }
 }
 
 Packet *
 ThreadSafeQueue::pull(int)
 {
-    // Code taken from SimpleQueue::deq.
-
-    // Reserve a slot by incrementing _xhead
-    Storage::index_type h, nh;
-    do {
-	h = head();
-	nh = next_i(h);
-    } while (_xhead.compare_swap(h, nh) != h);
-    // Other pullers spin until _head := nh (or _xhead := h)
-
-    Storage::index_type t = tail();
-    if (t != h)
-	return pull_success(h, nh);
-    else {
-	_xhead = h;
-	return pull_failure();
+    Packet *p;
+    if (_ring.dequeue(p)) {
+	dequeued();
+	return p;
+    } else
+	return pull_empty();
+}
+
+int
+ThreadSafeQueue::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+    Packet *ps[burst_max];
+    unsigned n = 0;
+    while (n < max) {
+	unsigned want = max - n < burst_max ? max - n : burst_max;
+	unsigned k = _ring.dequeue_burst(ps, want);
+	for (unsigned i = 0; i < k; ++i)
+	    batch.append(ps[i]);
+	n += k;
+	if (k < want)
+	    break;
     }
+    if (n)
+	dequeued();
+    else
+	pull_empty();
+    return n;
 }
 
 CLICK_ENDDECLS
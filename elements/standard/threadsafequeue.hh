@@ -2,6 +2,7 @@
 #ifndef CLICK_THREADSAFEQUEUE_HH
 #define CLICK_THREADSAFEQUEUE_HH
 #include "fullnotequeue.hh"
+#include <click/mpmcring.hh>
 CLICK_DECLS
 
 /*
@@ -20,11 +21,20 @@ Stores incoming packets in a first-in-first-out queue.
 Drops incoming packets if the queue already holds CAPACITY packets.
 The default for CAPACITY is 1000.
 
-This variant of the default Queue is (should be) completely thread safe, in
-that it supports multiple concurrent pushers and pullers.  In all respects
-other than thread safety it behaves just like Queue, and like Queue it has
+This variant of the default Queue is completely thread safe, in that it
+supports multiple concurrent pushers and pullers.  In all respects other
+than thread safety it behaves just like Queue, and like Queue it has
 non-full and non-empty notifiers.
 
+ThreadSafeQueue keeps its packets in an MPMCRing (see
+E<lt>click/mpmcring.hhE<gt>).  A batch push or pull moves the whole batch, as
+far as it fits, with a single atomic operation, so upstream elements that
+push batches and downstream pullers like Unqueue with BURST greater than 1
+contend far less than per-packet transfers do.  Because the packets do not
+live in a Queue-style array, ThreadSafeQueue cannot be used where a
+SimpleQueue is required, such as with yank operations.  Its length, as seen
+by handlers and by elements like RED, is an instantaneous estimate.
+
 =h length read-only
 
 Returns the current number of packets in the queue.
@@ -58,16 +68,26 @@ class ThreadSafeQueue : public FullNoteQueue { public:
     const char *class_name() const		{ return "ThreadSafeQueue"; }
     void *cast(const char *);
 
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
     int live_reconfigure(Vector<String> &conf, ErrorHandler *errh);
     void take_state(Element*, ErrorHandler*);
 
     void push(int port, Packet *);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    int pull_batch(int port, unsigned max, PacketBatch &batch);
 
   private:
 
-    atomic_uint32_t _xhead;
-    atomic_uint32_t _xtail;
+    enum { burst_max = 64 };
+
+    MPMCRing<Packet *> _ring;
+
+    inline void enqueued();
+    inline void dequeued();
+    inline Packet *pull_empty();
+    int fill_ring(Vector<Packet *> &packets, ErrorHandler *errh);
 
 };
 
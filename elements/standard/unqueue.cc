@@ -69,10 +69,11 @@ Unqueue::run_task(Task *)
     }
 
     while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    ++_count;
-	    output(0).push(p);
+	PacketBatch batch;
+	if (int n = input(0).pull_batch(limit - worked, batch)) {
+	    worked += n;
+	    _count += n;
+	    output(0).push_batch(batch);
 	} else if (!_signal)
 	    goto out;
 	else
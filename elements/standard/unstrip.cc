@@ -39,6 +39,31 @@ Unstrip::simple_action(Packet *p)
   return p->push(_nbytes);
 }
 
+void
+Unstrip::push_batch(int, PacketBatch &batch)
+{
+  // Packet::push() may reallocate a packet or fail, so rebuild the batch.
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if ((p = p->push(_nbytes)))
+      out.append(p);
+  output(0).push_batch(out);
+}
+
+int
+Unstrip::pull_batch(int, unsigned max, PacketBatch &batch)
+{
+  PacketBatch in;
+  input(0).pull_batch(max, in);
+  int n = 0;
+  while (Packet *p = in.pop_front())
+    if ((p = p->push(_nbytes))) {
+      batch.append(p);
+      ++n;
+    }
+  return n;
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Unstrip)
 ELEMENT_MT_SAFE(Unstrip)
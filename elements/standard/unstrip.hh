@@ -32,6 +32,8 @@ class Unstrip : public Element {
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
+  int pull_batch(int port, unsigned max, PacketBatch &batch);
 
 };
 
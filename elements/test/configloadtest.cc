@@ -0,0 +1,110 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * configloadtest.{cc,hh} -- benchmark loading large configurations
+ */
+
+#include <click/config.h>
+#include "configloadtest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/driver.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+ConfigLoadTest::ConfigLoadTest()
+    : _task(this), _n(16), _nrounds(1), _stop(true), _nelements(0)
+{
+}
+
+int
+ConfigLoadTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("N", _n)
+	.read("ROUNDS", _nrounds)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_n <= 0 || _nrounds <= 0)
+	return errh->error("bad N or ROUNDS");
+    return 0;
+}
+
+int
+ConfigLoadTest::initialize(ErrorHandler *)
+{
+    _task.initialize(this, true);
+    return 0;
+}
+
+String
+ConfigLoadTest::make_config() const
+{
+    StringAccum sa;
+    sa << "elementclass VOQ { input -> q :: Queue(100) -> output }\n";
+    for (int i = 0; i < _n; ++i) {
+	sa << "Idle -> rr" << i << " :: RoundRobinSwitch;\n";
+	for (int j = 0; j < _n; ++j)
+	    sa << "rr" << i << '[' << j << "] -> v" << i << '_' << j << " :: VOQ;\n";
+    }
+    for (int j = 0; j < _n; ++j) {
+	sa << "ps" << j << " :: PullSwitch(0) -> Idle;\n";
+	for (int i = 0; i < _n; ++i)
+	    sa << 'v' << i << '_' << j << " -> [" << i << "]ps" << j << ";\n";
+    }
+    return sa.take_string();
+}
+
+bool
+ConfigLoadTest::run_task(Task *)
+{
+    String config = make_config();
+    ErrorHandler *errh = ErrorHandler::default_handler();
+    for (int p = 0; p < Router::NLOAD_PHASES; ++p)
+	_load_time[p] = Timestamp();
+
+    for (int round = 0; round < _nrounds; ++round) {
+	Router *r = click_read_router(config, true, errh, true, router()->master());
+	if (!r) {
+	    errh->error("%p{element}: configuration failed", this);
+	    break;
+	}
+	_nelements = r->nelements();
+	for (int p = 0; p < Router::NLOAD_PHASES; ++p)
+	    _load_time[p] += r->load_time(p);
+	delete r;
+    }
+
+    Timestamp total;
+    for (int p = 0; p < Router::NLOAD_PHASES; ++p) {
+	_load_time[p] = _load_time[p] / _nrounds;
+	total += _load_time[p];
+    }
+    click_chatter("%p{element}: N %d, %d elements: %p{timestamp} per load (lex %p{timestamp}, build %p{timestamp})",
+		  this, _n, _nelements, &total,
+		  &_load_time[Router::LOAD_LEX], &_load_time[Router::LOAD_BUILD]);
+    if (_stop)
+	router()->please_stop_driver();
+    return true;
+}
+
+String
+ConfigLoadTest::read_handler(Element *e, void *)
+{
+    ConfigLoadTest *clt = static_cast<ConfigLoadTest *>(e);
+    StringAccum sa;
+    for (int p = 0; p < Router::NLOAD_PHASES; ++p)
+	sa << Router::load_phase_name(p) << ' ' << clt->_load_time[p] << '\n';
+    return sa.take_string();
+}
+
+void
+ConfigLoadTest::add_handlers()
+{
+    add_data_handlers("nelements", Handler::OP_READ, &_nelements);
+    add_read_handler("profile", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(ConfigLoadTest)
@@ -0,0 +1,93 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_CONFIGLOADTEST_HH
+#define CLICK_CONFIGLOADTEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/router.hh>
+CLICK_DECLS
+
+/*
+=c
+
+ConfigLoadTest([I<keywords>])
+
+=s test
+
+benchmarks loading large configurations
+
+=d
+
+ConfigLoadTest measures how long Click takes to parse, build, and initialize
+a large configuration.  It generates a synthetic N-by-N crossbar: N Idle
+sources, each feeding a RoundRobinSwitch with N outputs; N*N compound
+elements, each containing a Queue, one per source-destination pair; and N
+PullSwitch elements, each pulling from N queues.  The crossbar has N*N+4*N
+elements and 3*N*N+2*N connections, and every queue is reached through a
+compound element, so both element lookup and compound expansion are
+exercised.
+
+ConfigLoadTest loads the crossbar ROUNDS times, as a hot-swapped
+configuration would be loaded, deleting each router after it is
+initialized.  It then prints the mean time spent in each loading phase (see
+Router::load_time) to standard error and, if STOP is true, stops the driver.
+If Click was started with B<--config-cache>, the second and later rounds
+load the crossbar from the cache.
+
+ConfigLoadTest does not route packets.  It is only available at user level.
+
+Keyword arguments are:
+
+=over 8
+
+=item N
+
+Integer.  Crossbar size.  Default is 16.
+
+=item ROUNDS
+
+Integer.  Number of times to load the crossbar.  Default is 1.
+
+=item STOP
+
+Boolean.  If true, stop the driver after the last round.  Default is true.
+
+=back
+
+=h nelements r
+
+Returns the number of elements in the generated configuration.
+
+=h profile r
+
+Returns the mean time spent in each loading phase, one phase per line.
+
+*/
+
+class ConfigLoadTest : public Element { public:
+
+    ConfigLoadTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "ConfigLoadTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    bool run_task(Task *t);
+
+  private:
+
+    Task _task;
+    int _n;
+    int _nrounds;
+    bool _stop;
+    int _nelements;
+    Timestamp _load_time[Router::NLOAD_PHASES];
+
+    String make_config() const;
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
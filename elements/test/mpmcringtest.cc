@@ -0,0 +1,161 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * mpmcringtest.{cc,hh} -- benchmark the multi-producer, multi-consumer ring
+ */
+
+#include <click/config.h>
+#include "mpmcringtest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+MPMCRingTest::MPMCRingTest()
+    : _nproducers(0), _nconsumers(1), _count(1000000), _burst(32),
+      _capacity(1024), _stop(true)
+{
+    _received = 0;
+    _errors = 0;
+}
+
+MPMCRingTest::~MPMCRingTest()
+{
+    for (int i = 0; i < _producers.size(); ++i)
+	delete _producers[i];
+    for (int i = 0; i < _consumers.size(); ++i)
+	delete _consumers[i];
+}
+
+int
+MPMCRingTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _nproducers = master()->nthreads();
+    if (Args(conf, this, errh)
+	.read("PRODUCERS", _nproducers)
+	.read("CONSUMERS", _nconsumers)
+	.read("COUNT", _count)
+	.read("BURST", _burst)
+	.read("CAPACITY", _capacity)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_nproducers <= 0 || _nconsumers <= 0 || _count == 0
+	|| _burst == 0 || _capacity == 0)
+	return errh->error("bad PRODUCERS, CONSUMERS, COUNT, BURST, or CAPACITY");
+    if (_burst > burst_max)
+	return errh->error("BURST too large (max %d)", (int) burst_max);
+    if ((uint64_t) _nproducers * _count >= 0x80000000U)
+	return errh->error("too many values");
+    return 0;
+}
+
+int
+MPMCRingTest::initialize(ErrorHandler *errh)
+{
+    if (!_ring.reserve(_capacity))
+	return errh->error("out of memory");
+    _next.assign(_nproducers, 0);
+    int nthreads = master()->nthreads(), thread = 0;
+    for (int i = 0; i < _nproducers; ++i, ++thread) {
+	Worker *w = new Worker(run_producer, this, i);
+	_producers.push_back(w);
+	w->task.initialize(this, false);
+	w->task.move_thread(thread % nthreads);
+    }
+    for (int i = 0; i < _nconsumers; ++i, ++thread) {
+	Worker *w = new Worker(run_consumer, this, i);
+	_consumers.push_back(w);
+	w->task.initialize(this, false);
+	w->task.move_thread(thread % nthreads);
+    }
+    _start = Timestamp::now_steady();
+    for (int i = 0; i < _producers.size(); ++i)
+	_producers[i]->task.reschedule();
+    for (int i = 0; i < _consumers.size(); ++i)
+	_consumers[i]->task.reschedule();
+    return 0;
+}
+
+bool
+MPMCRingTest::run_producer(Task *task, void *user_data)
+{
+    Worker *w = static_cast<Worker *>(user_data);
+    MPMCRingTest *rt = w->owner;
+    uint64_t v[burst_max];
+    unsigned n = rt->_count - w->done < rt->_burst ? rt->_count - w->done : rt->_burst;
+    for (unsigned i = 0; i < n; ++i)
+	v[i] = ((uint64_t) w->index << producer_shift) | (w->done + i);
+    unsigned k = rt->_ring.enqueue_burst(v, n);
+    w->done += k;
+    if (w->done < rt->_count)
+	task->fast_reschedule();
+    return k > 0;
+}
+
+bool
+MPMCRingTest::run_consumer(Task *task, void *user_data)
+{
+    Worker *w = static_cast<Worker *>(user_data);
+    MPMCRingTest *rt = w->owner;
+    uint32_t total = rt->_nproducers * rt->_count;
+    if (rt->_received.value() >= total)
+	return false;
+
+    uint64_t v[burst_max];
+    unsigned k = rt->_ring.dequeue_burst(v, rt->_burst);
+    for (unsigned i = 0; i < k; ++i) {
+	uint64_t seq = v[i] & (((uint64_t) 1 << producer_shift) - 1);
+	int producer = v[i] >> producer_shift;
+	if (producer >= rt->_nproducers || seq >= rt->_count)
+	    ++rt->_errors;
+	else if (rt->_nconsumers == 1) {
+	    if (seq != rt->_next[producer])
+		++rt->_errors;
+	    rt->_next[producer] = seq + 1;
+	}
+	w->sum += seq;
+    }
+    w->done += k;
+
+    uint32_t before = rt->_received.fetch_and_add(k);
+    if (before + k >= total && before < total)
+	rt->finish();
+    else
+	task->fast_reschedule();
+    return k > 0;
+}
+
+void
+MPMCRingTest::finish()
+{
+    _elapsed = Timestamp::now_steady() - _start;
+
+    // Every producer sends 0 .. COUNT-1, so the sequence numbers received
+    // must add up to PRODUCERS * COUNT * (COUNT - 1) / 2.
+    uint64_t sum = 0, expected = (uint64_t) _count * (_count - 1) / 2 * _nproducers;
+    for (int i = 0; i < _consumers.size(); ++i)
+	sum += _consumers[i]->sum;
+    if (sum != expected)
+	++_errors;
+
+    uint32_t total = _nproducers * _count;
+    double rate = total / _elapsed.doubleval() / 1e6;
+    click_chatter("%p{element}: %d producers, %d consumers, burst %u: %u values in %p{timestamp} (%.2f Mvalues/s), %u errors",
+		  this, _nproducers, _nconsumers, _burst, total, &_elapsed,
+		  rate, _errors.value());
+    if (_stop)
+	router()->please_stop_driver();
+}
+
+void
+MPMCRingTest::add_handlers()
+{
+    add_data_handlers("received", Handler::OP_READ, &_received);
+    add_data_handlers("errors", Handler::OP_READ, &_errors);
+    add_data_handlers("elapsed", Handler::OP_READ, &_elapsed);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(MPMCRingTest)
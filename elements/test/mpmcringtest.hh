@@ -0,0 +1,132 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPMCRINGTEST_HH
+#define CLICK_MPMCRINGTEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/mpmcring.hh>
+CLICK_DECLS
+
+/*
+=c
+
+MPMCRingTest([I<keywords>])
+
+=s test
+
+benchmarks the multi-producer, multi-consumer ring
+
+=d
+
+MPMCRingTest measures MPMCRing throughput with several producers and
+consumers.  It creates PRODUCERS producer tasks and CONSUMERS consumer
+tasks, homed round-robin on the router's threads, producers first.  Each
+producer enqueues COUNT values in bursts of up to BURST; each consumer
+dequeues bursts of up to BURST until every value has arrived.  With one
+consumer, MPMCRingTest also checks that each producer's values arrive in
+order.  It always checks that no value is lost or duplicated.
+
+When every value has arrived, MPMCRingTest prints the elapsed time and
+throughput to standard error and, if STOP is true, stops the driver.
+Comparing BURST 1 with larger bursts shows the cost of one atomic
+operation per value.
+
+MPMCRingTest does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item PRODUCERS
+
+Integer.  Number of producer tasks.  Default is the number of threads.
+
+=item CONSUMERS
+
+Integer.  Number of consumer tasks.  Default is 1.
+
+=item COUNT
+
+Integer.  Values enqueued per producer.  Default is 1000000.
+
+=item BURST
+
+Integer.  Maximum values per enqueue or dequeue.  Default is 32.
+
+=item CAPACITY
+
+Integer.  Ring capacity.  Default is 1024.
+
+=item STOP
+
+Boolean.  If true, stop the driver when done.  Default is true.
+
+=back
+
+=h received r
+
+Returns the number of values received.
+
+=h errors r
+
+Returns the number of values that arrived out of order, more than once, or
+never.
+
+=h elapsed r
+
+Returns the time taken to pass every value, once done.
+
+=e
+
+  click -j 4 -e 'MPMCRingTest(PRODUCERS 3, CONSUMERS 1, BURST 32)'
+
+*/
+
+class MPMCRingTest : public Element { public:
+
+    MPMCRingTest() CLICK_COLD;
+    ~MPMCRingTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "MPMCRingTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    enum { burst_max = 256, producer_shift = 40 };
+
+    struct Worker {
+	Task task;
+	MPMCRingTest *owner;
+	int index;
+	uint64_t done;
+	uint64_t sum;
+	Worker(TaskCallback f, MPMCRingTest *o, int i)
+	    : task(f, this), owner(o), index(i), done(0), sum(0) {
+	}
+    };
+
+    MPMCRing<uint64_t> _ring;
+    Vector<Worker *> _producers;
+    Vector<Worker *> _consumers;
+    Vector<uint64_t> _next;		// next sequence number per producer
+    int _nproducers;
+    int _nconsumers;
+    uint32_t _count;
+    uint32_t _burst;
+    uint32_t _capacity;
+    bool _stop;
+    atomic_uint32_t _received;
+    atomic_uint32_t _errors;
+    Timestamp _start;
+    Timestamp _elapsed;
+
+    static bool run_producer(Task *task, void *user_data);
+    static bool run_consumer(Task *task, void *user_data);
+    void finish();
+
+};
+
+CLICK_ENDDECLS
+#endif
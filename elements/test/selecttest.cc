@@ -0,0 +1,140 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * selecttest.{cc,hh} -- benchmark file descriptor dispatch
+ */
+
+#include <click/config.h>
+#include "selecttest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/routerthread.hh>
+#include <click/selectset.hh>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+CLICK_DECLS
+
+SelectTest::SelectTest()
+    : _task(this), _nidle(0), _nactive(1), _nrounds(1000), _epoll(-1),
+      _stop(true), _round(0), _received(0)
+{
+}
+
+int
+SelectTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    bool epoll, have_epoll;
+    if (Args(conf, this, errh)
+	.read("IDLE", _nidle)
+	.read("ACTIVE", _nactive)
+	.read("ROUNDS", _nrounds)
+	.read("EPOLL", epoll).read_status(have_epoll)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_nidle < 0 || _nactive <= 0 || _nrounds <= 0)
+	return errh->error("bad IDLE, ACTIVE, or ROUNDS");
+    _epoll = have_epoll ? epoll : -1;
+    return 0;
+}
+
+int
+SelectTest::initialize(ErrorHandler *errh)
+{
+    _task.initialize(this, false);
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	_task.thread()->select_set().set_epoll(_epoll);
+#else
+    if (_epoll > 0)
+	errh->warning("epoll not supported");
+#endif
+
+    for (int i = 0; i < _nidle; ++i) {
+	int fd = socket(PF_INET, SOCK_DGRAM, 0);
+	if (fd < 0)
+	    return errh->error("socket: %s", strerror(errno));
+	_fds.push_back(fd);
+	add_select(fd, SELECT_READ);
+    }
+    for (int i = 0; i < _nactive; ++i) {
+	int p[2];
+	if (pipe(p) < 0)
+	    return errh->error("pipe: %s", strerror(errno));
+	fcntl(p[0], F_SETFL, O_NONBLOCK);
+	_fds.push_back(p[0]);
+	_write_fds.push_back(p[1]);
+	add_select(p[0], SELECT_READ);
+    }
+
+    _task.reschedule();
+    return 0;
+}
+
+void
+SelectTest::cleanup(CleanupStage)
+{
+    for (int i = 0; i < _fds.size(); ++i) {
+	remove_select(_fds[i], SELECT_READ);
+	close(_fds[i]);
+    }
+    for (int i = 0; i < _write_fds.size(); ++i)
+	close(_write_fds[i]);
+}
+
+void
+SelectTest::start_round()
+{
+    for (int i = 0; i < _write_fds.size(); ++i)
+	ignore_result(write(_write_fds[i], "", 1));
+}
+
+bool
+SelectTest::run_task(Task *)
+{
+    _start = Timestamp::now_steady();
+    start_round();
+    return true;
+}
+
+void
+SelectTest::selected(int fd, int)
+{
+    char buf[16];
+    if (read(fd, buf, sizeof(buf)) <= 0 || _round == _nrounds
+	|| ++_received < _nactive)
+	return;
+
+    _received = 0;
+    ++_round;
+    _elapsed = Timestamp::now_steady() - _start;
+    if (_round < _nrounds) {
+	start_round();
+	return;
+    }
+
+    const char *mechanism = "poll";
+#if HAVE_ALLOW_EPOLL
+    if (_task.thread()->select_set().epoll())
+	mechanism = "epoll";
+#endif
+    Timestamp per_round = _elapsed / _nrounds;
+    click_chatter("%p{element}: %d idle, %d active, %s: %d rounds in %p{timestamp} (%p{timestamp} per round)",
+		  this, _nidle, _nactive, mechanism, _nrounds,
+		  &_elapsed, &per_round);
+    if (_stop)
+	router()->please_stop_driver();
+}
+
+void
+SelectTest::add_handlers()
+{
+    add_data_handlers("rounds", Handler::OP_READ, &_round);
+    add_data_handlers("elapsed", Handler::OP_READ, &_elapsed);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+EXPORT_ELEMENT(SelectTest)
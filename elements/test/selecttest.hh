@@ -0,0 +1,99 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SELECTTEST_HH
+#define CLICK_SELECTTEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+CLICK_DECLS
+
+/*
+=c
+
+SelectTest([I<keywords>])
+
+=s test
+
+benchmarks file descriptor dispatch
+
+=d
+
+SelectTest measures how quickly its thread's SelectSet dispatches ready file
+descriptors when many other descriptors are idle.  It opens IDLE UDP sockets
+that never become readable and ACTIVE pipes, all selected for reading.  Each
+round, SelectTest writes one byte into every pipe, then waits until
+selected() has been called for all of them.  After ROUNDS rounds it prints
+the elapsed time to standard error and, if STOP is true, stops the driver.
+
+SelectTest does not route packets.  It is only available at user level.
+
+Keyword arguments are:
+
+=over 8
+
+=item IDLE
+
+Integer.  Number of idle file descriptors.  Default is 0.
+
+=item ACTIVE
+
+Integer.  Number of active file descriptors.  Default is 1.
+
+=item ROUNDS
+
+Integer.  Number of rounds.  Default is 1000.
+
+=item EPOLL
+
+Boolean.  If set, first switches the thread's SelectSet to epoll (if true) or
+away from it (if false).  Default leaves the SelectSet alone.
+
+=item STOP
+
+Boolean.  If true, stop the driver after the last round.  Default is true.
+
+=back
+
+=h rounds r
+
+Returns the number of completed rounds.
+
+=h elapsed r
+
+Returns the time taken by the completed rounds.
+
+*/
+
+class SelectTest : public Element { public:
+
+    SelectTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "SelectTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    bool run_task(Task *t);
+    void selected(int fd, int mask);
+
+  private:
+
+    Task _task;
+    Vector<int> _fds;
+    Vector<int> _write_fds;
+    int _nidle;
+    int _nactive;
+    int _nrounds;
+    int _epoll;
+    bool _stop;
+    int _round;
+    int _received;
+    Timestamp _start;
+    Timestamp _elapsed;
+
+    void start_round();
+
+};
+
+CLICK_ENDDECLS
+#endif
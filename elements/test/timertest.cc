@@ -22,10 +22,11 @@
 #include <click/error.hh>
 #include <click/args.hh>
 #include <click/master.hh>
+#include <click/routerthread.hh>
 CLICK_DECLS
 
 TimerTest::TimerTest()
-    : _timer(this), _benchmark(0)
+    : _timer(this), _benchmark(0), _wheel(-1)
 {
 }
 
@@ -33,14 +34,18 @@ int
 TimerTest::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     Timestamp delay;
-    bool schedule = false;
+    bool schedule = false, wheel, have_wheel;
     if (Args(conf, this, errh)
 	.read("BENCHMARK", _benchmark)
 	.read("DELAY", delay)
 	.read("SCHEDULE", schedule)
+	.read("WHEEL", wheel).read_status(have_wheel)
 	.complete() < 0)
 	return -1;
+    _wheel = have_wheel ? wheel : -1;
     _timer.initialize(this);
+    if (_wheel >= 0)
+	_timer.thread()->timer_set().set_timer_wheel(_wheel);
     if (schedule || delay)
 	_timer.schedule_after(delay);
     return 0;
@@ -66,9 +71,20 @@ TimerTest::initialize(ErrorHandler *)
 	    ts[i].assign();
 	    ts[i].initialize(this);
 	}
+	Timestamp t0 = Timestamp::now_steady();
 	benchmark_schedules(ts, _benchmark, now);
+	Timestamp t1 = Timestamp::now_steady();
 	benchmark_changes(ts, _benchmark, now);
+	Timestamp t2 = Timestamp::now_steady();
 	benchmark_fires(ts, _benchmark, now);
+	Timestamp t3 = Timestamp::now_steady();
+	t3 -= t2;
+	t2 -= t1;
+	t1 -= t0;
+	click_chatter("%p{element}: %d timers, %s: schedule %p{timestamp}, change %p{timestamp}, fire %p{timestamp}",
+		      this, _benchmark,
+		      ts->thread()->timer_set().timer_wheel() ? "wheel" : "heap",
+		      &t1, &t2, &t3);
 	delete[] ts;
     }
 
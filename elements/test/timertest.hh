@@ -39,7 +39,16 @@ is printed to standard error.
 
 Integer.  If set to a positive number, then TimerTest runs a timer
 manipulation benchmark at installation time involving BENCHMARK total
-timers.  Default is 0 (don't benchmark).
+timers, and reports how long it took to schedule the timers, to reschedule
+and unschedule them, and to fire them in expiry order.  Default is 0 (don't
+benchmark).
+
+=item WHEEL
+
+Boolean.  If set, TimerTest first switches its thread's timers to the timing
+wheel (if true) or to the heap alone (if false); see B<click>'s
+B<--timer-wheel> option.  This lets BENCHMARK compare the two.  Default
+leaves the thread's setting alone.
 
 =back
 
@@ -77,6 +86,7 @@ class TimerTest : public Element { public:
 
     Timer _timer;
     int _benchmark;
+    int _wheel;
 
     void benchmark_schedules(Timer *ts, int nts, const Timestamp &now);
     void benchmark_changes(Timer *ts, int nts, const Timestamp &now);
@@ -0,0 +1,140 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * wakeuptest.{cc,hh} -- benchmark cross-thread task wakeups
+ */
+
+#include <click/config.h>
+#include "wakeuptest.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+#include <click/routerthread.hh>
+#include <click/selectset.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+WakeupTest::WakeupTest()
+    : _ntasks(0), _ntokens(1), _nhops(100000), _stop(true)
+{
+    _completed = 0;
+}
+
+WakeupTest::~WakeupTest()
+{
+    for (int i = 0; i < _hops.size(); ++i)
+	delete _hops[i];
+}
+
+int
+WakeupTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _ntasks = master()->nthreads();
+    if (Args(conf, this, errh)
+	.read("TASKS", _ntasks)
+	.read("TOKENS", _ntokens)
+	.read("HOPS", _nhops)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_ntasks <= 0 || _ntokens == 0 || _nhops == 0)
+	return errh->error("bad TASKS, TOKENS, or HOPS");
+    return 0;
+}
+
+int
+WakeupTest::initialize(ErrorHandler *)
+{
+    int nthreads = master()->nthreads();
+    for (int i = 0; i < _ntasks; ++i) {
+	Hop *h = new Hop(this, i);
+	_hops.push_back(h);
+	h->task.initialize(this, false);
+	h->task.move_thread(i % nthreads);
+    }
+    // spread the tokens around the ring
+    for (uint32_t i = 0; i < _ntokens; ++i)
+	_hops[i % _ntasks]->tokens += 1;
+    _start = Timestamp::now_steady();
+    for (int i = 0; i < _ntasks; ++i)
+	if (_hops[i]->tokens)
+	    _hops[i]->task.reschedule();
+    return 0;
+}
+
+bool
+WakeupTest::run_hop(Task *, void *user_data)
+{
+    Hop *h = static_cast<Hop *>(user_data);
+    WakeupTest *wt = h->owner;
+    uint32_t n = h->tokens.swap(0);
+    if (!n)
+	return false;
+
+    uint32_t before = wt->_completed.fetch_and_add(n);
+    if (before >= wt->_nhops)
+	return true;
+    if (before + n >= wt->_nhops) {
+	wt->finish();
+	return true;
+    }
+
+    Hop *next = wt->_hops[h->index + 1 == wt->_hops.size() ? 0 : h->index + 1];
+    next->tokens += n;
+    next->task.reschedule();
+    return true;
+}
+
+void
+WakeupTest::finish()
+{
+    _elapsed = Timestamp::now_steady() - _start;
+    Timestamp per_hop = _elapsed / _nhops;
+    click_chatter("%p{element}: %d tasks on %d threads, %u tokens: %u hops in %p{timestamp} (%p{timestamp} per hop)",
+		  this, _ntasks, master()->nthreads(), _ntokens, _nhops,
+		  &_elapsed, &per_hop);
+    String s = thread_stats();
+    click_chatter("%p{element}: thread pending_tasks pending_batches wait_avg wait_max doorbells\n%s",
+		  this, s.c_str());
+    if (_stop)
+	router()->please_stop_driver();
+}
+
+String
+WakeupTest::thread_stats() const
+{
+    StringAccum sa;
+    for (int i = 0; i < master()->nthreads(); ++i) {
+	RouterThread *t = master()->thread(i);
+	uint64_t batches = t->pending_batches();
+	sa << i << ' ' << t->pending_tasks() << ' ' << batches << ' '
+	   << (batches ? t->pending_wait_cycles() / batches : 0) << ' '
+	   << t->pending_wait_max_cycles() << ' '
+	   << t->select_set().doorbells() << '\n';
+    }
+    return sa.take_string();
+}
+
+enum { h_hops, h_thread_stats };
+
+String
+WakeupTest::read_handler(Element *e, void *user_data)
+{
+    WakeupTest *wt = static_cast<WakeupTest *>(e);
+    if (reinterpret_cast<intptr_t>(user_data) == h_thread_stats)
+	return wt->thread_stats();
+    uint32_t hops = wt->_completed;
+    return String(hops < wt->_nhops ? hops : wt->_nhops);
+}
+
+void
+WakeupTest::add_handlers()
+{
+    add_read_handler("hops", read_handler, h_hops);
+    add_read_handler("thread_stats", read_handler, h_thread_stats);
+    add_data_handlers("elapsed", Handler::OP_READ, &_elapsed);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel umultithread)
+EXPORT_ELEMENT(WakeupTest)
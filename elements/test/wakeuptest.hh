@@ -0,0 +1,117 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WAKEUPTEST_HH
+#define CLICK_WAKEUPTEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/atomic.hh>
+CLICK_DECLS
+
+/*
+=c
+
+WakeupTest([I<keywords>])
+
+=s test
+
+benchmarks cross-thread task wakeups
+
+=d
+
+WakeupTest measures how quickly one thread can wake a task on another.  It
+creates TASKS tasks arranged in a ring and homes task I<i> on thread I<i>
+modulo the number of threads.  TOKENS tokens circulate around the ring.  A
+task that holds tokens passes each of them to the next task and schedules
+it, so with more than one thread, every hop goes through the next thread's
+pending queue.
+
+After HOPS hops, WakeupTest prints the time per hop and, for each thread,
+the pending-queue statistics: tasks taken from the pending queue, batches
+in which they were taken, average and maximum wait in cycles, and wake pipe
+doorbells.  If STOP is true, it then stops the driver.
+
+WakeupTest does not route packets.  It is only available in multithreaded
+user-level drivers.
+
+Keyword arguments are:
+
+=over 8
+
+=item TASKS
+
+Integer.  Number of tasks.  Default is the number of threads.
+
+=item TOKENS
+
+Integer.  Number of circulating tokens.  Default is 1.
+
+=item HOPS
+
+Integer.  Total number of hops.  Default is 100000.
+
+=item STOP
+
+Boolean.  If true, stop the driver after the last hop.  Default is true.
+
+=back
+
+=h hops r
+
+Returns the number of completed hops.
+
+=h elapsed r
+
+Returns the time taken by the completed hops.
+
+=h thread_stats r
+
+Returns one line per thread with the thread ID, pending tasks, pending
+batches, total and maximum pending wait in cycles, and doorbells.
+
+=e
+
+  click -j 4 -e 'WakeupTest(TOKENS 4)'
+
+*/
+
+class WakeupTest : public Element { public:
+
+    WakeupTest() CLICK_COLD;
+    ~WakeupTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "WakeupTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+  private:
+
+    struct Hop {
+	Task task;
+	atomic_uint32_t tokens;
+	WakeupTest *owner;
+	int index;
+	Hop(WakeupTest *o, int i)
+	    : task(run_hop, this), owner(o), index(i) {
+	    tokens = 0;
+	}
+    };
+
+    Vector<Hop *> _hops;
+    int _ntasks;
+    uint32_t _ntokens;
+    uint32_t _nhops;
+    bool _stop;
+    atomic_uint32_t _completed;
+    Timestamp _start;
+    Timestamp _elapsed;
+
+    static bool run_hop(Task *task, void *user_data);
+    void finish();
+    String thread_stats() const;
+    static String read_handler(Element *e, void *user_data);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -85,5 +85,19 @@ StaticThreadSched::initial_home_thread_id(const Element *e)
 	return THREAD_UNKNOWN;
 }
 
+int
+StaticThreadSched::initial_steal_policy(const Element *e)
+{
+    // An explicit thread preference pins the element's tasks.
+    int eidx = e->eindex();
+    if (eidx >= 0 && eidx < _thread_preferences.size()
+	&& _thread_preferences[eidx] != THREAD_UNKNOWN)
+	return STEAL_NEVER;
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_steal_policy(e);
+    else
+	return STEAL_UNKNOWN;
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(StaticThreadSched)
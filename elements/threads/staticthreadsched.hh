@@ -14,8 +14,10 @@ CLICK_DECLS
  * Statically binds elements to threads. If more than one StaticThreadSched
  * is specified, they will all run. The one that runs later may override an
  * earlier run.
+ *
+ * WorkStealingSched never steals the tasks of elements bound here.
  * =a
- * ThreadMonitor, BalancedThreadSched
+ * ThreadMonitor, BalancedThreadSched, WorkStealingSched
  */
 
 class StaticThreadSched : public Element, public ThreadSched { public:
@@ -28,6 +30,7 @@ class StaticThreadSched : public Element, public ThreadSched { public:
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
     int initial_home_thread_id(const Element *e);
+    int initial_steal_policy(const Element *e);
 
   private:
     Vector<int> _thread_preferences;
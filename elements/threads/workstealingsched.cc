@@ -0,0 +1,159 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * workstealingsched.{cc,hh} -- element lets idle threads steal tasks
+ */
+#include <click/config.h>
+#include "workstealingsched.hh"
+#include <click/task.hh>
+#include <click/routerthread.hh>
+#include <click/master.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/straccum.hh>
+CLICK_DECLS
+
+WorkStealingSched::WorkStealingSched()
+    : _all_stealable(true), _active(true), _next_thread_sched(0)
+{
+}
+
+WorkStealingSched::~WorkStealingSched()
+{
+}
+
+int
+WorkStealingSched::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _active = true;
+    if (Args(this, errh).bind(conf)
+	.read("ACTIVE", _active)
+	.consume() < 0)
+	return -1;
+
+    _stealable.assign(router()->nelements(), false);
+    _all_stealable = conf.empty();
+    for (int i = 0; i < conf.size(); i++) {
+	String ename;
+	if (Args(this, errh).push_back_words(conf[i])
+	    .read_mp("ELEMENT", ename)
+	    .complete() < 0)
+	    return -1;
+	bool set = false;
+	if (Element *e = router()->find(ename, this))
+	    _stealable[e->eindex()] = set = true;
+	else if (ename) {
+	    ename = router()->ename_context(eindex()) + ename + "/";
+	    for (int j = 0; j != router()->nelements(); ++j)
+		if (router()->ename(j).starts_with(ename))
+		    _stealable[j] = set = true;
+	}
+	if (!set)
+	    Args(this, errh).error("%<%s%> does not name an element", ename.c_str());
+    }
+
+    _next_thread_sched = router()->thread_sched();
+    router()->set_thread_sched(this);
+    return errh->nerrors() ? -1 : 0;
+}
+
+int
+WorkStealingSched::initialize(ErrorHandler *)
+{
+    master()->set_task_stealing(_active);
+    return 0;
+}
+
+void
+WorkStealingSched::cleanup(CleanupStage stage)
+{
+    if (stage >= CLEANUP_INITIALIZED)
+	master()->set_task_stealing(false);
+}
+
+int
+WorkStealingSched::initial_home_thread_id(const Element *e)
+{
+    if (_next_thread_sched)
+	return _next_thread_sched->initial_home_thread_id(e);
+    else
+	return THREAD_UNKNOWN;
+}
+
+int
+WorkStealingSched::initial_steal_policy(const Element *e)
+{
+    if (_next_thread_sched
+	&& _next_thread_sched->initial_steal_policy(e) == STEAL_NEVER)
+	return STEAL_NEVER;
+    int eidx = e->eindex();
+    if (_all_stealable
+	|| (eidx >= 0 && eidx < _stealable.size() && _stealable[eidx]))
+	return STEAL_ALLOWED;
+    else
+	return STEAL_NEVER;
+}
+
+String
+WorkStealingSched::read_handler(Element *e, void *user_data)
+{
+    WorkStealingSched *wss = static_cast<WorkStealingSched *>(e);
+    Master *m = wss->master();
+    int which = reinterpret_cast<intptr_t>(user_data);
+    if (which == h_active)
+	return String(wss->_active);
+    else if (which == h_thread_stats) {
+	StringAccum sa;
+	for (int i = 0; i < m->nthreads(); ++i) {
+	    RouterThread *t = m->thread(i);
+	    sa << i << ' ' << t->steals() << ' ' << t->steal_attempts()
+	       << ' ' << t->migrations() << '\n';
+	}
+	return sa.take_string();
+    }
+    uint64_t sum = 0;
+    for (int i = 0; i < m->nthreads(); ++i) {
+	RouterThread *t = m->thread(i);
+	if (which == h_steals)
+	    sum += t->steals();
+	else if (which == h_steal_attempts)
+	    sum += t->steal_attempts();
+	else
+	    sum += t->migrations();
+    }
+    return String(sum);
+}
+
+int
+WorkStealingSched::write_handler(const String &str, Element *e,
+				 void *user_data, ErrorHandler *errh)
+{
+    WorkStealingSched *wss = static_cast<WorkStealingSched *>(e);
+    Master *m = wss->master();
+    if (reinterpret_cast<intptr_t>(user_data) == h_active) {
+	bool active;
+	if (!BoolArg().parse(str, active))
+	    return errh->error("syntax error");
+	wss->_active = active;
+	m->set_task_stealing(active);
+    } else
+	for (int i = 0; i < m->nthreads(); ++i)
+	    m->thread(i)->reset_steal_counts();
+    return 0;
+}
+
+void
+WorkStealingSched::add_handlers()
+{
+    add_read_handler("active", read_handler, h_active, Handler::CHECKBOX);
+    add_write_handler("active", write_handler, h_active);
+    add_read_handler("steals", read_handler, h_steals);
+    add_read_handler("steal_attempts", read_handler, h_steal_attempts);
+    add_read_handler("migrations", read_handler, h_migrations);
+    add_read_handler("thread_stats", read_handler, h_thread_stats);
+    add_write_handler("reset", write_handler, h_reset, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(multithread)
+EXPORT_ELEMENT(WorkStealingSched)
@@ -0,0 +1,94 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_WORKSTEALINGSCHED_HH
+#define CLICK_WORKSTEALINGSCHED_HH
+#include <click/element.hh>
+#include <click/standard/threadsched.hh>
+CLICK_DECLS
+
+/*
+ * =c
+ * WorkStealingSched([ELEMENT ..., I<keywords> ACTIVE])
+ * =s threads
+ * lets idle threads steal tasks from busy ones
+ * =d
+ *
+ * Turns on work stealing between the router's threads.  A thread with more
+ * than one runnable task periodically offers its spare stealable tasks; a
+ * thread with nothing to run claims one of them, and the task moves to the
+ * idle thread.  Unlike BalancedThreadSched, which rebalances on a timer from
+ * measured costs, stealing reacts as soon as a thread goes idle.
+ *
+ * Only the tasks of MT-safe elements may change threads while the router
+ * runs.  Click cannot tell which elements are MT-safe, so each ELEMENT
+ * argument names an element, or a compound element's prefix, whose tasks may
+ * be stolen.  With no ELEMENT arguments, every task may be stolen.  Tasks
+ * whose elements are bound to a thread by StaticThreadSched, and tasks given
+ * a thread with Task::move_thread() before initialization, are never stolen;
+ * an element can also exclude its task with Task::set_stealable(false).
+ *
+ * Keyword arguments are:
+ *
+ * =over 8
+ *
+ * =item ACTIVE
+ *
+ * Boolean.  If false, do not steal until the C<active> handler is set to
+ * true.  Default is true.
+ *
+ * =back
+ *
+ * =h active rw
+ * Returns or sets the ACTIVE parameter.
+ *
+ * =h steals r
+ * Returns the number of tasks stolen by all threads.
+ *
+ * =h steal_attempts r
+ * Returns the number of times idle threads looked for a task to steal.
+ *
+ * =h migrations r
+ * Returns the number of times a task changed threads, whether stolen or
+ * moved explicitly.
+ *
+ * =h thread_stats r
+ * Returns one line per thread, containing the thread ID and its steals,
+ * steal attempts, and migrations counts.
+ *
+ * =h reset w
+ * Resets all counts to zero.
+ *
+ * =a StaticThreadSched, BalancedThreadSched, ThreadMonitor
+ */
+
+class WorkStealingSched : public Element, public ThreadSched { public:
+
+    WorkStealingSched() CLICK_COLD;
+    ~WorkStealingSched() CLICK_COLD;
+
+    const char *class_name() const	{ return "WorkStealingSched"; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    int initial_home_thread_id(const Element *e);
+    int initial_steal_policy(const Element *e);
+
+  private:
+
+    Vector<bool> _stealable;
+    bool _all_stealable;
+    bool _active;
+    ThreadSched *_next_thread_sched;
+
+    enum { h_active, h_steals, h_steal_attempts, h_migrations,
+	   h_thread_stats, h_reset };
+    static String read_handler(Element *e, void *user_data);
+    static int write_handler(const String &str, Element *e, void *user_data,
+			     ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -24,6 +24,8 @@
 #include <click/error.hh>
 #include <click/timer.hh>
 #include <click/router.hh>
+#include <click/master.hh>
+#include <click/routerthread.hh>
 #include <click/straccum.hh>
 #include <click/llrpc.h>
 #include <unistd.h>
@@ -33,7 +35,20 @@
 #include <fcntl.h>
 CLICK_DECLS
 
-const char ControlSocket::protocol_version[] = "1.3";
+const char ControlSocket::protocol_version[] = "1.4";
+
+#if HAVE_MULTITHREAD
+// Serializes SNAPSHOT READMANYs across all ControlSockets.
+static SimpleSpinlock snapshot_lock;
+
+static void
+unblock_threads(Master *m, RouterThread *home, int n)
+{
+    for (int t = 0; t < n; ++t)
+	if (m->thread(t) != home)
+	    m->thread(t)->unblock_tasks();
+}
+#endif
 
 class ControlSocketErrorHandler : public ErrorHandler { public:
 
@@ -83,7 +98,7 @@ ControlSocketErrorHandler::account(int level)
 
 
 ControlSocket::ControlSocket()
-  : _socket_fd(-1), _proxy(0), _full_proxy(0), _retry_timer(0)
+  : _socket_fd(-1), _snapshot(false), _proxy(0), _full_proxy(0), _retry_timer(0)
 {
 }
 
@@ -100,17 +115,21 @@ ControlSocket::configure(Vector<String> &conf, ErrorHandler *errh)
 	return -1;
 
     // remove keyword arguments
-    bool read_only = false, verbose = false, retry_warnings = true, localhost = false;
+    bool read_only = false, verbose = false, retry_warnings = true, localhost = false, snapshot = false;
     _retries = 0;
+    _snapshot_timeout = Timestamp::make_msec(100);
     if (args.read("READONLY", read_only)
 	.read("PROXY", _proxy)
 	.read("VERBOSE", verbose)
 	.read("RETRIES", _retries)
 	.read("RETRY_WARNINGS", retry_warnings)
 	.read("LOCALHOST", localhost)
+	.read("SNAPSHOT", snapshot)
+	.read("SNAPSHOT_TIMEOUT", _snapshot_timeout)
 	.consume() < 0)
 	return -1;
     _read_only = read_only;
+    _snapshot = snapshot;
     _verbose = verbose;
     _retry_warnings = retry_warnings;
     _localhost = localhost;
@@ -534,6 +553,141 @@ ControlSocket::read_command(connection &conn, const String &handlername, String
   return 0;
 }
 
+static bool
+has_glob(const String &s)
+{
+    for (const char *x = s.begin(); x != s.end(); ++x)
+	if (*x == '*' || *x == '?' || *x == '[')
+	    return true;
+    return false;
+}
+
+void
+ControlSocket::expand_read_pattern(const String &pattern, Vector<ReadManyItem> &items)
+{
+    String canonical_name = canonical_handler_name(pattern);
+    const char *dot = find(canonical_name, '.');
+    String epattern, hpattern = canonical_name;
+    if (dot != canonical_name.end()) {
+	epattern = canonical_name.substring(canonical_name.begin(), dot);
+	hpattern = canonical_name.substring(dot + 1, canonical_name.end());
+    }
+
+    Vector<int> hindexes;
+    for (int i = (epattern ? 0 : -1); i < (epattern ? router()->nelements() : 0); ++i) {
+	Element *e = (i < 0 ? router()->root_element() : router()->element(i));
+	if (i >= 0 && !router()->ename(i).glob_match(epattern))
+	    continue;
+	hindexes.clear();
+	Router::element_hindexes(e, hindexes);
+	for (int *hip = hindexes.begin(); hip != hindexes.end(); ++hip) {
+	    const Handler *h = Router::handler(router(), *hip);
+	    if (h->read_visible() && h->name().glob_match(hpattern)) {
+		ReadManyItem item;
+		item.name = (i < 0 ? h->name() : router()->ename(i) + "." + h->name());
+		item.e = e;
+		item.h = h;
+		item.code = CSERR_OK;
+		items.push_back(item);
+	    }
+	}
+    }
+}
+
+int
+ControlSocket::read_many_command(connection &conn, const Vector<String> &patterns, bool binary)
+{
+    // Resolve every pattern before calling any handler.  Lookup failures
+    // become records carrying the message lines a READ would have sent.
+    Vector<ReadManyItem> items;
+    for (const String *p = patterns.begin(); p != patterns.end(); ++p)
+	if (!_proxy && has_glob(*p))
+	    expand_read_pattern(*p, items);
+	else {
+	    ReadManyItem item;
+	    item.name = *p;
+	    connection errconn(conn.fd);
+	    item.h = parse_handler(errconn, *p, &item.e);
+	    if (item.h && !item.h->read_visible())
+		errconn.message(CSERR_PERMISSION, "Handler '" + *p + "' write-only");
+	    if (errconn.out_text.length()) {
+		item.h = 0;
+		item.code = atoi(errconn.out_text.c_str());
+		item.data = errconn.out_text.take_string();
+	    } else
+		item.code = CSERR_OK;
+	    items.push_back(item);
+	}
+
+    // Call the handlers back to back.  With SNAPSHOT, the router's other
+    // threads run no tasks meanwhile, so counters don't move between reads.
+    // (selected() runs on our home thread.)  Give up rather than wait
+    // forever for another snapshot or for a task that never yields.
+#if HAVE_MULTITHREAD
+    Master *m = master();
+    bool block = _snapshot && m->nthreads() > 1;
+    if (block) {
+	Timestamp deadline = Timestamp::now_steady() + _snapshot_timeout;
+	while (!snapshot_lock.attempt())
+	    if (Timestamp::now_steady() >= deadline)
+		return conn.message(CSERR_UNSPECIFIED, "Snapshot timed out waiting for another snapshot");
+	for (int t = 0; t < m->nthreads(); ++t)
+	    if (m->thread(t) != home_thread()
+		&& !m->thread(t)->block_tasks_until(deadline)) {
+		unblock_threads(m, home_thread(), t);
+		snapshot_lock.release();
+		return conn.message(CSERR_UNSPECIFIED, "Snapshot timed out waiting for thread " + String(t));
+	    }
+    }
+#endif
+    int nerrors = 0;
+    for (ReadManyItem *it = items.begin(); it != items.end(); ++it) {
+	if (!it->h) {
+	    ++nerrors;
+	    continue;
+	}
+	ControlSocketErrorHandler errh;
+	_proxied_handler = it->h->name();
+	_proxied_errh = &errh;
+	it->data = it->h->call_read(it->e, String(), &errh);
+	_proxied_errh = 0;
+	if (errh.nerrors() > 0) {
+	    connection errconn(conn.fd);
+	    errconn.transfer_messages(CSERR_UNSPECIFIED, "Read handler '" + it->name + "' error", &errh);
+	    it->code = atoi(errconn.out_text.c_str());
+	    it->data = errconn.out_text.take_string();
+	    ++nerrors;
+	}
+    }
+#if HAVE_MULTITHREAD
+    if (block) {
+	unblock_threads(m, home_thread(), m->nthreads());
+	snapshot_lock.release();
+    }
+#endif
+
+    StringAccum sa;
+    for (ReadManyItem *it = items.begin(); it != items.end(); ++it)
+	if (binary) {
+	    uint32_t header[3];
+	    header[0] = htonl(it->code);
+	    header[1] = htonl(it->name.length());
+	    header[2] = htonl(it->data.length());
+	    sa.append(reinterpret_cast<const char *>(header), sizeof(header));
+	    sa << it->name << it->data;
+	} else
+	    sa << it->code << ' ' << it->name << ' ' << it->data.length()
+	       << '\r' << '\n' << it->data << '\r' << '\n';
+
+    StringAccum msg;
+    msg << "Read " << items.size() << " handlers OK";
+    if (nerrors)
+	msg << ", " << nerrors << " failed";
+    conn.message(CSERR_OK, msg.take_string());
+    conn.out_text << "DATA " << sa.length() << '\r' << '\n' << sa;
+    return 0;
+}
+
 int
 ControlSocket::write_command(connection &conn, const String &handlername, String data)
 {
@@ -754,6 +908,10 @@ ControlSocket::parse_command(connection &conn, const String &line)
       else
 	  return write_command(conn, words[1], data);
 
+  } else if (command == "READMANY" || command == "READMANYBIN") {
+      words.pop_front();
+      return read_many_command(conn, words, command.length() > 8);
+
   } else if (command == "CHECKREAD" || command == "CHECKWRITE") {
       if (words.size() != 2)
 	  return conn.message(CSERR_SYNTAX, "Wrong number of arguments");
@@ -784,6 +942,8 @@ ControlSocket::parse_command(connection &conn, const String &line)
     conn.message(CSERR_OK, "READ handler [arg...]   call read handler, return DATA", true);
     conn.message(CSERR_OK, "READDATA handler len    call read handler with len data bytes, return DATA", true);
     conn.message(CSERR_OK, "READUNTIL handler term  call read handler, take data until term, return DATA", true);
+    conn.message(CSERR_OK, "READMANY pattern...     call matching read handlers, return records in DATA", true);
+    conn.message(CSERR_OK, "READMANYBIN pattern...  like READMANY, with binary records", true);
     conn.message(CSERR_OK, "WRITE handler [arg...]  call write handler", true);
     conn.message(CSERR_OK, "WRITEDATA handler len   call write handler, pass len data bytes", true);
     conn.message(CSERR_OK, "WRITEUNTIL handler term call write handler, take data until term", true);
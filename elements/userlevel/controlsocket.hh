@@ -2,6 +2,7 @@
 #define CLICK_CONTROLSOCKET_HH
 #include "elements/userlevel/handlerproxy.hh"
 #include <click/straccum.hh>
+#include <click/timestamp.hh>
 CLICK_DECLS
 class ControlSocketErrorHandler;
 class Timer;
@@ -10,7 +11,7 @@ class Handler;
 /*
 =c
 
-ControlSocket("TCP", PORTNUMBER [, I<keywords READONLY, PROXY, VERBOSE, LOCALHOST, RETRIES, RETRY_WARNINGS>])
+ControlSocket("TCP", PORTNUMBER [, I<keywords READONLY, PROXY, VERBOSE, LOCALHOST, RETRIES, RETRY_WARNINGS, SNAPSHOT, SNAPSHOT_TIMEOUT>])
 ControlSocket("UNIX", FILENAME [, I<keywords>])
 
 =s control
@@ -39,8 +40,8 @@ The server will accept lines terminated by CR, LF, or CRLF. Its response
 lines are always terminated by CRLF.
 
 When a connection is opened, the server responds by stating its protocol
-version number with a line like "Click::ControlSocket/1.3". The current
-version number is 1.3. Changes in minor version number will only add commands
+version number with a line like "Click::ControlSocket/1.4". The current
+version number is 1.4. Changes in minor version number will only add commands
 and functionality to this specification, not change existing functionality.
 
 ControlSocket supports hot-swapping, meaning you can change configurations
@@ -88,6 +89,23 @@ Boolean. If true, ControlSocket will print warning messages every time it
 fails to open a socket. If false, it will print messages only on the final
 failure. Default is true.
 
+=item SNAPSHOT
+
+Boolean. If true, the router's other threads run no tasks while a READMANY
+command calls its handlers, so the results describe a single moment. Timers
+and file descriptors on other threads are not held. Default is false.
+
+ControlSocket waits for each other thread to finish its current task before
+calling any handler. Only one snapshot runs at a time, router-wide. If
+another snapshot or a thread's task does not finish within SNAPSHOT_TIMEOUT,
+as with a task that never yields, such as EstimateTraffic's, READMANY calls
+no handlers and fails with a 590 error.
+
+=item SNAPSHOT_TIMEOUT
+
+Time. How long a SNAPSHOT READMANY waits for other threads to stop running
+tasks. Default is 100ms.
+
 =back
 
 The PORT argument for TCP ControlSockets can also be an integer followed by a
@@ -136,6 +154,33 @@ for a terminator, ControlSocket removes trailing spaces from both
 I<terminator> and the input lines. Introduced in version 1.3 of the
 ControlSocket protocol.
 
+=item READMANY I<pattern...>
+
+Call many read handlers at once and return all their results. Each
+I<pattern> is a handler name whose element and handler parts may contain
+shell-style wildcards (C<*>, C<?>, and C<[...]>); for example,
+C<voq*.length> reads the "length" handler of every element whose name
+starts with "voq", and C<q.*> reads every readable handler of element "q".
+Wildcards are not expanded through a PROXY. The handlers are called back to
+back, with no other commands or tasks on ControlSocket's thread running in
+between (and, with SNAPSHOT, no tasks on other threads either).
+
+The response is a "success" message followed by "DATA I<n>", as in READ. The
+I<n> bytes of data hold one record per handler, in pattern order, with
+wildcard matches in element and handler order. Each record is a line of the
+form "I<code> I<name> I<len>", terminated by CRLF, followed by I<len> bytes
+and a CRLF. I<Code> is 200 if the handler was read successfully, in which case the bytes
+are its result. Otherwise I<code> is an error code, and the bytes are the
+message lines that READ would have sent. Introduced in version 1.4 of the
+ControlSocket protocol.
+
+=item READMANYBIN I<pattern...>
+
+Like READMANY, but each record starts with three 32-bit integers in network
+byte order: the code, the length of the name, and the length of the data.
+The name and data follow. Introduced in version 1.4 of the ControlSocket
+protocol.
+
 =item WRITE I<handler> I<params...>
 
 Call a write I<handler>, passing the I<params>, if any, as arguments.
@@ -263,7 +308,9 @@ class ControlSocket : public Element { public:
     bool _verbose : 1;
     bool _retry_warnings : 1;
     bool _localhost : 1;
+    bool _snapshot : 1;
     uint8_t _type;
+    Timestamp _snapshot_timeout;
     Element *_proxy;
     HandlerProxy *_full_proxy;
 
@@ -288,6 +335,14 @@ class ControlSocket : public Element { public:
     };
     Vector<connection *> _conns;
 
+    struct ReadManyItem {
+	String name;
+	Element *e;
+	const Handler *h;
+	int code;
+	String data;
+    };
+
     String _proxied_handler;
     ErrorHandler *_proxied_errh;
 
@@ -306,6 +361,8 @@ class ControlSocket : public Element { public:
     String proxied_handler_name(const String &) const;
     const Handler* parse_handler(connection &conn, const String &, Element **);
     int read_command(connection &conn, const String &, String);
+    void expand_read_pattern(const String &pattern, Vector<ReadManyItem> &items);
+    int read_many_command(connection &conn, const Vector<String> &patterns, bool binary);
     int write_command(connection &conn, const String &, String);
     int check_command(connection &conn, const String &, bool write);
     int llrpc_command(connection &conn, const String &, String);
@@ -100,6 +100,7 @@ bool FromDPDKDevice::run_task(Task * t)
     struct rte_mbuf *pkts[_burst_size];
 
     unsigned n = rte_eth_rx_burst(_dev->port_id, _queue_id, pkts, _burst_size);
+    PacketBatch batch;
     for (unsigned i = 0; i < n; ++i) {
         unsigned char* data = rte_pktmbuf_mtod(pkts[i], unsigned char *);
         rte_prefetch0(data);
@@ -112,8 +113,9 @@ bool FromDPDKDevice::run_task(Task * t)
         p->set_packet_type_anno(Packet::HOST);
         p->set_mac_header(data);
 
-        output(0).push(p);
+        batch.append(p);
     }
+    output(0).push_batch(batch);
     _count += n;
 
     /* We reschedule directly, as we cannot know if there is actually packet
@@ -272,6 +272,61 @@ void ToDPDKDevice::push(int, Packet *p)
     p->kill();
 }
 
+void ToDPDKDevice::push_batch(int port, PacketBatch &batch)
+{
+    if (!_dev) {
+        batch.kill();
+        return;
+    }
+
+    // Get the thread-local internal queue
+    InternalQueue &iqueue = _iqueues[click_current_cpu_id()];
+
+    // Packets already waiting must leave first.
+    if (iqueue.nr_pending)
+        flush_internal_queue(iqueue);
+
+    /* With the internal queue empty, its array holds the batch's mbufs,
+     * which go to the device in one rte_eth_tx_burst call per IQUEUE
+     * packets. Whatever the device does not take stays in the internal
+     * queue, as in push(). */
+    while (batch.first()) {
+        if (iqueue.nr_pending) {
+            // If we're in blocking mode, we wait for the device to drain
+            if (!_blocking)
+                break;
+            flush_internal_queue(iqueue);
+            continue;
+        }
+
+        unsigned n = 0;
+        while (n < _iqueue_size && batch.first()) {
+            Packet *p = batch.pop_front();
+            iqueue.pkts[n++] = get_mbuf(p);
+            p->kill();
+        }
+
+        _lock.acquire();
+        unsigned r = rte_eth_tx_burst(_dev->port_id, _queue_id, iqueue.pkts, n);
+        _count += r;
+        _lock.release();
+
+        iqueue.index = (r == n ? 0 : r);
+        iqueue.nr_pending = n - r;
+    }
+
+    if (iqueue.nr_pending && _timeout >= 0 && !iqueue.timeout.scheduled()) {
+        if (_timeout == 0)
+            flush_internal_queue(iqueue);
+        else
+            iqueue.timeout.schedule_after_msec(_timeout);
+    }
+
+    // The device is congested; queue or drop the rest one at a time.
+    while (Packet *p = batch.pop_front())
+        ToDPDKDevice::push(port, p);
+}
+
 CLICK_ENDDECLS
 ELEMENT_REQUIRES(userlevel dpdk)
 EXPORT_ELEMENT(ToDPDKDevice)
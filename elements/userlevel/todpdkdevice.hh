@@ -144,6 +144,7 @@ public:
 
     void run_timer(Timer *) override;
     void push(int port, Packet *p) override;
+    void push_batch(int port, PacketBatch &batch) override;
 
 private:
 
@@ -18,6 +18,9 @@ void click_static_cleanup();
 
 Lexer *click_lexer();
 Router *click_read_router(String filename, bool is_expr, ErrorHandler * = 0, bool initialize = true, Master * = 0);
+#if CLICK_USERLEVEL
+void click_set_config_cache(const String &dir);
+#endif
 
 String click_compile_archive_file(const Vector<ArchiveElement> &ar,
                 const ArchiveElement *ae,
@@ -5,8 +5,13 @@
 #include <click/vector.hh>
 #include <click/string.hh>
 #include <click/packet.hh>
+#include <click/packetbatch.hh>
 #include <click/handler.hh>
+#include <click/perfevent.hh>
 CLICK_DECLS
+#if HAVE_PERF_EVENTS || HAVE_PACKET_TRACE
+# define CLICK_PORT_HOOKS 1
+#endif
 class Router;
 class Master;
 class RouterThread;
@@ -36,6 +41,8 @@ class Element { public:
     virtual void push(int port, Packet *p);
     virtual Packet *pull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual Packet *simple_action(Packet *p);
+    virtual void push_batch(int port, PacketBatch &batch);
+    virtual int pull_batch(int port, unsigned max, PacketBatch &batch);
 
     virtual bool run_task(Task *task);  // return true iff did useful work
     virtual void run_timer(Timer *timer);
@@ -219,6 +226,8 @@ class Element { public:
 
         inline void push(Packet* p) const;
         inline Packet* pull() const;
+        inline void push_batch(PacketBatch &batch) const;
+        inline int pull_batch(unsigned max, PacketBatch &batch) const;
 
 #if CLICK_STATS >= 1
         unsigned npackets() const       { return _packets; }
@@ -226,6 +235,15 @@ class Element { public:
 
         inline void assign(bool isoutput, Element *e, int port);
 
+#if CLICK_PORT_HOOKS
+        enum { hook_perf = 1, hook_trace = 2 };
+        /** @brief Turn a transfer hook on or off for every port.
+         *
+         * While any hook is on, transfers take an out-of-line path that
+         * serves PerfEvents and PacketTrace. */
+        static void set_hook(int hook, bool on);
+#endif
+
       private:
 
         Element* _e;
@@ -240,13 +258,22 @@ class Element { public:
 #if CLICK_STATS >= 1
         mutable unsigned _packets;      // How many packets have we moved?
 #endif
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || HAVE_PACKET_TRACE
         Element* _owner;                // Whose input or output are we?
 #endif
 
         inline Port();
         inline void assign(bool isoutput, Element *owner, Element *e, int port);
 
+#if CLICK_PORT_HOOKS
+        static volatile int _hooks;
+
+        void hooked_push(Packet *p) const;
+        Packet *hooked_pull() const;
+        void hooked_push_batch(PacketBatch &batch) const;
+        int hooked_pull_batch(unsigned max, PacketBatch &batch) const;
+#endif
+
         friend class Element;
 
     };
@@ -288,6 +315,11 @@ class Element { public:
     static String read_cycles_handler(Element *, void *);
     static int write_cycles_handler(const String &, Element *, void *, ErrorHandler *);
 #endif
+#if HAVE_PERF_EVENTS
+    PerfEvents::ElementProfile *_perf;  // Hardware counters, if profiled.
+    static String read_perf_handler(Element *, void *);
+    static int write_perf_handler(const String &, Element *, void *, ErrorHandler *);
+#endif
 
     Element(const Element &);
     Element &operator=(const Element &);
@@ -307,6 +339,9 @@ class Element { public:
     inline void add_data_handlers(const char *name, int flags, HandlerCallback callback, void *data);
 
     friend class Router;
+#if HAVE_PERF_EVENTS
+    friend class PerfEvents;
+#endif
 #if CLICK_STATS >= 2
     friend class Task;
     friend class Master;
@@ -515,12 +550,15 @@ Element::input_is_push(int port) const
         && !_ports[0][port].active();
 }
 
-#if CLICK_STATS >= 2
-# define PORT_ASSIGN(o) _packets = 0; _owner = (o)
-#elif CLICK_STATS >= 1
-# define PORT_ASSIGN(o) _packets = 0; (void) (o)
+#if CLICK_STATS >= 2 || HAVE_PACKET_TRACE
+# define PORT_ASSIGN_OWNER(o) _owner = (o)
 #else
-# define PORT_ASSIGN(o) (void) (o)
+# define PORT_ASSIGN_OWNER(o) (void) (o)
+#endif
+#if CLICK_STATS >= 1
+# define PORT_ASSIGN(o) _packets = 0; PORT_ASSIGN_OWNER(o)
+#else
+# define PORT_ASSIGN(o) PORT_ASSIGN_OWNER(o)
 #endif
 
 inline
@@ -612,6 +650,10 @@ Element::Port::push(Packet* p) const
 #if CLICK_STATS >= 1
     ++_packets;
 #endif
+#if CLICK_PORT_HOOKS
+    if (unlikely(_hooks))
+        return hooked_push(p);
+#endif
 #if CLICK_STATS >= 2
     ++_e->input(_port)._packets;
     click_cycles_t start_cycles = click_get_cycles(),
@@ -655,6 +697,10 @@ inline Packet*
 Element::Port::pull() const
 {
     assert(_e);
+#if CLICK_PORT_HOOKS
+    if (unlikely(_hooks))
+        return hooked_pull();
+#endif
 #if CLICK_STATS >= 2
     click_cycles_t start_cycles = click_get_cycles(),
         old_child_cycles = _e->_child_cycles;
@@ -684,6 +730,79 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Push every packet in @a batch over this port.
+ *
+ * Passes @a batch to the next element's @link Element::push_batch()
+ * push_batch() @endlink function, which by default pushes its packets one at
+ * a time.  Like push(), this relinquishes the packets; @a batch is empty on
+ * return.
+ *
+ * This port must be an active() push output port. */
+inline void
+Element::Port::push_batch(PacketBatch &batch) const
+{
+    assert(_e);
+    if (batch.empty())
+        return;
+#if CLICK_STATS >= 1
+    _packets += batch.count();
+#endif
+#if CLICK_PORT_HOOKS
+    if (unlikely(_hooks))
+        return hooked_push_batch(batch);
+#endif
+#if CLICK_STATS >= 2
+    _e->input(_port)._packets += batch.count();
+    click_cycles_t start_cycles = click_get_cycles(),
+        start_child_cycles = _e->_child_cycles;
+    _e->push_batch(_port, batch);
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+        own_delta = all_delta - (_e->_child_cycles - start_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    _e->push_batch(_port, batch);
+#endif
+    batch.clear();
+}
+
+/** @brief Pull up to @a max packets over this port, appending them to @a
+ * batch.
+ * @return the number of packets appended
+ *
+ * Calls the previous element's @link Element::pull_batch() pull_batch()
+ * @endlink function, which by default calls pull() until it returns null or
+ * @a max packets have been pulled.
+ *
+ * This port must be an active() pull input port. */
+inline int
+Element::Port::pull_batch(unsigned max, PacketBatch &batch) const
+{
+    assert(_e);
+#if CLICK_PORT_HOOKS
+    if (unlikely(_hooks))
+        return hooked_pull_batch(max, batch);
+#endif
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles(),
+        old_child_cycles = _e->_child_cycles;
+    int n = _e->pull_batch(_port, max, batch);
+    _e->output(_port)._packets += n;
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+        own_delta = all_delta - (_e->_child_cycles - old_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    int n = _e->pull_batch(_port, max, batch);
+#endif
+#if CLICK_STATS >= 1
+    _packets += n;
+#endif
+    return n;
+}
+
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
  *
@@ -7,6 +7,7 @@
 #include <click/variableenv.hh>
 CLICK_DECLS
 class LexerExtra;
+class StringAccum;
 
 enum Lexemes {
     lexEOF = 0,
@@ -103,7 +104,10 @@ class Lexer { public:
     bool ydone() const			{ return !_ps; }
     void ystep();
 
-    Router *create_router(Master *);
+    Router *create_router(Master *master, StringAccum *graph = 0);
+    Router *create_router_from_graph(const String &config, const String &graph,
+				     Master *master, LexerExtra *lextra,
+				     ErrorHandler *errh);
 
   private:
 
@@ -193,6 +197,7 @@ class Lexer { public:
     int lerror_syntax(const Lexeme &t);
 
     String anon_element_name(const String &) const;
+    void unparse_graph(StringAccum &sa, const Vector<int> &router_id) const;
     int get_element(String name, int etype,
 		    const String &configuration = String(),
 		    const String &filename = String(), unsigned lineno = 0);
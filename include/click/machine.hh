@@ -79,4 +79,19 @@ inline void click_write_fence() {
 #endif
 }
 
+/** @brief Prefetch the cache line at @a addr for reading.
+
+    A hint only: it never faults, and has no effect on correctness. */
+inline void
+click_prefetch(const void *addr)
+{
+#if CLICK_LINUXMODULE
+    prefetch(addr);
+#elif defined(__GNUC__)
+    __builtin_prefetch(addr);
+#else
+    (void) addr;
+#endif
+}
+
 #endif
@@ -32,6 +32,11 @@ class Master { public:
     inline RouterThread *thread(int id) const;
     void wake_somebody();
 
+#if HAVE_MULTITHREAD
+    bool task_stealing() const                  { return _task_stealing; }
+    void set_task_stealing(bool stealing);
+#endif
+
 #if CLICK_USERLEVEL
     int add_signal_handler(int signo, Router *router, String handler);
     int remove_signal_handler(int signo, Router *router, String handler);
@@ -59,6 +64,10 @@ class Master { public:
     // THREADS
     RouterThread **_threads;
     int _nthreads;
+#if HAVE_MULTITHREAD
+    volatile bool _task_stealing;
+    void unpublish_task(Task *t);
+#endif
 
     // ROUTERS
     Router *_routers;
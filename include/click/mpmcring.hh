@@ -0,0 +1,235 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_MPMCRING_HH
+#define CLICK_MPMCRING_HH
+#include <click/atomic.hh>
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @file <click/mpmcring.hh>
+ * @brief A bounded multi-producer, multi-consumer ring.
+ */
+
+/** @class MPMCRing
+ * @brief A bounded FIFO that many threads can enqueue to and dequeue from.
+ *
+ * MPMCRing holds up to capacity() values of type T, which should be a
+ * pointer or another small trivially copyable type.  Each slot carries a
+ * sequence number, as in Dmitry Vyukov's bounded MPMC queue, that says
+ * whether the slot is free for a given position or holds that position's
+ * value.  A producer counts the free slots starting at the enqueue position
+ * and claims them all with a single compare-and-swap; consumers do the same
+ * with published slots at the dequeue position.  Moving a burst of n values
+ * thus costs one atomic operation no matter how large n is.  No thread ever
+ * waits for another: a value becomes visible as soon as its own slot is
+ * published, and a consumer stops at the first slot whose producer has not
+ * finished.
+ *
+ * The enqueue and dequeue positions live on separate cache lines, so
+ * producers and consumers do not contend for a line except through the
+ * slots themselves.
+ *
+ * Bursts are all-or-some: enqueue_burst() stores as many values as fit and
+ * dequeue_burst() returns as many as are ready, up to the requested count.
+ * The ring has at least twice capacity() slots, so a producer almost never
+ * finds its slot still being emptied by a slow consumer.
+ *
+ * The ring is not resizable while in use; reserve() must be called before
+ * any thread touches the ring.
+ */
+template <typename T>
+class MPMCRing { public:
+
+    /** @brief Construct an empty ring with no capacity. */
+    MPMCRing()
+	: _slots(0), _mask(0), _capacity(0) {
+	_enq = 0;
+	_deq = 0;
+    }
+
+    ~MPMCRing() {
+	delete[] _slots;
+    }
+
+    /** @brief Allocate room for @a capacity values and empty the ring.
+     * @return true on success, false if out of memory
+     *
+     * The ring uses the next power of two at least 2 * @a capacity slots,
+     * but never holds more than @a capacity values. */
+    bool reserve(uint32_t capacity);
+
+    /** @brief Return the maximum number of values the ring holds. */
+    uint32_t capacity() const {
+	return _capacity;
+    }
+
+    /** @brief Return the number of values in the ring.
+     *
+     * Counts values whose positions have been claimed, so a value being
+     * enqueued counts and a value being dequeued does not.  Other threads
+     * may change the ring at any time, so this is an estimate. */
+    inline uint32_t size() const;
+
+    /** @brief Return true iff the ring appears empty. */
+    bool empty() const {
+	return size() == 0;
+    }
+
+    /** @brief Enqueue up to @a n values from @a v.
+     * @return number of values enqueued, which is less than @a n if the
+     * ring filled up */
+    inline unsigned enqueue_burst(const T *v, unsigned n);
+
+    /** @brief Dequeue up to @a n values into @a v.
+     * @return number of values dequeued */
+    inline unsigned dequeue_burst(T *v, unsigned n);
+
+    /** @brief Enqueue @a x.
+     * @return true on success, false if the ring is full */
+    bool enqueue(const T &x) {
+	return enqueue_burst(&x, 1) == 1;
+    }
+
+    /** @brief Dequeue one value into @a x.
+     * @return true on success, false if the ring is empty */
+    bool dequeue(T &x) {
+	return dequeue_burst(&x, 1) == 1;
+    }
+
+  private:
+
+    struct Slot {
+	volatile uint32_t seq;
+	T value;
+    };
+
+    Slot *_slots;
+    uint32_t _mask;
+    uint32_t _capacity;
+    atomic_uint32_t _enq CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    atomic_uint32_t _deq CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+
+    MPMCRing(const MPMCRing<T> &);
+    MPMCRing<T> &operator=(const MPMCRing<T> &);
+
+    // Orders a slot's value loads before the store that frees the slot.
+    static inline void load_store_fence() {
+#if !CLICK_LINUXMODULE && (defined(__i386__) || defined(__x86_64__))
+	click_compiler_fence();
+#else
+	click_fence();
+#endif
+    }
+
+};
+
+template <typename T>
+bool
+MPMCRing<T>::reserve(uint32_t capacity)
+{
+    uint32_t nslots = 2;
+    while (nslots < capacity * 2)
+	nslots *= 2;
+    Slot *slots = new Slot[nslots];
+    if (!slots)
+	return false;
+    for (uint32_t i = 0; i != nslots; ++i)
+	slots[i].seq = i;
+    delete[] _slots;
+    _slots = slots;
+    _mask = nslots - 1;
+    _capacity = capacity;
+    _enq = 0;
+    _deq = 0;
+    return true;
+}
+
+template <typename T>
+inline uint32_t
+MPMCRing<T>::size() const
+{
+    uint32_t deq = _deq.value();
+    int32_t n = (int32_t) (_enq.value() - deq);
+    if (n <= 0)
+	return 0;
+    return (uint32_t) n < _capacity ? n : _capacity;
+}
+
+template <typename T>
+inline unsigned
+MPMCRing<T>::enqueue_burst(const T *v, unsigned n)
+{
+    // Count the free slots from pos, then claim them.  A slot is free for
+    // position p once its sequence number equals p.
+    uint32_t pos = _enq.value();
+    unsigned k;
+    while (1) {
+	int32_t used = (int32_t) (pos - _deq.value());
+	int32_t room = used <= 0 ? _capacity : _capacity - used;
+	if (room <= 0)
+	    return 0;
+	unsigned want = n < (uint32_t) room ? n : room;
+	int32_t dif = 0;
+	for (k = 0; k != want; ++k)
+	    if ((dif = (int32_t) (_slots[(pos + k) & _mask].seq - (pos + k))))
+		break;
+	if (k == 0) {
+	    if (dif < 0)	// slot still holds an undequeued value
+		return 0;
+	    pos = _enq.value();	// another producer got there first
+	    continue;
+	}
+	uint32_t actual = _enq.compare_swap(pos, pos + k);
+	if (actual == pos)
+	    break;
+	pos = actual;
+    }
+
+    load_store_fence();
+    for (unsigned i = 0; i != k; ++i) {
+	Slot &s = _slots[(pos + i) & _mask];
+	s.value = v[i];
+	click_write_fence();
+	s.seq = pos + i + 1;
+    }
+    return k;
+}
+
+template <typename T>
+inline unsigned
+MPMCRing<T>::dequeue_burst(T *v, unsigned n)
+{
+    // Count the published slots from pos, then claim them.  A slot holds
+    // position p's value once its sequence number is p + 1.
+    uint32_t pos = _deq.value();
+    unsigned k;
+    while (1) {
+	int32_t dif = 0;
+	for (k = 0; k != n; ++k)
+	    if ((dif = (int32_t) (_slots[(pos + k) & _mask].seq - (pos + k + 1))))
+		break;
+	if (k == 0) {
+	    if (dif < 0)	// empty, or the next value is not yet stored
+		return 0;
+	    pos = _deq.value();	// another consumer got there first
+	    continue;
+	}
+	uint32_t actual = _deq.compare_swap(pos, pos + k);
+	if (actual == pos)
+	    break;
+	pos = actual;
+    }
+
+    // Freeing a slot for the next lap sets its sequence number to
+    // p + nslots.
+    click_read_fence();
+    for (unsigned i = 0; i != k; ++i) {
+	Slot &s = _slots[(pos + i) & _mask];
+	v[i] = s.value;
+	load_store_fence();
+	s.seq = pos + i + _mask + 1;
+    }
+    return k;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -70,6 +70,26 @@ class Packet { public:
 
     static void static_cleanup();
 
+#if HAVE_CLICK_PACKET_POOL
+    /** @brief Packet pool counters, summed over all threads. */
+    struct PoolStatistics {
+	uint64_t hits;		///< packets and buffers reused from a pool
+	uint64_t misses;	///< packets and buffers newly allocated
+	uint64_t steals;	///< batches taken from other threads
+	uint64_t donations;	///< batches offered to other threads
+	uint64_t frees;		///< packets and buffers released by full pools
+	uint64_t arena_chunks;	///< data arena chunks mapped
+	uint64_t hugepage_chunks; ///< data arena chunks backed by hugepages
+    };
+    enum {
+	pool_arena_numa = 1,	///< carve data buffers from per-node arenas
+	pool_arena_hugepages = 2 ///< back arenas with hugepages if possible
+    };
+    static int set_pool_parameters(uint32_t pool_size, uint32_t buffer_size,
+				   int arena_flags = 0);
+    static void pool_statistics(PoolStatistics &stats);
+#endif
+
     inline void kill();
 
     inline bool shared() const;
@@ -384,6 +404,17 @@ class Packet { public:
     /** @brief Set the packet type annotation. */
     inline void set_packet_type_anno(PacketType t);
 
+#if HAVE_PACKET_TRACE
+    /** @brief Return the packet trace annotation.
+     *
+     * The trace annotation is reserved for PacketTrace.  It is zero for
+     * packets the tracer has not yet seen.  It lives outside the
+     * anno_size-byte annotation area, so no element can overwrite it. */
+    uint32_t trace_anno() const		{ return _aa.trace; }
+    /** @brief Set the packet trace annotation. */
+    void set_trace_anno(uint32_t t)	{ _aa.trace = t; }
+#endif
+
 #if CLICK_NS
     class SimPacketinfoWrapper { public:
 	simclick_simpacketinfo _pinfo;
@@ -726,6 +757,9 @@ class Packet { public:
 	unsigned char *h;
 	PacketType pkt_type;
 	char timestamp[sizeof(Timestamp)];
+# if HAVE_PACKET_TRACE
+	uint32_t trace;		// fills padding on LP64
+# endif
 	Packet *next;
 	Packet *prev;
     };
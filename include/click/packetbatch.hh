@@ -0,0 +1,146 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETBATCH_HH
+#define CLICK_PACKETBATCH_HH
+#include <click/packet.hh>
+CLICK_DECLS
+
+/** @file <click/packetbatch.hh>
+ * @brief A list of packets transferred together between elements.
+ */
+
+/** @class PacketBatch
+ * @brief A FIFO list of packets.
+ *
+ * A PacketBatch links packets through their Packet::next() annotation and
+ * keeps its first packet, last packet, and length.  Element::push_batch()
+ * and Element::pull_batch() use PacketBatches to move several packets over
+ * a connection with a single call.
+ *
+ * A PacketBatch owns the packets it holds.  Passing a batch to
+ * Element::Port::push_batch() relinquishes all of them, and leaves the batch
+ * empty.  To walk a batch without consuming it, use first() and
+ * Packet::next(); the last packet's next() is null.
+ *
+ * @code
+ * PacketBatch batch;
+ * while (batch.count() < 32 && (p = input(0).pull()))
+ *     batch.append(p);
+ * output(0).push_batch(batch);
+ * @endcode
+ */
+class PacketBatch { public:
+
+    /** @brief Construct an empty batch. */
+    PacketBatch()
+	: _head(0), _tail(0), _count(0) {
+    }
+
+    /** @brief Return the first packet, or null if the batch is empty. */
+    Packet *first() const {
+	return _head;
+    }
+
+    /** @brief Return the last packet, or null if the batch is empty. */
+    Packet *last() const {
+	return _tail;
+    }
+
+    /** @brief Return the number of packets in the batch. */
+    unsigned count() const {
+	return _count;
+    }
+
+    /** @brief Return true iff the batch is empty. */
+    bool empty() const {
+	return _count == 0;
+    }
+
+    /** @brief Append @a p to the end of the batch. */
+    inline void append(Packet *p);
+
+    /** @brief Move all of @a x's packets to the end of the batch.
+     *
+     * @a x is left empty. */
+    inline void append(PacketBatch &x);
+
+    /** @brief Remove and return the first packet, or null if the batch is
+     * empty.
+     *
+     * The returned packet's next() annotation is cleared. */
+    inline Packet *pop_front();
+
+    /** @brief Forget all packets without freeing them.
+     *
+     * Call this after handing the packets off individually. */
+    void clear() {
+	_head = _tail = 0;
+	_count = 0;
+    }
+
+    /** @brief Kill every packet in the batch and empty it. */
+    inline void kill();
+
+  private:
+
+    Packet *_head;
+    Packet *_tail;
+    unsigned _count;
+
+    PacketBatch(const PacketBatch &);
+    PacketBatch &operator=(const PacketBatch &);
+
+};
+
+inline void
+PacketBatch::append(Packet *p)
+{
+    p->set_next(0);
+    if (_tail)
+	_tail->set_next(p);
+    else
+	_head = p;
+    _tail = p;
+    ++_count;
+}
+
+inline void
+PacketBatch::append(PacketBatch &x)
+{
+    if (!x._head)
+	return;
+    if (_tail)
+	_tail->set_next(x._head);
+    else
+	_head = x._head;
+    _tail = x._tail;
+    _count += x._count;
+    x.clear();
+}
+
+inline Packet *
+PacketBatch::pop_front()
+{
+    Packet *p = _head;
+    if (p) {
+	_head = p->next();
+	if (!_head)
+	    _tail = 0;
+	--_count;
+	p->set_next(0);
+    }
+    return p;
+}
+
+inline void
+PacketBatch::kill()
+{
+    for (Packet *p = _head; p; ) {
+	Packet *n = p->next();
+	p->kill();
+	p = n;
+    }
+    clear();
+}
+
+CLICK_ENDDECLS
+#endif
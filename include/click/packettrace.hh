@@ -0,0 +1,130 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/packettrace.cc" -*-
+#ifndef CLICK_PACKETTRACE_HH
+#define CLICK_PACKETTRACE_HH
+#if HAVE_PACKET_TRACE
+#include <click/string.hh>
+#include <click/packet.hh>
+CLICK_DECLS
+class Element;
+class Router;
+
+/** @file <click/packettrace.hh>
+ * @brief Sampled packet tracing through the element graph.
+ */
+
+/** @class PacketTrace
+ * @brief Records where sampled packets spend their time.
+ *
+ * When tracing is active, the first connection a packet crosses decides
+ * whether to trace it: one packet in every sample_rate() is given a fresh
+ * trace ID in its trace annotation (Packet::trace_anno()), and the rest are
+ * marked as unsampled.  Every later push or pull of a traced packet appends
+ * a Record, naming the connection and the time, to a ring buffer owned by
+ * the current thread.  When a ring fills, its oldest records are
+ * overwritten.
+ *
+ * Tracing is off by default and costs one predictable branch per transfer,
+ * shared with PerfEvents.  It is controlled with the global "trace_sample"
+ * handler.  The global "trace_dump" handler returns the recorded hops in the
+ * binary format described below; the click-trace2json script converts it to
+ * the Chrome trace event format.
+ *
+ * A dump starts with a 32-byte header: the magic "CLKTRACE", a 32-bit
+ * version (1), the number of elements, a 64-bit record count, the sample
+ * rate, and a reserved word.  The element table follows, with each
+ * element's name and class name as NUL-terminated strings in element index
+ * order.  The records come last, sorted by trace ID and time, each laid out
+ * as a Record.  All integers are in host byte order.
+ */
+class PacketTrace { public:
+
+    enum {
+	UNSAMPLED = 0xFFFFFFFFU,	///< trace annotation of unsampled packets
+	PUSH = 0,
+	PULL = 1,
+	VERSION = 1
+    };
+
+    /** @brief One hop of a traced packet, as stored in a dump. */
+    struct Record {
+	uint64_t time;			///< steady clock, in nanoseconds
+	uint32_t trace;			///< trace ID
+	uint16_t thread;		///< thread that made the transfer
+	uint8_t kind;			///< PUSH or PULL
+	uint8_t reserved;
+	int32_t from;			///< upstream element index
+	int32_t to;			///< downstream element index
+	uint16_t from_port;		///< upstream output port
+	uint16_t to_port;		///< downstream input port
+	uint32_t reserved2;
+    };
+
+    /** @brief Return true iff tracing is active. */
+    static bool active() {
+	return _rate != 0;
+    }
+
+    /** @brief Return the sampling rate, or 0 if tracing is off. */
+    static uint32_t sample_rate() {
+	return _rate;
+    }
+
+    /** @brief Trace one in @a rate packets through @a router.
+     *
+     * A @a rate of 0 turns tracing off.  Only one router is traced at a
+     * time; turning tracing on for @a router stops tracing any other. */
+    static void set_sample_rate(Router *router, uint32_t rate);
+
+    /** @brief Return the traced router, if any. */
+    static Router *traced_router() {
+	return _router;
+    }
+
+    /** @brief Stop tracing @a router, if it is traced. */
+    static void stop(Router *router);
+
+    /** @brief Record @a p crossing a connection.
+     * @param p packet
+     * @param from upstream element
+     * @param from_port upstream output port
+     * @param to downstream element
+     * @param to_port downstream input port
+     * @param kind PUSH or PULL */
+    static inline void hop(Packet *p, const Element *from, int from_port,
+			   const Element *to, int to_port, int kind);
+    /** @brief Record @a first, and the packets linked after it, crossing a
+     * connection. */
+    static void hop_list(Packet *first, const Element *from, int from_port,
+			 const Element *to, int to_port, int kind);
+
+    /** @brief Return the number of hops recorded and not overwritten. */
+    static uint64_t nrecords();
+    /** @brief Return the number of packets sampled. */
+    static uint32_t nsampled();
+
+    /** @brief Return @a router's hops in the binary trace format. */
+    static String dump(Router *router);
+    /** @brief Discard all recorded hops. */
+    static void reset();
+
+  private:
+
+    static volatile uint32_t _rate;
+    static Router *_router;
+
+    static void sampled_hop(Packet *p, const Element *from, int from_port,
+			    const Element *to, int to_port, int kind);
+
+};
+
+inline void
+PacketTrace::hop(Packet *p, const Element *from, int from_port,
+		 const Element *to, int to_port, int kind)
+{
+    if (p->trace_anno() != UNSAMPLED)
+	sampled_hop(p, from, from_port, to, to_port, kind);
+}
+
+CLICK_ENDDECLS
+#endif
+#endif
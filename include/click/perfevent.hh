@@ -0,0 +1,100 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/perfevent.cc" -*-
+#ifndef CLICK_PERFEVENT_HH
+#define CLICK_PERFEVENT_HH
+#if HAVE_PERF_EVENTS
+CLICK_DECLS
+class Element;
+class ErrorHandler;
+class Router;
+class StringAccum;
+
+/** @file <click/perfevent.hh>
+ * @brief Per-element hardware performance counters.
+ */
+
+/** @class PerfEvents
+ * @brief Attributes hardware performance counters to elements.
+ *
+ * When profiling is active, Click reads each thread's cycle, instruction,
+ * last-level cache miss, and branch miss counters when a push or pull enters
+ * an element, and when a task or timer fires.  The difference when the call
+ * returns, less whatever was spent in nested calls, is charged to the element
+ * that was called.  Counters are opened with perf_event_open(2), one group
+ * per thread, and read with rdpmc where the kernel allows it.  If hardware
+ * counters are unavailable, cycles fall back to click_get_cycles() and the
+ * other events read as zero.
+ *
+ * Profiling is off by default and costs one predictable branch per transfer.
+ * It is turned on at run time with the global "perf_profiling" handler.
+ * Each element's "perf" handler reports its counts, and the global
+ * "perf_report" handler lists every profiled element.
+ */
+class PerfEvents { public:
+
+    enum {
+	CYCLES, INSTRUCTIONS, LLC_MISSES, BRANCH_MISSES, NEVENTS
+    };
+    enum {
+	XFER, TASK, TIMER, NKINDS
+    };
+
+    struct Counts {
+	uint64_t calls;
+	uint64_t v[NEVENTS];
+    };
+
+    /** @brief Counts charged to one element, by kind of call. */
+    struct ElementProfile {
+	Counts kind[NKINDS];
+	ElementProfile()		{ clear(); }
+	void clear();
+    };
+
+    /** @brief State saved across one profiled call. */
+    struct Frame {
+	uint64_t start[NEVENTS];
+	uint64_t saved_child[NEVENTS];
+    };
+
+    /** @brief Return true iff profiling is active. */
+    static bool active() {
+	return _active;
+    }
+
+    /** @brief Turn profiling for @a router on or off.
+     *
+     * Turning profiling on allocates a profile for each of @a router's
+     * elements.  Profiling stays active while any router wants it. */
+    static void set_active(Router *router, bool active);
+
+    /** @brief Return the name of event @a e, such as "cycles". */
+    static const char *event_name(int e);
+    /** @brief Return the name of call kind @a k, such as "task". */
+    static const char *kind_name(int k);
+    /** @brief Return true iff event @a e was counted by some thread. */
+    static bool event_available(int e);
+
+    /** @brief Start a profiled call. */
+    static void enter(Frame &f);
+    /** @brief Finish a profiled call, charging element @a e for it. */
+    static void exit(Frame &f, Element *e, int kind);
+    /** @brief Close the calling thread's counters.
+     *
+     * A RouterThread calls this as its driver returns.  The counters reopen
+     * if the thread profiles another call. */
+    static void close_thread();
+
+    static void unparse_element(StringAccum &sa, const Element *e);
+    static void unparse_report(StringAccum &sa, Router *router);
+    static void reset(Router *router);
+
+  private:
+
+    static volatile bool _active;
+    static int _nactive;
+
+};
+
+CLICK_ENDDECLS
+#endif
+#endif
@@ -0,0 +1,114 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_PERTHREAD_HH
+#define CLICK_PERTHREAD_HH
+#include <click/glue.hh>
+CLICK_DECLS
+
+/** @file <click/perthread.hh>
+ * @brief Per-thread copies of a value.
+ */
+
+/** @class PerThread
+ * @brief One copy of a value per thread, each on its own cache lines.
+ *
+ * PerThread keeps click_max_cpu_ids() copies of a value of type T, which
+ * must be a plain data type such as an integer or a struct of integers.
+ * get() returns the calling thread's copy.  Each copy starts on a cache line
+ * boundary and shares its lines with no other copy, so threads updating
+ * their own copies never contend.  PerThread suits statistics that many
+ * threads update and that are read rarely: a reader sums or otherwise
+ * combines all copies, reading other threads' copies without
+ * synchronization.
+ *
+ * If a thread's ID is at least size(), as can happen for threads Click
+ * did not start, it shares a copy with another thread, and concurrent
+ * updates to that copy may be lost.
+ *
+ * initialize() must be called before any thread uses the PerThread.
+ */
+template <typename T>
+class PerThread { public:
+
+    /** @brief Construct a PerThread with no copies. */
+    PerThread()
+	: _mem(0), _slots(0), _n(0) {
+    }
+
+    ~PerThread() {
+	delete[] _mem;
+    }
+
+    /** @brief Allocate @a n copies, each set to T().
+     * @return true on success, false if out of memory */
+    bool initialize(unsigned n = click_max_cpu_ids());
+
+    /** @brief Return the number of copies. */
+    unsigned size() const {
+	return _n;
+    }
+
+    /** @brief Return the calling thread's copy. */
+    T &get() {
+	return _slots[index()].v;
+    }
+
+    /** @brief Return copy @a i. */
+    T &operator[](unsigned i) {
+	return _slots[i].v;
+    }
+
+    /** @brief Return copy @a i. */
+    const T &operator[](unsigned i) const {
+	return _slots[i].v;
+    }
+
+    /** @brief Set every copy to @a x. */
+    void assign(const T &x) {
+	for (unsigned i = 0; i != _n; ++i)
+	    _slots[i].v = x;
+    }
+
+  private:
+
+    union Slot {
+	T v;
+	char pad[((sizeof(T) + CLICK_CACHE_LINE_SIZE - 1) / CLICK_CACHE_LINE_SIZE)
+		 * CLICK_CACHE_LINE_SIZE];
+    };
+
+    char *_mem;
+    Slot *_slots;
+    unsigned _n;
+
+    unsigned index() const {
+	unsigned i = click_current_cpu_id();
+	if (unlikely(i >= _n))
+	    i %= _n;
+	return i;
+    }
+
+    PerThread(const PerThread<T> &);
+    PerThread<T> &operator=(const PerThread<T> &);
+
+};
+
+template <typename T>
+bool
+PerThread<T>::initialize(unsigned n)
+{
+    if (n == 0)
+	n = 1;
+    char *mem = new char[n * sizeof(Slot) + CLICK_CACHE_LINE_SIZE];
+    if (!mem)
+	return false;
+    delete[] _mem;
+    _mem = mem;
+    uintptr_t x = reinterpret_cast<uintptr_t>(mem) + CLICK_CACHE_LINE_SIZE - 1;
+    _slots = reinterpret_cast<Slot *>(x & ~(uintptr_t) (CLICK_CACHE_LINE_SIZE - 1));
+    _n = n;
+    assign(T());
+    return true;
+}
+
+CLICK_ENDDECLS
+#endif
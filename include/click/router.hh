@@ -107,6 +107,15 @@ class Router { public:
     void unparse_connections(StringAccum& sa, const String& indent = String()) const;
 
     String element_ports_string(const Element *e) const;
+
+    // LOAD PROFILE
+    enum {
+        LOAD_LEX, LOAD_BUILD, LOAD_CHECK, LOAD_CONFIGURE, LOAD_HANDLERS,
+        LOAD_INITIALIZE, NLOAD_PHASES
+    };
+    inline const Timestamp &load_time(int phase) const;
+    inline void add_load_time(int phase, const Timestamp &t);
+    static const char *load_phase_name(int phase);
     //@}
 
     // INITIALIZATION
@@ -295,6 +304,7 @@ class Router { public:
     mutable NameInfo* _name_info;
     Vector<int> _flow_code_override_eindex;
     Vector<String> _flow_code_override;
+    Timestamp _load_time[NLOAD_PHASES];
 
     Router* _next_router;
 
@@ -508,6 +518,27 @@ Router::please_stop_driver()
     adjust_runcount(-1);
 }
 
+/** @brief  Return the time spent in load phase @a phase.
+ *
+ *  Phases are LOAD_LEX (parsing the configuration text and expanding
+ *  compounds), LOAD_BUILD (creating elements and connections), LOAD_CHECK
+ *  (checking connections), LOAD_CONFIGURE, LOAD_HANDLERS, and
+ *  LOAD_INITIALIZE.  The global "load_profile" handler reports them all. */
+inline const Timestamp &
+Router::load_time(int phase) const
+{
+    assert(phase >= 0 && phase < NLOAD_PHASES);
+    return _load_time[phase];
+}
+
+/** @brief  Charge @a t to load phase @a phase. */
+inline void
+Router::add_load_time(int phase, const Timestamp &t)
+{
+    assert(phase >= 0 && phase < NLOAD_PHASES);
+    _load_time[phase] += t;
+}
+
 /** @brief Returns the overriding flow code for element @a e, if any.
  *  @param eindex element index
  *  @return The flow code, or null if none has been set. */
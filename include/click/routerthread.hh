@@ -51,6 +51,9 @@ class RouterThread { public:
 
     inline void schedule_block_tasks();
     inline void block_tasks(bool scheduled);
+#if CLICK_USERLEVEL
+    inline bool block_tasks_until(const Timestamp &deadline);
+#endif
     inline void unblock_tasks();
 
     inline bool stop_flag() const;
@@ -80,6 +83,33 @@ class RouterThread { public:
     inline void run_signals();
 #endif
 
+#if HAVE_MULTITHREAD
+    /** @brief Return the number of tasks this thread has stolen. */
+    uint64_t steals() const             { return _steals; }
+    /** @brief Return the number of times this thread looked for a task to
+     * steal. */
+    uint64_t steal_attempts() const     { return _steal_attempts; }
+    /** @brief Return the number of tasks that have left this thread for
+     * another, whether stolen or moved with Task::move_thread(). */
+    uint64_t migrations() const         { return _migrations; }
+    void reset_steal_counts();
+#endif
+
+    /** @brief Return the number of tasks this thread took from its pending
+     * queue, typically because other threads scheduled or moved them. */
+    uint64_t pending_tasks() const      { return _pending_tasks; }
+    /** @brief Return the number of times this thread drained a nonempty
+     * pending queue. */
+    uint64_t pending_batches() const    { return _pending_batches; }
+    /** @brief Return the total cycles between a pending queue becoming
+     * nonempty and this thread draining it. */
+    uint64_t pending_wait_cycles() const { return _pending_wait_cycles; }
+    /** @brief Return the longest such wait, in cycles. */
+    click_cycles_t pending_wait_max_cycles() const {
+        return _pending_wait_max_cycles;
+    }
+    void reset_pending_counts();
+
     enum { S_PAUSED, S_BLOCKED, S_TIMERWAIT,
            S_LOCKSELECT, S_LOCKTASKS,
            S_RUNTASK, S_RUNTIMER, S_RUNSIGNAL, S_RUNPENDING, S_RUNSELECT,
@@ -149,9 +179,11 @@ class RouterThread { public:
     atomic_uint32_t _task_blocker;
     atomic_uint32_t _task_blocker_waiting;
 
-    Task::Pending _pending_head;
-    Task::Pending *_pending_tail;
-    SpinlockIRQ _pending_lock;
+    // Lock-free multi-producer, single-consumer stack of pending tasks,
+    // linked through Task::_pending_nextptr; 2 marks the bottom.  The owner
+    // takes the whole stack at once and reverses it.
+    Task::Pending _pending_head CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
+    click_cycles_t _pending_since;
 
     // SHARED STATE GROUP
     Master *_master CLICK_ALIGNED(CLICK_CACHE_LINE_SIZE);
@@ -172,6 +204,29 @@ class RouterThread { public:
     unsigned _iters_per_os;
   private:
 
+    // PENDING STATISTICS (written only by this thread)
+    uint64_t _pending_tasks;
+    uint64_t _pending_batches;
+    uint64_t _pending_wait_cycles;
+    click_cycles_t _pending_wait_max_cycles;
+
+#if HAVE_MULTITHREAD
+    // WORK STEALING
+    // Tasks this thread offers to idle threads. Only this thread stores
+    // tasks into empty slots, under _steal_lock; anyone may empty a slot
+    // with a compare-and-swap. A thief publishes the task it is claiming in
+    // _steal_hazard so Task::cleanup() can wait for it.
+    enum { STEAL_SLOTS = 16 };
+    Task * volatile _steal_slots[STEAL_SLOTS];
+    Task * volatile _steal_hazard;
+    Spinlock _steal_lock;
+    volatile bool _steal_idle;
+    int _steal_victim;
+    uint64_t _steals;
+    uint64_t _steal_attempts;
+    uint64_t _migrations;
+#endif
+
 #if CLICK_NS
     Timestamp _ns_scheduled;
     Timestamp _ns_last_active;
@@ -207,6 +262,8 @@ class RouterThread { public:
 
     // task requests
     inline void add_pending();
+    void push_pending(Task *t);
+    void remove_pending(Task *t);
 #if HAVE_STRIDE_SCHED
     inline unsigned pass() const {
 # if HAVE_TASK_HEAP
@@ -228,6 +285,11 @@ class RouterThread { public:
     inline void run_tasks(int ntasks);
     inline void process_pending();
     inline void run_os();
+#if HAVE_MULTITHREAD
+    void publish_stealable_tasks();
+    bool steal_task();
+    void unpublish_task(Task *t);
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     void client_set_tickets(int client, int tickets);
     inline void client_update_pass(int client, const Timestamp &before);
@@ -424,6 +486,34 @@ RouterThread::block_tasks(bool scheduled)
     --_task_blocker_waiting;
 }
 
+#if CLICK_USERLEVEL
+/** @brief Block tasks as block_tasks(false) does, but give up at the steady
+ * time @a deadline.
+ *
+ * Returns true iff tasks are blocked, in which case the caller must call
+ * unblock_tasks().  A thread running a task that never yields cannot be
+ * blocked, so this returns false once @a deadline passes. */
+inline bool
+RouterThread::block_tasks_until(const Timestamp &deadline)
+{
+    assert(!current_thread_is_running());
+    ++_task_blocker_waiting;
+    bool blocked = false;
+    for (unsigned n = 1; ; ++n) {
+        uint32_t blocker = _task_blocker.value();
+        if ((int32_t) blocker >= 0
+            && _task_blocker.compare_swap(blocker, blocker + 1) == blocker) {
+            blocked = true;
+            break;
+        }
+        if (n % 1024 == 0 && Timestamp::now_steady() >= deadline)
+            break;
+    }
+    --_task_blocker_waiting;
+    return blocked;
+}
+#endif
+
 inline void
 RouterThread::unblock_tasks()
 {
@@ -7,7 +7,7 @@
 #include <click/vector.hh>
 #include <click/sync.hh>
 #include <unistd.h>
-#if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE
+#if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE && !HAVE_ALLOW_EPOLL
 # define HAVE_ALLOW_SELECT 1
 #endif
 #if defined(__APPLE__) && HAVE_ALLOW_SELECT && HAVE_ALLOW_POLL
@@ -18,16 +18,22 @@
 # include <poll.h>
 #else
 # undef HAVE_ALLOW_POLL
-# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_KQUEUE
+# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_KQUEUE && !HAVE_ALLOW_EPOLL
 #  error "poll is not supported on this system, try --enable-select"
 # endif
 #endif
 #if !HAVE_SYS_EVENT_H || !HAVE_KQUEUE
 # undef HAVE_ALLOW_KQUEUE
-# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL
+# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_EPOLL
 #  error "kqueue is not supported on this system, try --enable-select"
 # endif
 #endif
+#if !HAVE_SYS_EPOLL_H
+# undef HAVE_ALLOW_EPOLL
+# if !HAVE_ALLOW_SELECT && !HAVE_ALLOW_POLL && !HAVE_ALLOW_KQUEUE
+#  error "epoll is not supported on this system, try --enable-select"
+# endif
+#endif
 CLICK_DECLS
 class Element;
 class Router;
@@ -44,15 +50,32 @@ class SelectSet { public:
     int remove_select(int fd, Element *element, int mask);
 
     void run_selects(RouterThread *thread);
-    inline void wake_immediate() {
-	_wake_pipe_pending = true;
-	ignore_result(write(_wake_pipe[1], "", 1));
+    inline void wake_immediate();
+
+    /** @brief Return the number of wakeups written to the wake pipe.
+     *
+     * Wakeups issued while an earlier one is still undelivered are not
+     * written, and so not counted. */
+    uint64_t doorbells() const {
+	return _doorbells;
     }
 
     void kill_router(Router *router);
 
     inline void fence();
 
+#if HAVE_ALLOW_EPOLL
+    /** @brief Return true iff this SelectSet waits with epoll.
+     *
+     * Where available, epoll is used automatically.  A SelectSet falls back
+     * to poll() or select() if some file descriptor cannot be used with
+     * epoll, such as a regular file. */
+    bool epoll() const {
+	return _epoll >= 0;
+    }
+    void set_epoll(bool epoll);
+#endif
+
   private:
 
     struct SelectorInfo {
@@ -65,11 +88,15 @@ class SelectSet { public:
 	}
     };
 
-    int _wake_pipe[2];
+    int _wake_pipe[2];		// both ends are one eventfd, if available
     volatile bool _wake_pipe_pending;
+    uint64_t _doorbells;
 #if HAVE_ALLOW_KQUEUE
     int _kqueue;
 #endif
+#if HAVE_ALLOW_EPOLL
+    int _epoll;
+#endif
 #if !HAVE_ALLOW_POLL
     struct pollfd {
 	int fd;
@@ -88,11 +115,18 @@ class SelectSet { public:
 
     void register_select(int fd, bool add_read, bool add_write);
     void remove_pollfd(int pi, int event);
-    inline void call_selected(int fd, int mask) const;
+#if HAVE_ALLOW_EPOLL
+    void epoll_update(int fd, int old_events, int new_events);
+#endif
+    void drain_wake_pipe();
+    inline void call_selected(int fd, int mask);
     inline bool post_select(RouterThread *thread, bool acquire);
 #if HAVE_ALLOW_KQUEUE
     void run_selects_kqueue(RouterThread *thread);
 #endif
+#if HAVE_ALLOW_EPOLL
+    void run_selects_epoll(RouterThread *thread);
+#endif
 #if HAVE_ALLOW_POLL
     void run_selects_poll(RouterThread *thread);
 #else
@@ -108,6 +142,23 @@ class SelectSet { public:
 
 };
 
+inline void
+SelectSet::wake_immediate()
+{
+    // The caller's changes must be visible before we test the flag;
+    // post_select() clears the flag before looking for work.
+    click_fence();
+    if (!_wake_pipe_pending) {
+	_wake_pipe_pending = true;
+#if HAVE_SYS_EVENTFD_H
+	uint64_t one = 1;
+	ignore_result(write(_wake_pipe[1], &one, sizeof(one)));
+#else
+	ignore_result(write(_wake_pipe[1], "", 1));
+#endif
+    }
+}
+
 inline void
 SelectSet::lock()
 {
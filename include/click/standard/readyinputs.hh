@@ -0,0 +1,239 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_READYINPUTS_HH
+#define CLICK_READYINPUTS_HH
+#include <click/element.hh>
+#include <click/notifier.hh>
+#include <click/atomic.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+/** @class ReadyInputs
+ * @brief Tracks which inputs of a pull scheduler might have packets.
+ *
+ * ReadyInputs keeps one bit per input of a pull element.  An input's bit is
+ * set while the input might produce a packet.  The element clears the bit,
+ * using idle(), after the input's pull fails and its empty notifier has gone
+ * to sleep.  The notifier's wake callback sets the bit again.  next() finds
+ * the next ready input with find-first-set on the bitmap and on a summary
+ * word of nonempty bitmap words, so the cost of a scheduling decision does
+ * not grow with the number of idle inputs.
+ *
+ * Bits change with atomic operations, and only when an input goes idle or
+ * wakes up, so any number of threads may pull from the element, and wake
+ * callbacks may run on any thread.
+ *
+ * An input with no empty notifier has a busy signal, which never goes to
+ * sleep, so its bit stays set.
+ *
+ * Elements that keep other per-input state for ready inputs, such as a
+ * heap, can also learn which inputs woke up: any_woken() says whether any
+ * did since the last clear_woken(), and take_woken() returns and clears
+ * them a word at a time.
+ */
+class ReadyInputs { public:
+
+    ReadyInputs()
+	: _n(0), _nwords(0), _nsummary(0), _bits(0), _summary(0),
+	  _woken(0), _dependent(0) {
+	_woken_any = 0;
+    }
+
+    ~ReadyInputs() {
+	delete[] _bits;
+	delete[] _summary;
+	delete[] _woken;
+    }
+
+    /** @brief Look up the empty signals of @a e's inputs and mark every
+     * input ready.
+     * @param dependent notifier to wake, as well, when an input wakes up
+     * @return 0 on success, -ENOMEM if out of memory */
+    inline int initialize(Element *e, Notifier *dependent = 0);
+
+    /** @brief Return the number of inputs. */
+    int size() const {
+	return _n;
+    }
+
+    /** @brief Return input @a i's empty signal. */
+    const NotifierSignal &signal(int i) const {
+	return _ports[i].signal;
+    }
+
+    /** @brief Return true iff input @a i is ready. */
+    bool test(int i) const {
+	return _bits[i / word_bits].value() & (1U << (i % word_bits));
+    }
+
+    /** @brief Return true iff no input is ready. */
+    bool empty() const {
+	for (int s = 0; s < _nsummary; ++s)
+	    if (_summary[s].value())
+		return false;
+	return true;
+    }
+
+    /** @brief Mark input @a i ready. */
+    inline void set(int i);
+
+    /** @brief Mark input @a i not ready if its signal is inactive.
+     * @return true if the input was marked not ready
+     *
+     * Call after a pull from input @a i has failed. */
+    inline bool idle(int i);
+
+    /** @brief Return the first ready input at or after @a i, or -1. */
+    inline int next(int i) const;
+
+    /** @brief Return the first ready input at or after @a i, wrapping
+     * around to input 0, or -1 if no input is ready. */
+    int next_cyclic(int i) const {
+	int j = next(i);
+	return (j >= 0 || i == 0 ? j : next(0));
+    }
+
+    enum { word_bits = 32 };
+
+    /** @brief Return the number of bitmap words. */
+    int nwords() const {
+	return _nwords;
+    }
+
+    /** @brief Return true iff some input woke up since the last
+     * clear_woken(). */
+    bool any_woken() const {
+	return _woken_any.value();
+    }
+
+    /** @brief Forget that inputs woke up; call before take_woken(). */
+    void clear_woken() {
+	_woken_any = 0;
+    }
+
+    /** @brief Return and clear word @a w of the woken-input bitmap.
+     *
+     * Bit I<b> of the result stands for input @a w * word_bits + I<b>. */
+    uint32_t take_woken(int w) {
+	return _woken[w].value() ? _woken[w].swap(0) : 0;
+    }
+
+  private:
+
+    struct port {
+	ReadyInputs *owner;
+	int index;
+	NotifierSignal signal;
+    };
+
+    int _n;
+    int _nwords;
+    int _nsummary;
+    Vector<port> _ports;
+    atomic_uint32_t *_bits;	// one bit per input
+    atomic_uint32_t *_summary;	// one bit per nonzero word of _bits
+    atomic_uint32_t *_woken;	// inputs that woke since take_woken()
+    atomic_uint32_t _woken_any;
+    Notifier *_dependent;
+
+    static void wake(void *user_data, Notifier *);
+
+};
+
+inline int
+ReadyInputs::initialize(Element *e, Notifier *dependent)
+{
+    _n = e->ninputs();
+    _nwords = (_n + word_bits - 1) / word_bits;
+    _nsummary = (_nwords + word_bits - 1) / word_bits;
+    _ports.resize(_n);
+    if (!(_bits = new atomic_uint32_t[_nwords ? _nwords : 1])
+	|| !(_summary = new atomic_uint32_t[_nsummary ? _nsummary : 1])
+	|| !(_woken = new atomic_uint32_t[_nwords ? _nwords : 1]))
+	return -ENOMEM;
+    for (int w = 0; w < _nwords; ++w) {
+	_bits[w] = 0;
+	_woken[w] = 0;
+    }
+    for (int s = 0; s < _nsummary; ++s)
+	_summary[s] = 0;
+    _dependent = dependent;
+    for (int i = 0; i < _n; ++i) {
+	_ports[i].owner = this;
+	_ports[i].index = i;
+	_ports[i].signal = Notifier::upstream_empty_signal(e, i, wake, &_ports[i]);
+	set(i);
+    }
+    return 0;
+}
+
+inline void
+ReadyInputs::wake(void *user_data, Notifier *)
+{
+    port *p = static_cast<port *>(user_data);
+    ReadyInputs *ri = p->owner;
+    ri->set(p->index);
+    ri->_woken[p->index / word_bits] |= 1U << (p->index % word_bits);
+    ri->_woken_any = 1;
+    if (ri->_dependent)
+	ri->_dependent->wake();
+}
+
+inline void
+ReadyInputs::set(int i)
+{
+    // Set the input's bit before its summary bit; idle() relies on it.
+    int w = i / word_bits;
+    if (!(_bits[w].value() & (1U << (i % word_bits))))
+	_bits[w] |= 1U << (i % word_bits);
+    if (!(_summary[w / word_bits].value() & (1U << (w % word_bits))))
+	_summary[w / word_bits] |= 1U << (w % word_bits);
+}
+
+inline bool
+ReadyInputs::idle(int i)
+{
+    if (_ports[i].signal)
+	return false;
+    int w = i / word_bits;
+    _bits[w] &= ~(1U << (i % word_bits));
+    if (!_bits[w].value()) {
+	_summary[w / word_bits] &= ~(1U << (w % word_bits));
+	// Another input in the word may have been set meanwhile.
+	if (_bits[w].value())
+	    set(w * word_bits + ffs_lsb(_bits[w].value()) - 1);
+    }
+    // The input may have woken after we checked its signal, but before
+    // its bit was cleared.
+    if (_ports[i].signal) {
+	set(i);
+	return false;
+    }
+    return true;
+}
+
+inline int
+ReadyInputs::next(int i) const
+{
+    if (i >= _n)
+	return -1;
+    int w = i / word_bits;
+    uint32_t bits = _bits[w].value() & (~0U << (i % word_bits));
+    while (!bits) {
+	// find the next nonzero word through the summary
+	if (++w >= _nwords)
+	    return -1;
+	int s = w / word_bits;
+	uint32_t sbits = _summary[s].value() & (~0U << (w % word_bits));
+	while (!sbits) {
+	    if (++s >= _nsummary)
+		return -1;
+	    sbits = _summary[s].value();
+	}
+	w = s * word_bits + ffs_lsb(sbits) - 1;
+	bits = _bits[w].value();
+    }
+    return w * word_bits + ffs_lsb(bits) - 1;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -3,8 +3,8 @@
 #define CLICK_STORAGE_HH
 #include <click/machine.hh>
 #include <click/atomic.hh>
+#include <click/packetbatch.hh>
 CLICK_DECLS
-class Packet;
 
 class Storage { public:
 
@@ -38,6 +38,10 @@ class Storage { public:
     inline void set_tail_acquire(index_type t); // acquire barrier (LIFO)
     inline index_type reserve_tail_atomic();
 
+    inline unsigned enq_burst(Packet* volatile* q, PacketBatch& batch);
+    inline unsigned deq_burst(Packet* volatile* q, unsigned max,
+			      PacketBatch& batch);
+
     static inline void packet_memory_barrier(Packet* volatile& packet,
                                              volatile index_type& index)
         __attribute__((deprecated));
@@ -107,6 +111,59 @@ Storage::reserve_tail_atomic()
     return t;
 }
 
+/** @brief Move packets from the front of @a batch into the ring @a q.
+ * @return the number of packets moved
+ *
+ * Stores packets at the tail until @a batch is empty or the ring is full,
+ * then publishes them all with a single set_tail(). Packets that did not
+ * fit stay in @a batch. Only one thread at a time may enqueue. */
+inline unsigned
+Storage::enq_burst(Packet* volatile* q, PacketBatch& batch)
+{
+    index_type h = _head, t = _tail;
+    unsigned n = 0;
+    while (!batch.empty()) {
+	index_type nt = next_i(t);
+	if (nt == h && (h = _head) == nt)
+	    break;
+	q[t] = batch.pop_front();
+	t = nt;
+	++n;
+    }
+    if (n)
+	set_tail(t);
+    return n;
+}
+
+/** @brief Move up to @a max packets from the head of the ring @a q onto
+ * the end of @a batch.
+ * @return the number of packets moved
+ *
+ * Frees all the slots with a single set_head(). While it walks the ring,
+ * deq_burst() prefetches each following packet and the header data of each
+ * packet it takes, so the caller's first touch of a packet is likely to hit
+ * the cache. Only one thread at a time may dequeue. */
+inline unsigned
+Storage::deq_burst(Packet* volatile* q, unsigned max, PacketBatch& batch)
+{
+    index_type h = _head, t = _tail;
+    unsigned n = 0;
+    if (h != t && max)
+	click_prefetch(q[h]);
+    while (h != t && n < max) {
+	Packet* p = q[h];
+	h = next_i(h);
+	if (h != t && n + 1 < max)
+	    click_prefetch(q[h]);
+	click_prefetch(p->data());
+	batch.append(p);
+	++n;
+    }
+    if (n)
+	set_head(h);
+    return n;
+}
+
 inline void
 Storage::packet_memory_barrier(Packet* volatile& packet, volatile index_type& index)
 {
@@ -6,11 +6,13 @@ CLICK_DECLS
 class ThreadSched { public:
 
     enum { THREAD_QUIESCENT = -1, THREAD_UNKNOWN = -1000 };
+    enum { STEAL_UNKNOWN = -1, STEAL_NEVER = 0, STEAL_ALLOWED = 1 };
 
     ThreadSched()			{ }
     virtual ~ThreadSched()		{ }
 
     virtual int initial_home_thread_id(const Element *e);
+    virtual int initial_steal_policy(const Element *e);
 
 };
 
@@ -274,6 +274,26 @@ class Task : private TaskLink { public:
      */
     void move_thread(int new_thread_id);
 
+#if HAVE_MULTITHREAD
+    /** @brief Return true iff an idle thread may steal this task.
+     *
+     * Stealing only happens when the router has a WorkStealingSched. A task
+     * is initially stealable if its ThreadSched chain allows stealing for
+     * its element and the task was not given an explicit home with
+     * move_thread() before initialize(). */
+    inline bool stealable() const {
+        return _stealable;
+    }
+
+    /** @brief Set whether an idle thread may steal this task.
+     *
+     * Elements whose task must stay on one thread, for instance because it
+     * touches thread-local state, should call set_stealable(false). */
+    inline void set_stealable(bool stealable) {
+        _stealable = stealable;
+    }
+#endif
+
 
 #if HAVE_STRIDE_SCHED
     inline int tickets() const;
@@ -330,6 +350,7 @@ class Task : private TaskLink { public:
 #if HAVE_MULTITHREAD
     DirectEWMA _cycles;
     unsigned _cycle_runs;
+    bool _stealable;
 #endif
 
     RouterThread *_thread;
@@ -360,6 +381,9 @@ class Task : private TaskLink { public:
 
     void add_pending(bool always);
     void process_pending(RouterThread* thread);
+#if HAVE_MULTITHREAD
+    bool steal(int victim_thread_id, int new_thread_id);
+#endif
 
     void complete_schedule(RouterThread* process_pending_thread);
     inline void remove_from_scheduled_list();
@@ -391,7 +415,7 @@ Task::Task(TaskCallback f, void *user_data)
       _runs(0), _work_done(0),
 #endif
 #if HAVE_MULTITHREAD
-      _cycle_runs(0),
+      _cycle_runs(0), _stealable(false),
 #endif
       _thread(0), _owner(0)
 {
@@ -414,7 +438,7 @@ Task::Task(Element* e)
       _runs(0), _work_done(0),
 #endif
 #if HAVE_MULTITHREAD
-      _cycle_runs(0),
+      _cycle_runs(0), _stealable(false),
 #endif
       _thread(0), _owner(0)
 {
@@ -578,12 +602,23 @@ Task::fire()
 #endif
 #if HAVE_MULTITHREAD
     _cycle_runs++;
+#endif
+#if HAVE_PERF_EVENTS
+    PerfEvents::Frame frame;
+    Element *owner = _owner;    // the callback may delete the task
+    bool profiled = PerfEvents::active();
+    if (unlikely(profiled))
+        PerfEvents::enter(frame);
 #endif
     bool work_done;
     if (!_hook)
         work_done = ((Element*)_thunk)->run_task(this);
     else
         work_done = _hook(this, _thunk);
+#if HAVE_PERF_EVENTS
+    if (unlikely(profiled))
+        PerfEvents::exit(frame, owner, PerfEvents::TASK);
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     ++_runs;
     _work_done += work_done;
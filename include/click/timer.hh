@@ -346,6 +346,8 @@ class Timer { public:
     void *_thunk;
     Element *_owner;
     RouterThread *_thread;
+    Timer *_wheel_next;			// valid only in a TimerSet wheel
+    Timer **_wheel_pprev;
 
     Timer &operator=(const Timer &x);
 
@@ -12,6 +12,7 @@ class Timer;
 class TimerSet { public:
 
     TimerSet();
+    ~TimerSet();
 
     Timestamp timer_expiry_steady() const	{ return _timer_expiry; }
     inline Timestamp timer_expiry_steady_adjusted() const;
@@ -25,6 +26,9 @@ class TimerSet { public:
     unsigned timer_stride() const		{ return _timer_stride; }
     void set_max_timer_stride(unsigned timer_stride);
 
+    bool timer_wheel() const			{ return _wheel != 0; }
+    void set_timer_wheel(bool wheel);
+
     void kill_router(Router *router);
 
     void run_timers(RouterThread *thread, Master *master);
@@ -71,6 +75,24 @@ class TimerSet { public:
     Timestamp _timer_check;
     uint32_t _timer_check_reports;
 
+    // Optional hierarchical timing wheel with millisecond ticks.  Timers
+    // due at least one tick in the future, and less than wheel_span ticks
+    // away, wait in the wheel, where scheduling and unscheduling are O(1).
+    // As each tick comes due, its timers move to the heap, which keeps
+    // their exact expiry order.
+    enum {
+	wheel_bits0 = 8, wheel_bits = 6, wheel_levels = 4,
+	wheel_size0 = 1 << wheel_bits0, wheel_size = 1 << wheel_bits,
+	wheel_nslots = wheel_size0 + (wheel_levels - 1) * wheel_size,
+	wheel_span = 1 << (wheel_bits0 + (wheel_levels - 1) * wheel_bits)
+    };
+    enum { schedpos_wheel = -0x7FFFFFFF };
+    Timer **_wheel;
+    Timestamp::value_type _wheel_tick;	// next tick to process
+    unsigned _wheel_count;
+    Timestamp _wheel_expiry;		// no wheel timer expires before this
+    uint64_t _wheel_bitmap0[wheel_size0 / 64];
+
     inline void run_one_timer(Timer *);
 
     void set_timer_expiry() {
@@ -78,9 +100,19 @@ class TimerSet { public:
 	    _timer_expiry = _timer_heap.unchecked_at(0).expiry_s;
 	else
 	    _timer_expiry = Timestamp();
+	if (_wheel_count && (!_timer_expiry || _wheel_expiry < _timer_expiry))
+	    _timer_expiry = _wheel_expiry;
     }
     void check_timer_expiry(Timer *t);
 
+    void heap_insert(Timer *t);
+    bool wheel_insert(Timer *t);
+    bool wheel_schedule(Timer *t);
+    void wheel_remove(Timer *t);
+    void wheel_advance(Timestamp::value_type tick);
+    void set_wheel_expiry();
+    void wheel_next_timer();
+
     inline void lock_timers();
     inline bool attempt_lock_timers();
     inline void unlock_timers();
@@ -153,6 +185,8 @@ inline Timer *
 TimerSet::next_timer()
 {
     lock_timers();
+    if (_wheel_count)
+	wheel_next_timer();
     Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
     unlock_timers();
     return t;
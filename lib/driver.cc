@@ -48,6 +48,11 @@
 # include <click/lexer.hh>
 #endif
 
+#if CLICK_USERLEVEL
+# include <click/md5.h>
+# include <click/variableenv.hh>
+#endif
+
 #if CLICK_USERLEVEL || CLICK_MINIOS
 # include <click/master.hh>
 # include <click/notifier.hh>
@@ -480,6 +485,57 @@ click_static_cleanup()
 # endif /* HAVE_DYNAMIC_LINKING */
 }
 
+#if CLICK_USERLEVEL
+static String config_cache_dir;
+
+void
+click_set_config_cache(const String &dir)
+{
+    config_cache_dir = dir;
+}
+
+// The cache key covers everything that affects parsing: the driver version,
+// the file name (which appears in landmarks), global definitions from the
+// command line, and the configuration text.
+static String
+config_cache_filename(Lexer *l, const String &filename, const String &config)
+{
+    md5_state_t pms;
+    md5_init(&pms);
+    StringAccum sa;
+    sa << "click " << CLICK_VERSION << '\0' << filename << '\0';
+    VariableEnvironment &scope = l->global_scope();
+    for (int i = 0; i < scope.size(); ++i)
+        sa << scope.name(i) << '=' << scope.value(i) << '\0';
+    md5_append(&pms, (const unsigned char *) sa.data(), sa.length());
+    md5_append(&pms, (const unsigned char *) config.data(), config.length());
+    unsigned char digest[16];
+    md5_finish(&pms, digest);
+    md5_free(&pms);
+
+    sa.clear();
+    sa << config_cache_dir << '/';
+    for (int i = 0; i < 16; ++i)
+        sa.snprintf(3, "%02x", digest[i]);
+    sa << ".graph";
+    return sa.take_string();
+}
+
+static void
+write_config_cache(const String &cache_file, const String &graph)
+{
+    // write to a temporary file and rename it, so concurrent readers never
+    // see a partial graph
+    String tmp_file = cache_file + ".tmp" + String(getpid());
+    if (FILE *f = fopen(tmp_file.c_str(), "wb")) {
+        bool ok = fwrite(graph.data(), 1, graph.length(), f) == (size_t) graph.length();
+        ok = (fclose(f) == 0) && ok;
+        if (!ok || rename(tmp_file.c_str(), cache_file.c_str()) != 0)
+            unlink(tmp_file.c_str());
+    }
+}
+#endif
+
 Router *
 click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initialize, Master *master)
 {
@@ -517,14 +573,47 @@ click_read_router(String filename, bool is_expr, ErrorHandler *errh, bool initia
         }
     }
 
-    // lex
+    if (!master)
+        master = new Master(1);
     Lexer *l = click_lexer();
     RequireLexerExtra lextra(&archive);
-    int cookie = l->begin_parse(config_str, filename, &lextra, errh);
-    while (!l->ydone())
-        l->ystep();
-    Router *router = l->create_router(master ? master : new Master(1));
-    l->end_parse(cookie);
+    Router *router = 0;
+
+#if CLICK_USERLEVEL
+    // try the flat graph cache
+    String cache_file;
+    if (config_cache_dir && !archive.size()) {
+        Timestamp read_start = Timestamp::now_steady();
+        cache_file = config_cache_filename(l, filename, config_str);
+        String graph = file_string(cache_file, ErrorHandler::silent_handler());
+        Timestamp build_start = Timestamp::now_steady();
+        if (graph
+            && (router = l->create_router_from_graph(config_str, graph, master, &lextra, errh))) {
+            router->add_load_time(Router::LOAD_LEX, build_start - read_start);
+            router->add_load_time(Router::LOAD_BUILD, Timestamp::now_steady() - build_start);
+        }
+    }
+#endif
+
+    // lex
+    if (!router) {
+        Timestamp lex_start = Timestamp::now_steady();
+        int cookie = l->begin_parse(config_str, filename, &lextra, errh);
+        while (!l->ydone())
+            l->ystep();
+        Timestamp build_start = Timestamp::now_steady();
+        StringAccum graph;
+        router = l->create_router(master, &graph);
+        l->end_parse(cookie);
+        if (router) {
+            router->add_load_time(Router::LOAD_LEX, build_start - lex_start);
+            router->add_load_time(Router::LOAD_BUILD, Timestamp::now_steady() - build_start);
+        }
+#if CLICK_USERLEVEL
+        if (router && cache_file && graph.length() && errh->nerrors() == before)
+            write_config_cache(cache_file, graph.take_string());
+#endif
+    }
 
     // initialize if requested
     if (initialize)
@@ -31,6 +31,7 @@
 #include <click/master.hh>
 #include <click/straccum.hh>
 #include <click/etheraddress.hh>
+#include <click/packettrace.hh>
 #if CLICK_DEBUG_SCHEDULING
 # include <click/notifier.hh>
 #endif
@@ -426,11 +427,17 @@ Element::Element()
 #if CLICK_STATS >= 2
     reset_cycles();
 #endif
+#if HAVE_PERF_EVENTS
+    _perf = 0;
+#endif
 }
 
 Element::~Element()
 {
     nelements_allocated--;
+#if HAVE_PERF_EVENTS
+    delete _perf;
+#endif
     if (_ports[0] < _inline_ports || _ports[0] > _inline_ports + INLINE_PORTS)
 	delete[] _ports[0];
     if (_ports[1] < _inline_ports || _ports[1] > _inline_ports + INLINE_PORTS)
@@ -1214,6 +1221,11 @@ Element::processing_vector(int* in_v, int* out_v, ErrorHandler* errh) const
  * RoundRobinSched has 0 inputs, are idle rather than busy, and waste no
  * CPU time.</dd>
  *
+ * <dt><tt>Y0</tt></dt> <dd>This element's task, once running, never returns
+ * to its thread's scheduler, so no other task on that thread runs again.
+ * Elements that place work on other threads, such as RunSchedule, use this
+ * flag to avoid those threads.</dd>
+ *
  * </dl>
  */
 const char*
@@ -2089,6 +2101,144 @@ Element::write_cycles_handler(const String &, Element *e, void *, ErrorHandler *
 }
 #endif
 
+#if HAVE_PERF_EVENTS
+String
+Element::read_perf_handler(Element *e, void *)
+{
+    StringAccum sa;
+    PerfEvents::unparse_element(sa, e);
+    return sa.take_string();
+}
+
+int
+Element::write_perf_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+    if (e->_perf)
+	e->_perf->clear();
+    return 0;
+}
+#endif
+
+#if CLICK_PORT_HOOKS
+volatile int Element::Port::_hooks;
+
+void
+Element::Port::set_hook(int hook, bool on)
+{
+    if (on)
+	__sync_fetch_and_or(&_hooks, hook);
+    else
+	__sync_fetch_and_and(&_hooks, ~hook);
+}
+
+// The hooked transfer paths run while PerfEvents or PacketTrace is active.
+// PacketTrace records a push before the downstream element sees the packet,
+// and a pull after the upstream element gives it up.
+
+void
+Element::Port::hooked_push(Packet *p) const
+{
+# if HAVE_PACKET_TRACE
+    if (_hooks & hook_trace)
+	PacketTrace::hop(p, _owner, this - _owner->_ports[1], _e, _port,
+			 PacketTrace::PUSH);
+# endif
+# if HAVE_PERF_EVENTS
+    PerfEvents::Frame frame;
+    if (_hooks & hook_perf)
+	PerfEvents::enter(frame);
+# endif
+# if HAVE_BOUND_PORT_TRANSFER
+    _bound.push(_e, _port, p);
+# else
+    _e->push(_port, p);
+# endif
+# if HAVE_PERF_EVENTS
+    if (_hooks & hook_perf)
+	PerfEvents::exit(frame, _e, PerfEvents::XFER);
+# endif
+}
+
+Packet *
+Element::Port::hooked_pull() const
+{
+# if HAVE_PERF_EVENTS
+    PerfEvents::Frame frame;
+    if (_hooks & hook_perf)
+	PerfEvents::enter(frame);
+# endif
+# if HAVE_BOUND_PORT_TRANSFER
+    Packet *p = _bound.pull(_e, _port);
+# else
+    Packet *p = _e->pull(_port);
+# endif
+# if HAVE_PERF_EVENTS
+    if (_hooks & hook_perf)
+	PerfEvents::exit(frame, _e, PerfEvents::XFER);
+# endif
+    if (p) {
+# if HAVE_PACKET_TRACE
+	if (_hooks & hook_trace)
+	    PacketTrace::hop(p, _e, _port, _owner, this - _owner->_ports[0],
+			     PacketTrace::PULL);
+# endif
+# if CLICK_STATS >= 1
+	++_packets;
+# endif
+    }
+    return p;
+}
+
+void
+Element::Port::hooked_push_batch(PacketBatch &batch) const
+{
+# if HAVE_PACKET_TRACE
+    if (_hooks & hook_trace)
+	PacketTrace::hop_list(batch.first(), _owner, this - _owner->_ports[1],
+			      _e, _port, PacketTrace::PUSH);
+# endif
+# if HAVE_PERF_EVENTS
+    PerfEvents::Frame frame;
+    if (_hooks & hook_perf)
+	PerfEvents::enter(frame);
+# endif
+    _e->push_batch(_port, batch);
+# if HAVE_PERF_EVENTS
+    if (_hooks & hook_perf)
+	PerfEvents::exit(frame, _e, PerfEvents::XFER);
+# endif
+    batch.clear();
+}
+
+int
+Element::Port::hooked_pull_batch(unsigned max, PacketBatch &batch) const
+{
+# if HAVE_PACKET_TRACE
+    Packet *old_last = batch.last();
+# endif
+# if HAVE_PERF_EVENTS
+    PerfEvents::Frame frame;
+    if (_hooks & hook_perf)
+	PerfEvents::enter(frame);
+# endif
+    int n = _e->pull_batch(_port, max, batch);
+# if HAVE_PERF_EVENTS
+    if (_hooks & hook_perf)
+	PerfEvents::exit(frame, _e, PerfEvents::XFER);
+# endif
+# if HAVE_PACKET_TRACE
+    if (n && (_hooks & hook_trace))
+	PacketTrace::hop_list(old_last ? old_last->next() : batch.first(),
+			      _e, _port, _owner, this - _owner->_ports[0],
+			      PacketTrace::PULL);
+# endif
+# if CLICK_STATS >= 1
+    _packets += n;
+# endif
+    return n;
+}
+#endif
+
 void
 Element::add_default_handlers(bool allow_write_config)
 {
@@ -2107,6 +2257,10 @@ Element::add_default_handlers(bool allow_write_config)
   add_write_handler("cycles", write_cycles_handler, 0);
 # endif
 #endif
+#if HAVE_PERF_EVENTS
+  add_read_handler("perf", read_perf_handler, 0);
+  add_write_handler("perf", write_perf_handler, 0, Handler::f_button);
+#endif
 }
 
 #if HAVE_STRIDE_SCHED
@@ -2916,6 +3070,55 @@ Element::pull(int port)
     return p;
 }
 
+/** @brief Push a batch of packets onto push input @a port.
+ *
+ * @param port the input port number on which the packets arrive
+ * @param batch the packets
+ *
+ * An upstream element transferred every packet in @a batch to this element
+ * with Port::push_batch().  This element must account for each packet, just
+ * as push() does; the caller empties @a batch afterwards.
+ *
+ * The default implementation calls push() on each packet in order.  Elements
+ * on hot paths can override it to amortize per-call costs over the batch.
+ */
+void
+Element::push_batch(int port, PacketBatch &batch)
+{
+    for (Packet *p = batch.first(); p; ) {
+	Packet *next = p->next();
+	p->set_next(0);
+	push(port, p);
+	p = next;
+    }
+    batch.clear();
+}
+
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request
+ * @param max maximum number of packets to return
+ * @param batch batch to which packets are appended
+ * @return the number of packets appended to @a batch
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets have been pulled.  Elements on hot paths can override it to
+ * amortize per-call costs over the batch.
+ */
+int
+Element::pull_batch(int port, unsigned max, PacketBatch &batch)
+{
+    unsigned n = 0;
+    while (n < max) {
+	Packet *p = pull(port);
+	if (!p)
+	    break;
+	batch.append(p);
+	++n;
+    }
+    return n;
+}
+
 /** @brief Process a packet for a simple packet filter.
  *
  * @param p the input packet
@@ -2171,7 +2171,7 @@ Lexer::expand_compound_element(int which, VariableEnvironment &ve)
 }
 
 Router *
-Lexer::create_router(Master *master)
+Lexer::create_router(Master *master, StringAccum *graph)
 {
   Router *router = new Router(_file._big_string, master);
   if (!router)
@@ -2239,10 +2239,162 @@ Lexer::create_router(Master *master)
   for (int i = 0; i < _requirements.size(); i += 2)
       router->add_requirement(_requirements[i], _requirements[i+1]);
 
+  // A graph of a configuration that read library files or loaded packages
+  // would go stale when those changed, so don't produce one.
+  bool cacheable = !_libraries.size();
+  for (int i = 0; i < _requirements.size() && cacheable; i += 2)
+      cacheable = (_requirements[i] != "package");
+  if (graph && cacheable)
+      unparse_graph(*graph, router_id);
+
   return router;
 }
 
 
+//
+// FLAT GRAPHS
+//
+
+// A flat graph records the result of parsing and expanding a configuration:
+// the primitive elements with their classes, names, configurations, and
+// landmarks, the connections between them, and the requirements.  Building
+// a router from a flat graph skips lexing and compound expansion.
+
+static const char graph_magic[] = "Click flat graph 1\n";
+
+static void
+graph_append(StringAccum &sa, uint32_t x)
+{
+    sa.append(reinterpret_cast<const char *>(&x), sizeof(x));
+}
+
+static void
+graph_append(StringAccum &sa, const String &str)
+{
+    graph_append(sa, (uint32_t) str.length());
+    sa.append(str.data(), str.length());
+}
+
+static bool
+graph_read(const char *&s, const char *end, uint32_t &x)
+{
+    if (end - s < (ptrdiff_t) sizeof(x))
+	return false;
+    memcpy(&x, s, sizeof(x));
+    s += sizeof(x);
+    return true;
+}
+
+static bool
+graph_read(const char *&s, const char *end, const String &graph, String &str)
+{
+    uint32_t len;
+    if (!graph_read(s, end, len) || (uint32_t) (end - s) < len)
+	return false;
+    str = graph.substring(s, s + len);
+    s += len;
+    return true;
+}
+
+void
+Lexer::unparse_graph(StringAccum &sa, const Vector<int> &router_id) const
+{
+    sa.append(graph_magic, sizeof(graph_magic) - 1);
+    uint32_t n = 0;
+    for (int i = 0; i < router_id.size(); ++i)
+	n += (router_id[i] >= 0);
+    graph_append(sa, n);
+    for (int i = 0; i < router_id.size(); ++i)
+	if (router_id[i] >= 0) {
+	    graph_append(sa, _element_types[_c->_elements[i]].name);
+	    graph_append(sa, _c->_element_names[i]);
+	    graph_append(sa, _c->_element_configurations[i]);
+	    graph_append(sa, _c->_element_filenames[i]);
+	    graph_append(sa, (uint32_t) _c->_element_linenos[i]);
+	}
+    n = 0;
+    for (const Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp)
+	n += ((*cp)[0].idx >= 0 && (*cp)[1].idx >= 0);
+    graph_append(sa, n);
+    for (const Connection *cp = _c->_conn.begin(); cp != _c->_conn.end(); ++cp)
+	if ((*cp)[0].idx >= 0 && (*cp)[1].idx >= 0) {
+	    graph_append(sa, (uint32_t) (*cp)[1].idx);
+	    graph_append(sa, (uint32_t) (*cp)[1].port);
+	    graph_append(sa, (uint32_t) (*cp)[0].idx);
+	    graph_append(sa, (uint32_t) (*cp)[0].port);
+	}
+    graph_append(sa, (uint32_t) _requirements.size() / 2);
+    for (const String *it = _requirements.begin(); it != _requirements.end(); ++it)
+	graph_append(sa, *it);
+}
+
+Router *
+Lexer::create_router_from_graph(const String &config, const String &graph,
+				Master *master, LexerExtra *lextra,
+				ErrorHandler *errh)
+{
+    const char *s = graph.begin(), *end = graph.end();
+    size_t magic_len = sizeof(graph_magic) - 1;
+    if ((size_t) graph.length() < magic_len || memcmp(s, graph_magic, magic_len) != 0)
+	return 0;
+    s += magic_len;
+
+    Router *router = new Router(config, master);
+    uint32_t n;
+    bool ok = graph_read(s, end, n);
+    for (uint32_t i = 0; ok && i < n; ++i) {
+	String type_name, name, conf, filename;
+	uint32_t lineno;
+	ok = graph_read(s, end, graph, type_name)
+	    && graph_read(s, end, graph, name)
+	    && graph_read(s, end, graph, conf)
+	    && graph_read(s, end, graph, filename)
+	    && graph_read(s, end, lineno);
+	int etype = (ok ? element_type(type_name) : -1);
+	if (etype <= ERROR_TYPE
+	    || _element_types[etype].factory == compound_element_factory)
+	    ok = false;
+#if CLICK_LINUXMODULE
+	else if (_element_types[etype].module
+		 && router->add_module_ref(_element_types[etype].module) < 0)
+	    ok = false;
+#endif
+	else if (Element *e = (*_element_types[etype].factory)(_element_types[etype].thunk))
+	    ok = (router->add_element(e, name, conf, filename, lineno) == (int) i);
+	else
+	    ok = false;
+    }
+
+    ok = ok && graph_read(s, end, n);
+    for (uint32_t i = 0; ok && i < n; ++i) {
+	uint32_t from_idx, from_port, to_idx, to_port;
+	ok = graph_read(s, end, from_idx) && graph_read(s, end, from_port)
+	    && graph_read(s, end, to_idx) && graph_read(s, end, to_port)
+	    && from_idx < (uint32_t) router->nelements()
+	    && to_idx < (uint32_t) router->nelements()
+	    && router->add_connection(from_idx, from_port, to_idx, to_port) >= 0;
+    }
+
+    ok = ok && graph_read(s, end, n);
+    for (uint32_t i = 0; ok && i < n; ++i) {
+	String type, value;
+	ok = graph_read(s, end, graph, type) && graph_read(s, end, graph, value)
+	    && cp_is_word(type);
+	if (ok) {
+	    if (lextra)
+		lextra->require(type, value, errh);
+	    router->add_requirement(type, value);
+	}
+    }
+
+    if (!ok || s != end) {
+	delete router;
+	return 0;
+    }
+    return router;
+}
+
+
 //
 // LEXEREXTRA
 //
@@ -2260,27 +2412,15 @@ LexerExtra::require(String, String, ErrorHandler *)
 Lexer::TunnelEnd *
 Lexer::find_tunnel(const Port &h, bool isoutput, bool insert)
 {
-  // binary search for tunnel
-  unsigned l = 0, r = _tunnels.size();
-  while (l < r) {
-    unsigned m = l + (r - l) / 2;
-    if (h.idx < _tunnels[m]->_port.idx)
-      r = m;
-    else if (h.idx > _tunnels[m]->_port.idx)
-      l = m + 1;
-    else {
-      l = m;
-      r = m + 1;
-      break;
-    }
+  // tunnel ends are listed by element index
+  if (h.idx >= _tunnels.size()) {
+    if (!insert)
+      return 0;
+    if (h.idx >= _tunnels.capacity())
+      _tunnels.reserve(h.idx * 2 + 1);
+    _tunnels.resize(h.idx + 1, 0);
   }
-
-  // insert space if necessary
-  if (l >= r && insert) {
-    _tunnels.insert(_tunnels.begin() + l, 0);
-    ++r;
-  } else if (l >= r)
-    return 0;
+  int l = h.idx;
 
   // find match
   TunnelEnd *match = 0;
@@ -43,6 +43,9 @@ Master::Master(int nthreads)
 {
     _refcount = 0;
     _master_paused = 0;
+#if HAVE_MULTITHREAD
+    _task_stealing = false;
+#endif
 
     _nthreads = nthreads + 1;
     _threads = new RouterThread *[_nthreads];
@@ -144,6 +147,34 @@ Master::unblock_all()
 }
 
 
+// TASK STEALING
+
+#if HAVE_MULTITHREAD
+void
+Master::set_task_stealing(bool stealing)
+{
+    _task_stealing = stealing;
+    click_fence();
+    if (stealing)
+        for (int i = 1; i < _nthreads; ++i)
+            _threads[i]->wake();
+}
+
+void
+Master::unpublish_task(Task *t)
+{
+    // Called from Task::cleanup() once t's home thread is -1, so no thread
+    // will publish t again and no thief can claim it.  Remove t from every
+    // steal slot, then wait out any thief that claimed it first.
+    for (int i = 1; i < _nthreads; ++i)
+        _threads[i]->unpublish_task(t);
+    for (int i = 1; i < _nthreads; ++i)
+        while (_threads[i]->_steal_hazard == t)
+            click_relax_fence();
+}
+#endif
+
+
 // ROUTERS
 
 void
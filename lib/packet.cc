@@ -27,6 +27,10 @@
 #if CLICK_USERLEVEL || CLICK_MINIOS
 # include <unistd.h>
 #endif
+#if CLICK_USERLEVEL && ALLOW_MMAP && defined(__linux__)
+# include <sys/mman.h>
+# include <sys/syscall.h>
+#endif
 CLICK_DECLS
 
 /** @file packet.hh
@@ -180,6 +184,10 @@ CLICK_DECLS
  * Avoid writing buggy code like this!  Use WritablePacket selectively, and
  * try to avoid calling WritablePacket::clone() when possible. */
 
+#if CLICK_USERLEVEL || CLICK_MINIOS
+static void free_packet_data(unsigned char *head, unsigned char *end);
+#endif
+
 Packet::~Packet()
 {
     // This is a convenient place to put static assertions.
@@ -213,8 +221,8 @@ Packet::~Packet()
 # if CLICK_USERLEVEL || CLICK_MINIOS
     else if (_head && _destructor)
 	_destructor(_head, _end - _head, _destructor_argument);
-    else
-	delete[] _head;
+    else if (_head)
+	free_packet_data(_head, _end);
 # elif CLICK_BSDMODULE
     if (_m)
 	m_freem(_m);
@@ -232,11 +240,26 @@ Packet::~Packet()
 // important to do so quickly. This specialized packet allocator saves
 // pre-initialized Packet objects, either with or without data, for fast
 // reuse. It can support multithreaded deployments: each thread has its own
-// pool, with a global pool to even out imbalance.
+// pool, and threads hand whole pools to each other through a lock-free
+// exchange to even out imbalance. At user level, data buffers can instead
+// come from per-NUMA-node arenas, optionally backed by hugepages, so a
+// buffer stays on the node of the thread that first used it.
+//
+// Pool size, buffer size, and arena use are set once at startup with
+// Packet::set_pool_parameters().
 
 #  define CLICK_PACKET_POOL_BUFSIZ		2048
 #  define CLICK_PACKET_POOL_SIZE		1000 // see LIMIT in packetpool-01.testie
 #  define CLICK_GLOBAL_PACKET_POOL_COUNT	16
+#  if CLICK_USERLEVEL && ALLOW_MMAP && defined(__linux__)
+#   define HAVE_CLICK_PACKET_ARENA		1
+#   define CLICK_PACKET_ARENA_CHUNK		(2 << 20) // one x86-64 hugepage
+#   define CLICK_PACKET_ARENA_REFILL		64
+#   define CLICK_PACKET_ARENA_MAX_CHUNKS	4096 // 8 GB of buffers
+#   define CLICK_PACKET_POOL_NODES		8
+#  else
+#   define CLICK_PACKET_POOL_NODES		1
+#  endif
 
 namespace {
 struct PacketData {
@@ -252,30 +275,260 @@ struct PacketPool {
     unsigned pcount;            // # packets in `p` list
     PacketData* pd;             // free data buffers, linked by pd->next
     unsigned pdcount;           // # buffers in `pd` list
+    unsigned node;              // NUMA node whose buffers this pool holds
+    uint64_t hits;              // packets and buffers served from the pool
+    uint64_t misses;            // packets and buffers from the heap or arena
+    uint64_t steals;            // batches taken from the exchange
+    uint64_t donations;         // batches given to the exchange
+    uint64_t frees;             // objects released when the pool overflowed
 #  if HAVE_MULTITHREAD
+    unsigned exchange_slot;     // first exchange slot this thread tries
     PacketPool* thread_pool_next; // link to next per-thread pool
 #  endif
 };
 }
 
+static uint32_t packet_pool_size = CLICK_PACKET_POOL_SIZE;
+static uint32_t packet_pool_bufsiz = CLICK_PACKET_POOL_BUFSIZ;
+static int packet_pool_arena = 0;
+static bool packet_pool_started = false;
+
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
 
 struct GlobalPacketPool {
-    WritablePacket* pbatch;     // batches of free packets, linked by p->prev()
+    // Full pools waiting for another thread. A null slot is empty. A thread
+    // takes a batch by swapping its slot to null, and offers one by swapping
+    // a null slot to the batch, so neither side needs a lock.
+    WritablePacket* volatile pbatch[CLICK_GLOBAL_PACKET_POOL_COUNT];
                                 //   p->anno_u32(0) is # packets in batch
-    unsigned pbatchcount;       // # batches in `pbatch` list
-    PacketData* pdbatch;        // batches of free data buffers
-    unsigned pdbatchcount;      // # batches in `pdbatch` list
+    PacketData* volatile pdbatch[CLICK_PACKET_POOL_NODES][CLICK_GLOBAL_PACKET_POOL_COUNT];
 
-    PacketPool* thread_pools;   // all thread packet pools
-    volatile uint32_t lock;
+    PacketPool* volatile thread_pools; // all thread packet pools
+    atomic_uint32_t nthread_pools;
 };
 static GlobalPacketPool global_packet_pool;
+
+template <typename T> static inline T *
+exchange_take(T* volatile *slots, unsigned first)
+{
+    for (unsigned i = 0; i < CLICK_GLOBAL_PACKET_POOL_COUNT; ++i) {
+	T* volatile &slot = slots[(first + i) % CLICK_GLOBAL_PACKET_POOL_COUNT];
+	if (slot)
+	    if (T *x = __sync_lock_test_and_set(&slot, (T *) 0))
+		return x;
+    }
+    return 0;
+}
+
+template <typename T> static inline bool
+exchange_put(T* volatile *slots, unsigned first, T *x)
+{
+    for (unsigned i = 0; i < CLICK_GLOBAL_PACKET_POOL_COUNT; ++i) {
+	T* volatile &slot = slots[(first + i) % CLICK_GLOBAL_PACKET_POOL_COUNT];
+	if (!slot && __sync_bool_compare_and_swap(&slot, (T *) 0, x))
+	    return true;
+    }
+    return false;
+}
 #else
 static PacketPool global_packet_pool;
 #  endif
 
+#  if HAVE_CLICK_PACKET_ARENA
+namespace {
+struct PacketArena {
+    PacketData* free;           // returned buffers, linked by pd->next
+    unsigned char* next;        // next uncarved buffer in current chunk
+    unsigned char* end;         // end of current chunk
+    void* chunks;               // all chunks, linked through their first word
+    uint32_t nchunks;           // # chunks mapped
+    uint32_t nhugepage_chunks;  // # of those backed by hugepages
+    volatile uint32_t lock;
+};
+}
+static PacketArena packet_arenas[CLICK_PACKET_POOL_NODES];
+
+// Every arena chunk, so a freed buffer can find its home arena. Chunks are
+// aligned to their size, so a buffer's chunk is its address rounded down.
+// Each entry is a chunk address plus its node + 1; an open-addressed hash
+// on the chunk number, kept at most half full, and only ever added to
+// until static_cleanup().
+static uintptr_t packet_arena_chunk_table[2 * CLICK_PACKET_ARENA_MAX_CHUNKS];
+static atomic_uint32_t packet_arena_nchunks;
+
+static inline unsigned arena_chunk_hash(uintptr_t chunk) {
+    return ((chunk / CLICK_PACKET_ARENA_CHUNK) * 2654435761U)
+	% (2 * CLICK_PACKET_ARENA_MAX_CHUNKS);
+}
+
+static void arena_add_chunk(void *m, unsigned node) {
+    uintptr_t chunk = reinterpret_cast<uintptr_t>(m);
+    for (unsigned i = arena_chunk_hash(chunk); ;
+	 i = (i + 1) % (2 * CLICK_PACKET_ARENA_MAX_CHUNKS))
+	if (__sync_bool_compare_and_swap(&packet_arena_chunk_table[i],
+					 (uintptr_t) 0, chunk + node + 1))
+	    return;
+}
+
+/** @brief Return the node of the arena that owns buffer @a data, or -1 if
+    @a data came from the heap. */
+static int arena_home(const void *data) {
+    uintptr_t chunk = reinterpret_cast<uintptr_t>(data)
+	& ~(uintptr_t) (CLICK_PACKET_ARENA_CHUNK - 1);
+    for (unsigned i = arena_chunk_hash(chunk); ;
+	 i = (i + 1) % (2 * CLICK_PACKET_ARENA_MAX_CHUNKS)) {
+	uintptr_t x = packet_arena_chunk_table[i];
+	if (!x)
+	    return -1;
+	if ((x & ~(uintptr_t) (CLICK_PACKET_ARENA_CHUNK - 1)) == chunk)
+	    return (x & (CLICK_PACKET_ARENA_CHUNK - 1)) - 1;
+    }
+}
+
+static inline uint32_t packet_arena_stride() {
+    return (packet_pool_bufsiz + CLICK_CACHE_LINE_SIZE - 1) & ~(CLICK_CACHE_LINE_SIZE - 1);
+}
+
+static unsigned current_numa_node() {
+#   ifdef SYS_getcpu
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, (void *) 0) == 0)
+	return node % CLICK_PACKET_POOL_NODES;
+#   endif
+    return 0;
+}
+
+/** @brief Map a new chunk for @a arena.
+    @pre The caller holds @a arena.lock. */
+static bool arena_map_chunk(PacketArena &arena) {
+    if (packet_arena_nchunks.fetch_and_add(1) >= CLICK_PACKET_ARENA_MAX_CHUNKS) {
+	--packet_arena_nchunks;
+	return false;
+    }
+    void *m = MAP_FAILED;
+#   ifdef MAP_HUGETLB
+    if (packet_pool_arena & Packet::pool_arena_hugepages) {
+	m = mmap(0, CLICK_PACKET_ARENA_CHUNK, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (m != MAP_FAILED)
+	    ++arena.nhugepage_chunks;
+    }
+#   endif
+    if (m == MAP_FAILED) {
+	// Map twice the size and trim to an aligned chunk.
+	unsigned char *x = reinterpret_cast<unsigned char *>
+	    (mmap(0, 2 * CLICK_PACKET_ARENA_CHUNK, PROT_READ | PROT_WRITE,
+		  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	if (x != MAP_FAILED) {
+	    uintptr_t skew = reinterpret_cast<uintptr_t>(x)
+		& (CLICK_PACKET_ARENA_CHUNK - 1);
+	    unsigned char *start = x + (skew ? CLICK_PACKET_ARENA_CHUNK - skew : 0);
+	    if (start != x)
+		munmap(x, start - x);
+	    munmap(start + CLICK_PACKET_ARENA_CHUNK,
+		   x + CLICK_PACKET_ARENA_CHUNK - start);
+	    m = start;
+	}
+    }
+    if (m == MAP_FAILED) {
+	--packet_arena_nchunks;
+	return false;
+    }
+    arena_add_chunk(m, &arena - packet_arenas);
+    *reinterpret_cast<void **>(m) = arena.chunks;
+    arena.chunks = m;
+    ++arena.nchunks;
+    // The first cache line holds the chunk link.
+    arena.next = reinterpret_cast<unsigned char *>(m) + CLICK_CACHE_LINE_SIZE;
+    arena.end = reinterpret_cast<unsigned char *>(m) + CLICK_PACKET_ARENA_CHUNK;
+    return true;
+}
+
+/** @brief Return a data buffer from the local pool's arena, moving up to
+    CLICK_PACKET_ARENA_REFILL more into the pool.
+
+    Returns null if arenas are off or no memory is available. Buffers are
+    carved by the allocating thread, so under the default first-touch policy
+    their pages land on that thread's node. */
+static PacketData *arena_allocate(PacketPool &packet_pool) {
+    if (!packet_pool_arena)
+	return 0;
+    PacketArena &arena = packet_arenas[packet_pool.node];
+    uint32_t stride = packet_arena_stride();
+    unsigned want = CLICK_PACKET_ARENA_REFILL;
+    if (want > packet_pool_size - packet_pool.pdcount)
+	want = packet_pool_size - packet_pool.pdcount;
+
+    while (atomic_uint32_t::swap(arena.lock, 1) == 1)
+	/* do nothing */;
+    PacketData *result = 0;
+    for (unsigned i = 0; i <= want; ++i) {
+	PacketData *pd;
+	if ((pd = arena.free))
+	    arena.free = pd->next;
+	else if (arena.next + stride <= arena.end || arena_map_chunk(arena)) {
+	    pd = reinterpret_cast<PacketData *>(arena.next);
+	    arena.next += stride;
+	} else
+	    break;
+	if (!result)
+	    result = pd;
+	else {
+	    pd->next = packet_pool.pd;
+	    packet_pool.pd = pd;
+	    ++packet_pool.pdcount;
+	}
+    }
+    click_compiler_fence();
+    arena.lock = 0;
+    return result;
+}
+#  endif /* HAVE_CLICK_PACKET_ARENA */
+
+/** @brief Release a list of @a n data buffers that no pool can hold.
+
+    Arena buffers go back to the arena they were carved from, whichever
+    thread frees them; heap buffers go back to the heap. */
+static void free_data_list(PacketPool &packet_pool, PacketData *pd, unsigned n) {
+    packet_pool.frees += n;
+#  if HAVE_CLICK_PACKET_ARENA
+    if (packet_pool_arena) {
+	PacketData *head[CLICK_PACKET_POOL_NODES], *tail[CLICK_PACKET_POOL_NODES];
+	memset(head, 0, sizeof(head));
+	while (pd) {
+	    PacketData *next = pd->next;
+	    int node = arena_home(pd);
+	    if (node < 0)
+		delete[] reinterpret_cast<unsigned char *>(pd);
+	    else {
+		if (!head[node])
+		    tail[node] = pd;
+		pd->next = head[node];
+		head[node] = pd;
+	    }
+	    pd = next;
+	}
+	for (int node = 0; node < CLICK_PACKET_POOL_NODES; ++node)
+	    if (head[node]) {
+		PacketArena &arena = packet_arenas[node];
+		while (atomic_uint32_t::swap(arena.lock, 1) == 1)
+		    /* do nothing */;
+		tail[node]->next = arena.free;
+		arena.free = head[node];
+		click_compiler_fence();
+		arena.lock = 0;
+	    }
+	return;
+    }
+#  endif
+    while (pd) {
+	PacketData *next = pd->next;
+	delete[] reinterpret_cast<unsigned char *>(pd);
+	pd = next;
+    }
+}
+
 /** @brief Return the local packet pool for this thread.
     @pre make_local_packet_pool() has succeeded on this thread. */
 static inline PacketPool& local_packet_pool() {
@@ -293,16 +546,29 @@ static inline PacketPool* make_local_packet_pool() {
     PacketPool *pp = thread_packet_pool;
     if (!pp && (pp = new PacketPool)) {
 	memset(pp, 0, sizeof(PacketPool));
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
-	pp->thread_pool_next = global_packet_pool.thread_pools;
-	global_packet_pool.thread_pools = pp;
+	packet_pool_started = true;
+#   if HAVE_CLICK_PACKET_ARENA
+	if (packet_pool_arena)
+	    pp->node = current_numa_node();
+#   endif
+	// Spread threads over the exchange so they rarely race for a slot.
+	pp->exchange_slot = global_packet_pool.nthread_pools.fetch_and_add(1)
+	    * (CLICK_GLOBAL_PACKET_POOL_COUNT / 4 + 1);
+	do {
+	    pp->thread_pool_next = global_packet_pool.thread_pools;
+	} while (!__sync_bool_compare_and_swap(&global_packet_pool.thread_pools,
+					       pp->thread_pool_next, pp));
 	thread_packet_pool = pp;
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
     }
     return pp;
 #  else
+    if (!packet_pool_started) {
+	packet_pool_started = true;
+#   if HAVE_CLICK_PACKET_ARENA
+	if (packet_pool_arena)
+	    global_packet_pool.node = current_numa_node();
+#   endif
+    }
     return &global_packet_pool;
 #  endif
 }
@@ -314,31 +580,19 @@ WritablePacket::pool_allocate(bool with_data)
     (void) with_data;
 
 #  if HAVE_MULTITHREAD
-    // Steal packets and/or data from the global pool if there's nothing on
+    // Steal packets and/or data from the exchange if there's nothing on
     // the local pool.
-    if ((!packet_pool.p && global_packet_pool.pbatch)
-	|| (with_data && !packet_pool.pd && global_packet_pool.pdbatch)) {
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
-
-	WritablePacket *pp;
-	if (!packet_pool.p && (pp = global_packet_pool.pbatch)) {
-	    global_packet_pool.pbatch = static_cast<WritablePacket *>(pp->prev());
-	    --global_packet_pool.pbatchcount;
-	    packet_pool.p = pp;
-	    packet_pool.pcount = pp->anno_u32(0);
-	}
-
-	PacketData *pd;
-	if (with_data && !packet_pool.pd && (pd = global_packet_pool.pdbatch)) {
-	    global_packet_pool.pdbatch = pd->batch_next;
-	    --global_packet_pool.pdbatchcount;
-	    packet_pool.pd = pd;
-	    packet_pool.pdcount = pd->batch_pdcount;
-	}
-
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
+    if (!packet_pool.p
+	&& (packet_pool.p = exchange_take(global_packet_pool.pbatch,
+					  packet_pool.exchange_slot))) {
+	packet_pool.pcount = packet_pool.p->anno_u32(0);
+	++packet_pool.steals;
+    }
+    if (with_data && !packet_pool.pd
+	&& (packet_pool.pd = exchange_take(global_packet_pool.pdbatch[packet_pool.node],
+					   packet_pool.exchange_slot))) {
+	packet_pool.pdcount = packet_pool.pd->batch_pdcount;
+	++packet_pool.steals;
     }
 #  endif /* HAVE_MULTITHREAD */
 
@@ -346,8 +600,11 @@ WritablePacket::pool_allocate(bool with_data)
     if (p) {
 	packet_pool.p = static_cast<WritablePacket*>(p->next());
 	--packet_pool.pcount;
-    } else
+	++packet_pool.hits;
+    } else {
 	p = new WritablePacket;
+	++packet_pool.misses;
+    }
     return p;
 }
 
@@ -356,19 +613,25 @@ WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
 			      uint32_t tailroom)
 {
     uint32_t n = headroom + length + tailroom;
-    if (n < CLICK_PACKET_POOL_BUFSIZ)
-	n = CLICK_PACKET_POOL_BUFSIZ;
-    WritablePacket *p = pool_allocate(n == CLICK_PACKET_POOL_BUFSIZ);
+    if (n < packet_pool_bufsiz)
+	n = packet_pool_bufsiz;
+    WritablePacket *p = pool_allocate(n == packet_pool_bufsiz);
     if (p) {
 	p->initialize();
 	PacketData *pd;
 	PacketPool& packet_pool = local_packet_pool();
-	if (n == CLICK_PACKET_POOL_BUFSIZ && (pd = packet_pool.pd)) {
+	if (n == packet_pool_bufsiz && (pd = packet_pool.pd)) {
 	    packet_pool.pd = pd->next;
 	    --packet_pool.pdcount;
+	    ++packet_pool.hits;
 	    p->_head = reinterpret_cast<unsigned char *>(pd);
+#  if HAVE_CLICK_PACKET_ARENA
+	} else if (n == packet_pool_bufsiz && (pd = arena_allocate(packet_pool))) {
+	    ++packet_pool.misses;
+	    p->_head = reinterpret_cast<unsigned char *>(pd);
+#  endif
 	} else if ((p->_head = new unsigned char[n]))
-	    /* OK */;
+	    ++packet_pool.misses;
 	else {
 	    delete p;
 	    return 0;
@@ -385,61 +648,62 @@ WritablePacket::recycle(WritablePacket *p)
 {
     unsigned char *data = 0;
     if (!p->_data_packet && p->_head && !p->_destructor
-	&& p->_end - p->_head == CLICK_PACKET_POOL_BUFSIZ) {
+	&& p->_end - p->_head == packet_pool_bufsiz) {
 	data = p->_head;
 	p->_head = 0;
     }
     p->~WritablePacket();
 
     PacketPool& packet_pool = *make_local_packet_pool();
-#  if HAVE_MULTITHREAD
-    if ((packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE)
-	|| (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE)) {
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
-
-	if (packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
-		while (WritablePacket *p = packet_pool.p) {
-		    packet_pool.p = static_cast<WritablePacket *>(p->next());
-		    ::operator delete((void *) p);
-		}
-	    } else {
-		packet_pool.p->set_prev(global_packet_pool.pbatch);
-                packet_pool.p->set_anno_u32(0, packet_pool.pcount);
-		global_packet_pool.pbatch = packet_pool.p;
-		++global_packet_pool.pbatchcount;
-		packet_pool.p = 0;
-	    }
-	    packet_pool.pcount = 0;
+#  if HAVE_CLICK_PACKET_ARENA
+    // Keep only this node's buffers; send others home.
+    if (data && packet_pool_arena) {
+	int node = arena_home(data);
+	if (node >= 0 && (unsigned) node != packet_pool.node) {
+	    PacketData *pd = reinterpret_cast<PacketData *>(data);
+	    pd->next = 0;
+	    free_data_list(packet_pool, pd, 1);
+	    data = 0;
 	}
-
-	if (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	    if (global_packet_pool.pdbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
-		while (PacketData *pd = packet_pool.pd) {
-		    packet_pool.pd = pd->next;
-		    delete[] reinterpret_cast<unsigned char *>(pd);
-		}
-	    } else {
-		packet_pool.pd->batch_next = global_packet_pool.pdbatch;
-                packet_pool.pd->batch_pdcount = packet_pool.pdcount;
-		global_packet_pool.pdbatch = packet_pool.pd;
-		++global_packet_pool.pdbatchcount;
-		packet_pool.pd = 0;
+    }
+#  endif
+#  if HAVE_MULTITHREAD
+    if (packet_pool.p && packet_pool.pcount == packet_pool_size) {
+	packet_pool.p->set_anno_u32(0, packet_pool.pcount);
+	if (exchange_put(global_packet_pool.pbatch, packet_pool.exchange_slot,
+			 packet_pool.p))
+	    ++packet_pool.donations;
+	else {
+	    packet_pool.frees += packet_pool.pcount;
+	    while (WritablePacket *p = packet_pool.p) {
+		packet_pool.p = static_cast<WritablePacket *>(p->next());
+		::operator delete((void *) p);
 	    }
-	    packet_pool.pdcount = 0;
 	}
+	packet_pool.p = 0;
+	packet_pool.pcount = 0;
+    }
 
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
+    if (data && packet_pool.pd && packet_pool.pdcount == packet_pool_size) {
+	packet_pool.pd->batch_pdcount = packet_pool.pdcount;
+	if (exchange_put(global_packet_pool.pdbatch[packet_pool.node],
+			 packet_pool.exchange_slot, packet_pool.pd))
+	    ++packet_pool.donations;
+	else
+	    free_data_list(packet_pool, packet_pool.pd, packet_pool.pdcount);
+	packet_pool.pd = 0;
+	packet_pool.pdcount = 0;
     }
 #  else /* !HAVE_MULTITHREAD */
-    if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
+    if (packet_pool.pcount == packet_pool_size) {
 	::operator delete((void *) p);
+	++packet_pool.frees;
 	p = 0;
     }
-    if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
-	delete[] data;
+    if (data && packet_pool.pdcount == packet_pool_size) {
+	PacketData *pd = reinterpret_cast<PacketData *>(data);
+	pd->next = 0;
+	free_data_list(packet_pool, pd, 1);
 	data = 0;
     }
 #  endif /* HAVE_MULTITHREAD */
@@ -448,19 +712,121 @@ WritablePacket::recycle(WritablePacket *p)
 	++packet_pool.pcount;
 	p->set_next(packet_pool.p);
 	packet_pool.p = p;
-	assert(packet_pool.pcount <= CLICK_PACKET_POOL_SIZE);
+	assert(packet_pool.pcount <= packet_pool_size);
     }
     if (data) {
 	++packet_pool.pdcount;
 	PacketData *pd = reinterpret_cast<PacketData *>(data);
 	pd->next = packet_pool.pd;
 	packet_pool.pd = pd;
-	assert(packet_pool.pdcount <= CLICK_PACKET_POOL_SIZE);
+	assert(packet_pool.pdcount <= packet_pool_size);
+    }
+}
+
+/** @brief Set the packet pool's parameters.
+ * @param pool_size maximum number of free packets, and of free data
+ *   buffers, each thread keeps, or 0 to keep the current value
+ * @param buffer_size size of pooled data buffers, or 0 to keep the current
+ *   value
+ * @param arena_flags zero, or a combination of pool_arena_numa and
+ *   pool_arena_hugepages
+ * @return 0 on success, -EINVAL for bad parameters, -EBUSY if the pool is
+ *   already in use, or -EOPNOTSUPP if arenas were requested but this
+ *   platform does not support them
+ *
+ * Buffers of exactly @a buffer_size bytes are pooled; packets that need
+ * more get their data from the heap. With pool_arena_numa, pooled buffers
+ * are carved from per-NUMA-node arenas, and buffers move between threads
+ * only within a node. pool_arena_hugepages backs the arenas with hugepages
+ * when the system has some to spare (and implies pool_arena_numa).
+ *
+ * Call this before the first packet is allocated. */
+int
+Packet::set_pool_parameters(uint32_t pool_size, uint32_t buffer_size,
+			    int arena_flags)
+{
+    if (pool_size == 0)
+	pool_size = packet_pool_size;
+    if (buffer_size == 0)
+	buffer_size = packet_pool_bufsiz;
+    if (buffer_size < min_buffer_length
+	|| (arena_flags & ~(pool_arena_numa | pool_arena_hugepages)))
+	return -EINVAL;
+    if (packet_pool_started)
+	return -EBUSY;
+    if (arena_flags & pool_arena_hugepages)
+	arena_flags |= pool_arena_numa;
+#  if HAVE_CLICK_PACKET_ARENA
+    if (arena_flags
+	&& ((buffer_size + CLICK_CACHE_LINE_SIZE - 1) & ~(CLICK_CACHE_LINE_SIZE - 1))
+	   > CLICK_PACKET_ARENA_CHUNK - CLICK_CACHE_LINE_SIZE)
+	return -EINVAL;
+#  else
+    if (arena_flags)
+	return -EOPNOTSUPP;
+#  endif
+    packet_pool_size = pool_size;
+    packet_pool_bufsiz = buffer_size;
+    packet_pool_arena = arena_flags;
+    return 0;
+}
+
+static void
+add_pool_statistics(Packet::PoolStatistics &stats, const PacketPool &pp)
+{
+    stats.hits += pp.hits;
+    stats.misses += pp.misses;
+    stats.steals += pp.steals;
+    stats.donations += pp.donations;
+    stats.frees += pp.frees;
+}
+
+/** @brief Collect packet pool statistics, summed over all threads.
+ *
+ * Counters from other threads are read without synchronization, so the
+ * result is approximate while those threads run. */
+void
+Packet::pool_statistics(PoolStatistics &stats)
+{
+    memset(&stats, 0, sizeof(stats));
+#  if HAVE_MULTITHREAD
+    for (PacketPool *pp = global_packet_pool.thread_pools; pp;
+	 pp = pp->thread_pool_next)
+	add_pool_statistics(stats, *pp);
+#  else
+    add_pool_statistics(stats, global_packet_pool);
+#  endif
+#  if HAVE_CLICK_PACKET_ARENA
+    for (int i = 0; i < CLICK_PACKET_POOL_NODES; ++i) {
+	stats.arena_chunks += packet_arenas[i].nchunks;
+	stats.hugepage_chunks += packet_arenas[i].nhugepage_chunks;
     }
+#  endif
 }
 
 # endif /* HAVE_PACKET_POOL */
 
+# if CLICK_USERLEVEL || CLICK_MINIOS
+/** @brief Free a data buffer that has no destructor and no data packet. */
+static void
+free_packet_data(unsigned char *head, unsigned char *end)
+{
+#  if HAVE_CLICK_PACKET_ARENA
+    // With arenas on, a pool-sized buffer may lie in an arena chunk, which
+    // the heap does not own; free_data_list() sends it to its arena.
+    if (packet_pool_arena && end - head == packet_pool_bufsiz) {
+	PacketData *pd = reinterpret_cast<PacketData *>(head);
+	pd->next = 0;
+	free_data_list(*make_local_packet_pool(), pd, 1);
+	return;
+    }
+#  else
+    (void) end;
+#  endif
+    delete[] head;
+}
+# endif
+
 bool
 Packet::alloc_data(uint32_t headroom, uint32_t length, uint32_t tailroom)
 {
@@ -757,7 +1123,7 @@ Packet::expensive_uniqueify(int32_t extra_headroom, int32_t extra_tailroom,
     else if (_destructor)
 	_destructor(old_head, old_end - old_head, _destructor_argument);
     else
-	delete[] old_head;
+	free_packet_data(old_head, old_end);
     _destructor = 0;
 # elif CLICK_BSDMODULE
     m_freem(old_m); // alloc_data() created a new mbuf, so free the old one
@@ -945,10 +1311,15 @@ cleanup_pool(PacketPool *pp, int global)
     while (PacketData *pd = pp->pd) {
 	++pdcount;
 	pp->pd = pd->next;
+# if HAVE_CLICK_PACKET_ARENA
+	// Arena buffers are released with their chunks.
+	if (packet_pool_arena && arena_home(pd) >= 0)
+	    continue;
+# endif
 	delete[] reinterpret_cast<unsigned char *>(pd);
     }
-    assert(pcount <= CLICK_PACKET_POOL_SIZE);
-    assert(pdcount <= CLICK_PACKET_POOL_SIZE);
+    assert(pcount <= packet_pool_size);
+    assert(pdcount <= packet_pool_size);
     assert(global || (pcount == pp->pcount && pdcount == pp->pdcount));
 }
 #endif
@@ -963,23 +1334,33 @@ Packet::static_cleanup()
 	cleanup_pool(pp, 0);
 	delete pp;
     }
-    unsigned rounds = global_packet_pool.pbatchcount;
-    if (rounds < global_packet_pool.pdbatchcount)
-        rounds = global_packet_pool.pdbatchcount;
-    assert(rounds <= CLICK_GLOBAL_PACKET_POOL_COUNT);
     PacketPool fake_pool;
-    while (global_packet_pool.pbatch || global_packet_pool.pdbatch) {
-        if ((fake_pool.p = global_packet_pool.pbatch))
-            global_packet_pool.pbatch = static_cast<WritablePacket*>(fake_pool.p->prev());
-        if ((fake_pool.pd = global_packet_pool.pdbatch))
-            global_packet_pool.pdbatch = fake_pool.pd->batch_next;
+    for (int i = 0; i < CLICK_GLOBAL_PACKET_POOL_COUNT; ++i) {
+	fake_pool.p = global_packet_pool.pbatch[i];
+	global_packet_pool.pbatch[i] = 0;
+	fake_pool.pd = 0;
 	cleanup_pool(&fake_pool, 1);
-	--rounds;
+	for (int n = 0; n < CLICK_PACKET_POOL_NODES; ++n) {
+	    fake_pool.pd = global_packet_pool.pdbatch[n][i];
+	    global_packet_pool.pdbatch[n][i] = 0;
+	    cleanup_pool(&fake_pool, 1);
+	}
     }
-    assert(rounds == 0);
 # else
     cleanup_pool(&global_packet_pool, 0);
 # endif
+# if HAVE_CLICK_PACKET_ARENA
+    for (int i = 0; i < CLICK_PACKET_POOL_NODES; ++i) {
+	PacketArena &arena = packet_arenas[i];
+	while (void *chunk = arena.chunks) {
+	    arena.chunks = *reinterpret_cast<void **>(chunk);
+	    munmap(chunk, CLICK_PACKET_ARENA_CHUNK);
+	}
+	memset(&arena, 0, sizeof(arena));
+    }
+    memset(packet_arena_chunk_table, 0, sizeof(packet_arena_chunk_table));
+    packet_arena_nchunks = 0;
+# endif
 #endif
 }
 
@@ -0,0 +1,234 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/packettrace.hh" -*-
+/*
+ * packettrace.{cc,hh} -- sampled packet tracing
+ */
+
+#include <click/config.h>
+#include <click/packettrace.hh>
+#if HAVE_PACKET_TRACE
+#include <click/element.hh>
+#include <click/router.hh>
+#include <click/hashtable.hh>
+#include <click/straccum.hh>
+#include <click/vector.hh>
+#include <click/timestamp.hh>
+#include <click/atomic.hh>
+#include <click/sync.hh>
+#include <string.h>
+CLICK_DECLS
+
+volatile uint32_t PacketTrace::_rate;
+Router *PacketTrace::_router;
+
+namespace {
+
+static const uint32_t ring_capacity = 65536;
+
+// Rings hold element pointers; dump() translates them to indexes.
+struct TraceHop {
+    uint64_t time;
+    uint32_t trace;
+    uint16_t thread;
+    uint8_t kind;
+    const Element *from;
+    const Element *to;
+    uint16_t from_port;
+    uint16_t to_port;
+};
+
+// Each thread appends to its own ring.  Rings are never freed, so dump()
+// can walk them while their threads keep tracing; a record being written
+// during a dump may come out garbled.
+struct TraceRing {
+    TraceHop hop[ring_capacity];
+    uint64_t head;
+    uint16_t thread;
+    TraceRing *next;
+};
+
+__thread TraceRing *trace_ring;
+__thread uint32_t trace_countdown;
+TraceRing *all_rings;
+Spinlock rings_lock;
+atomic_uint32_t next_trace;
+atomic_uint32_t sampled;
+
+TraceRing *
+make_ring()
+{
+    TraceRing *r = new TraceRing;
+    r->head = 0;
+    r->thread = click_current_cpu_id();
+    rings_lock.acquire();
+    r->next = all_rings;
+    all_rings = r;
+    rings_lock.release();
+    return trace_ring = r;
+}
+
+}
+
+void
+PacketTrace::sampled_hop(Packet *p, const Element *from, int from_port,
+			 const Element *to, int to_port, int kind)
+{
+    uint32_t trace = p->trace_anno();
+    if (!trace) {
+	// The packet's first hop since tracing started: sample it or not.
+	if (trace_countdown > 1) {
+	    --trace_countdown;
+	    p->set_trace_anno(UNSAMPLED);
+	    return;
+	}
+	trace_countdown = _rate;
+	do {
+	    trace = next_trace.fetch_and_add(1) + 1;
+	} while (trace == 0 || trace == UNSAMPLED);
+	p->set_trace_anno(trace);
+	++sampled;
+    }
+
+    TraceRing *r = trace_ring;
+    if (unlikely(!r))
+	r = make_ring();
+    TraceHop &h = r->hop[r->head & (ring_capacity - 1)];
+    Timestamp now = Timestamp::now_steady();
+    h.time = (uint64_t) now.sec() * 1000000000 + now.nsec();
+    h.trace = trace;
+    h.thread = r->thread;
+    h.kind = kind;
+    h.from = from;
+    h.to = to;
+    h.from_port = from_port;
+    h.to_port = to_port;
+    ++r->head;
+}
+
+void
+PacketTrace::hop_list(Packet *first, const Element *from, int from_port,
+		      const Element *to, int to_port, int kind)
+{
+    for (Packet *p = first; p; p = p->next())
+	hop(p, from, from_port, to, to_port, kind);
+}
+
+void
+PacketTrace::set_sample_rate(Router *router, uint32_t rate)
+{
+    if (_router != router) {
+	if (!rate)
+	    return;
+	reset();
+    }
+    _router = rate ? router : 0;
+    _rate = rate;
+    Element::Port::set_hook(Element::Port::hook_trace, rate != 0);
+}
+
+void
+PacketTrace::stop(Router *router)
+{
+    if (_router == router && router) {
+	set_sample_rate(router, 0);
+	reset();
+    }
+}
+
+uint64_t
+PacketTrace::nrecords()
+{
+    uint64_t n = 0;
+    rings_lock.acquire();
+    for (TraceRing *r = all_rings; r; r = r->next)
+	n += r->head < ring_capacity ? r->head : ring_capacity;
+    rings_lock.release();
+    return n;
+}
+
+uint32_t
+PacketTrace::nsampled()
+{
+    return sampled;
+}
+
+void
+PacketTrace::reset()
+{
+    rings_lock.acquire();
+    for (TraceRing *r = all_rings; r; r = r->next)
+	r->head = 0;
+    rings_lock.release();
+    sampled = 0;
+}
+
+namespace {
+int
+record_compare(const void *ap, const void *bp, void *)
+{
+    const PacketTrace::Record *a = static_cast<const PacketTrace::Record *>(ap);
+    const PacketTrace::Record *b = static_cast<const PacketTrace::Record *>(bp);
+    if (a->trace != b->trace)
+	return a->trace < b->trace ? -1 : 1;
+    if (a->time != b->time)
+	return a->time < b->time ? -1 : 1;
+    return 0;
+}
+}
+
+String
+PacketTrace::dump(Router *router)
+{
+    HashTable<const Element *, int> eindex(-1);
+    for (int i = 0; i < router->nelements(); ++i)
+	eindex[router->element(i)] = i;
+
+    Vector<Record> records;
+    rings_lock.acquire();
+    for (TraceRing *r = all_rings; r; r = r->next) {
+	uint64_t head = r->head;
+	uint64_t first = head > ring_capacity ? head - ring_capacity : 0;
+	for (uint64_t i = first; i < head; ++i) {
+	    const TraceHop &h = r->hop[i & (ring_capacity - 1)];
+	    int from = eindex.get(h.from), to = eindex.get(h.to);
+	    if (from < 0 || to < 0)
+		continue;
+	    Record rec;
+	    memset(&rec, 0, sizeof(rec));
+	    rec.time = h.time;
+	    rec.trace = h.trace;
+	    rec.thread = h.thread;
+	    rec.kind = h.kind;
+	    rec.from = from;
+	    rec.to = to;
+	    rec.from_port = h.from_port;
+	    rec.to_port = h.to_port;
+	    records.push_back(rec);
+	}
+    }
+    rings_lock.release();
+    if (records.size())
+	click_qsort(records.begin(), records.size(), sizeof(Record),
+		    record_compare);
+
+    StringAccum sa;
+    uint32_t header[8];
+    memcpy(header, "CLKTRACE", 8);
+    header[2] = VERSION;
+    header[3] = router->nelements();
+    uint64_t nrec = records.size();
+    memcpy(&header[4], &nrec, sizeof(nrec));
+    header[6] = _rate;
+    header[7] = 0;
+    sa.append(reinterpret_cast<const char *>(header), sizeof(header));
+    for (int i = 0; i < router->nelements(); ++i) {
+	sa << router->ename(i) << '\0';
+	sa << router->element(i)->class_name() << '\0';
+    }
+    if (records.size())
+	sa.append(reinterpret_cast<const char *>(records.begin()),
+		  records.size() * sizeof(Record));
+    return sa.take_string();
+}
+
+CLICK_ENDDECLS
+#endif
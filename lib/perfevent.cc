@@ -0,0 +1,327 @@
+// -*- c-basic-offset: 4; related-file-name: "../include/click/perfevent.hh" -*-
+/*
+ * perfevent.{cc,hh} -- per-element hardware performance counters
+ */
+
+#include <click/config.h>
+#include <click/element.hh>
+#if HAVE_PERF_EVENTS
+#include <click/router.hh>
+#include <click/straccum.hh>
+#include <click/vector.hh>
+#include <click/atomic.hh>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <string.h>
+CLICK_DECLS
+
+volatile bool PerfEvents::_active;
+int PerfEvents::_nactive;
+
+namespace {
+
+const char * const event_names[PerfEvents::NEVENTS] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"
+};
+const uint64_t event_configs[PerfEvents::NEVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+};
+const char * const kind_names[PerfEvents::NKINDS] = {
+    "xfer", "task", "timer"
+};
+
+// Events some thread has opened.  Written racily, but only ever set.
+bool event_opened[PerfEvents::NEVENTS];
+
+// Each thread opens its own counter group the first time it profiles a call.
+// The group leader is the first event that opens; "order" maps group
+// positions to events.
+struct PerfThread {
+    bool opened;
+    int nfds;
+    int fd[PerfEvents::NEVENTS];
+    int order[PerfEvents::NEVENTS];
+    struct perf_event_mmap_page *page[PerfEvents::NEVENTS];
+    uint64_t child[PerfEvents::NEVENTS];
+};
+
+__thread PerfThread perf_thread;
+
+int
+open_event(int e, int group_fd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = event_configs[e];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+void
+open_thread(PerfThread &t)
+{
+    t.opened = true;
+    t.nfds = 0;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    for (int e = 0; e < PerfEvents::NEVENTS; ++e) {
+	int fd = open_event(e, t.nfds ? t.fd[t.order[0]] : -1);
+	t.fd[e] = fd;
+	if (fd < 0)
+	    continue;
+	void *page = mmap(0, pagesize, PROT_READ, MAP_SHARED, fd, 0);
+	t.page[t.nfds] = (page == MAP_FAILED ? 0 : (struct perf_event_mmap_page *) page);
+	t.order[t.nfds] = e;
+	++t.nfds;
+	event_opened[e] = true;
+    }
+}
+
+#if defined(__i386__) || defined(__x86_64__)
+// Read a counter from user space, following the protocol in
+// <linux/perf_event.h>.  Fails if the kernel does not allow rdpmc or the
+// counter is not currently on the PMU.
+inline bool
+rdpmc_read(volatile struct perf_event_mmap_page *pc, uint64_t &value)
+{
+    uint32_t seq;
+    uint64_t count;
+    do {
+	seq = pc->lock;
+	click_compiler_fence();
+	uint32_t idx = pc->index;
+	if (!pc->cap_user_rdpmc || !idx)
+	    return false;
+	int64_t offset = pc->offset;
+	unsigned width = pc->pmc_width;
+	uint32_t lo, hi;
+	asm volatile("rdpmc" : "=a" (lo), "=d" (hi) : "c" (idx - 1));
+	int64_t pmc = (int64_t) (((uint64_t) hi << 32) | lo);
+	pmc <<= 64 - width;
+	pmc >>= 64 - width;
+	count = offset + pmc;
+	click_compiler_fence();
+    } while (pc->lock != seq);
+    value = count;
+    return true;
+}
+#endif
+
+void
+read_counters(PerfThread &t, uint64_t *v)
+{
+    if (unlikely(!t.opened))
+	open_thread(t);
+    for (int e = 0; e < PerfEvents::NEVENTS; ++e)
+	v[e] = 0;
+    if (t.fd[PerfEvents::CYCLES] < 0)
+	v[PerfEvents::CYCLES] = click_get_cycles();
+    if (!t.nfds)
+	return;
+
+#if defined(__i386__) || defined(__x86_64__)
+    int i;
+    for (i = 0; i < t.nfds; ++i)
+	if (!t.page[i] || !rdpmc_read(t.page[i], v[t.order[i]]))
+	    break;
+    if (i == t.nfds)
+	return;
+#endif
+
+    uint64_t buf[1 + PerfEvents::NEVENTS];
+    if (read(t.fd[t.order[0]], buf, sizeof(buf)) > 0)
+	for (uint64_t i = 0; i < buf[0] && i < (uint64_t) t.nfds; ++i)
+	    v[t.order[i]] = buf[1 + i];
+}
+
+}
+
+void
+PerfEvents::close_thread()
+{
+    PerfThread &t = perf_thread;
+    if (!t.opened)
+	return;
+    long pagesize = sysconf(_SC_PAGESIZE);
+    for (int i = 0; i < t.nfds; ++i)
+	if (t.page[i])
+	    munmap(t.page[i], pagesize);
+    for (int e = 0; e < NEVENTS; ++e)
+	if (t.fd[e] >= 0)
+	    close(t.fd[e]);
+    t.opened = false;
+    t.nfds = 0;
+}
+
+void
+PerfEvents::ElementProfile::clear()
+{
+    memset(kind, 0, sizeof(kind));
+}
+
+const char *
+PerfEvents::event_name(int e)
+{
+    return (unsigned) e < NEVENTS ? event_names[e] : "?";
+}
+
+const char *
+PerfEvents::kind_name(int k)
+{
+    return (unsigned) k < NKINDS ? kind_names[k] : "?";
+}
+
+bool
+PerfEvents::event_available(int e)
+{
+    return (unsigned) e < NEVENTS && event_opened[e];
+}
+
+void
+PerfEvents::enter(Frame &f)
+{
+    PerfThread &t = perf_thread;
+    read_counters(t, f.start);
+    for (int e = 0; e < NEVENTS; ++e) {
+	f.saved_child[e] = t.child[e];
+	t.child[e] = 0;
+    }
+}
+
+void
+PerfEvents::exit(Frame &f, Element *elt, int kind)
+{
+    PerfThread &t = perf_thread;
+    uint64_t now[NEVENTS];
+    read_counters(t, now);
+    // An element running on several threads at once may lose a few counts
+    // here; profiles are statistics, not ledgers.
+    Counts *c = elt && elt->_perf ? &elt->_perf->kind[kind] : 0;
+    if (c)
+	++c->calls;
+    for (int e = 0; e < NEVENTS; ++e) {
+	uint64_t all = now[e] - f.start[e];
+	if (c)
+	    c->v[e] += all - t.child[e];
+	t.child[e] = f.saved_child[e] + all;
+    }
+}
+
+void
+PerfEvents::set_active(Router *router, bool active)
+{
+    void *&attached = router->force_attachment("PerfEvents");
+    if (active && !attached) {
+	for (int i = 0; i < router->nelements(); ++i) {
+	    Element *e = router->element(i);
+	    if (!e->_perf)
+		e->_perf = new ElementProfile;
+	}
+	++_nactive;
+    } else if (!active && attached)
+	--_nactive;
+    attached = active ? router : 0;
+    click_fence();
+    _active = _nactive > 0;
+    Element::Port::set_hook(Element::Port::hook_perf, _active);
+}
+
+void
+PerfEvents::reset(Router *router)
+{
+    for (int i = 0; i < router->nelements(); ++i)
+	if (ElementProfile *p = router->element(i)->_perf)
+	    p->clear();
+}
+
+void
+PerfEvents::unparse_element(StringAccum &sa, const Element *elt)
+{
+    if (!elt->_perf)
+	return;
+    for (int k = 0; k < NKINDS; ++k) {
+	const Counts &c = elt->_perf->kind[k];
+	if (!c.calls)
+	    continue;
+	sa << kind_names[k] << ' ' << c.calls;
+	for (int e = 0; e < NEVENTS; ++e)
+	    sa << ' ' << c.v[e];
+	sa << '\n';
+    }
+}
+
+namespace {
+struct ReportRow {
+    Element *e;
+    PerfEvents::Counts total;
+};
+
+int
+report_row_compare(const void *ap, const void *bp, void *)
+{
+    const ReportRow *a = static_cast<const ReportRow *>(ap);
+    const ReportRow *b = static_cast<const ReportRow *>(bp);
+    uint64_t ac = a->total.v[PerfEvents::CYCLES], bc = b->total.v[PerfEvents::CYCLES];
+    if (ac != bc)
+	return ac > bc ? -1 : 1;
+    return a->e->eindex() - b->e->eindex();
+}
+}
+
+void
+PerfEvents::unparse_report(StringAccum &sa, Router *router)
+{
+    Vector<ReportRow> rows;
+    uint64_t all_cycles = 0;
+    for (int i = 0; i < router->nelements(); ++i) {
+	Element *e = router->element(i);
+	if (!e->_perf)
+	    continue;
+	ReportRow row;
+	row.e = e;
+	memset(&row.total, 0, sizeof(row.total));
+	for (int k = 0; k < NKINDS; ++k) {
+	    const Counts &c = e->_perf->kind[k];
+	    row.total.calls += c.calls;
+	    for (int ev = 0; ev < NEVENTS; ++ev)
+		row.total.v[ev] += c.v[ev];
+	}
+	if (row.total.calls) {
+	    rows.push_back(row);
+	    all_cycles += row.total.v[CYCLES];
+	}
+    }
+    if (rows.size())
+	click_qsort(rows.begin(), rows.size(), sizeof(ReportRow),
+		    report_row_compare);
+
+    sa << "# cycles from " << (event_opened[CYCLES] ? "perf" : "tsc");
+    for (int ev = INSTRUCTIONS; ev < NEVENTS; ++ev)
+	if (!event_opened[ev])
+	    sa << ", no " << event_names[ev];
+    sa << '\n';
+    sa.snprintf(128, "%6s %14s %10s %9s %5s %11s %11s  %s\n",
+		"%cyc", "cycles", "calls", "cyc/call", "ipc",
+		"llc_misses", "br_misses", "element");
+    for (ReportRow *r = rows.begin(); r != rows.end(); ++r) {
+	const Counts &c = r->total;
+	double share = all_cycles ? 100. * c.v[CYCLES] / all_cycles : 0;
+	double ipc = c.v[CYCLES] ? (double) c.v[INSTRUCTIONS] / c.v[CYCLES] : 0;
+	sa.snprintf(128, "%6.2f %14llu %10llu %9llu %5.2f %11llu %11llu  ",
+		    share, (unsigned long long) c.v[CYCLES],
+		    (unsigned long long) c.calls,
+		    (unsigned long long) (c.v[CYCLES] / c.calls), ipc,
+		    (unsigned long long) c.v[LLC_MISSES],
+		    (unsigned long long) c.v[BRANCH_MISSES]);
+	sa << r->e->name() << " (" << r->e->class_name() << ")\n";
+    }
+}
+
+CLICK_ENDDECLS
+#endif
@@ -34,6 +34,7 @@
 #include <click/notifier.hh>
 #include <click/nameinfo.hh>
 #include <click/bighashmap_arena.hh>
+#include <click/packettrace.hh>
 #if CLICK_STATS >= 2
 # include <click/hashtable.hh>
 #endif
@@ -122,6 +123,14 @@ Router::~Router()
             _elements[i]->cleanup(Element::CLEANUP_NO_ROUTER);
     }
 
+#if HAVE_PERF_EVENTS
+    // Stop profiling on this router's behalf
+    PerfEvents::set_active(this, false);
+#endif
+#if HAVE_PACKET_TRACE
+    PacketTrace::stop(this);
+#endif
+
     // Delete elements in reverse configuration order
     if (_element_configure_order.size())
         for (int ord = _elements.size() - 1; ord >= 0; ord--)
@@ -1090,6 +1099,7 @@ Router::initialize(ErrorHandler *errh)
     if (_state != ROUTER_NEW)
         return errh->error("second attempt to initialize router");
     _state = ROUTER_PRECONFIGURE;
+    Timestamp load_start = Timestamp::now_steady(), load_now;
 
     // initialize handlers to empty
     initialize_handlers(false, false);
@@ -1128,6 +1138,9 @@ Router::initialize(ErrorHandler *errh)
             all_ok = true;
         }
     }
+    load_now = Timestamp::now_steady();
+    add_load_time(LOAD_CHECK, load_now - load_start);
+    load_start = load_now;
 
     // prepare master
     _runcount = 1;
@@ -1164,6 +1177,9 @@ Router::initialize(ErrorHandler *errh)
                 element_stage[i] = Element::CLEANUP_CONFIGURED;
         }
     }
+    load_now = Timestamp::now_steady();
+    add_load_time(LOAD_CONFIGURE, load_now - load_start);
+    load_start = load_now;
 
 #if CLICK_DMALLOC
     CLICK_DMALLOC_REG("iHoo");
@@ -1173,6 +1189,9 @@ Router::initialize(ErrorHandler *errh)
     if (all_ok) {
         _state = ROUTER_PREINITIALIZE;
         initialize_handlers(true, true);
+        load_now = Timestamp::now_steady();
+        add_load_time(LOAD_HANDLERS, load_now - load_start);
+        load_start = load_now;
         for (int ord = 0; all_ok && ord < _elements.size(); ord++) {
             int i = _element_configure_order[ord];
             assert(element_stage[i] == Element::CLEANUP_CONFIGURED);
@@ -1193,6 +1212,7 @@ Router::initialize(ErrorHandler *errh)
                 all_ok = false;
             }
         }
+        add_load_time(LOAD_INITIALIZE, Timestamp::now_steady() - load_start);
     }
 
 #if CLICK_DMALLOC
@@ -1946,6 +1966,12 @@ ThreadSched::initial_home_thread_id(const Element *)
     return 0;
 }
 
+int
+ThreadSched::initial_steal_policy(const Element *)
+{
+    return STEAL_UNKNOWN;
+}
+
 /** @cond never */
 /** @brief  Create (if necessary) and return the NameInfo object for this router.
  *
@@ -2185,10 +2211,22 @@ Router::configuration_string() const
     }
 }
 
+const char *
+Router::load_phase_name(int phase)
+{
+    static const char * const names[NLOAD_PHASES] = {
+        "lex", "build", "check", "configure", "handlers", "initialize"
+    };
+    return (unsigned) phase < NLOAD_PHASES ? names[phase] : "?";
+}
+
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES,
+       GH_PERF_PROFILING, GH_PERF_REPORT, GH_RESET_PERF,
+       GH_TRACE_SAMPLE, GH_TRACE_DUMP, GH_TRACE_STATS, GH_RESET_TRACE,
+       GH_LOAD_PROFILE };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2375,6 +2413,42 @@ Router::router_read_handler(Element *e, void *thunk)
     }
 #endif
 
+#if HAVE_PERF_EVENTS
+    case GH_PERF_PROFILING:
+        return String(r && r->attachment("PerfEvents") != 0);
+
+    case GH_PERF_REPORT:
+        if (r)
+            PerfEvents::unparse_report(sa, r);
+        break;
+#endif
+
+    case GH_LOAD_PROFILE:
+        if (r) {
+            Timestamp total;
+            for (int phase = 0; phase < NLOAD_PHASES; ++phase) {
+                sa << load_phase_name(phase) << ' ' << r->load_time(phase) << '\n';
+                total += r->load_time(phase);
+            }
+            sa << "total " << total << '\n';
+        }
+        break;
+
+#if HAVE_PACKET_TRACE
+    case GH_TRACE_SAMPLE:
+        return String(r && PacketTrace::traced_router() == r ? PacketTrace::sample_rate() : 0);
+
+    case GH_TRACE_DUMP:
+        if (r)
+            return PacketTrace::dump(r);
+        break;
+
+    case GH_TRACE_STATS:
+        sa << "sampled " << PacketTrace::nsampled() << '\n'
+           << "records " << PacketTrace::nrecords() << '\n';
+        break;
+#endif
+
     }
     return sa.take_string();
 }
@@ -2400,6 +2474,30 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
         for (int i = 0; i < (r ? r->nelements() : 0); i++)
             r->_elements[i]->reset_cycles();
         break;
+#endif
+#if HAVE_PERF_EVENTS
+    case GH_PERF_PROFILING: {
+        bool on;
+        if (!BoolArg().parse(cp_uncomment(s), on))
+            return errh->error("syntax error");
+        PerfEvents::set_active(r, on);
+        break;
+    }
+    case GH_RESET_PERF:
+        PerfEvents::reset(r);
+        break;
+#endif
+#if HAVE_PACKET_TRACE
+    case GH_TRACE_SAMPLE: {
+        uint32_t rate;
+        if (!IntArg().parse(cp_uncomment(s), rate))
+            return errh->error("syntax error");
+        PacketTrace::set_sample_rate(r, rate);
+        break;
+    }
+    case GH_RESET_TRACE:
+        PacketTrace::reset();
+        break;
 #endif
     default:
         break;
@@ -2420,6 +2518,7 @@ Router::static_initialize()
         add_read_handler(0, "handlers", Element::read_handlers_handler, 0);
         add_read_handler(0, "list", router_read_handler, (void *)GH_LIST);
         add_write_handler(0, "stop", router_write_handler, (void *)GH_STOP);
+        add_read_handler(0, "load_profile", router_read_handler, (void *)GH_LOAD_PROFILE);
 #if CLICK_STATS >= 1
         add_read_handler(0, "active_ports", router_read_handler, (void *)GH_ACTIVE_PORTS);
         add_read_handler(0, "active_port_stats", router_read_handler, (void *)GH_ACTIVE_PORT_STATS);
@@ -2437,6 +2536,19 @@ Router::static_initialize()
         add_read_handler(0, "element_cycles.csv", router_read_handler, (void *)GH_ELEMENT_CYCLES);
         add_read_handler(0, "class_cycles.csv", router_read_handler, (void *)GH_CLASS_CYCLES);
         add_write_handler(0, "reset_cycles", router_write_handler, (void *)GH_RESET_CYCLES);
+#endif
+#if HAVE_PERF_EVENTS
+        add_read_handler(0, "perf_profiling", router_read_handler, (void *)GH_PERF_PROFILING);
+        add_write_handler(0, "perf_profiling", router_write_handler, (void *)GH_PERF_PROFILING);
+        add_read_handler(0, "perf_report", router_read_handler, (void *)GH_PERF_REPORT);
+        add_write_handler(0, "reset_perf", router_write_handler, (void *)GH_RESET_PERF);
+#endif
+#if HAVE_PACKET_TRACE
+        add_read_handler(0, "trace_sample", router_read_handler, (void *)GH_TRACE_SAMPLE);
+        add_write_handler(0, "trace_sample", router_write_handler, (void *)GH_TRACE_SAMPLE);
+        add_read_handler(0, "trace_dump", router_read_handler, (void *)GH_TRACE_DUMP, Handler::f_raw);
+        add_read_handler(0, "trace_stats", router_read_handler, (void *)GH_TRACE_STATS);
+        add_write_handler(0, "reset_trace", router_write_handler, (void *)GH_RESET_TRACE);
 #endif
     }
 }
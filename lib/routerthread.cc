@@ -70,7 +70,8 @@ RouterThread::RouterThread(Master *master, int id)
     : _stop_flag(false), _master(master), _id(id), _driver_entered(false)
 {
     _pending_head.x = 0;
-    _pending_tail = &_pending_head;
+    _pending_since = 0;
+    reset_pending_counts();
 
 #if !HAVE_TASK_HEAP
     _task_link._prev = _task_link._next = &_task_link;
@@ -83,6 +84,14 @@ RouterThread::RouterThread(Master *master, int id)
 
     _task_blocker = 0;
     _task_blocker_waiting = 0;
+#if HAVE_MULTITHREAD
+    for (int i = 0; i < STEAL_SLOTS; ++i)
+        _steal_slots[i] = 0;
+    _steal_hazard = 0;
+    _steal_idle = false;
+    _steal_victim = 0;
+    _steals = _steal_attempts = _migrations = 0;
+#endif
 #if HAVE_ADAPTIVE_SCHEDULER
     _max_click_share = 80 * Task::MAX_UTILIZATION / 100;
     _min_click_share = Task::MAX_UTILIZATION / 200;
@@ -171,6 +180,113 @@ RouterThread::scheduled_tasks(Router *router, Vector<Task *> &x)
 }
 
 
+/******************************/
+/* Work stealing              */
+/******************************/
+
+#if HAVE_MULTITHREAD
+
+void
+RouterThread::reset_steal_counts()
+{
+    _steals = _steal_attempts = _migrations = 0;
+}
+
+/* Offer this thread's stealable tasks to idle threads.  Called by the driver
+   with the task list locked.  The first scheduled task stays put: a thread
+   with one runnable task has nothing to give away. */
+void
+RouterThread::publish_stealable_tasks()
+{
+    _steal_lock.acquire();
+
+    int nfree = 0;
+    for (int i = 0; i < STEAL_SLOTS; ++i)
+        if (Task *t = _steal_slots[i]) {
+            if (t->_status.home_thread_id != _id)
+                __sync_bool_compare_and_swap(&_steal_slots[i], t, (Task *) 0);
+            else
+                continue;
+        } else
+            ++nfree;
+
+    bool published = false;
+    Task *t = task_begin();
+    if (t != task_end())
+        t = task_next(t);
+    for (int slot = 0; nfree > 0 && t != task_end(); t = task_next(t)) {
+        if (!t->_stealable || t->_status.home_thread_id != _id)
+            continue;
+        int i;
+        for (i = 0; i < STEAL_SLOTS && _steal_slots[i] != t; ++i)
+            /* nada */;
+        if (i < STEAL_SLOTS)
+            continue;
+        while (_steal_slots[slot])
+            ++slot;
+        _steal_slots[slot] = t;
+        --nfree;
+        published = true;
+    }
+
+    _steal_lock.release();
+
+    if (published)
+        for (int i = 0; i < _master->nthreads(); ++i) {
+            RouterThread *thief = _master->thread(i);
+            if (thief != this && thief->_steal_idle) {
+                thief->wake();
+                break;
+            }
+        }
+}
+
+/* Try to claim one task published by another thread.  Victims are visited
+   round-robin so that several idle threads spread over the busy ones. */
+bool
+RouterThread::steal_task()
+{
+    int n = _master->nthreads();
+    ++_steal_attempts;
+    for (int v = 0; v < n; ++v) {
+        _steal_victim = (_steal_victim + 1) % n;
+        RouterThread *victim = _master->thread(_steal_victim);
+        if (victim == this)
+            continue;
+        for (int i = 0; i < STEAL_SLOTS; ++i) {
+            Task *t = victim->_steal_slots[i];
+            if (!t)
+                continue;
+            _steal_hazard = t;
+            click_fence();
+            bool ok = victim->_steal_slots[i] == t
+                && __sync_bool_compare_and_swap(&victim->_steal_slots[i], t, (Task *) 0)
+                && t->steal(victim->_id, _id);
+            click_fence();
+            _steal_hazard = 0;
+            if (ok) {
+                ++_steals;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* Remove @a t from this thread's steal slots. */
+void
+RouterThread::unpublish_task(Task *t)
+{
+    _steal_lock.acquire();
+    for (int i = 0; i < STEAL_SLOTS; ++i)
+        if (_steal_slots[i] == t)
+            __sync_bool_compare_and_swap(&_steal_slots[i], t, (Task *) 0);
+    _steal_lock.release();
+}
+
+#endif
+
+
 /******************************/
 /* Adaptive scheduler         */
 /******************************/
@@ -533,22 +649,110 @@ RouterThread::process_pending()
 {
     // must be called with thread's lock acquired
 
-    // claim the current pending list
+    // claim the current pending stack, which lists the most recently
+    // added task first
     set_thread_state(RouterThread::S_RUNPENDING);
-    SpinlockIRQ::flags_t flags = _pending_lock.acquire();
-    Task::Pending my_pending = _pending_head;
-    _pending_head.x = 0;
-    _pending_tail = &_pending_head;
-    _pending_lock.release(flags);
-
-    // process the list
+    Task::Pending my_pending;
+    my_pending.x = __sync_lock_test_and_set(&_pending_head.x, (uintptr_t) 0);
+    if (my_pending.x == 0)
+        return;
+    click_cycles_t since = _pending_since;
+
+    // reverse it so tasks are processed in the order they were added
+    Task::Pending fifo;
+    fifo.x = 2;
+    unsigned n = 0;
     while (my_pending.x > 2) {
         Task *t = my_pending.t;
         my_pending = t->_pending_nextptr;
+        t->_pending_nextptr = fifo;
+        fifo.t = t;
+        ++n;
+    }
+
+    _pending_tasks += n;
+    ++_pending_batches;
+    // _pending_since may already belong to a newer push; ignore such waits
+    click_cycles_t now = click_get_cycles();
+    if (now >= since) {
+        _pending_wait_cycles += now - since;
+        if (now - since > _pending_wait_max_cycles)
+            _pending_wait_max_cycles = now - since;
+    }
+
+    // process the list
+    while (fifo.x > 2) {
+        Task *t = fifo.t;
+        fifo = t->_pending_nextptr;
         t->process_pending(this);
     }
 }
 
+/** @brief Push @a t onto this thread's pending stack and wake the thread.
+ *
+ * The caller must have claimed @a t's pending state (see
+ * Task::add_pending()). Safe to call from any thread. */
+void
+RouterThread::push_pending(Task *t)
+{
+    uintptr_t old;
+    do {
+        old = _pending_head.x;
+        if (old == 0) {
+            t->_pending_nextptr.x = 2;
+            _pending_since = click_get_cycles();
+        } else
+            t->_pending_nextptr.x = old;
+    } while (__sync_val_compare_and_swap(&_pending_head.x, old, (uintptr_t) t) != old);
+    add_pending();
+}
+
+/** @brief Remove @a t from this thread's pending stack, if it is there.
+ *
+ * Must be called by this thread, or with its tasks locked, since only one
+ * thread at a time may take tasks off the stack. Other threads may push
+ * concurrently; the remaining tasks keep their order. */
+void
+RouterThread::remove_pending(Task *t)
+{
+    click_cycles_t since = _pending_since;
+    Task::Pending head;
+    head.x = __sync_lock_test_and_set(&_pending_head.x, (uintptr_t) 0);
+
+    Task::Pending *tptr = &head;
+    while (tptr->x > 2 && tptr->t != t)
+        tptr = &tptr->t->_pending_nextptr;
+    if (tptr->x > 2) {
+        *tptr = t->_pending_nextptr;
+        click_fence();
+        t->_pending_nextptr.x = 0;
+    }
+    if (head.x <= 2)
+        return;
+
+    // put the rest back underneath anything pushed in the meantime
+    Task *last = head.t;
+    while (last->_pending_nextptr.x > 2)
+        last = last->_pending_nextptr.t;
+    uintptr_t old;
+    do {
+        old = _pending_head.x;
+        if (old == 0) {
+            last->_pending_nextptr.x = 2;
+            _pending_since = since;
+        } else
+            last->_pending_nextptr.x = old;
+    } while (__sync_val_compare_and_swap(&_pending_head.x, old, head.x) != old);
+}
+
+void
+RouterThread::reset_pending_counts()
+{
+    _pending_tasks = _pending_batches = 0;
+    _pending_wait_cycles = 0;
+    _pending_wait_max_cycles = 0;
+}
+
 void
 RouterThread::driver()
 {
@@ -613,6 +817,19 @@ RouterThread::driver()
             run_tasks(_tasks_per_iter);
         } while (0);
 
+#if HAVE_MULTITHREAD
+        // offer spare tasks to idle threads, or steal one; at most one
+        // steal per OS visit, since a stolen task arrives only once its old
+        // thread processes it
+        if (_master->task_stealing() && iter % _iters_per_os == 0) {
+            if (active()) {
+                _steal_idle = false;
+                publish_stealable_tasks();
+            } else
+                _steal_idle = !steal_task();
+        }
+#endif
+
 #if CLICK_USERLEVEL
         // run signals
         run_signals();
@@ -653,6 +870,9 @@ RouterThread::driver()
     }
 
     driver_unlock_tasks();
+#if HAVE_PERF_EVENTS
+    PerfEvents::close_thread();
+#endif
 
     _driver_entered = false;
 #if HAVE_ADAPTIVE_SCHEDULER
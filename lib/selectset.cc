@@ -33,6 +33,12 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+# include <sys/epoll.h>
+#endif
+#if HAVE_SYS_EVENTFD_H
+# include <sys/eventfd.h>
+#endif
 CLICK_DECLS
 
 namespace {
@@ -46,6 +52,7 @@ SelectSet::SelectSet()
 {
     _wake_pipe_pending = false;
     _wake_pipe[0] = _wake_pipe[1] = -1;
+    _doorbells = 0;
 
 #if HAVE_ALLOW_KQUEUE
 # if defined(__APPLE__) && (HAVE_ALLOW_SELECT || HAVE_ALLOW_POLL)
@@ -57,6 +64,9 @@ SelectSet::SelectSet()
     _kqueue = kqueue();
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+#endif
 
 #if !HAVE_ALLOW_POLL
     FD_ZERO(&_read_select_fd_set);
@@ -85,16 +95,30 @@ SelectSet::~SelectSet()
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0)
 	close(_kqueue);
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
 #endif
     if (_wake_pipe[0] >= 0) {
 	close(_wake_pipe[0]);
-	close(_wake_pipe[1]);
+	if (_wake_pipe[1] != _wake_pipe[0])
+	    close(_wake_pipe[1]);
     }
 }
 
 void
 SelectSet::initialize()
 {
+#if HAVE_SYS_EVENTFD_H
+    if (_wake_pipe[0] < 0) {
+	int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (fd >= 0) {
+	    _wake_pipe[0] = _wake_pipe[1] = fd;
+	    register_select(fd, true, false);
+	}
+    }
+#endif
     if (_wake_pipe[0] < 0 && pipe(_wake_pipe) >= 0) {
 	fcntl(_wake_pipe[0], F_SETFL, O_NONBLOCK);
 	fcntl(_wake_pipe[1], F_SETFL, O_NONBLOCK);
@@ -103,6 +127,10 @@ SelectSet::initialize()
 	register_select(_wake_pipe[0], true, false);
     }
     assert(_wake_pipe[0] >= 0);
+    // Wakeups before now had nowhere to go.  Our thread checks for work
+    // before it first blocks, so just let later wakeups write.
+    _wake_pipe_pending = false;
+    click_fence();
 }
 
 void
@@ -140,10 +168,17 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
     int pi = _selinfo[fd].pollfd;
 
     // add the elements
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
     if (add_read)
 	_pollfds[pi].events |= POLLIN;
     if (add_write)
 	_pollfds[pi].events |= POLLOUT;
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	epoll_update(fd, old_events, _pollfds[pi].events);
+#endif
 
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0) {
@@ -237,8 +272,12 @@ SelectSet::add_select(int fd, Element *element, int mask)
 	_selinfo[fd].write = element;
 
 #if HAVE_MULTITHREAD
-    // need to wake up selecting thread since there's more to select
-    wake_immediate();
+    // need to wake up selecting thread since there's more to select;
+    // epoll_wait() notices new file descriptors on its own
+# if HAVE_ALLOW_EPOLL
+    if (_epoll < 0)
+# endif
+	wake_immediate();
 #endif
 
     unlock();
@@ -252,6 +291,10 @@ SelectSet::remove_pollfd(int pi, int event)
 
     // remove event
     int fd = _pollfds[pi].fd;
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	epoll_update(fd, _pollfds[pi].events, _pollfds[pi].events & ~event);
+#endif
     _pollfds[pi].events &= ~event;
     if (event == POLLIN)
 	_selinfo[fd].read = 0;
@@ -297,6 +340,50 @@ SelectSet::remove_pollfd(int pi, int event)
 #endif
 }
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::epoll_update(int fd, int old_events, int new_events)
+{
+    struct epoll_event ev;
+    ev.events = (new_events & POLLIN ? (uint32_t) EPOLLIN : 0)
+	| (new_events & POLLOUT ? (uint32_t) EPOLLOUT : 0);
+    ev.data.u64 = 0;
+    ev.data.fd = fd;
+    int op = !old_events ? EPOLL_CTL_ADD
+	: new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL;
+    int r = epoll_ctl(_epoll, op, fd, &ev);
+    // The kernel forgets a closed file descriptor on its own, so its number
+    // may come back registered or unregistered.
+    if (r < 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+	r = epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+    else if (r < 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+	r = epoll_ctl(_epoll, EPOLL_CTL_MOD, fd, &ev);
+    if (r < 0 && op != EPOLL_CTL_DEL) {
+	// Not all file descriptors are epollable (regular files, for
+	// instance).  So if we encounter a problem, fall back to poll() or
+	// select(), which _pollfds always supports.
+	close(_epoll);
+	_epoll = -1;
+    }
+}
+
+void
+SelectSet::set_epoll(bool epoll)
+{
+    lock();
+    if (epoll && _epoll < 0) {
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+	for (int pi = 0; _epoll >= 0 && pi < _pollfds.size(); ++pi)
+	    epoll_update(_pollfds[pi].fd, 0, _pollfds[pi].events);
+    } else if (!epoll && _epoll >= 0) {
+	close(_epoll);
+	_epoll = -1;
+    }
+    unlock();
+    wake_immediate();
+}
+#endif
+
 int
 SelectSet::remove_select(int fd, Element *element, int mask)
 {
@@ -338,12 +425,8 @@ SelectSet::post_select(RouterThread *thread, bool acquire)
     (void) acquire;
 #endif
 
-    if (_wake_pipe_pending) {
-	_wake_pipe_pending = false;
-	char crap[64];
-	while (read(_wake_pipe[0], crap, 64) == 64)
-	    /* do nothing */;
-    }
+    if (_wake_pipe_pending)
+	drain_wake_pipe();
 
     if (thread->master()->paused() || thread->stop_flag())
 	return true;
@@ -352,9 +435,39 @@ SelectSet::post_select(RouterThread *thread, bool acquire)
     return false;
 }
 
+void
+SelectSet::drain_wake_pipe()
+{
+    if (_wake_pipe[1] == _wake_pipe[0]) {
+	// eventfd: one read returns and resets the count
+	uint64_t count;
+	if (read(_wake_pipe[0], &count, sizeof(count)) == (ssize_t) sizeof(count))
+	    _doorbells += count;
+    } else {
+	char crap[64];
+	ssize_t r;
+	while ((r = read(_wake_pipe[0], crap, 64)) > 0) {
+	    _doorbells += r;
+	    if (r < 64)
+		break;
+	}
+    }
+    // Clear the flag only after draining: a wakeup that finds the flag set
+    // skips its write, and relies on our caller to look for its work
+    // afterwards.
+    _wake_pipe_pending = false;
+    click_fence();
+}
+
 inline void
-SelectSet::call_selected(int fd, int mask) const
+SelectSet::call_selected(int fd, int mask)
 {
+    // A wakeup can land after post_select() has drained the pipe; drain it
+    // here so it does not stay readable.
+    if (fd == _wake_pipe[0]) {
+	drain_wake_pipe();
+	return;
+    }
     Element *read = 0, *write = 0;
     if ((unsigned) fd < (unsigned) _selinfo.size()) {
 	const SelectorInfo &es = _selinfo[fd];
@@ -424,6 +537,48 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
 }
 #endif /* HAVE_ALLOW_KQUEUE */
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::run_selects_epoll(RouterThread *thread)
+{
+# if HAVE_MULTITHREAD
+    click_fence();
+    _select_lock.release();
+# endif
+
+    // Decide how long to wait.
+    int timeout;
+    Timestamp t;
+    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    if (delay_type == 0)
+	timeout = 0;
+    else if (delay_type > 0)
+	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+    else
+	timeout = -1;
+    thread->set_thread_state_for_blocking(delay_type);
+
+    // Unlike poll(), epoll_wait() returns only ready file descriptors, so
+    // dispatch costs O(ready) rather than O(registered).
+    struct epoll_event ev[256];
+    int n = epoll_wait(_epoll, &ev[0], 256, timeout);
+    int was_errno = errno;
+
+    if (post_select(thread, true))
+	return;
+
+    thread->set_thread_state(RouterThread::S_RUNSELECT);
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; ++p) {
+	    int mask = (p->events & ~EPOLLOUT ? Element::SELECT_READ : 0)
+		+ (p->events & ~EPOLLIN ? Element::SELECT_WRITE : 0);
+	    call_selected(p->data.fd, mask);
+	}
+}
+#endif /* HAVE_ALLOW_EPOLL */
+
 #if HAVE_ALLOW_POLL
 void
 SelectSet::run_selects_poll(RouterThread *thread)
@@ -571,6 +726,12 @@ SelectSet::run_selects(RouterThread *thread)
 
     // Call the relevant selector implementation.
     do {
+#if HAVE_ALLOW_EPOLL
+	if (_epoll >= 0) {
+	    run_selects_epoll(thread);
+	    break;
+	}
+#endif
 #if HAVE_ALLOW_KQUEUE
 	if (_kqueue >= 0) {
 	    run_selects_kqueue(thread);
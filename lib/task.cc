@@ -25,6 +25,7 @@
 #include <click/router.hh>
 #include <click/routerthread.hh>
 #include <click/master.hh>
+#include <click/standard/threadsched.hh>
 CLICK_DECLS
 
 /** @file task.hh
@@ -91,13 +92,13 @@ CLICK_DECLS
 // Lock protection:
 // - _status, which contains home_thread_id, is_scheduled, and
 //   is_strong_unscheduled, may be changed at any time without locking.
-// - Changes to _thread are protected by old(_thread)->_pending_lock.
-//   Furthermore, only old(_thread) itself may change _thread
-//   (except that if old(_thread) is quiescent, anyone may change _thread).
-// - _pending_nextptr is generally protected by _thread->_pending_lock.
-//   It may be set by another thread only if it is 0.
-//   After acquiring _thread->_pending_lock, verify that _thread has not
-//   changed.
+// - Only old(_thread) itself may change _thread, while processing the task
+//   (_pending_nextptr.x == 1). If old(_thread) is quiescent, whoever claims
+//   the task's pending state may change _thread.
+// - _pending_nextptr is claimed by compare-and-swap from 0 (or, for the
+//   processing thread, from 1) to 2. Only the claimer may then push the
+//   task onto _thread's pending stack, or reset _pending_nextptr to 0.
+//   Once pushed, only _thread itself may take the task off the stack.
 // - _thread may be read at any time. However, if it is being read from a
 //   different thread, it might change underneath. Read it into a local
 //   variable. To arrange for _thread to change, set home_thread_id and
@@ -223,46 +224,36 @@ Task::complete_schedule(RouterThread* process_pending_thread)
 void
 Task::add_pending(bool always)
 {
-    // lock current thread and wait for current process_pending to complete
-    // (indicated by _pending_nextptr.x == 1)
-    RouterThread* thread;
-    SpinlockIRQ::flags_t flags;
+    // claim the pending state; wait for a current process_pending to
+    // complete (indicated by _pending_nextptr.x == 1) unless we are it
     while (1) {
-        thread = _thread;
-        flags = thread->_pending_lock.acquire();
-        if (thread == _thread && (_pending_nextptr.x != 1 || always))
+        uintptr_t x = _pending_nextptr.x;
+        if (x >= 2)
+            return;
+        if (x == 1 && !always) {
+            click_relax_fence();
+            continue;
+        }
+        if (__sync_bool_compare_and_swap(&_pending_nextptr.x, x, (uintptr_t) 2))
             break;
-        thread->_pending_lock.release(flags);
     }
 
     // quiescent threads have no pending list; if current thread is
     // quiescent, but task has been moved, change threads now
+    RouterThread* thread = _thread;
     if (thread->thread_id() < 0 && _status.home_thread_id >= 0) {
-        assert(!on_scheduled_list() && !on_pending_list());
-        RouterThread* next_thread = thread->master()->thread(_status.home_thread_id);
-        if (next_thread != thread) {
-            // No deadlock: lock order by thread_id()
-            SpinlockIRQ::flags_t next_flags = next_thread->_pending_lock.acquire();
-            _thread = next_thread;
-            thread->_pending_lock.release(flags);
-            thread = next_thread;
-            flags = next_flags;
-        }
+        assert(!on_scheduled_list());
+        thread = thread->master()->thread(_status.home_thread_id);
+        _thread = thread;
     }
 
     // add to list, unless the router is in the process of dying
-    if (_pending_nextptr.x < 2) {
-        assert(_pending_nextptr.x == 0 || always);
-        if (thread->thread_id() >= 0 && !router()->dying()) {
-            _pending_nextptr.x = 2;
-            thread->_pending_tail->t = this;
-            thread->_pending_tail = &_pending_nextptr;
-            thread->add_pending();
-        } else
-            _pending_nextptr.x = 0;
+    if (thread->thread_id() >= 0 && !router()->dying())
+        thread->push_pending(this);
+    else {
+        click_fence();
+        _pending_nextptr.x = 0;
     }
-
-    thread->_pending_lock.release(flags);
 }
 
 
@@ -273,6 +264,13 @@ Task::initialize(Element *owner, bool schedule)
 
     Router *router = owner->router();
     int tid = _status.home_thread_id;
+#if HAVE_MULTITHREAD
+    // A home set with move_thread() before initialization is an affinity
+    // hint; such tasks are never stolen.
+    ThreadSched *ts = router->thread_sched();
+    _stealable = tid == -2 && ts
+        && ts->initial_steal_policy(owner) == ThreadSched::STEAL_ALLOWED;
+#endif
     if (tid == -2)
         tid = router->home_thread_id(owner);
     // Master::thread() returns the quiescent thread if its argument is out of
@@ -313,6 +311,11 @@ Task::cleanup()
         _status.home_thread_id = -1;
         click_fence();
 
+#if HAVE_MULTITHREAD
+        // Make sure no thread can still steal the task.
+        _thread->master()->unpublish_task(this);
+#endif
+
         // Task must not be scheduled. If scheduled on another thread, wait
         // for that thread to notice. If scheduled on this thread, remove
         // it ourselves.
@@ -334,27 +337,13 @@ Task::cleanup()
                 continue;
             }
 
-            SpinlockIRQ::flags_t flags = thread->_pending_lock.acquire();
-            if (thread == _thread && on_pending_list()) {
-                Pending *tptr = &thread->_pending_head;
-                while (tptr->x > 2 && tptr->t != this)
-                    tptr = &tptr->t->_pending_nextptr;
-                // We'll usually have `tptr->t == this`; but if another
-                // thread's `Task::process_pending()` has just set
-                // `this->_thread` to this thread (because of an earlier
-                // move_thread), we might have `tptr->x == 1` (because the
-                // task is on the other thread's pending list still).
-                if (tptr->t == this) {
-                    *tptr = _pending_nextptr;
-                    if (_pending_nextptr.x == 2) {
-                        thread->_pending_tail = tptr;
-                        if (tptr == &thread->_pending_head)
-                            tptr->x = 0;
-                    }
-                    _pending_nextptr.x = 0;
-                }
-            }
-            thread->_pending_lock.release(flags);
+            // The task might be claimed but not yet pushed, or still be
+            // on another thread's stack (if that thread has just moved it
+            // here); remove_pending() then does nothing, and we retry.
+            if (thread == _thread && on_pending_list())
+                thread->remove_pending(this);
+            else
+                click_relax_fence();
         }
 
         _owner = 0;
@@ -376,6 +365,34 @@ Task::move_thread(int new_thread_id)
         add_pending(false);
 }
 
+#if HAVE_MULTITHREAD
+/** @brief Move a stealable task from @a victim_thread_id to
+ * @a new_thread_id.
+ *
+ * Fails, returning false, unless the task is stealable, scheduled, and
+ * still homed on @a victim_thread_id. Unlike move_thread(), the home
+ * change is atomic, so it cannot undo a concurrent move_thread() or
+ * cleanup(). */
+bool
+Task::steal(int victim_thread_id, int new_thread_id)
+{
+    Task::Status old_status(_status);
+    if (!_stealable
+        || old_status.home_thread_id != victim_thread_id
+        || !old_status.is_scheduled
+        || old_status.is_strong_unscheduled)
+        return false;
+    Task::Status new_status(old_status);
+    new_status.home_thread_id = new_thread_id;
+    if (atomic_uint32_t::compare_swap(_status.status, old_status.status,
+                                      new_status.status) != old_status.status)
+        return false;
+    if (_pending_nextptr.x < 2)
+        add_pending(false);
+    return true;
+}
+#endif
+
 void
 Task::process_pending(RouterThread* thread)
 {
@@ -390,17 +407,21 @@ Task::process_pending(RouterThread* thread)
 
     Task::Status status(_status);
     if (status.home_thread_id != thread->thread_id()) {
-        SpinlockIRQ::flags_t flags = thread->_pending_lock.acquire();
+#if HAVE_MULTITHREAD
+        if (thread->thread_id() >= 0 && status.home_thread_id >= 0)
+            ++thread->_migrations;
+#endif
         remove_from_scheduled_list();
         click_fence();
         _thread = thread->master()->thread(status.home_thread_id);
-        thread->_pending_lock.release(flags);
     }
 
     if (status.is_scheduled && !status.is_strong_unscheduled)
         complete_schedule(thread);
-    else
+    else {
+        click_fence();
         _pending_nextptr.x = 0;
+    }
 }
 
 CLICK_ENDDECLS
@@ -270,6 +270,10 @@ Timer::schedule_at_steady(const Timestamp &when)
     // manipulate list; this is essentially a "decrease-key" operation
     // any reschedule removes a timer from the runchunk (XXX -- even backwards
     // reschedulings)
+    if (unlikely(ts._wheel) && ts.wheel_schedule(this)) {
+	ts.unlock_timers();
+	return;
+    }
     int old_schedpos1 = _schedpos1;
     if (_schedpos1 <= 0) {
 	if (_schedpos1 < 0)
@@ -313,7 +317,9 @@ Timer::unschedule()
 	ts._timer_heap.pop_back();
 	if (old_schedpos1 == 1)
 	    ts.set_timer_expiry();
-    } else if (_schedpos1 < 0)
+    } else if (_schedpos1 == TimerSet::schedpos_wheel)
+	ts.wheel_remove(this);
+    else if (_schedpos1 < 0)
 	ts._timer_runchunk[-_schedpos1 - 1] = 0;
     _schedpos1 = 0;
     ts.unlock_timers();
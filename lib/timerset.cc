@@ -48,6 +48,15 @@ TimerSet::TimerSet()
 #endif
     _timer_check = Timestamp::now_steady();
     _timer_check_reports = 0;
+
+    _wheel = 0;
+    _wheel_tick = 0;
+    _wheel_count = 0;
+}
+
+TimerSet::~TimerSet()
+{
+    delete[] _wheel;
 }
 
 void
@@ -55,6 +64,15 @@ TimerSet::kill_router(Router *router)
 {
     lock_timers();
     assert(!_timer_runchunk.size());
+    for (int i = 0; _wheel_count && i < wheel_nslots; ++i)
+	for (Timer *t = _wheel[i], *next; t; t = next) {
+	    next = t->_wheel_next;
+	    if (t->router() == router) {
+		wheel_remove(t);
+		t->_owner = 0;
+		t->_schedpos1 = 0;
+	    }
+	}
     for (heap_element *thp = _timer_heap.end();
 	 thp > _timer_heap.begin(); ) {
 	--thp;
@@ -78,6 +96,200 @@ TimerSet::set_max_timer_stride(unsigned timer_stride)
 	_timer_stride = _max_timer_stride;
 }
 
+void
+TimerSet::set_timer_wheel(bool wheel)
+{
+    lock_timers();
+    if (wheel && !_wheel) {
+	_wheel = new Timer *[wheel_nslots];
+	memset(_wheel, 0, sizeof(Timer *) * wheel_nslots);
+	memset(_wheel_bitmap0, 0, sizeof(_wheel_bitmap0));
+	_wheel_tick = Timestamp::now_steady().msecval();
+	_wheel_count = 0;
+    } else if (!wheel && _wheel) {
+	for (int i = 0; _wheel_count && i < wheel_nslots; ++i)
+	    while (Timer *t = _wheel[i]) {
+		wheel_remove(t);
+		heap_insert(t);
+	    }
+	delete[] _wheel;
+	_wheel = 0;
+	set_timer_expiry();
+    }
+    unlock_timers();
+}
+
+void
+TimerSet::heap_insert(Timer *t)
+{
+    t->_schedpos1 = _timer_heap.size() + 1;
+    _timer_heap.push_back(heap_element(t));
+    push_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+}
+
+bool
+TimerSet::wheel_insert(Timer *t)
+{
+    Timestamp::value_type tick = t->_expiry_s.msecval();
+    Timestamp::value_type delta = tick - _wheel_tick;
+    if (delta < 0 || delta >= wheel_span)
+	return false;
+
+    int slot;
+    if (delta < wheel_size0) {
+	slot = tick & (wheel_size0 - 1);
+	_wheel_bitmap0[slot / 64] |= (uint64_t) 1 << (slot % 64);
+    } else {
+	int level = 1, shift = wheel_bits0;
+	while (delta >= ((Timestamp::value_type) 1 << (shift + wheel_bits)))
+	    ++level, shift += wheel_bits;
+	slot = wheel_size0 + (level - 1) * wheel_size
+	    + ((tick >> shift) & (wheel_size - 1));
+    }
+
+    Timer **head = &_wheel[slot];
+    if ((t->_wheel_next = *head))
+	t->_wheel_next->_wheel_pprev = &t->_wheel_next;
+    t->_wheel_pprev = head;
+    *head = t;
+    t->_schedpos1 = schedpos_wheel;
+    ++_wheel_count;
+    return true;
+}
+
+void
+TimerSet::wheel_remove(Timer *t)
+{
+    if ((*t->_wheel_pprev = t->_wheel_next))
+	t->_wheel_next->_wheel_pprev = t->_wheel_pprev;
+    else if (t->_wheel_pprev >= _wheel && t->_wheel_pprev < _wheel + wheel_size0
+	     && !*t->_wheel_pprev) {
+	int slot = t->_wheel_pprev - _wheel;
+	_wheel_bitmap0[slot / 64] &= ~((uint64_t) 1 << (slot % 64));
+    }
+    --_wheel_count;
+    t->_schedpos1 = 0;
+}
+
+/* Schedule @a t, whose expiry is already set, in the wheel if it fits there.
+   Returns false, leaving @a t unscheduled or in the heap, if it does not. */
+bool
+TimerSet::wheel_schedule(Timer *t)
+{
+    if (t->_schedpos1 == schedpos_wheel)
+	wheel_remove(t);
+    if (!_wheel_count) {
+	Timestamp::value_type now_tick = Timestamp::recent_steady().msecval();
+	if (now_tick > _wheel_tick)
+	    _wheel_tick = now_tick;
+    }
+    // Timers due within the current tick stay exact in the heap.
+    if (t->_expiry_s.msecval() <= _wheel_tick)
+	return false;
+
+    int old_schedpos1 = t->_schedpos1;
+    if (old_schedpos1 > 0) {
+	remove_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+		       _timer_heap.begin() + old_schedpos1 - 1,
+		       heap_less(), heap_place());
+	_timer_heap.pop_back();
+    } else if (old_schedpos1 < 0)
+	_timer_runchunk[-old_schedpos1 - 1] = 0;
+    t->_schedpos1 = 0;
+    if (!wheel_insert(t)) {
+	if (old_schedpos1 == 1)
+	    set_timer_expiry();
+	return false;
+    }
+
+    Timestamp old_expiry = _timer_expiry;
+    Timestamp tick_start = Timestamp::make_msec(t->_expiry_s.msecval());
+    if (_wheel_count == 1 || tick_start < _wheel_expiry)
+	_wheel_expiry = tick_start;
+    set_timer_expiry();
+    if (_timer_expiry != old_expiry && _timer_expiry == _wheel_expiry)
+	t->_thread->wake();
+    return true;
+}
+
+/* Move every wheel timer due at or before @a tick into the heap. */
+void
+TimerSet::wheel_advance(Timestamp::value_type tick)
+{
+    while (_wheel_tick <= tick) {
+	if (!_wheel_count) {
+	    _wheel_tick = tick + 1;
+	    break;
+	}
+
+	int idx = _wheel_tick & (wheel_size0 - 1);
+	if (idx == 0) {
+	    // cascade one slot from each level whose lower level wrapped
+	    int shift = wheel_bits0;
+	    for (int level = 1; level < wheel_levels; ++level, shift += wheel_bits) {
+		int lidx = (_wheel_tick >> shift) & (wheel_size - 1);
+		Timer **head = &_wheel[wheel_size0 + (level - 1) * wheel_size + lidx];
+		while (Timer *t = *head) {
+		    wheel_remove(t);
+		    if (!wheel_insert(t))
+			heap_insert(t);
+		}
+		if (lidx != 0)
+		    break;
+	    }
+	}
+
+	while (Timer *t = _wheel[idx]) {
+	    wheel_remove(t);
+	    heap_insert(t);
+	}
+
+	// skip to the next occupied level-0 slot or the next cascade
+	Timestamp::value_type next = (_wheel_tick | (wheel_size0 - 1)) + 1;
+	for (int w = (idx + 1) / 64; w < wheel_size0 / 64; ++w) {
+	    uint64_t bits = _wheel_bitmap0[w];
+	    if (w == (idx + 1) / 64)
+		bits &= ~(uint64_t) 0 << ((idx + 1) % 64);
+	    if (bits) {
+		next = _wheel_tick + (w * 64 + ffs_lsb(bits) - 1 - idx);
+		break;
+	    }
+	}
+	_wheel_tick = next;
+    }
+    set_wheel_expiry();
+}
+
+void
+TimerSet::set_wheel_expiry()
+{
+    // A lower bound: the next occupied level-0 slot, or the next cascade.
+    Timestamp::value_type next = (_wheel_tick | (wheel_size0 - 1)) + 1;
+    int idx = _wheel_tick & (wheel_size0 - 1);
+    for (int w = idx / 64; w < wheel_size0 / 64; ++w) {
+	uint64_t bits = _wheel_bitmap0[w];
+	if (w == idx / 64)
+	    bits &= ~(uint64_t) 0 << (idx % 64);
+	if (bits) {
+	    next = _wheel_tick + (w * 64 + ffs_lsb(bits) - 1 - idx);
+	    break;
+	}
+    }
+    _wheel_expiry = Timestamp::make_msec(next);
+}
+
+/* Pull wheel timers into the heap until the heap's first timer is the
+   earliest scheduled timer.  Used by next_timer(). */
+void
+TimerSet::wheel_next_timer()
+{
+    while (_wheel_count
+	   && (_timer_heap.empty()
+	       || !(_timer_heap.unchecked_at(0).expiry_s < _wheel_expiry)))
+	wheel_advance(_wheel_expiry.msecval());
+    set_timer_expiry();
+}
+
 void
 TimerSet::check_timer_expiry(Timer *t)
 {
@@ -94,14 +306,29 @@ TimerSet::check_timer_expiry(Timer *t)
 inline void
 TimerSet::run_one_timer(Timer *t)
 {
-#if CLICK_STATS >= 2
+#if CLICK_STATS >= 2 || HAVE_PERF_EVENTS
+    // The callback may delete the timer.
     Element *owner = t->_owner;
+#endif
+#if CLICK_STATS >= 2
     click_cycles_t start_cycles = click_get_cycles(),
 	start_child_cycles = owner->_child_cycles;
 #endif
 
+#if HAVE_PERF_EVENTS
+    PerfEvents::Frame frame;
+    bool profiled = PerfEvents::active();
+    if (unlikely(profiled))
+	PerfEvents::enter(frame);
+#endif
+
     t->_hook.callback(t, t->_thunk);
 
+#if HAVE_PERF_EVENTS
+    if (unlikely(profiled))
+	PerfEvents::exit(frame, owner, PerfEvents::TIMER);
+#endif
+
 #if CLICK_STATS >= 2
     click_cycles_t all_delta = click_get_cycles() - start_cycles,
 	own_delta = all_delta - (owner->_child_cycles - start_child_cycles);
@@ -115,7 +342,8 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 {
     if (!_timer_lock.attempt())
 	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
+    if (!master->paused() && (_timer_heap.size() > 0 || _wheel_count)
+	&& !thread->stop_flag()) {
 	thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
 	_timer_task = current;
@@ -123,9 +351,13 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 	_timer_processor = click_current_processor();
 #endif
 	_timer_check = Timestamp::now_steady();
+	if (_wheel_count && _wheel_expiry <= _timer_check) {
+	    wheel_advance(_timer_check.msecval());
+	    set_timer_expiry();
+	}
 	heap_element *th = _timer_heap.begin();
 
-	if (th->expiry_s <= _timer_check) {
+	if (_timer_heap.size() > 0 && th->expiry_s <= _timer_check) {
 	    // potentially adjust timer stride
 	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
 	    if (adj_expiry <= _timer_check) {
@@ -58,6 +58,7 @@
 #include <click/userutils.hh>
 #include <click/args.hh>
 #include <click/handlercall.hh>
+#include <click/packettrace.hh>
 #include "elements/standard/quitwatcher.hh"
 #include "elements/userlevel/controlsocket.hh"
 CLICK_USING_DECLS
@@ -82,17 +83,31 @@ CLICK_USING_DECLS
 #define SOCKET_OPT              318
 #define THREADS_AFF_OPT         319
 #define DPDK_OPT                320
+#define PACKET_POOL_OPT         321
+#define PACKET_BUFSIZ_OPT       322
+#define PACKET_ARENA_OPT        323
+#define HUGEPAGES_OPT           324
+#define TIMER_WHEEL_OPT         325
+#define PERF_OPT                326
+#define TRACE_OPT               327
+#define CONFIG_CACHE_OPT        328
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
     { "clickpath", 'C', CLICKPATH_OPT, Clp_ValString, 0 },
+    { "config-cache", 0, CONFIG_CACHE_OPT, Clp_ValString, 0 },
     { "expression", 'e', EXPRESSION_OPT, Clp_ValString, 0 },
     { "dpdk", 0, DPDK_OPT, 0, 0 },
     { "file", 'f', ROUTER_OPT, Clp_ValString, 0 },
     { "handler", 'h', HANDLER_OPT, Clp_ValString, 0 },
     { "help", 0, HELP_OPT, 0, 0 },
+    { "hugepages", 0, HUGEPAGES_OPT, 0, Clp_Negate },
     { "output", 'o', OUTPUT_OPT, Clp_ValString, 0 },
+    { "packet-arenas", 0, PACKET_ARENA_OPT, 0, Clp_Negate },
+    { "packet-buffer-size", 0, PACKET_BUFSIZ_OPT, Clp_ValUnsigned, 0 },
+    { "packet-pool-size", 0, PACKET_POOL_OPT, Clp_ValUnsigned, 0 },
     { "socket", 0, SOCKET_OPT, Clp_ValInt, 0 },
+    { "perf", 0, PERF_OPT, 0, Clp_Negate },
     { "port", 'p', PORT_OPT, Clp_ValString, 0 },
     { "quit", 'q', QUIT_OPT, 0, 0 },
     { "simtime", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
@@ -101,6 +116,8 @@ static const Clp_Option options[] = {
     { "cpu", 0, THREADS_AFF_OPT, Clp_ValInt, Clp_Optional | Clp_Negate },
     { "affinity", 'a', THREADS_AFF_OPT, Clp_ValInt, Clp_Optional | Clp_Negate },
     { "time", 't', TIME_OPT, 0, 0 },
+    { "trace", 0, TRACE_OPT, Clp_ValUnsigned, 0 },
+    { "timer-wheel", 0, TIMER_WHEEL_OPT, 0, Clp_Negate },
     { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
     { "version", 'v', VERSION_OPT, 0, 0 },
     { "warnings", 0, WARNINGS_OPT, 0, Clp_Negate },
@@ -154,6 +171,14 @@ Options:\n\
   -w, --no-warnings             Do not print warnings.\n\
       --simtime                 Run in simulation time.\n\
   -C, --clickpath PATH          Use PATH for CLICKPATH.\n\
+      --config-cache DIR        Cache parsed configurations in DIR.\n\
+      --packet-pool-size N      Keep up to N free packets per thread.\n\
+      --packet-buffer-size N    Pool packet data buffers of N bytes.\n\
+      --packet-arenas           Carve packet data from per-NUMA-node arenas.\n\
+      --hugepages               Back packet arenas with hugepages.\n\
+      --timer-wheel             Keep far-off timers in a timing wheel.\n\
+      --perf                    Profile elements with hardware counters.\n\
+      --trace N                 Trace one in N packets through the router.\n\
       --help                    Print this message and exit.\n\
   -v, --version                 Print version number and exit.\n\
 \n\
@@ -221,7 +246,7 @@ call_read_handler(Element *e, String handler_name,
   String result = rh->call_read(e);
   if (!rh->raw() && result && result.back() != '\n')
       result += '\n';
-  fputs(result.c_str(), stdout);
+  fwrite(result.data(), 1, result.length(), stdout);
   if (print_name)
     fputs("\n", stdout);
 
@@ -443,6 +468,36 @@ timewarp_read_handler(Element *, void *)
         return String(Timestamp::warp_speed());
 }
 
+#if HAVE_CLICK_PACKET_POOL
+enum { pool_hits, pool_misses, pool_steals, pool_stats };
+
+static String
+packet_pool_read_handler(Element *, void *thunk)
+{
+    Packet::PoolStatistics stats;
+    Packet::pool_statistics(stats);
+    switch ((intptr_t) thunk) {
+    case pool_hits:
+        return String(stats.hits);
+    case pool_misses:
+        return String(stats.misses);
+    case pool_steals:
+        return String(stats.steals);
+    default: {
+        StringAccum sa;
+        sa << "hits " << stats.hits << "\n"
+           << "misses " << stats.misses << "\n"
+           << "steals " << stats.steals << "\n"
+           << "donations " << stats.donations << "\n"
+           << "frees " << stats.frees << "\n"
+           << "arena_chunks " << stats.arena_chunks << "\n"
+           << "hugepage_chunks " << stats.hugepage_chunks << "\n";
+        return sa.take_string();
+    }
+    }
+}
+#endif
+
 static int
 timewarp_write_handler(const String &text, Element *, void *, ErrorHandler *errh)
 {
@@ -533,6 +588,12 @@ main(int argc, char **argv)
   Vector<String> handlers;
   String exit_handler;
   Vector<char*> dpdk_arg;
+  uint32_t packet_pool_size = 0;
+  uint32_t packet_buffer_size = 0;
+  int packet_arena = 0;
+  bool timer_wheel = false;
+  bool perf_profiling = false;
+  uint32_t trace_sample = 0;
 
   while (1) {
     int opt = Clp_Next(clp);
@@ -636,6 +697,52 @@ main(int argc, char **argv)
       break;
      }
 #endif // HAVE_DPDK
+     case PACKET_POOL_OPT:
+      packet_pool_size = clp->val.u;
+      break;
+
+     case PACKET_BUFSIZ_OPT:
+      packet_buffer_size = clp->val.u;
+      break;
+
+     case PACKET_ARENA_OPT:
+      if (clp->negated)
+          packet_arena = 0;
+      else
+          packet_arena |= Packet::pool_arena_numa;
+      break;
+
+     case HUGEPAGES_OPT:
+      if (clp->negated)
+          packet_arena &= ~Packet::pool_arena_hugepages;
+      else
+          packet_arena |= Packet::pool_arena_numa | Packet::pool_arena_hugepages;
+      break;
+
+     case TIMER_WHEEL_OPT:
+      timer_wheel = !clp->negated;
+      break;
+
+     case PERF_OPT:
+      perf_profiling = !clp->negated;
+#if !HAVE_PERF_EVENTS
+      if (perf_profiling)
+          errh->warning("Click was built without perf_event support, ignoring --perf");
+#endif
+      break;
+
+     case CONFIG_CACHE_OPT:
+      click_set_config_cache(clp->vstr);
+      break;
+
+     case TRACE_OPT:
+      trace_sample = clp->val.u;
+#if !HAVE_PACKET_TRACE
+      if (trace_sample)
+          errh->warning("Click was built without packet tracing, ignoring --trace");
+#endif
+      break;
+
      case THREADS_OPT:
       click_nthreads = clp->val.i;
       if (click_nthreads <= 1)
@@ -718,19 +825,51 @@ particular purpose.\n");
     }
 #endif
 
+  // size packet pools before any packets exist
+  if (packet_pool_size || packet_buffer_size || packet_arena) {
+#if HAVE_CLICK_PACKET_POOL
+      int r = Packet::set_pool_parameters(packet_pool_size, packet_buffer_size, packet_arena);
+      if (r == -EOPNOTSUPP)
+          errh->warning("packet arenas are not supported on this platform");
+      else if (r < 0) {
+          errh->error("bad packet pool parameters");
+          return cleanup(clp, 1);
+      }
+#else
+      errh->warning("Click was built without packet pools, ignoring packet pool options");
+#endif
+  }
+
   // provide hotconfig handler if asked
   if (allow_reconfigure)
       Router::add_write_handler(0, "hotconfig", hotconfig_handler, 0, Handler::f_raw | Handler::f_nonexclusive);
   Router::add_read_handler(0, "timewarp", timewarp_read_handler, 0);
+#if HAVE_CLICK_PACKET_POOL
+  Router::add_read_handler(0, "packet_pool_hits", packet_pool_read_handler, (void *) pool_hits);
+  Router::add_read_handler(0, "packet_pool_misses", packet_pool_read_handler, (void *) pool_misses);
+  Router::add_read_handler(0, "packet_pool_steals", packet_pool_read_handler, (void *) pool_steals);
+  Router::add_read_handler(0, "packet_pool_stats", packet_pool_read_handler, (void *) pool_stats);
+#endif
   if (Timestamp::warp_class() != Timestamp::warp_simulation)
       Router::add_write_handler(0, "timewarp", timewarp_write_handler, 0);
 
   // parse configuration
   click_master = new Master(click_nthreads);
+  if (timer_wheel)
+      for (int t = 0; t < click_nthreads; ++t)
+          click_master->thread(t)->timer_set().set_timer_wheel(true);
   click_router = parse_configuration(router_file, file_is_expr, false, errh);
   if (!click_router)
     return cleanup(clp, 1);
   click_router->use();
+#if HAVE_PERF_EVENTS
+  if (perf_profiling)
+      PerfEvents::set_active(click_router, true);
+#endif
+#if HAVE_PACKET_TRACE
+  if (trace_sample)
+      PacketTrace::set_sample_rate(click_router, trace_sample);
+#endif
 
   int exit_value = 0;
 #if (HAVE_MULTITHREAD)